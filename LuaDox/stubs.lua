@@ -36,6 +36,10 @@ function ofs.ScriptCount() end
 -- @treturn String Name
 function ofs.ScriptName(scriptIdx) end
 
+--- Request a few more frames, update and gui get called for them.
+-- OFS stops drawing while nothing changes, extensions which animate something call this every update.
+function ofs.RequestUpdate() end
+
 --- Funscript.
 -- @section funscript
 
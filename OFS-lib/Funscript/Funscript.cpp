@@ -7,6 +7,8 @@
 #include "EventSystem.h"
 #include "OFS_Serialization.h"
 #include "FunscriptUndoSystem.h"
+#include "OFS_AsyncIO.h"
+#include "OFS_Localization.h"
 
 #include <algorithm>
 #include <limits>
@@ -14,14 +16,14 @@
 Funscript::Funscript() 
 {
 	NotifyActionsChanged(false);
-	saveMutex = SDL_CreateMutex();
+	publishSnapshot();
 	undoSystem = std::make_unique<FunscriptUndoSystem>(this);
 	editTime = std::chrono::system_clock::now();
 }
 
 Funscript::~Funscript()
 {
-	SDL_DestroyMutex(saveMutex);
+	saveTask.Wait();
 }
 
 void Funscript::loadMetadata() noexcept
@@ -39,25 +41,32 @@ void Funscript::saveMetadata() noexcept
 	OFS::serializer::save(&LocalMetadata, &Json["metadata"]);
 }
 
-void Funscript::startSaveThread(const std::string& path, FunscriptArray&& actions, nlohmann::json&& json) noexcept
+// failed saves get reported like failed project saves
+static OFS_Task<OFS_AsyncIO::Result> WriteSave(OFS_AsyncIO::Write&& write) noexcept
+{
+	auto task = OFS_AsyncIO::WriteOrQueue(std::move(write));
+	task.ThenOnMain([](auto& result) {
+		if (!result.Success) {
+			Util::MessageBoxAlert(TR(ERROR_STR), FMT(TR(FAILED_TO_SAVE_FMT), result.Path.c_str()));
+		}
+	});
+	return task;
+}
+
+void Funscript::startSaveTask(const std::string& path, FunscriptArray&& actions, nlohmann::json&& json) noexcept
 {
 	OFS_PROFILE(__FUNCTION__);
-	struct SaveThreadData {
+	struct SaveTaskData {
 		nlohmann::json jsonObj;
 		FunscriptArray actions;
 		std::string path;
-		SDL_mutex* mutex;
 	};
-	SaveThreadData* threadData = new SaveThreadData();
-	threadData->mutex = saveMutex;
-	threadData->path = path;
-	threadData->jsonObj = std::move(json); // give ownership to the thread
-	threadData->actions = std::move(actions);
-
-	auto thread = [](void* user) -> int {
-		SaveThreadData* data = static_cast<SaveThreadData*>(user);
-		SDL_LockMutex(data->mutex);
+	auto data = std::make_shared<SaveTaskData>();
+	data->path = path;
+	data->jsonObj = std::move(json); // give ownership to the task
+	data->actions = std::move(actions);
 
+	auto saveJob = [data]() {
 		data->jsonObj["actions"] = nlohmann::json::array();
 		data->jsonObj["version"] = "1.0";
 		data->jsonObj["inverted"] = false;
@@ -81,19 +90,25 @@ void Funscript::startSaveThread(const std::string& path, FunscriptArray&& action
 				};
 				actions.emplace_back(std::move(actionObj));
 			}
-	}
+		}
 
 #ifdef NDEBUG
-		Util::WriteJson(data->jsonObj, data->path.c_str());
+		auto jsonText = data->jsonObj.dump(-1, ' ');
 #else
-		Util::WriteJson(data->jsonObj, data->path.c_str(), true);
+		auto jsonText = data->jsonObj.dump(4, ' ');
 #endif
-		SDL_UnlockMutex(data->mutex);
-		delete data;
-		return 0;
+		OFS_AsyncIO::Write write;
+		write.Path = std::move(data->path);
+		write.Buffer.assign(jsonText.begin(), jsonText.end());
+		WriteSave(std::move(write));
 	};
-	auto handle = SDL_CreateThread(thread, "SaveScriptThread", threadData);
-	SDL_DetachThread(handle);
+
+	if (saveTask.Done()) {
+		saveTask = OFS_TaskScheduler::Spawn(std::move(saveJob), OFS_TaskPriority::Background);
+	}
+	else {
+		saveTask = saveTask.Then(std::move(saveJob), OFS_TaskPriority::Background);
+	}
 }
 
 void Funscript::update() noexcept
@@ -101,14 +116,26 @@ void Funscript::update() noexcept
 	OFS_PROFILE(__FUNCTION__);
 	if (funscriptChanged) {
 		funscriptChanged = false;
-		EventSystem::PushEvent(FunscriptEvents::FunscriptActionsChangedEvent, this);
+		publishSnapshot();
+		if (EventSystem::instance) {
+			EventSystem::ev().Post(FunscriptEvents::FunscriptActionsChangedEvent, this, dirtyRange);
+		}
 	}
 	if (selectionChanged) {
 		selectionChanged = false;
-		EventSystem::PushEvent(FunscriptEvents::FunscriptSelectionChangedEvent, this);
+		if (EventSystem::instance) {
+			EventSystem::ev().Post(FunscriptEvents::FunscriptSelectionChangedEvent, this);
+		}
 	}
 }
 
+void Funscript::publishSnapshot() noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	auto snapshot = std::make_shared<const FunscriptArray>(data.Actions);
+	std::atomic_store(&actionsSnapshot, std::move(snapshot));
+}
+
 float Funscript::GetPositionAtTime(float time) noexcept
 {
 	OFS_PROFILE(__FUNCTION__);
@@ -164,6 +191,7 @@ void Funscript::EditActionUnsafe(FunscriptAction* edit, FunscriptAction action)
 	if (edit >= data.Actions.begin() && edit < data.Actions.end()) {
 		FunscriptAction* before = edit > data.Actions.begin() ? edit - 1 : edit;
 		FunscriptAction* after = edit + 1 != data.Actions.end() ? edit + 1 : edit;
+		EventRange range = editRange(edit->atS, action.atS);
 
 		if (before->atS < action.atS && after->atS > action.atS) {
 			*edit = action;
@@ -176,7 +204,7 @@ void Funscript::EditActionUnsafe(FunscriptAction* edit, FunscriptAction action)
 				data.Actions.emplace(copyDeleted);
 			}
 		}
-		NotifyActionsChanged(true);
+		NotifyActionsChanged(true, range);
 	}
 }
 
@@ -186,10 +214,11 @@ bool Funscript::EditAction(FunscriptAction oldAction, FunscriptAction newAction)
 	// update action
 	auto act = getAction(oldAction);
 	if (act != nullptr) {
+		auto range = editRange(oldAction.atS, newAction.atS);
 		act->atS = newAction.atS;
 		act->pos = newAction.pos;
 		checkForInvalidatedActions();
-		NotifyActionsChanged(true);
+		NotifyActionsChanged(true, range);
 		sortActions(data.Actions);
 		return true;
 	}
@@ -201,8 +230,9 @@ void Funscript::AddEditAction(FunscriptAction action, float frameTime) noexcept
 	OFS_PROFILE(__FUNCTION__);
 	auto close = getActionAtTime(data.Actions, action.atS, frameTime);
 	if (close != nullptr) {
+		EventRange range = editRange(close->atS, action.atS);
 		*close = action;
-		NotifyActionsChanged(true);
+		NotifyActionsChanged(true, range);
 		checkForInvalidatedActions();
 	}
 	else {
@@ -230,8 +260,9 @@ void Funscript::RemoveAction(FunscriptAction action, bool checkInvalidSelection)
 	OFS_PROFILE(__FUNCTION__);
 	auto it = data.Actions.find(action);
 	if (it != data.Actions.end()) {
+		auto range = editRange(action.atS, action.atS);
 		data.Actions.erase(it);
-		NotifyActionsChanged(true);
+		NotifyActionsChanged(true, range);
 
 		if (checkInvalidSelection) { checkForInvalidatedActions(); }
 	}
@@ -316,6 +347,7 @@ void Funscript::SetActions(const FunscriptArray& override_with) noexcept
 void Funscript::RemoveActionsInInterval(float fromTime, float toTime) noexcept
 {
 	OFS_PROFILE(__FUNCTION__);
+	auto range = editRange(fromTime, toTime);
 	data.Actions.erase(
 		std::remove_if(data.Actions.begin(), data.Actions.end(),
 			[fromTime, toTime](auto action) {
@@ -323,7 +355,7 @@ void Funscript::RemoveActionsInInterval(float fromTime, float toTime) noexcept
 			}), data.Actions.end()
 	);
 	checkForInvalidatedActions();
-	NotifyActionsChanged(true);
+	NotifyActionsChanged(true, range);
 }
 
 void Funscript::RangeExtendSelection(int32_t rangeExtend) noexcept
@@ -510,12 +542,9 @@ void Funscript::SelectTime(float fromTime, float toTime, bool clear) noexcept
 	if(clear)
 		ClearSelection();
 
-	for (auto& action : data.Actions) {
-		if (action.atS >= fromTime && action.atS <= toTime) {
-			ToggleSelection(action);
-		}
-		else if (action.atS > toTime)
-			break;
+	auto it = data.Actions.lower_bound(FunscriptAction(fromTime, 0));
+	for (; it != data.Actions.end() && it->atS <= toTime; ++it) {
+		ToggleSelection(*it);
 	}
 
 	if (!clear)
@@ -752,8 +781,8 @@ int32_t FunscriptEvents::FunscriptSelectionChangedEvent = 0;
 
 void FunscriptEvents::RegisterEvents() noexcept
 {
-	FunscriptActionsChangedEvent = SDL_RegisterEvents(1);
-	FunscriptSelectionChangedEvent = SDL_RegisterEvents(1);
+	FunscriptActionsChangedEvent = EventSystem::RegisterEvent("FunscriptActionsChanged", EventCoalesce::MergeRanges);
+	FunscriptSelectionChangedEvent = EventSystem::RegisterEvent("FunscriptSelectionChanged", EventCoalesce::LatestWins);
 }
 
 bool Funscript::Metadata::loadFromFunscript(const std::string& path) noexcept
@@ -772,10 +801,14 @@ bool Funscript::Metadata::writeToFunscript(const std::string& path) noexcept
 	OFS_PROFILE(__FUNCTION__);
 	bool succ;
 	auto json = Util::LoadJson(path, &succ);
-	if (succ) {
-		json["metadata"] = nlohmann::json::object();
-		OFS::serializer::save(this, &json["metadata"]);
-		Util::WriteJson(json, path, false);
-	}
-	return succ;
+	if (!succ) return false;
+
+	json["metadata"] = nlohmann::json::object();
+	OFS::serializer::save(this, &json["metadata"]);
+	auto jsonText = json.dump(-1, ' ');
+	OFS_AsyncIO::Write write;
+	write.Path = path;
+	write.Buffer.assign(jsonText.begin(), jsonText.end());
+	// only true once the file is actually written
+	return WriteSave(std::move(write)).Get().Success;
 }
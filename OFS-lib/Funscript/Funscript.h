@@ -9,17 +9,24 @@
 #include <string>
 #include <memory>
 #include <chrono>
+#include <algorithm>
 
 #include "OFS_Util.h"
-#include "SDL_mutex.h"
+#include "OFS_TaskScheduler.h"
+#include "EventSystem.h"
 
 #include "FunscriptSpline.h"
+#include "FunscriptCursor.h"
 #include "OFS_Profiling.h"
+#include "OFS_Redraw.h"
 
 #include "EASTL/sort.h"
 
 class FunscriptUndoSystem;
 
+// immutable copy of a scripts actions which can be shared with other threads
+using FunscriptSnapshot = std::shared_ptr<const FunscriptArray>;
+
 class FunscriptEvents
 {
 public:
@@ -125,9 +132,23 @@ private:
 	bool funscriptChanged = false; // used to fire only one event every frame a change occurs
 	bool unsavedEdits = false; // used to track if the script has unsaved changes
 	bool selectionChanged = false;
-	SDL_mutex* saveMutex = nullptr;
+	// times touched since the last event, handlers get it through data2
+	EventRange dirtyRange = EventRange::All();
+	// every save is chained onto the previous one so they can't overtake each other
+	OFS_Task<void> saveTask;
 	FunscriptData data;
 
+	// incremented on every change to data.Actions
+	// used to invalidate cached lookups
+	uint32_t actionsRevision = 1;
+	FunscriptCursor playheadCursor;
+	FunscriptWindowCursor windowCursor;
+
+	// published once per frame after the actions changed
+	// only ever accessed through std::atomic_load/std::atomic_store
+	FunscriptSnapshot actionsSnapshot;
+	void publishSnapshot() noexcept;
+
 	void checkForInvalidatedActions() noexcept;
 
 	inline FunscriptAction* getAction(FunscriptAction action) noexcept
@@ -140,6 +161,15 @@ private:
 
 	public:
 	static inline FunscriptAction* getActionAtTime(FunscriptArray& actions, float time, float maxErrorTime) noexcept
+	{
+		OFS_PROFILE(__FUNCTION__);
+		if (actions.empty()) return nullptr;
+		auto it = actions.lower_bound(FunscriptAction(time - maxErrorTime, 0));
+		return getActionAtTime(actions, std::distance(actions.begin(), it), time, maxErrorTime);
+	}
+
+	// lowerBoundIdx has to be the index of the first action with atS >= (time - maxErrorTime)
+	static inline FunscriptAction* getActionAtTime(FunscriptArray& actions, int32_t lowerBoundIdx, float time, float maxErrorTime) noexcept
 	{
 		OFS_PROFILE(__FUNCTION__);
 		if (actions.empty()) return nullptr;
@@ -147,12 +177,8 @@ private:
 		float smallestError = std::numeric_limits<float>::max();
 		FunscriptAction* smallestErrorAction = nullptr;
 
-		int i = 0;
-		auto it = actions.lower_bound(FunscriptAction(time - maxErrorTime, 0));
-		if (it != actions.end()) {
-			i = std::distance(actions.begin(), it);
-			if (i > 0) --i;
-		}
+		int i = lowerBoundIdx;
+		if (i > 0) --i;
 
 		for (; i < actions.size(); i++) {
 			auto& action = actions[i];
@@ -174,20 +200,42 @@ private:
 		return smallestErrorAction;
 	}
 	private:
+	inline FunscriptAction* getActionAtTime(float time, float maxErrorTime) noexcept
+	{
+		OFS_PROFILE(__FUNCTION__);
+		if (data.Actions.empty()) return nullptr;
+		int32_t idx = playheadCursor.LowerBound(data.Actions, time - maxErrorTime, actionsRevision);
+		return getActionAtTime(data.Actions, idx, time, maxErrorTime);
+	}
+
 	inline FunscriptAction* getNextActionAhead(float time) noexcept
 	{
 		OFS_PROFILE(__FUNCTION__);
 		if (data.Actions.empty()) return nullptr;
-		auto it = data.Actions.upper_bound(FunscriptAction(time, 0));
-		return it != data.Actions.end() ? it : nullptr;
+		int32_t idx = playheadCursor.LowerBound(data.Actions, time, actionsRevision);
+		while (idx < data.Actions.size() && data.Actions[idx].atS <= time) { ++idx; }
+		return idx < data.Actions.size() ? &data.Actions[idx] : nullptr;
 	}
 
 	inline FunscriptAction* getPreviousActionBehind(float time) noexcept
 	{
 		OFS_PROFILE(__FUNCTION__);
 		if (data.Actions.empty()) return nullptr;
-		auto it = data.Actions.lower_bound(FunscriptAction(time, 0));
-		return it-1 >= data.Actions.begin() ? it - 1 : nullptr;
+		int32_t idx = playheadCursor.LowerBound(data.Actions, time, actionsRevision);
+		return idx > 0 ? &data.Actions[idx - 1] : nullptr;
+	}
+
+	// an edit between from and to also changes the strokes to the actions around it
+	// needs sorted actions, call it before changing anything
+	inline EventRange editRange(float from, float to) const noexcept
+	{
+		EventRange range = { std::min(from, to), std::max(from, to) };
+		auto& actions = data.Actions;
+		auto before = std::lower_bound(actions.begin(), actions.end(), FunscriptAction(range.begin, 0));
+		if (before != actions.begin()) { range.begin = (before - 1)->atS; }
+		auto after = std::upper_bound(actions.begin(), actions.end(), FunscriptAction(range.end, 0));
+		if (after != actions.end()) { range.end = after->atS; }
+		return range;
 	}
 
 	void moveAllActionsTime(float timeOffset);
@@ -199,8 +247,9 @@ private:
 	}
 	inline void addAction(FunscriptArray& actions, FunscriptAction newAction) noexcept {
 		OFS_PROFILE(__FUNCTION__);
+		auto range = editRange(newAction.atS, newAction.atS);
 		actions.emplace(newAction);
-		NotifyActionsChanged(true);
+		NotifyActionsChanged(true, range);
 	}
 
 	inline void NotifySelectionChanged() noexcept {
@@ -210,22 +259,23 @@ private:
 	void loadMetadata() noexcept;
 	void saveMetadata() noexcept;
 
-	void startSaveThread(const std::string& path, FunscriptArray&& actions, nlohmann::json&& json) noexcept;	
+	void startSaveTask(const std::string& path, FunscriptArray&& actions, nlohmann::json&& json) noexcept;	
 	std::string CurrentPath;
 public:
 	Funscript();
 	~Funscript();
 
-	inline void NotifyActionsChanged(bool isEdit) noexcept {
+	inline void NotifyActionsChanged(bool isEdit, const EventRange& range = EventRange::All()) noexcept {
+		if (funscriptChanged) { dirtyRange.Merge(range); }
+		else { dirtyRange = range; }
 		funscriptChanged = true;
+		// scripts also get edited by lua and the websocket api
+		OFS_Redraw::Request();
+		if (++actionsRevision == 0) { actionsRevision = 1; }
 		if (isEdit && !unsavedEdits) {
 			unsavedEdits = true;
 			editTime = std::chrono::system_clock::now();
 		}
-
-#ifndef NDEBUG
-		data.Actions.set_capacity(data.Actions.size()); // force threading issues
-#endif
 	}
 
 	std::unique_ptr<FunscriptUndoSystem> undoSystem;
@@ -256,12 +306,23 @@ public:
 	const FunscriptData& Data() const noexcept { return data; }
 	const auto& Selection() const noexcept { return data.selection; }
 	const auto& Actions() const noexcept { return data.Actions; }
+	inline uint32_t ActionsRevision() const noexcept { return actionsRevision; }
+	// latest published actions, safe to call from any thread
+	// the editor never waits on readers since every change publishes a new copy
+	inline FunscriptSnapshot ActionsSnapshot() const noexcept { return std::atomic_load(&actionsSnapshot); }
+
+	// range of actions overlapping [fromTime, toTime]
+	// cached between frames, meant to be queried once per frame by the timeline
+	inline const FunscriptWindowCursor& VisibleWindow(float fromTime, float toTime) noexcept {
+		windowCursor.Update(data.Actions, fromTime, toTime, actionsRevision);
+		return windowCursor;
+	}
 
 	inline const FunscriptAction* GetAction(FunscriptAction action) noexcept { return getAction(action); }
-	inline const FunscriptAction* GetActionAtTime(float time, float errorTime) noexcept { return getActionAtTime(data.Actions, time, errorTime); }
+	inline const FunscriptAction* GetActionAtTime(float time, float errorTime) noexcept { return getActionAtTime(time, errorTime); }
 	inline const FunscriptAction* GetNextActionAhead(float time) noexcept { return getNextActionAhead(time); }
 	inline const FunscriptAction* GetPreviousActionBehind(float time) noexcept { return getPreviousActionBehind(time); }
-	inline const FunscriptAction* GetClosestAction(float time) noexcept { return getActionAtTime(data.Actions, time, std::numeric_limits<float>::max()); }
+	inline const FunscriptAction* GetClosestAction(float time) noexcept { return getActionAtTime(time, std::numeric_limits<float>::max()); }
 
 	float GetPositionAtTime(float time) noexcept;
 	
@@ -378,5 +439,5 @@ inline void Funscript::save(const std::string& path, bool override_location)
 	}
 
 	auto copyActions = data.Actions;
-	startSaveThread(path, std::move(copyActions), std::move(Json));
+	startSaveTask(path, std::move(copyActions), std::move(Json));
 }
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+#include "OFS_Profiling.h"
+#include "FunscriptAction.h"
+
+#include <cstdint>
+#include <iterator>
+
+#include "EASTL/vector_set.h"
+
+// Frame coherent lower_bound cache for a FunscriptArray.
+// Lookups which only drift a little between frames (playback, scrolling)
+// are resolved by walking from the previous result.
+// Everything else falls back to a binary search.
+class FunscriptCursor
+{
+	uint32_t revision = 0; // 0 means invalid
+	int32_t cacheIdx = 0;
+
+	static constexpr int32_t MaxWalk = 32;
+public:
+	inline void Invalidate() noexcept { revision = 0; }
+
+	// returns the index of the first action with atS >= time
+	inline int32_t LowerBound(const FunscriptArray& actions, float time, uint32_t actionsRevision) noexcept
+	{
+		OFS_PROFILE(__FUNCTION__);
+		const int32_t size = actions.size();
+		if (revision == actionsRevision && cacheIdx <= size) {
+			int32_t walked = 0;
+			while (cacheIdx > 0 && actions[cacheIdx - 1].atS >= time && walked < MaxWalk) { --cacheIdx; ++walked; }
+			while (cacheIdx < size && actions[cacheIdx].atS < time && walked < MaxWalk) { ++cacheIdx; ++walked; }
+			if (walked < MaxWalk) {
+				// cache hit!
+				return cacheIdx;
+			}
+		}
+		// cache miss
+		auto it = actions.lower_bound(FunscriptAction(time, 0));
+		cacheIdx = std::distance(actions.begin(), it);
+		revision = actionsRevision;
+		return cacheIdx;
+	}
+};
+
+// Tracks the range of actions visible in a time window.
+// The range includes one action on each side of the window
+// so lines going out of view can still be drawn.
+class FunscriptWindowCursor
+{
+	FunscriptCursor fromCursor;
+	FunscriptCursor toCursor;
+public:
+	int32_t FromIdx = 0;
+	int32_t ToIdx = 0;
+
+	inline void Invalidate() noexcept { fromCursor.Invalidate(); toCursor.Invalidate(); }
+
+	inline void Update(const FunscriptArray& actions, float fromTime, float toTime, uint32_t actionsRevision) noexcept
+	{
+		OFS_PROFILE(__FUNCTION__);
+		const int32_t size = actions.size();
+		FromIdx = fromCursor.LowerBound(actions, fromTime, actionsRevision);
+		if (FromIdx > 0) { FromIdx -= 1; }
+
+		ToIdx = toCursor.LowerBound(actions, toTime, actionsRevision);
+		if (ToIdx < size) { ToIdx += 1; }
+	}
+};
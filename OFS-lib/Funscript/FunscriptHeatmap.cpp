@@ -2,6 +2,8 @@
 #include "OFS_Util.h"
 #include "OFS_Profiling.h"
 #include <array>
+#include <limits>
+#include <algorithm>
 
 ImGradient HeatmapGradient::Colors;
 
@@ -35,6 +37,11 @@ HeatmapGradient::HeatmapGradient() noexcept
 }
 
 void HeatmapGradient::Update(float totalDuration, const FunscriptArray& actions) noexcept
+{
+    Update(totalDuration, actions, -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity());
+}
+
+void HeatmapGradient::Update(float totalDuration, const FunscriptArray& actions, float fromTime, float toTime) noexcept
 {
     OFS_PROFILE(__FUNCTION__);
     ImColor BackgroundColor(0.f, 0.f, 0.f, 1.f);
@@ -42,26 +49,61 @@ void HeatmapGradient::Update(float totalDuration, const FunscriptArray& actions)
     Gradient.clear();
     Gradient.addMark(0.f, BackgroundColor);
     Gradient.addMark(1.f, BackgroundColor);
-    if (actions.empty()) { Gradient.refreshCache(); return; }
+    if (actions.empty()) { 
+        Speeds.clear();
+        Gradient.refreshCache();
+        return;
+    }
 
-    constexpr float GapDuration = 10.f;
     constexpr float MinSegmentTime = 2.f;
     constexpr int32_t MaxSegments = 200;
-    int SegmentCount = Util::Clamp((int32_t)std::round(totalDuration / MinSegmentTime), 1, MaxSegments);
-    Speeds.clear(); Speeds.resize(SegmentCount, 0.f);
-    
-    float SegmentDuration = totalDuration / MaxSegments;
+    int32_t SegmentCount = Util::Clamp((int32_t)std::round(totalDuration / MinSegmentTime), 1, MaxSegments);
+    auto segmentAt = [totalDuration, SegmentCount](float time) noexcept {
+        return (int32_t)(Util::Clamp(time / totalDuration, 0.f, 1.f) * (SegmentCount - 1));
+    };
+    // stroke i goes from action i - 1 to action i and counts for the segment of its midpoint
+    // midpoints grow with i so the strokes of a run of segments are a run of strokes as well
+    auto segmentOf = [&actions, &segmentAt](int32_t stroke) noexcept {
+        return segmentAt((actions[stroke - 1].atS + actions[stroke].atS) / 2.f);
+    };
+
+    int32_t firstSegment = 0;
+    int32_t lastSegment = SegmentCount - 1;
+    if (Speeds.size() != SegmentCount || speedsDuration != totalDuration) {
+        Speeds.clear(); Speeds.resize(SegmentCount, 0.f);
+        speedsDuration = totalDuration;
+    }
+    else {
+        firstSegment = segmentAt(fromTime);
+        lastSegment = segmentAt(toTime);
+    }
+    std::fill(Speeds.begin() + firstSegment, Speeds.begin() + lastSegment + 1, 0.f);
+
+    // first stroke of firstSegment
+    int32_t stroke = 1;
+    int32_t count = (int32_t)actions.size() - 1;
+    while (count > 0) {
+        int32_t step = count / 2;
+        if (segmentOf(stroke + step) < firstSegment) {
+            stroke += step + 1;
+            count -= step + 1;
+        }
+        else {
+            count = step;
+        }
+    }
 
-    auto lastAction = actions.front();
-    for (int i = 1; i < actions.size(); ++i) {
-        auto& action = actions[i];
+    for (; stroke < actions.size(); ++stroke) {
+        int segmentIdx = segmentOf(stroke);
+        if (segmentIdx > lastSegment) break;
+        auto& lastAction = actions[stroke - 1];
+        auto& action = actions[stroke];
         float duration = action.atS - lastAction.atS;
         assert(duration > 0.f);
         float length = std::abs(action.pos - lastAction.pos);
         float speed = length / duration; // speed
         speed = Util::Clamp(speed / MaxSpeedPerSecond, 0.f, 1.f);
 
-        int segmentIdx = Util::Clamp((action.atS + (duration / 2.f)) / totalDuration, 0.f, 1.f) * (Speeds.size()-1);
         auto& segment = Speeds[segmentIdx];
         if (segment > 0.f) {
             segment += speed;
@@ -70,7 +112,6 @@ void HeatmapGradient::Update(float totalDuration, const FunscriptArray& actions)
         else {
             segment = speed;
         }
-        lastAction = action;
     }
 
     float offset = (1.f/Speeds.size())/2.f;
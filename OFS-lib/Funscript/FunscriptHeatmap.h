@@ -15,4 +15,10 @@ public:
 
 	HeatmapGradient() noexcept;
 	void Update(float totalDuration , const FunscriptArray& actions) noexcept;
+	// only recomputes the segments of strokes between fromTime and toTime
+	// everything gets recomputed if the duration changed since the last update
+	void Update(float totalDuration, const FunscriptArray& actions, float fromTime, float toTime) noexcept;
+
+private:
+	float speedsDuration = 0.f;
 };
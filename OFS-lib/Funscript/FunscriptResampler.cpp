@@ -0,0 +1,260 @@
+#include "FunscriptResampler.h"
+#include "FunscriptSpline.h"
+#include "OFS_Util.h"
+#include "OFS_Profiling.h"
+
+#include "OFS_TaskScheduler.h"
+
+#include "SDL_endian.h"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+const char* FunscriptResampler::InterpolationNames[static_cast<int32_t>(Interpolation::TotalCount)] = {
+    "Linear",
+    "Spline",
+    "Step"
+};
+
+const char* FunscriptResampler::FormatNames[static_cast<int32_t>(Format::TotalCount)] = {
+    "Binary uint16",
+    "Binary float16",
+    "CSV"
+};
+
+const char* FunscriptResampler::FormatExtensions[static_cast<int32_t>(Format::TotalCount)] = {
+    ".ofsr",
+    ".ofsr",
+    ".csv"
+};
+
+uint16_t FunscriptResampler::FloatToHalf(float value) noexcept
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (exponent <= 0) {
+        // subnormal or zero
+        if (exponent < -10) return sign;
+        mantissa |= 0x800000;
+        uint32_t shift = 14 - exponent;
+        uint16_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1) { half++; }
+        return sign | half;
+    }
+    if (exponent >= 31) {
+        return sign | 0x7C00;
+    }
+    uint16_t half = sign | (exponent << 10) | (mantissa >> 13);
+    // round to nearest, a carry into the exponent is still correct
+    if (mantissa & 0x1000) { half++; }
+    return half;
+}
+
+// samples per parallel job
+static constexpr int32_t RangeSamples = 4096;
+
+struct ResampleChunk
+{
+    const std::vector<FunscriptResampler::Axis>* axes = nullptr;
+    float rate = 1000.f;
+    FunscriptResampler::Interpolation interpolation = FunscriptResampler::Interpolation::Linear;
+
+    // rows of axis values
+    float* values = nullptr;
+    int64_t chunkStart = 0;
+    int32_t chunkLength = 0;
+};
+
+static void SampleAxis(const ResampleChunk& chunk, int32_t axisIdx, int32_t begin, int32_t end) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    auto& actions = *(*chunk.axes)[axisIdx].actions;
+    int32_t axisCount = chunk.axes->size();
+    float* out = chunk.values + (int64_t)begin * axisCount + axisIdx;
+
+    if (actions.empty()) {
+        for (int32_t i = begin; i < end; i++, out += axisCount) { *out = 0.f; }
+        return;
+    }
+
+    float firstTime = actions.front().atS;
+    float lastTime = actions.back().atS;
+    float time = (chunk.chunkStart + begin) / chunk.rate;
+    auto it = actions.upper_bound(FunscriptAction(time, 0));
+    int32_t index = std::max(0, (int32_t)std::distance(actions.begin(), it) - 1);
+
+    for (int32_t i = begin; i < end; i++, out += axisCount) {
+        time = (chunk.chunkStart + i) / chunk.rate;
+        while (index + 1 < actions.size() && actions[index + 1].atS <= time) { index++; }
+
+        if (time <= firstTime) { *out = actions.front().pos / 100.f; continue; }
+        if (time >= lastTime) { *out = actions.back().pos / 100.f; continue; }
+
+        auto& a = actions[index];
+        auto& b = actions[index + 1];
+        float pos;
+        switch (chunk.interpolation) {
+            case FunscriptResampler::Interpolation::Spline:
+                pos = FunscriptSpline::SampleAtIndex(actions, index, time);
+                break;
+            case FunscriptResampler::Interpolation::Step:
+                pos = a.pos / 100.f;
+                break;
+            default:
+            {
+                float progress = (time - a.atS) / (b.atS - a.atS);
+                pos = Util::Lerp<float>(a.pos / 100.f, b.pos / 100.f, progress);
+                break;
+            }
+        }
+        *out = Util::Clamp(pos, 0.f, 1.f);
+    }
+}
+
+static bool WriteChunk(SDL_RWops* file, FunscriptResampler::Format format, const float* values,
+    int64_t chunkStart, int32_t chunkLength, int32_t axisCount, float rate, std::vector<uint16_t>& binaryBuffer, std::string& textBuffer) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    size_t valueCount = (size_t)chunkLength * axisCount;
+    if (format == FunscriptResampler::Format::Csv) {
+        textBuffer.clear();
+        char buf[32];
+        for (int32_t i = 0; i < chunkLength; i++) {
+            int len = stbsp_snprintf(buf, sizeof(buf), "%.6f", (chunkStart + i) / (double)rate);
+            textBuffer.append(buf, len);
+            for (int32_t axis = 0; axis < axisCount; axis++) {
+                len = stbsp_snprintf(buf, sizeof(buf), ",%.4f", values[(size_t)i * axisCount + axis]);
+                textBuffer.append(buf, len);
+            }
+            textBuffer.append(1, '\n');
+        }
+        return SDL_RWwrite(file, textBuffer.data(), 1, textBuffer.size()) == textBuffer.size();
+    }
+
+    binaryBuffer.resize(valueCount);
+    if (format == FunscriptResampler::Format::Float16) {
+        for (size_t i = 0; i < valueCount; i++) {
+            binaryBuffer[i] = SDL_SwapLE16(FunscriptResampler::FloatToHalf(values[i]));
+        }
+    }
+    else {
+        for (size_t i = 0; i < valueCount; i++) {
+            binaryBuffer[i] = SDL_SwapLE16((uint16_t)std::lround(values[i] * 65535.f));
+        }
+    }
+    return SDL_RWwrite(file, binaryBuffer.data(), sizeof(uint16_t), valueCount) == valueCount;
+}
+
+static bool WriteHeader(SDL_RWops* file, FunscriptResampler::Format format,
+    const std::vector<FunscriptResampler::Axis>& axes, float rate, uint64_t sampleCount) noexcept
+{
+    if (format == FunscriptResampler::Format::Csv) {
+        std::string header = "time";
+        for (auto& axis : axes) {
+            header.append(1, ',');
+            header.append(axis.name);
+        }
+        header.append(1, '\n');
+        return SDL_RWwrite(file, header.data(), 1, header.size()) == header.size();
+    }
+
+    bool ok = SDL_RWwrite(file, "OFSR", 1, 4) == 4;
+    ok = ok && SDL_WriteLE32(file, FunscriptResampler::BinaryVersion);
+    ok = ok && SDL_WriteLE32(file, format == FunscriptResampler::Format::Float16 ? 1 : 0);
+    ok = ok && SDL_WriteLE32(file, (uint32_t)axes.size());
+    double rate64 = rate;
+    uint64_t rateBits;
+    memcpy(&rateBits, &rate64, sizeof(rateBits));
+    ok = ok && SDL_WriteLE64(file, rateBits);
+    ok = ok && SDL_WriteLE64(file, sampleCount);
+    for (auto& axis : axes) {
+        uint16_t length = (uint16_t)std::min<size_t>(axis.name.size(), UINT16_MAX);
+        ok = ok && SDL_WriteLE16(file, length);
+        ok = ok && SDL_RWwrite(file, axis.name.data(), 1, length) == length;
+    }
+    return ok;
+}
+
+bool FunscriptResampler::Export(const std::string& path, const std::vector<Axis>& axes,
+    float duration, float rate, Interpolation interpolation, Format format,
+    int* progress, int* maxProgress) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    if (axes.empty() || rate <= 0.f || duration < 0.f) return false;
+
+    auto file = Util::OpenFile(path.c_str(), "wb", path.size());
+    if (file == nullptr) {
+        LOGF_ERROR("Failed to open \"%s\" for writing.", path.c_str());
+        return false;
+    }
+
+    uint64_t sampleCount = (uint64_t)std::floor(duration * (double)rate) + 1;
+    int32_t chunkCount = (int32_t)((sampleCount + ChunkSamples - 1) / ChunkSamples);
+    int32_t axisCount = axes.size();
+    if (progress) *progress = 0;
+    if (maxProgress) *maxProgress = chunkCount;
+
+    bool ok = WriteHeader(file, format, axes, rate, sampleCount);
+
+    // one chunk gets written while the workers compute the next one
+    std::array<std::vector<float>, 2> chunks;
+    for (auto& chunk : chunks) { chunk.resize((size_t)ChunkSamples * axisCount); }
+    std::vector<uint16_t> binaryBuffer;
+    std::string textBuffer;
+
+    auto chunkLength = [&](int32_t chunkIdx) noexcept {
+        return (int32_t)std::min<uint64_t>(ChunkSamples, sampleCount - (uint64_t)chunkIdx * ChunkSamples);
+    };
+
+    auto computeChunk = [&](int32_t chunkIdx) noexcept {
+        ResampleChunk chunk;
+        chunk.axes = &axes;
+        chunk.rate = rate;
+        chunk.interpolation = interpolation;
+        chunk.values = chunks[chunkIdx & 1].data();
+        chunk.chunkStart = (int64_t)chunkIdx * ChunkSamples;
+        chunk.chunkLength = chunkLength(chunkIdx);
+        return OFS_TaskScheduler::Spawn([chunk]() {
+            // split by axis and range so a single script still uses every worker
+            int32_t partCount = (chunk.chunkLength + RangeSamples - 1) / RangeSamples;
+            int64_t jobCount = (int64_t)partCount * chunk.axes->size();
+            OFS_TaskScheduler::ParallelFor(0, jobCount, 1, [&chunk, partCount](int64_t first, int64_t last) {
+                for (int64_t job = first; job < last; job++) {
+                    int32_t begin = (int32_t)(job % partCount) * RangeSamples;
+                    int32_t end = std::min(begin + RangeSamples, chunk.chunkLength);
+                    SampleAxis(chunk, (int32_t)(job / partCount), begin, end);
+                }
+            });
+        }, OFS_TaskPriority::High);
+    };
+
+    OFS_Task<void> computing;
+    for (int32_t chunkIdx = 0; chunkIdx <= chunkCount && ok; chunkIdx++) {
+        auto previous = computing;
+        if (chunkIdx < chunkCount) {
+            computing = computeChunk(chunkIdx);
+        }
+
+        if (chunkIdx > 0) {
+            int32_t writeIdx = chunkIdx - 1;
+            previous.Wait();
+            ok = WriteChunk(file, format, chunks[writeIdx & 1].data(), (int64_t)writeIdx * ChunkSamples,
+                chunkLength(writeIdx), axisCount, rate, binaryBuffer, textBuffer);
+            if (progress) *progress = chunkIdx;
+        }
+    }
+    // the buffers are still in use until the last chunk is done
+    computing.Wait();
+
+    SDL_RWclose(file);
+    if (!ok) {
+        LOGF_ERROR("Failed to write \"%s\"", path.c_str());
+    }
+    return ok;
+}
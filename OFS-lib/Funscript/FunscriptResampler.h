@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Funscript.h"
+
+#include <string>
+#include <vector>
+
+// resamples multiple scripts onto one fixed rate time grid
+// the grid is produced chunk by chunk so long projects never have to fit into memory
+// every chunk is split across the task workers by axis and range
+//
+// binary layout (little endian):
+//   char[4]  "OFSR"
+//   uint32   version
+//   uint32   format (0 = uint16, 1 = float16)
+//   uint32   axis count
+//   float64  rate in Hz
+//   uint64   sample count
+//   per axis: uint16 name length, name bytes (utf-8)
+//   samples: one row of 2 byte values per sample with a column per axis, 0 to 1
+class FunscriptResampler
+{
+public:
+	enum class Interpolation : int32_t {
+		Linear,
+		Spline,
+		Step,
+
+		TotalCount
+	};
+	static const char* InterpolationNames[static_cast<int32_t>(Interpolation::TotalCount)];
+
+	enum class Format : int32_t {
+		Uint16,
+		Float16,
+		Csv,
+
+		TotalCount
+	};
+	static const char* FormatNames[static_cast<int32_t>(Format::TotalCount)];
+	static const char* FormatExtensions[static_cast<int32_t>(Format::TotalCount)];
+
+	static constexpr uint32_t BinaryVersion = 1;
+	static constexpr int32_t ChunkSamples = 1 << 16;
+
+	struct Axis {
+		std::string name;
+		FunscriptSnapshot actions;
+	};
+
+	// blocking, meant to be called from a task thread
+	// progress counts up to maxProgress chunks
+	static bool Export(const std::string& path, const std::vector<Axis>& axes,
+		float duration, float rate, Interpolation interpolation, Format format,
+		int* progress = nullptr, int* maxProgress = nullptr) noexcept;
+
+	static uint16_t FloatToHalf(float value) noexcept;
+};
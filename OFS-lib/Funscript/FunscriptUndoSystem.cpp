@@ -5,15 +5,23 @@ void FunscriptUndoSystem::ClearRedo() noexcept
 	RedoStack.clear();
 }
 
+// the ring buffers are preallocated, a recycled slot copies into the buffers it already has
+inline static void PushState(eastl::ring_buffer<ScriptState>& stack, int32_t type, const Funscript::FunscriptData& data) noexcept
+{
+	auto& state = stack.push_back();
+	state.type = type;
+	state.Data() = data;
+}
+
 void FunscriptUndoSystem::SnapshotRedo(int32_t type) noexcept
 {
-	RedoStack.push_back() = std::move(ScriptState(type, script->Data()));
+	PushState(RedoStack, type, script->Data());
 }
 
 void FunscriptUndoSystem::Snapshot(int32_t type, bool clearRedo) noexcept
 {
 	OFS_PROFILE(__FUNCTION__);
-	UndoStack.push_back() = std::move(ScriptState(type, script->Data()));
+	PushState(UndoStack, type, script->Data());
 
 	// redo gets cleared after every snapshot
 	if (clearRedo && !RedoStack.empty())
@@ -1,12 +1,302 @@
+#include "OFS_Allocator.h"
 #include "OFS_Util.h"
+#include "OFS_Profiling.h"
+#include "OFS_Localization.h"
 
-// allocators for eastl
-void* operator new[](size_t size, const char* pName, int flags, unsigned debugFlags, const char* file, int line)
+#include "imgui.h"
+#include "EASTL/allocator.h"
+
+#include <cstdlib>
+#include <algorithm>
+
+static struct AllocatorRegistry {
+	SDL_SpinLock lock = 0;
+	OFS_AllocatorStats* first = nullptr;
+} Registry;
+
+OFS_AllocatorStats::OFS_AllocatorStats(const char* name, uint32_t blockSize) noexcept
+	: name(name), blockSize(blockSize)
+{
+	SDL_AtomicLock(&Registry.lock);
+	next = Registry.first;
+	Registry.first = this;
+	SDL_AtomicUnlock(&Registry.lock);
+}
+
+void* OFS_Memory::AlignedAlloc(size_t size, size_t alignment) noexcept
+{
+	alignment = std::max(alignment, alignof(std::max_align_t));
+#if defined(WIN32)
+	return _aligned_malloc(size, alignment);
+#else
+	void* ptr = nullptr;
+	if (posix_memalign(&ptr, alignment, size) != 0) return nullptr;
+	return ptr;
+#endif
+}
+
+void OFS_Memory::AlignedFree(void* ptr) noexcept
+{
+#if defined(WIN32)
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+void OFS_Memory::ShowMetrics(bool* open) noexcept
+{
+	if (!*open) return;
+	OFS_PROFILE(__FUNCTION__);
+	ImGui::Begin(TR_ID("ALLOCATOR_METRICS", Tr::ALLOCATOR_METRICS), open);
+	ImGui::Columns(7, "AllocatorMetrics");
+	ImGui::TextUnformatted("Allocator"); ImGui::NextColumn();
+	ImGui::TextUnformatted("Block"); ImGui::NextColumn();
+	ImGui::TextUnformatted("Allocations"); ImGui::NextColumn();
+	ImGui::TextUnformatted("In use kb"); ImGui::NextColumn();
+	ImGui::TextUnformatted("Peak kb"); ImGui::NextColumn();
+	ImGui::TextUnformatted("Reserved kb"); ImGui::NextColumn();
+	ImGui::TextUnformatted("Overflows"); ImGui::NextColumn();
+	ImGui::Separator();
+
+	SDL_AtomicLock(&Registry.lock);
+	auto first = Registry.first;
+	SDL_AtomicUnlock(&Registry.lock);
+	// entries are only ever prepended, the rest of the list is stable
+	for (auto stats = first; stats != nullptr; stats = stats->next) {
+		ImGui::TextUnformatted(stats->name); ImGui::NextColumn();
+		if (stats->blockSize > 0) ImGui::Text("%u", stats->blockSize);
+		ImGui::NextColumn();
+		ImGui::Text("%llu", (unsigned long long)stats->allocations.load(std::memory_order_relaxed)); ImGui::NextColumn();
+		ImGui::Text("%.1f", stats->bytesInUse.load(std::memory_order_relaxed) / 1024.0); ImGui::NextColumn();
+		ImGui::Text("%.1f", stats->peakBytes.load(std::memory_order_relaxed) / 1024.0); ImGui::NextColumn();
+		ImGui::Text("%.1f", stats->reservedBytes.load(std::memory_order_relaxed) / 1024.0); ImGui::NextColumn();
+		ImGui::Text("%llu", (unsigned long long)stats->overflows.load(std::memory_order_relaxed)); ImGui::NextColumn();
+	}
+	ImGui::Columns(1);
+	ImGui::End();
+}
+
+// frame arena
+static constexpr size_t FrameChunkSize = 256 * 1024;
+static constexpr size_t FrameChunkAlignment = 64;
+
+struct FrameBuffer
+{
+	uint8_t* chunk = nullptr;
+	size_t chunkSize = 0;
+	size_t used = 0;
+	// total including overflow chunks, the next chunk gets sized by it
+	size_t frameBytes = 0;
+	std::vector<uint8_t*> overflow;
+};
+
+static struct FrameArenaData {
+	FrameBuffer buffers[2];
+	uint32_t current = 0;
+	OFS_AllocatorStats stats = OFS_AllocatorStats("Frame arena");
+} FrameArena;
+
+void* OFS_FrameArena::Allocate(size_t size, size_t alignment) noexcept
+{
+	FUN_ASSERT(Util::InMainThread(), "main thread only");
+	auto& buffer = FrameArena.buffers[FrameArena.current];
+	if (buffer.chunk == nullptr) {
+		buffer.chunk = (uint8_t*)OFS_Memory::AlignedAlloc(FrameChunkSize, FrameChunkAlignment);
+		buffer.chunkSize = FrameChunkSize;
+		FrameArena.stats.reservedBytes.fetch_add(FrameChunkSize, std::memory_order_relaxed);
+	}
+
+	size_t offset = (buffer.used + alignment - 1) & ~(alignment - 1);
+	size_t padded = size + (offset - buffer.used);
+	buffer.frameBytes += padded;
+	FrameArena.stats.Allocated(padded);
+	if (offset + size <= buffer.chunkSize) {
+		buffer.used = offset + size;
+		return buffer.chunk + offset;
+	}
+
+	// only for this frame, NextFrame makes the chunk big enough
+	FrameArena.stats.overflows.fetch_add(1, std::memory_order_relaxed);
+	auto ptr = (uint8_t*)OFS_Memory::AlignedAlloc(size, std::max(alignment, FrameChunkAlignment));
+	buffer.overflow.emplace_back(ptr);
+	return ptr;
+}
+
+void OFS_FrameArena::NextFrame() noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	FrameArena.current = (FrameArena.current + 1) % 2;
+	auto& buffer = FrameArena.buffers[FrameArena.current];
+	FrameArena.stats.Freed(buffer.frameBytes);
+
+	if (!buffer.overflow.empty()) {
+		for (auto ptr : buffer.overflow) { OFS_Memory::AlignedFree(ptr); }
+		buffer.overflow.clear();
+		// grows with some headroom, it never shrinks
+		size_t newSize = std::max(buffer.chunkSize, buffer.frameBytes + buffer.frameBytes / 2);
+		newSize = (newSize + FrameChunkSize - 1) / FrameChunkSize * FrameChunkSize;
+		FrameArena.stats.reservedBytes.fetch_add(newSize - buffer.chunkSize, std::memory_order_relaxed);
+		OFS_Memory::AlignedFree(buffer.chunk);
+		buffer.chunk = (uint8_t*)OFS_Memory::AlignedAlloc(newSize, FrameChunkAlignment);
+		buffer.chunkSize = newSize;
+	}
+	buffer.used = 0;
+	buffer.frameBytes = 0;
+}
+
+void OFS_FrameArena::Shutdown() noexcept
+{
+	for (auto& buffer : FrameArena.buffers) {
+		for (auto ptr : buffer.overflow) { OFS_Memory::AlignedFree(ptr); }
+		buffer.overflow.clear();
+		OFS_Memory::AlignedFree(buffer.chunk);
+		buffer = FrameBuffer();
+	}
+	FrameArena.stats.bytesInUse = 0;
+	FrameArena.stats.reservedBytes = 0;
+}
+
+// pools
+static constexpr size_t PoolPageSize = 64 * 1024;
+
+// free blocks store the next pointer in place
+inline static uint32_t PoolBlockSize(size_t size, size_t alignment) noexcept
+{
+	alignment = std::max(alignment, alignof(void*));
+	return (uint32_t)((std::max(size, sizeof(void*)) + alignment - 1) & ~(alignment - 1));
+}
+
+OFS_PoolBase::OFS_PoolBase(const char* name, size_t blockSize, size_t alignment) noexcept
+	: blockSize(PoolBlockSize(blockSize, alignment)),
+	alignment((uint32_t)std::max(alignment, alignof(void*))),
+	stats(name, PoolBlockSize(blockSize, alignment))
+{
+}
+
+void* OFS_PoolBase::Allocate() noexcept
+{
+	SDL_AtomicLock(&lock);
+	void* ptr = freeList;
+	if (ptr != nullptr) {
+		freeList = *(void**)ptr;
+	}
+	else {
+		if (cursor == nullptr || cursor + blockSize > end) {
+			// the rest of the old page is lost, that's less than a block
+			cursor = (uint8_t*)OFS_Memory::AlignedAlloc(PoolPageSize, alignment);
+			end = cursor + PoolPageSize;
+			stats.reservedBytes.fetch_add(PoolPageSize, std::memory_order_relaxed);
+		}
+		ptr = cursor;
+		cursor += blockSize;
+	}
+	SDL_AtomicUnlock(&lock);
+	stats.Allocated(blockSize);
+	return ptr;
+}
+
+void OFS_PoolBase::Free(void* ptr) noexcept
 {
-	return new uint8_t[size];
+	if (ptr == nullptr) return;
+	SDL_AtomicLock(&lock);
+	*(void**)ptr = freeList;
+	freeList = ptr;
+	SDL_AtomicUnlock(&lock);
+	stats.Freed(blockSize);
 }
 
-void* operator new[](size_t size, size_t alignment, size_t alignmentOffset, const char* pName, int flags, unsigned debugFlags, const char* file, int line)
+// eastl::allocator, EASTL_USER_DEFINED_ALLOCATOR is set in lib/CMakeLists.txt
+// the default implementation goes through operator new[] which can't honor the alignment and still be released with delete[]
+// every allocation goes through AlignedAlloc instead so both allocate overloads share deallocate
+namespace eastl
 {
-	return new uint8_t[size];
-}
\ No newline at end of file
+	allocator::allocator(const char* EASTL_NAME(pName))
+	{
+#if EASTL_NAME_ENABLED
+		mpName = pName ? pName : EASTL_ALLOCATOR_DEFAULT_NAME;
+#endif
+	}
+
+	allocator::allocator(const allocator& EASTL_NAME(alloc))
+	{
+#if EASTL_NAME_ENABLED
+		mpName = alloc.mpName;
+#endif
+	}
+
+	allocator::allocator(const allocator&, const char* EASTL_NAME(pName))
+	{
+#if EASTL_NAME_ENABLED
+		mpName = pName ? pName : EASTL_ALLOCATOR_DEFAULT_NAME;
+#endif
+	}
+
+	allocator& allocator::operator=(const allocator& EASTL_NAME(alloc))
+	{
+#if EASTL_NAME_ENABLED
+		mpName = alloc.mpName;
+#endif
+		return *this;
+	}
+
+	const char* allocator::get_name() const
+	{
+#if EASTL_NAME_ENABLED
+		return mpName;
+#else
+		return EASTL_ALLOCATOR_DEFAULT_NAME;
+#endif
+	}
+
+	void allocator::set_name(const char* EASTL_NAME(pName))
+	{
+#if EASTL_NAME_ENABLED
+		mpName = pName;
+#endif
+	}
+
+	void* allocator::allocate(size_t n, int)
+	{
+		return OFS_Memory::AlignedAlloc(n, alignof(std::max_align_t));
+	}
+
+	void* allocator::allocate(size_t n, size_t alignment, size_t alignmentOffset, int)
+	{
+		// eastl containers never ask for an offset which breaks the alignment
+		FUN_ASSERT((alignmentOffset % alignment) == 0, "unsupported alignment offset");
+		return OFS_Memory::AlignedAlloc(n, alignment);
+	}
+
+	void allocator::deallocate(void* p, size_t)
+	{
+		OFS_Memory::AlignedFree(p);
+	}
+
+	bool operator==(const allocator&, const allocator&)
+	{
+		return true;
+	}
+
+#if !defined(EA_COMPILER_HAS_THREE_WAY_COMPARISON)
+	bool operator!=(const allocator&, const allocator&)
+	{
+		return false;
+	}
+#endif
+
+	static allocator DefaultAllocator;
+	static allocator* DefaultAllocatorPtr = &DefaultAllocator;
+
+	allocator* GetDefaultAllocator()
+	{
+		return DefaultAllocatorPtr;
+	}
+
+	allocator* SetDefaultAllocator(allocator* pAllocator)
+	{
+		allocator* prev = DefaultAllocatorPtr;
+		DefaultAllocatorPtr = pAllocator;
+		return prev;
+	}
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <vector>
+#include <new>
+#include <type_traits>
+
+#include "SDL_atomic.h"
+
+// counters for the allocator metrics window
+// registered on construction and never unregistered
+struct OFS_AllocatorStats
+{
+	const char* name = nullptr;
+	// 0 for allocators without fixed size blocks
+	uint32_t blockSize = 0;
+	std::atomic<uint64_t> allocations = { 0 };
+	std::atomic<uint64_t> bytesInUse = { 0 };
+	std::atomic<uint64_t> peakBytes = { 0 };
+	std::atomic<uint64_t> reservedBytes = { 0 };
+	// allocations which didn't fit and went to the heap
+	std::atomic<uint64_t> overflows = { 0 };
+	OFS_AllocatorStats* next = nullptr;
+
+	OFS_AllocatorStats(const char* name, uint32_t blockSize = 0) noexcept;
+
+	inline void Allocated(uint64_t size) noexcept
+	{
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		uint64_t inUse = bytesInUse.fetch_add(size, std::memory_order_relaxed) + size;
+		uint64_t peak = peakBytes.load(std::memory_order_relaxed);
+		while (inUse > peak && !peakBytes.compare_exchange_weak(peak, inUse, std::memory_order_relaxed)) {}
+	}
+	inline void Freed(uint64_t size) noexcept { bytesInUse.fetch_sub(size, std::memory_order_relaxed); }
+};
+
+namespace OFS_Memory
+{
+	// has to be freed with AlignedFree, alignment is a power of two
+	void* AlignedAlloc(size_t size, size_t alignment) noexcept;
+	void AlignedFree(void* ptr) noexcept;
+
+	void ShowMetrics(bool* open) noexcept;
+}
+
+// linear allocator for scratch data of the main thread
+// there are two buffers, NextFrame switches to the older one so data allocated last frame stays valid until the end of this one.
+// nothing gets freed individually, a buffer which overflowed into extra chunks gets replaced by a single bigger one on reset.
+class OFS_FrameArena
+{
+public:
+	static void* Allocate(size_t size, size_t alignment) noexcept;
+	// lives until the end of the next frame, long enough for draw callbacks on the render thread
+	template<typename T>
+	inline static T* Copy(const T& value) noexcept
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "nothing runs the destructor");
+		return new (Allocate(sizeof(T), alignof(T))) T(value);
+	}
+	// once per frame before anything allocates from the arena
+	static void NextFrame() noexcept;
+	static void Shutdown() noexcept;
+};
+
+template<typename T>
+struct OFS_FrameAllocator
+{
+	using value_type = T;
+	using is_always_equal = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+
+	OFS_FrameAllocator() noexcept = default;
+	template<typename U>
+	OFS_FrameAllocator(const OFS_FrameAllocator<U>&) noexcept {}
+
+	inline T* allocate(size_t n) noexcept { return static_cast<T*>(OFS_FrameArena::Allocate(n * sizeof(T), alignof(T))); }
+	inline void deallocate(T*, size_t) noexcept {}
+
+	template<typename U>
+	inline bool operator==(const OFS_FrameAllocator<U>&) const noexcept { return true; }
+	template<typename U>
+	inline bool operator!=(const OFS_FrameAllocator<U>&) const noexcept { return false; }
+};
+
+template<typename T>
+using OFS_FrameVector = std::vector<T, OFS_FrameAllocator<T>>;
+
+// frame vectors which are kept around need fresh storage once per frame
+// clear() would keep writing into memory which the arena hands out again
+template<typename T>
+inline void OFS_RenewFrameVector(OFS_FrameVector<T>& vec) noexcept
+{
+	static_assert(std::is_trivially_destructible_v<T>, "the old storage is gone, nothing may run on it");
+	OFS_FrameVector<T>().swap(vec);
+}
+
+// fixed size blocks carved out of 64kb pages, freed blocks go into a free list
+// pages are never returned, the pool is sized by its peak usage
+class OFS_PoolBase
+{
+	uint32_t blockSize;
+	uint32_t alignment;
+	SDL_SpinLock lock = 0;
+	void* freeList = nullptr;
+	uint8_t* cursor = nullptr;
+	uint8_t* end = nullptr;
+	OFS_AllocatorStats stats;
+public:
+	OFS_PoolBase(const char* name, size_t blockSize, size_t alignment) noexcept;
+
+	void* Allocate() noexcept;
+	void Free(void* ptr) noexcept;
+};
+
+// one pool per type, thread safe
+template<typename T>
+class OFS_Pool
+{
+public:
+	inline static OFS_PoolBase& Get(const char* name) noexcept
+	{
+		// leaked on purpose, blocks might get freed during static destruction
+		static OFS_PoolBase* pool = new OFS_PoolBase(name, sizeof(T), alignof(T));
+		return *pool;
+	}
+};
+
+// allocator for std::allocate_shared and node based containers
+// single objects come from the pool of their (rebound) type, arrays go to the heap
+template<typename T>
+struct OFS_PoolAllocator
+{
+	using value_type = T;
+	using is_always_equal = std::true_type;
+	const char* name;
+
+	explicit OFS_PoolAllocator(const char* name) noexcept : name(name) {}
+	template<typename U>
+	OFS_PoolAllocator(const OFS_PoolAllocator<U>& other) noexcept : name(other.name) {}
+
+	inline T* allocate(size_t n) noexcept
+	{
+		if (n == 1) return static_cast<T*>(OFS_Pool<T>::Get(name).Allocate());
+		return static_cast<T*>(OFS_Memory::AlignedAlloc(n * sizeof(T), alignof(T)));
+	}
+	inline void deallocate(T* ptr, size_t n) noexcept
+	{
+		if (n == 1) OFS_Pool<T>::Get(name).Free(ptr);
+		else OFS_Memory::AlignedFree(ptr);
+	}
+
+	template<typename U>
+	inline bool operator==(const OFS_PoolAllocator<U>&) const noexcept { return true; }
+	template<typename U>
+	inline bool operator!=(const OFS_PoolAllocator<U>&) const noexcept { return false; }
+};
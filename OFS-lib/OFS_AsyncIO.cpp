@@ -1,46 +1,526 @@
 #include "OFS_AsyncIO.h"
 #include "OFS_Util.h"
+#include "OFS_Profiling.h"
 
-static int AsyncIO_Thread(void* data) noexcept
+#include <algorithm>
+
+#ifdef WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+#ifdef OFS_IO_URING
+#include <liburing.h>
+#endif
+
+OFS_AsyncIO* OFS_AsyncIO::instance = nullptr;
+
+const char* OFS_AsyncIO::SyncPolicyNames[static_cast<int32_t>(SyncPolicy::TotalCount)] = {
+	"None",
+	"Data",
+	"Full"
+};
+
+struct OFS_AsyncIO::Request
+{
+	enum class Type : int32_t {
+		Read,
+		Write
+	};
+	Type type = Type::Write;
+	std::string path;
+	std::vector<uint8_t> buffer;
+	PriorityClass priority = PriorityClass::UserSave;
+	SyncPolicy sync = SyncPolicy::None;
+	bool atomic = true;
+
+	std::shared_ptr<OFS_TaskDetail::State<Result>> state;
+	// writes which got replaced by this one, they complete with its result
+	std::vector<std::shared_ptr<OFS_TaskDetail::State<Result>>> superseded;
+
+	inline std::string tempPath() const noexcept { return atomic ? path + ".tmp" : path; }
+};
+
+static void Complete(OFS_AsyncIO::Request& request, bool success) noexcept
+{
+	if (!success) {
+		LOGF_ERROR("Failed to %s \"%s\"", request.type == OFS_AsyncIO::Request::Type::Read ? "read" : "write", request.path.c_str());
+	}
+	auto fulfill = [&](OFS_TaskDetail::State<OFS_AsyncIO::Result>& state, bool superseded) noexcept {
+		OFS_AsyncIO::Result result;
+		result.Path = request.path;
+		result.Success = success;
+		result.Superseded = superseded;
+		result.Size = request.buffer.size();
+		if (!superseded && request.type == OFS_AsyncIO::Request::Type::Read) {
+			result.Buffer = std::move(request.buffer);
+		}
+		state.value.emplace(std::move(result));
+		state.complete();
+	};
+	for (auto& state : request.superseded) { fulfill(*state, true); }
+	fulfill(*request.state, false);
+}
+
+// blocking implementation, also used if an io_uring request fails halfway
+#ifdef WIN32
+static bool WriteBlocking(const OFS_AsyncIO::Request& request) noexcept
+{
+	auto tempPath = Util::Utf8ToUtf16(request.tempPath());
+	HANDLE file = CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	size_t written = 0;
+	bool ok = true;
+	while (ok && written < request.buffer.size()) {
+		DWORD chunk = (DWORD)std::min<size_t>(request.buffer.size() - written, 1 << 30);
+		DWORD result = 0;
+		ok = ::WriteFile(file, request.buffer.data() + written, chunk, &result, NULL);
+		written += result;
+	}
+	if (ok && request.sync != OFS_AsyncIO::SyncPolicy::None) {
+		ok = FlushFileBuffers(file);
+	}
+	CloseHandle(file);
+
+	if (ok && request.atomic) {
+		auto path = Util::Utf8ToUtf16(request.path);
+		DWORD flags = MOVEFILE_REPLACE_EXISTING;
+		if (request.sync == OFS_AsyncIO::SyncPolicy::Full) { flags |= MOVEFILE_WRITE_THROUGH; }
+		ok = MoveFileExW(tempPath.c_str(), path.c_str(), flags);
+	}
+	if (!ok && request.atomic) { DeleteFileW(tempPath.c_str()); }
+	return ok;
+}
+
+static bool ReadBlocking(OFS_AsyncIO::Request& request) noexcept
+{
+	auto path = Util::Utf8ToUtf16(request.path);
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size;
+	bool ok = GetFileSizeEx(file, &size);
+	if (ok) { request.buffer.resize((size_t)size.QuadPart); }
+	size_t read = 0;
+	while (ok && read < request.buffer.size()) {
+		DWORD chunk = (DWORD)std::min<size_t>(request.buffer.size() - read, 1 << 30);
+		DWORD result = 0;
+		ok = ::ReadFile(file, request.buffer.data() + read, chunk, &result, NULL) && result > 0;
+		read += result;
+	}
+	CloseHandle(file);
+	return ok;
+}
+#else
+static void SyncDirectory(const std::string& path) noexcept
+{
+	auto directory = Util::PathFromString(path).parent_path().u8string();
+	int fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd >= 0) {
+		fsync(fd);
+		close(fd);
+	}
+}
+
+static bool SyncFile(int fd, OFS_AsyncIO::SyncPolicy sync) noexcept
+{
+	switch (sync) {
+		case OFS_AsyncIO::SyncPolicy::Data:
+#ifdef __APPLE__
+			return fsync(fd) == 0;
+#else
+			return fdatasync(fd) == 0;
+#endif
+		case OFS_AsyncIO::SyncPolicy::Full:
+			return fsync(fd) == 0;
+		default:
+			return true;
+	}
+}
+
+static bool WriteBlocking(const OFS_AsyncIO::Request& request) noexcept
+{
+	auto tempPath = request.tempPath();
+	int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) return false;
+
+	size_t written = 0;
+	bool ok = true;
+	while (ok && written < request.buffer.size()) {
+		ssize_t result = write(fd, request.buffer.data() + written, request.buffer.size() - written);
+		if (result < 0 && errno == EINTR) continue;
+		ok = result > 0;
+		if (ok) { written += result; }
+	}
+	ok = ok && SyncFile(fd, request.sync);
+	ok = close(fd) == 0 && ok;
+
+	if (ok && request.atomic) {
+		ok = rename(tempPath.c_str(), request.path.c_str()) == 0;
+	}
+	if (!ok && request.atomic) { unlink(tempPath.c_str()); }
+	if (ok && request.sync == OFS_AsyncIO::SyncPolicy::Full) {
+		// makes the rename itself durable
+		SyncDirectory(request.path);
+	}
+	return ok;
+}
+
+static bool ReadBlocking(OFS_AsyncIO::Request& request) noexcept
+{
+	int fd = open(request.path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return false;
+
+	struct stat st;
+	bool ok = fstat(fd, &st) == 0;
+	if (ok) { request.buffer.resize(st.st_size); }
+	size_t read = 0;
+	while (ok && read < request.buffer.size()) {
+		ssize_t result = ::read(fd, request.buffer.data() + read, request.buffer.size() - read);
+		if (result < 0 && errno == EINTR) continue;
+		ok = result > 0;
+		if (ok) { read += result; }
+	}
+	close(fd);
+	return ok;
+}
+#endif
+
+static void ProcessBlocking(OFS_AsyncIO::Request& request) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	bool ok = request.type == OFS_AsyncIO::Request::Type::Read
+		? ReadBlocking(request)
+		: WriteBlocking(request);
+	Complete(request, ok);
+}
+
+OFS_AsyncIO::OFS_AsyncIO() noexcept
+{
+}
+
+OFS_AsyncIO::~OFS_AsyncIO() noexcept
+{
+	FUN_ASSERT(!thread.Valid() || thread.Done(), "io thread still running");
+}
+
+void OFS_AsyncIO::push(std::unique_ptr<Request>&& request) noexcept
+{
+	SDL_AtomicLock(&queueLock);
+	if (request->type == Request::Type::Write) {
+		// a queued write which hasn't started yet gets replaced
+		for (auto& queue : queues) {
+			auto it = std::find_if(queue.begin(), queue.end(), [&](auto& queued) {
+				return queued->type == Request::Type::Write && queued->path == request->path;
+			});
+			if (it == queue.end()) continue;
+
+			auto& old = *it;
+			request->superseded = std::move(old->superseded);
+			request->superseded.emplace_back(std::move(old->state));
+			// keeps the strongest guarantees of both
+			request->priority = std::min(request->priority, old->priority);
+			request->sync = std::max(request->sync, old->sync);
+			request->atomic = request->atomic || old->atomic;
+			queue.erase(it);
+			break;
+		}
+	}
+	queues[static_cast<size_t>(request->priority)].emplace_back(std::move(request));
+	SDL_AtomicUnlock(&queueLock);
+	SDL_SemPost(wake);
+}
+
+std::unique_ptr<OFS_AsyncIO::Request> OFS_AsyncIO::pop(const std::vector<std::string>& busyPaths) noexcept
 {
-	OFS_AsyncIO* io = (OFS_AsyncIO*)data;
-	SDL_mutex* mutex = SDL_CreateMutex();
-	SDL_LockMutex(mutex);
-	for (;;)
-	{
-		if (io->ShouldExit && io->Writes.empty()) {
+	std::unique_ptr<Request> request;
+	SDL_AtomicLock(&queueLock);
+	for (auto& queue : queues) {
+		// requests for a path which is still in flight have to wait, renames could overtake each other
+		auto it = std::find_if(queue.begin(), queue.end(), [&](auto& queued) {
+			return std::find(busyPaths.begin(), busyPaths.end(), queued->path) == busyPaths.end();
+		});
+		if (it != queue.end()) {
+			request = std::move(*it);
+			queue.erase(it);
 			break;
 		}
-		else if(io->Writes.empty()) {
-			SDL_CondWait(io->WakeThreadCondition, mutex);
-			if (io->Writes.empty()) break;
+	}
+	SDL_AtomicUnlock(&queueLock);
+	return request;
+}
+
+bool OFS_AsyncIO::empty() noexcept
+{
+	SDL_AtomicLock(&queueLock);
+	bool empty = std::all_of(queues.begin(), queues.end(), [](auto& queue) { return queue.empty(); });
+	SDL_AtomicUnlock(&queueLock);
+	return empty;
+}
+
+void OFS_AsyncIO::runBlocking() noexcept
+{
+	static const std::vector<std::string> NoBusyPaths;
+	for (;;) {
+		auto request = pop(NoBusyPaths);
+		if (request) {
+			ProcessBlocking(*request);
+			continue;
 		}
-		SDL_AtomicLock(&io->QueueLock);
-		auto write = std::move(io->Writes.front());
-		io->Writes.pop();
-		SDL_AtomicUnlock(&io->QueueLock);
+		if (shouldExit.load(std::memory_order_acquire)) break;
+		SDL_SemWaitTimeout(wake, 100);
+	}
+}
+
+#ifdef OFS_IO_URING
+// every request is one linked chain
+// write -> fsync -> close -> rename or read -> close
+struct UringRequest
+{
+	static constexpr int32_t MaxOps = 4;
+	enum Op : int32_t {
+		ReadWrite,
+		Fsync,
+		Close,
+		Rename
+	};
+
+	std::unique_ptr<OFS_AsyncIO::Request> request;
+	std::string tempPath;
+	int fd = -1;
+	int32_t pending = 0;
+	bool failed = false;
+	bool closed = false;
+};
+
+static bool SubmitUring(io_uring& ring, UringRequest& op) noexcept
+{
+	auto& request = *op.request;
+	bool isRead = request.type == OFS_AsyncIO::Request::Type::Read;
+	if (io_uring_sq_space_left(&ring) < UringRequest::MaxOps) return false;
 
-		size_t written = Util::WriteFile(write.Path.c_str(), write.Buffer, write.Size);
-		FUN_ASSERT(written == write.Size, "fuck");
-		write.Callback(write);
+	// opening is cheap compared to the rest and keeps the chain free of direct descriptors
+	if (isRead) {
+		op.fd = open(request.path.c_str(), O_RDONLY | O_CLOEXEC);
+		struct stat st;
+		if (op.fd < 0 || fstat(op.fd, &st) != 0) return false;
+		request.buffer.resize(st.st_size);
 	}
-	SDL_DestroyMutex(mutex);
-	return 0;
+	else {
+		op.tempPath = request.tempPath();
+		op.fd = open(op.tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (op.fd < 0) return false;
+	}
+
+	auto add = [&](UringRequest::Op type) noexcept {
+		auto sqe = io_uring_get_sqe(&ring);
+		io_uring_sqe_set_data(sqe, (void*)((uintptr_t)&op | type));
+		op.pending++;
+		return sqe;
+	};
+	auto linkLast = [](io_uring_sqe* sqe) noexcept { sqe->flags |= IOSQE_IO_LINK; };
+
+	io_uring_sqe* sqe;
+	if (isRead) {
+		sqe = add(UringRequest::ReadWrite);
+		io_uring_prep_read(sqe, op.fd, request.buffer.data(), request.buffer.size(), 0);
+	}
+	else {
+		sqe = add(UringRequest::ReadWrite);
+		io_uring_prep_write(sqe, op.fd, request.buffer.data(), request.buffer.size(), 0);
+		if (request.sync != OFS_AsyncIO::SyncPolicy::None) {
+			linkLast(sqe);
+			sqe = add(UringRequest::Fsync);
+			io_uring_prep_fsync(sqe, op.fd, request.sync == OFS_AsyncIO::SyncPolicy::Data ? IORING_FSYNC_DATASYNC : 0);
+		}
+	}
+	linkLast(sqe);
+	sqe = add(UringRequest::Close);
+	io_uring_prep_close(sqe, op.fd);
+	if (!isRead && request.atomic) {
+		linkLast(sqe);
+		sqe = add(UringRequest::Rename);
+		io_uring_prep_rename(sqe, op.tempPath.c_str(), request.path.c_str());
+	}
+	return true;
+}
+
+static void CompleteUring(UringRequest& op) noexcept
+{
+	auto& request = *op.request;
+	if (!op.closed && op.fd >= 0) { close(op.fd); }
+	if (op.failed) {
+		// short transfers and old kernels end up here, the blocking path handles all of it
+		if (request.type == OFS_AsyncIO::Request::Type::Write && request.atomic) { unlink(op.tempPath.c_str()); }
+		ProcessBlocking(request);
+		return;
+	}
+	if (request.type == OFS_AsyncIO::Request::Type::Write && request.sync == OFS_AsyncIO::SyncPolicy::Full) {
+		SyncDirectory(request.path);
+	}
+	Complete(request, true);
+}
+
+void OFS_AsyncIO::runIoUring(void* ringPtr) noexcept
+{
+	constexpr int32_t MaxInFlight = 16;
+	auto& ring = *(io_uring*)ringPtr;
+	std::vector<std::unique_ptr<UringRequest>> inFlight;
+	std::vector<std::string> busyPaths;
+
+	for (;;) {
+		bool submitted = false;
+		while (inFlight.size() < MaxInFlight) {
+			busyPaths.clear();
+			for (auto& op : inFlight) { busyPaths.emplace_back(op->request->path); }
+			auto request = pop(busyPaths);
+			if (!request) break;
+
+			auto op = std::make_unique<UringRequest>();
+			op->request = std::move(request);
+			if (!SubmitUring(ring, *op)) {
+				if (op->fd >= 0) { close(op->fd); }
+				ProcessBlocking(*op->request);
+				continue;
+			}
+			inFlight.emplace_back(std::move(op));
+			submitted = true;
+		}
+		if (submitted) { io_uring_submit(&ring); }
+
+		if (inFlight.empty()) {
+			if (shouldExit.load(std::memory_order_acquire) && empty()) break;
+			SDL_SemWaitTimeout(wake, 100);
+			continue;
+		}
+
+		// new requests get picked up at least every few ms
+		io_uring_cqe* cqe = nullptr;
+		__kernel_timespec timeout = { 0, 2000000 };
+		if (io_uring_wait_cqe_timeout(&ring, &cqe, &timeout) != 0) continue;
+
+		unsigned head;
+		uint32_t count = 0;
+		io_uring_for_each_cqe(&ring, head, cqe) {
+			count++;
+			auto data = (uintptr_t)io_uring_cqe_get_data(cqe);
+			auto& op = *(UringRequest*)(data & ~(uintptr_t)3);
+			auto type = (UringRequest::Op)(data & 3);
+			auto& request = *op.request;
+
+			if (type == UringRequest::Close && cqe->res == 0) { op.closed = true; }
+			if (cqe->res < 0) { op.failed = true; }
+			else if (type == UringRequest::ReadWrite && (size_t)cqe->res != request.buffer.size()) { op.failed = true; }
+			op.pending--;
+		}
+		io_uring_cq_advance(&ring, count);
+
+		auto done = std::stable_partition(inFlight.begin(), inFlight.end(), [](auto& op) { return op->pending > 0; });
+		for (auto it = done; it != inFlight.end(); ++it) {
+			CompleteUring(**it);
+		}
+		inFlight.erase(done, inFlight.end());
+	}
+}
+
+static bool InitIoUring(io_uring& ring) noexcept
+{
+	if (io_uring_queue_init(64, &ring, 0) != 0) return false;
+	// close needs 5.6 and rename 5.11
+	auto probe = io_uring_get_probe_ring(&ring);
+	bool supported = probe != nullptr
+		&& io_uring_opcode_supported(probe, IORING_OP_CLOSE)
+		&& io_uring_opcode_supported(probe, IORING_OP_RENAMEAT);
+	if (probe) { io_uring_free_probe(probe); }
+	if (!supported) { io_uring_queue_exit(&ring); }
+	return supported;
+}
+#endif
+
+void OFS_AsyncIO::ioThread(OFS_AsyncIO* io) noexcept
+{
+#ifdef OFS_IO_URING
+	io_uring ring;
+	io->ioUring = InitIoUring(ring);
+	if (io->ioUring) {
+		LOG_INFO("Using io_uring for file io.");
+		io->runIoUring(&ring);
+		io_uring_queue_exit(&ring);
+		return;
+	}
+#endif
+	io->runBlocking();
 }
 
 void OFS_AsyncIO::Init() noexcept
 {
-	FUN_ASSERT(IO_Thread == nullptr, "thread already running");
-	WakeThreadCondition = SDL_CreateCond();
-	IO_Thread = SDL_CreateThread(AsyncIO_Thread, "OFS_AsyncIO", this);
+	FUN_ASSERT(!thread.Valid(), "thread already running");
+	FUN_ASSERT(instance == nullptr, "there can only be one instance");
+	instance = this;
+	shouldExit.store(false, std::memory_order_relaxed);
+	wake = SDL_CreateSemaphore(0);
+	thread = OFS_TaskScheduler::SpawnLongRunning("OFS_AsyncIO", [this]() { ioThread(this); });
 }
 
 void OFS_AsyncIO::Shutdown() noexcept
 {
-	ShouldExit = true;
-	SDL_CondBroadcast(WakeThreadCondition);
-	int result;
-	SDL_WaitThread(IO_Thread, &result);
-	FUN_ASSERT(Writes.empty(), "Writes not empty!!!");
-	SDL_DestroyCond(WakeThreadCondition);
+	if (!thread.Valid()) return;
+	instance = nullptr;
+	shouldExit.store(true, std::memory_order_release);
+	SDL_SemPost(wake);
+	thread.Wait();
+	thread = OFS_Task<void>();
+	FUN_ASSERT(empty(), "requests not empty!!!");
+	SDL_DestroySemaphore(wake);
+	wake = nullptr;
+}
+
+OFS_Task<OFS_AsyncIO::Result> OFS_AsyncIO::PushWrite(Write&& write) noexcept
+{
+	auto request = std::make_unique<Request>();
+	request->type = Request::Type::Write;
+	request->path = std::move(write.Path);
+	request->buffer = std::move(write.Buffer);
+	request->priority = write.Priority;
+	request->sync = GetSyncPolicy(write.Priority);
+	request->atomic = write.Atomic;
+	request->state = std::make_shared<OFS_TaskDetail::State<Result>>();
+	auto task = OFS_Task<Result>(std::shared_ptr<OFS_TaskDetail::State<Result>>(request->state));
+	push(std::move(request));
+	return task;
+}
+
+OFS_Task<OFS_AsyncIO::Result> OFS_AsyncIO::PushRead(const std::string& path, PriorityClass priority) noexcept
+{
+	auto request = std::make_unique<Request>();
+	request->type = Request::Type::Read;
+	request->path = path;
+	request->priority = priority;
+	request->state = std::make_shared<OFS_TaskDetail::State<Result>>();
+	auto task = OFS_Task<Result>(std::shared_ptr<OFS_TaskDetail::State<Result>>(request->state));
+	push(std::move(request));
+	return task;
+}
+
+OFS_Task<OFS_AsyncIO::Result> OFS_AsyncIO::WriteOrQueue(Write&& write) noexcept
+{
+	if (instance != nullptr) {
+		return instance->PushWrite(std::move(write));
+	}
+
+	Request request;
+	request.path = std::move(write.Path);
+	request.buffer = std::move(write.Buffer);
+	request.priority = write.Priority;
+	request.sync = write.Priority == PriorityClass::Cache ? SyncPolicy::None : SyncPolicy::Data;
+	request.atomic = write.Atomic;
+	request.state = std::make_shared<OFS_TaskDetail::State<Result>>();
+	ProcessBlocking(request);
+	return OFS_Task<Result>(std::move(request.state));
 }
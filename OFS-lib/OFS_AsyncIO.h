@@ -1,45 +1,111 @@
 #pragma once
 
-#include <functional>
-#include <queue>
+#include "OFS_TaskScheduler.h"
+
+#include <array>
+#include <deque>
 #include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
 
 #include "SDL_thread.h"
 #include "SDL_mutex.h"
 
 /*
 * I wrote this because spinning up thread to save takes longer than you'd think (like 1ms :/)
+*
+* a single io thread, on linux it drives io_uring and keeps several requests in flight.
+* everywhere else (or if io_uring isn't available at runtime) it does the same work with blocking calls.
+* writes go to a temporary file first which gets renamed over the target, a crash never leaves a truncated file behind.
+* a queued write gets replaced by a newer write to the same path, only the latest data hits the disk.
 */
 class OFS_AsyncIO
 {
 public:
-	struct Write
+	// higher classes get picked first
+	enum class PriorityClass : int32_t {
+		UserSave,
+		Autosave,
+		Cache,
+
+		TotalCount
+	};
+
+	enum class SyncPolicy : int32_t {
+		None, // leave it to the os
+		Data, // fdatasync the file before the rename
+		Full, // fsync the file and the directory after the rename
+
+		TotalCount
+	};
+	static const char* SyncPolicyNames[static_cast<int32_t>(SyncPolicy::TotalCount)];
+
+	struct Result
 	{
 		std::string Path;
-		uint8_t* Buffer = nullptr;
+		bool Success = false;
+		// a newer write to the same path replaced this one before it started
+		bool Superseded = false;
 		size_t Size = 0;
-		void* Userdata = nullptr;
-		std::function<void(Write&)> Callback = [](Write&) {};
+		// reads only
+		std::vector<uint8_t> Buffer;
+	};
+
+	struct Write
+	{
+		std::string Path;
+		std::vector<uint8_t> Buffer;
+		PriorityClass Priority = PriorityClass::UserSave;
+		// write to Path + ".tmp" and rename
+		bool Atomic = true;
 	};
 
-	SDL_SpinLock QueueLock;
+	static OFS_AsyncIO* instance;
 
-	SDL_cond* WakeThreadCondition = nullptr;
+	OFS_AsyncIO() noexcept;
+	~OFS_AsyncIO() noexcept;
 
-	std::queue<Write> Writes;
+	void Init() noexcept;
+	// finishes every queued request
+	void Shutdown() noexcept;
 
-	SDL_Thread* IO_Thread = nullptr;
-	bool ShouldExit = false;
+	OFS_Task<Result> PushWrite(Write&& write) noexcept;
+	OFS_Task<Result> PushRead(const std::string& path, PriorityClass priority = PriorityClass::UserSave) noexcept;
 
-	inline void PushWrite(Write&& write) noexcept
+	inline void SetSyncPolicy(PriorityClass priority, SyncPolicy policy) noexcept
 	{
-		SDL_AtomicLock(&QueueLock);
-		Writes.emplace(std::move(write));
-		SDL_AtomicUnlock(&QueueLock);
-
-		SDL_CondSignal(WakeThreadCondition);
+		syncPolicy[static_cast<int32_t>(priority)].store(policy, std::memory_order_relaxed);
+	}
+	inline SyncPolicy GetSyncPolicy(PriorityClass priority) const noexcept
+	{
+		return syncPolicy[static_cast<int32_t>(priority)].load(std::memory_order_relaxed);
 	}
 
-	void Init() noexcept;
-	void Shutdown() noexcept;
-};
\ No newline at end of file
+	inline bool UsingIoUring() const noexcept { return ioUring; }
+
+	// without an instance the write happens right away on the calling thread
+	static OFS_Task<Result> WriteOrQueue(Write&& write) noexcept;
+
+	struct Request;
+private:
+	std::array<std::deque<std::unique_ptr<Request>>, static_cast<size_t>(PriorityClass::TotalCount)> queues;
+	// set from the ui, read by whoever pushes a write
+	std::array<std::atomic<SyncPolicy>, static_cast<size_t>(PriorityClass::TotalCount)> syncPolicy = { {
+		{ SyncPolicy::Full }, { SyncPolicy::Data }, { SyncPolicy::None }
+	} };
+	SDL_SpinLock queueLock = 0;
+	SDL_sem* wake = nullptr;
+	OFS_Task<void> thread;
+	std::atomic<bool> shouldExit = { false };
+	bool ioUring = false;
+
+	void push(std::unique_ptr<Request>&& request) noexcept;
+	// highest priority request whose path isn't busy
+	std::unique_ptr<Request> pop(const std::vector<std::string>& busyPaths) noexcept;
+	bool empty() noexcept;
+
+	void runBlocking() noexcept;
+	void runIoUring(void* ring) noexcept;
+	static void ioThread(OFS_AsyncIO* io) noexcept;
+};
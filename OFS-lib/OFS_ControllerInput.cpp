@@ -2,6 +2,7 @@
 #include "OFS_Util.h"
 #include "KeybindingSystem.h"
 #include "OFS_Profiling.h"
+#include "OFS_Redraw.h"
 
 #include "SDL.h"
 
@@ -107,6 +108,8 @@ void ControllerInput::update(int32_t buttonRepeatIntervalMs) noexcept
 {
 	int buttonEnumVal = 0;
 	for (auto&& button : ButtonsHeldDown) {
+		// repeats are generated here, the loop can't idle while a button is held
+		if (button > 0) OFS_Redraw::Request();
 		if (button > 0 && ((int64_t)SDL_GetTicks() - button) >= buttonRepeatIntervalMs) {
 			SDL_Event ev;
 			ev.type = KeybindingEvents::ControllerButtonRepeat;
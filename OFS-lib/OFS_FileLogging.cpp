@@ -11,197 +11,571 @@
 
 #include "stb_sprintf.h"
 #include <vector>
+#include <memory>
+
+using namespace OFS_LogDetail;
 
 static OFS::AppLog OFS_MainLog;
 
 SDL_RWops* OFS_FileLogger::LogFileHandle = nullptr;
 
-struct OFS_LogThread
+// per thread, 64kb covers a lot of bursts before the writer catches up
+static constexpr uint32_t RingCapacity = 64 * 1024;
+static constexpr uint32_t MaxRecordSize = RingCapacity / 4;
+// per call site
+static constexpr uint32_t MaxMessagesPerSecond = 20;
+
+inline static uint32_t AlignRecord(uint32_t size) noexcept { return (size + 7) & ~7u; }
+
+// single producer (the owning thread), single consumer (the writer)
+struct OFS_ThreadLog
+{
+    std::unique_ptr<uint8_t[]> ring = std::make_unique<uint8_t[]>(RingCapacity);
+    std::atomic<uint64_t> head = { 0 };
+    std::atomic<uint64_t> tail = { 0 };
+    std::atomic<uint32_t> dropped = { 0 };
+    std::atomic<bool> inUse = { false };
+    uint32_t index = 0;
+    // the registry is append only, next never changes once linked
+    OFS_ThreadLog* next = nullptr;
+};
+
+static struct OFS_LogThread
 {
-    SDL_SpinLock lock;
-    SDL_cond* WaitFlush = nullptr;
-    std::vector<char> LogMsgBuffer;
+    std::atomic<OFS_ThreadLog*> registry = { nullptr };
+    std::atomic<uint32_t> threadCount = { 0 };
 
-    volatile bool ShouldExit = false;
-    volatile bool Exited = false;
+    SDL_Thread* thread = nullptr;
+    SDL_sem* wake = nullptr;
+    std::atomic<bool> running = { false };
+    std::atomic<bool> shouldExit = { false };
+    std::atomic<OFS_LogOverflow> overflow = { OFS_LogOverflow::Block };
 
-    void Init() noexcept
-    {
-        WaitFlush = SDL_CreateCond();
-        LogMsgBuffer.reserve(4096);
+    uint64_t startTicks = 0;
+    uint64_t ticksPerSecond = 1;
+
+    // formatted for the log window, handed over in Flush
+    SDL_SpinLock windowLock = 0;
+    std::string windowBuffer;
+
+    SDL_SpinLock fileLock = 0;
+} Thread;
+
+struct OFS_ThreadLogHandle
+{
+    OFS_ThreadLog* log = nullptr;
+    // the ring gets reused once the writer emptied it
+    ~OFS_ThreadLogHandle() noexcept { if (log) log->inUse.store(false, std::memory_order_release); }
+};
+static thread_local OFS_ThreadLogHandle CurrentLog;
+// a record which couldn't go into a ring
+static thread_local std::vector<uint8_t> DirectRecord;
+static thread_local bool DirectPending = false;
+
+static OFS_ThreadLog* AcquireThreadLog() noexcept
+{
+    for (auto log = Thread.registry.load(std::memory_order_acquire); log != nullptr; log = log->next) {
+        bool expected = false;
+        if (log->head.load(std::memory_order_acquire) == log->tail.load(std::memory_order_acquire)
+            && log->inUse.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            return log;
+        }
     }
 
-    void Shutdown() noexcept
+    auto log = new OFS_ThreadLog();
+    log->inUse.store(true, std::memory_order_relaxed);
+    log->index = Thread.threadCount.fetch_add(1, std::memory_order_relaxed);
+    auto head = Thread.registry.load(std::memory_order_relaxed);
+    do {
+        log->next = head;
+    } while (!Thread.registry.compare_exchange_weak(head, log, std::memory_order_release, std::memory_order_relaxed));
+    return log;
+}
+
+// padded for the file, trimmed for the log window
+static const char* LevelName(uint8_t level, bool padded) noexcept
+{
+    switch ((OFS_LogLevel)level) {
+        case OFS_LogLevel::OFS_LOG_INFO: return padded ? "INFO " : "INFO";
+        case OFS_LogLevel::OFS_LOG_WARN: return padded ? "WARN " : "WARN";
+        case OFS_LogLevel::OFS_LOG_DEBUG: return "DEBUG";
+        case OFS_LogLevel::OFS_LOG_ERROR: return "ERROR";
+    }
+    return "-----";
+}
+
+struct LogArg
+{
+    ArgType type;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+    };
+    const char* str = nullptr;
+    uint16_t length = 0;
+
+    inline int64_t AsInt() const noexcept
     {
-        ShouldExit = true;
-        SDL_CondSignal(WaitFlush);
-        while(!Exited) { SDL_Delay(1); }
-        SDL_DestroyCond(WaitFlush);
+        switch (type) {
+            case ArgType::Double: return (int64_t)d;
+            case ArgType::String: return 0;
+            default: return i;
+        }
+    }
+    inline double AsDouble() const noexcept
+    {
+        switch (type) {
+            case ArgType::Double: return d;
+            case ArgType::UInt: case ArgType::Pointer: return (double)u;
+            case ArgType::String: return 0.0;
+            default: return (double)i;
+        }
     }
 };
 
-OFS_LogThread Thread;
+static constexpr int32_t MaxArgs = 32;
 
-static int LogThreadFunction(void* threadData) noexcept
+static int32_t DecodeArgs(const RecordHeader& header, const uint8_t* data, LogArg* args) noexcept
 {
-    auto& thread = *(OFS_LogThread*)threadData;
-    auto& msg = thread.LogMsgBuffer;
-    auto waitMut = SDL_CreateMutex();
-    SDL_LockMutex(waitMut);
-    while(!thread.ShouldExit && OFS_FileLogger::LogFileHandle) {
-        if(SDL_CondWait(thread.WaitFlush, waitMut) == 0) {
-            SDL_AtomicLock(&thread.lock);
-            SDL_RWwrite(OFS_FileLogger::LogFileHandle, msg.data(), 1, msg.size());
-            msg.clear();
-            SDL_AtomicUnlock(&thread.lock);
+    int32_t count = std::min<int32_t>(header.argCount, MaxArgs);
+    for (int32_t i = 0; i < count; i++) {
+        auto& arg = args[i];
+        arg.type = (ArgType)*data++;
+        if (arg.type == ArgType::String) {
+            memcpy(&arg.length, data, sizeof(arg.length));
+            data += sizeof(arg.length);
+            arg.str = (const char*)data;
+            data += arg.length;
+        }
+        else {
+            memcpy(&arg.u, data, sizeof(arg.u));
+            data += sizeof(arg.u);
         }
     }
+    return count;
+}
 
-    SDL_DestroyMutex(waitMut);
-    thread.Exited = true;
+// printf subset, every conversion gets formatted on its own with the argument widened to 64 bit
+static void FormatMessage(const char* fmt, const LogArg* args, int32_t argCount, std::string& out) noexcept
+{
+    char spec[32];
+    char buf[512];
+    std::string str;
+    int32_t argIdx = 0;
+    const char* p = fmt;
+    while (*p) {
+        if (*p != '%') {
+            auto start = p;
+            while (*p && *p != '%') p++;
+            out.append(start, p - start);
+            continue;
+        }
+        if (p[1] == '%') {
+            out.append(1, '%');
+            p += 2;
+            continue;
+        }
 
-    return 0;
+        auto specStart = p++;
+        while (*p && strchr("-+ #0'123456789.", *p)) p++;
+        int32_t specLen = std::min<int32_t>(p - specStart, sizeof(spec) - 4);
+        memcpy(spec, specStart, specLen);
+        // length modifiers don't matter, everything is 64 bit
+        while (*p && strchr("hlLqjzt", *p)) p++;
+        char conversion = *p;
+        if (conversion == '\0') break;
+        p++;
+
+        if (argIdx >= argCount) {
+            out.append("<missing>");
+            continue;
+        }
+        auto& arg = args[argIdx++];
+        int len = 0;
+        switch (conversion) {
+            case 'd': case 'i':
+                memcpy(spec + specLen, "lld", 4);
+                len = stbsp_snprintf(buf, sizeof(buf), spec, (long long)arg.AsInt());
+                break;
+            case 'u': case 'x': case 'X': case 'o':
+                spec[specLen] = 'l'; spec[specLen + 1] = 'l'; spec[specLen + 2] = conversion; spec[specLen + 3] = '\0';
+                len = stbsp_snprintf(buf, sizeof(buf), spec, (unsigned long long)arg.AsInt());
+                break;
+            case 'c':
+                memcpy(spec + specLen, "c", 2);
+                len = stbsp_snprintf(buf, sizeof(buf), spec, (int)arg.AsInt());
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                spec[specLen] = conversion; spec[specLen + 1] = '\0';
+                len = stbsp_snprintf(buf, sizeof(buf), spec, arg.AsDouble());
+                break;
+            case 'p':
+                memcpy(spec + specLen, "p", 2);
+                len = stbsp_snprintf(buf, sizeof(buf), spec, (void*)(uintptr_t)arg.u);
+                break;
+            case 's':
+                if (arg.type == ArgType::String) {
+                    if (specLen == 1) {
+                        // the common case, no padding or precision
+                        out.append(arg.str, arg.length);
+                        continue;
+                    }
+                    str.assign(arg.str, arg.length);
+                    memcpy(spec + specLen, "s", 2);
+                    len = stbsp_snprintf(buf, sizeof(buf), spec, str.c_str());
+                    break;
+                }
+                // not a string, print whatever it is
+                len = arg.type == ArgType::Double
+                    ? stbsp_snprintf(buf, sizeof(buf), "%g", arg.d)
+                    : stbsp_snprintf(buf, sizeof(buf), "%lld", (long long)arg.AsInt());
+                break;
+            default:
+                out.append(specStart, p - specStart);
+                argIdx--;
+                continue;
+        }
+        out.append(buf, std::min<int>(len, sizeof(buf) - 1));
+    }
 }
 
-void OFS_FileLogger::Init() noexcept
+struct FormattedLine
 {
-    if(LogFileHandle) return;
-    #ifndef NDEBUG
-        SDL_LogSetAllPriority(SDL_LOG_PRIORITY_VERBOSE);
-    #endif
-    auto LogFilePath = Util::Prefpath("OFS.log");
-    LogFileHandle = SDL_RWFromFile(LogFilePath.c_str(), "w");
+    uint64_t timestamp;
+    uint8_t level;
+    bool raw;
+    uint32_t thread;
+    uint32_t offset;
+    uint32_t length;
+};
 
-    Thread.Init();
-    auto t = SDL_CreateThread(LogThreadFunction, "MessageLogging", &Thread);
-    SDL_DetachThread(t);
-}
+struct LogBatch
+{
+    std::vector<FormattedLine> lines;
+    std::string messages;
+    std::string file;
+};
 
-void OFS_FileLogger::Shutdown() noexcept
+static void AppendRecord(LogBatch& batch, const RecordHeader& header, const uint8_t* data, uint32_t threadIndex) noexcept
 {
-    if(!LogFileHandle) return;
-    Thread.Shutdown();
-    SDL_RWclose(LogFileHandle);
+    LogArg args[MaxArgs];
+    int32_t argCount = DecodeArgs(header, data, args);
+
+    FormattedLine line;
+    line.timestamp = header.timestamp;
+    line.level = header.level;
+    line.raw = header.flags & RecordFlags::Raw;
+    line.thread = threadIndex;
+    line.offset = batch.messages.size();
+
+    if (line.raw) {
+        for (int32_t i = 0; i < argCount; i++) {
+            if (args[i].type == ArgType::String) batch.messages.append(args[i].str, args[i].length);
+        }
+    }
+    else {
+        FormatMessage(header.format, args, argCount, batch.messages);
+        if (header.suppressed > 0) {
+            char buf[64];
+            int len = stbsp_snprintf(buf, sizeof(buf), " (%u similar messages suppressed)", header.suppressed);
+            batch.messages.append(buf, len);
+        }
+    }
+    // the message is always followed by exactly one newline
+    while (batch.messages.size() > line.offset && batch.messages.back() == '\n') {
+        batch.messages.pop_back();
+    }
+    line.length = batch.messages.size() - line.offset;
+    batch.lines.emplace_back(line);
 }
 
-void OFS_FileLogger::DrawLogWindow(bool* open) noexcept
+static void AppendDropped(LogBatch& batch, uint32_t dropped, uint32_t threadIndex) noexcept
 {
-    if(!*open) return;
-    OFS_MainLog.Draw(TR_ID("OFS_LOG_OUTPUT", Tr::OFS_LOG_OUTPUT), open);
+    char buf[96];
+    int len = stbsp_snprintf(buf, sizeof(buf), "%u messages from thread %u were dropped.", dropped, threadIndex);
+    FormattedLine line;
+    line.timestamp = SDL_GetPerformanceCounter();
+    line.level = (uint8_t)OFS_LogLevel::OFS_LOG_WARN;
+    line.raw = false;
+    line.thread = threadIndex;
+    line.offset = batch.messages.size();
+    line.length = len;
+    batch.messages.append(buf, len);
+    batch.lines.emplace_back(line);
 }
 
-inline static void LogToConsole(OFS_LogLevel level, const char* msg) noexcept
+static void EmitBatch(LogBatch& batch) noexcept
 {
+    if (batch.lines.empty()) return;
     OFS_PROFILE(__FUNCTION__);
-    switch(level) {
-        case OFS_LogLevel::OFS_LOG_INFO:
-            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, msg);
-            OFS_MainLog.AddLog("[INFO]: %s\n", msg);
-            break;
-        case OFS_LogLevel::OFS_LOG_WARN:
-            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, msg);
-            OFS_MainLog.AddLog("[WARN]: %s\n", msg);
-            break;
-        case OFS_LogLevel::OFS_LOG_DEBUG: 
-            SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION, msg); 
-            OFS_MainLog.AddLog("[DEBUG]: %s\n", msg);
-            break;
-        case OFS_LogLevel::OFS_LOG_ERROR: 
-            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, msg); 
-            OFS_MainLog.AddLog("[ERROR]: %s\n", msg);
-            break;
-    }
-}
-
-inline static void AppendToBuf(std::vector<char>& buffer, const char* msg, uint32_t size) noexcept {
-    OFS_PROFILE(__FUNCTION__);
-    auto initialSize = buffer.size();               
-    buffer.resize(initialSize + size);
-    memcpy(buffer.data() + initialSize, msg, size);
-};
+    // rings get drained one after another, this restores the order between threads
+    std::stable_sort(batch.lines.begin(), batch.lines.end(),
+        [](auto& a, auto& b) { return a.timestamp < b.timestamp; });
+
+    std::string window;
+    char prefix[64];
+    for (auto& line : batch.lines) {
+        const char* msg = batch.messages.data() + line.offset;
+        if (line.raw) {
+            SDL_Log("%.*s", (int)line.length, msg);
+            batch.file.append(msg, line.length);
+            batch.file.append(1, '\n');
+            continue;
+        }
+
+        float time = (line.timestamp - Thread.startTicks) / (double)Thread.ticksPerSecond;
+        int len = stbsp_snprintf(prefix, sizeof(prefix), "[%6.3f][%s][T%u]: ", time, LevelName(line.level, true), line.thread);
+        batch.file.append(prefix, len);
+        batch.file.append(msg, line.length);
+        batch.file.append(1, '\n');
 
-inline static void AddNewLine() noexcept
+        SDL_LogPriority priority;
+        switch ((OFS_LogLevel)line.level) {
+            case OFS_LogLevel::OFS_LOG_WARN: priority = SDL_LOG_PRIORITY_WARN; break;
+            case OFS_LogLevel::OFS_LOG_DEBUG: priority = SDL_LOG_PRIORITY_DEBUG; break;
+            case OFS_LogLevel::OFS_LOG_ERROR: priority = SDL_LOG_PRIORITY_ERROR; break;
+            default: priority = SDL_LOG_PRIORITY_INFO; break;
+        }
+        SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, priority, "%.*s", (int)line.length, msg);
+
+        len = stbsp_snprintf(prefix, sizeof(prefix), "[%s]: ", LevelName(line.level, false));
+        window.append(prefix, len);
+        window.append(msg, line.length);
+        window.append(1, '\n');
+    }
+
+    // records which bypassed the rings get emitted from their own thread
+    SDL_AtomicLock(&Thread.fileLock);
+    if (OFS_FileLogger::LogFileHandle) {
+        SDL_RWwrite(OFS_FileLogger::LogFileHandle, batch.file.data(), 1, batch.file.size());
+    }
+    SDL_AtomicUnlock(&Thread.fileLock);
+    if (!window.empty()) {
+        SDL_AtomicLock(&Thread.windowLock);
+        Thread.windowBuffer.append(window);
+        SDL_AtomicUnlock(&Thread.windowLock);
+    }
+
+    batch.lines.clear();
+    batch.messages.clear();
+    batch.file.clear();
+}
+
+static void DrainThreadLog(OFS_ThreadLog& log, LogBatch& batch) noexcept
 {
-    OFS_PROFILE(__FUNCTION__);
-    // insert a newline if needed
-    auto& buffer = Thread.LogMsgBuffer;
-    if(!buffer.empty() &&  buffer.back() != '\n') {
-        buffer.resize(buffer.size() + 1);
-        buffer.back() = '\n';
+    uint64_t tail = log.tail.load(std::memory_order_relaxed);
+    uint64_t head = log.head.load(std::memory_order_acquire);
+    while (tail < head) {
+        auto record = log.ring.get() + (tail % RingCapacity);
+        RecordHeader header;
+        // padding at the end of the ring might be shorter than a full header
+        memcpy(&header, record, sizeof(header.size) + sizeof(header.flags));
+        if (!(header.flags & RecordFlags::Padding)) {
+            memcpy(&header, record, sizeof(header));
+            AppendRecord(batch, header, record + sizeof(header), log.index);
+        }
+        tail += AlignRecord(header.size);
+        // frees the space right away, a blocked producer can continue
+        log.tail.store(tail, std::memory_order_release);
+    }
+
+    uint32_t dropped = log.dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+        AppendDropped(batch, dropped, log.index);
     }
 }
 
-void OFS_FileLogger::LogToFileR(const char* prefix, const char* msg, bool newLine) noexcept
+static void DrainAll(LogBatch& batch) noexcept
 {
-    OFS_PROFILE(__FUNCTION__);
-    SDL_Log("%s %s", prefix, msg);
-    SDL_AtomicLock(&Thread.lock);
-    
-    auto& buffer = Thread.LogMsgBuffer;
-    AppendToBuf(buffer, prefix, strlen(prefix));
-    AppendToBuf(buffer, msg, strlen(msg));
+    for (auto log = Thread.registry.load(std::memory_order_acquire); log != nullptr; log = log->next) {
+        DrainThreadLog(*log, batch);
+    }
+    EmitBatch(batch);
+}
 
-    if(newLine) {
-        AddNewLine();
+static int LogThreadFunction(void*) noexcept
+{
+    LogBatch batch;
+    while (!Thread.shouldExit.load(std::memory_order_acquire)) {
+        // producers never signal unless their ring is full, a short timeout keeps the file current
+        SDL_SemWaitTimeout(Thread.wake, 20);
+        DrainAll(batch);
     }
+    DrainAll(batch);
+    return 0;
+}
 
-    SDL_AtomicUnlock(&Thread.lock);   
+bool OFS_FileLogger::beginRecord(OFS_LogSite& site, uint64_t& timestamp, uint32_t& suppressed) noexcept
+{
+    timestamp = SDL_GetPerformanceCounter();
+    uint32_t window = (uint32_t)(timestamp / Thread.ticksPerSecond);
+    if (site.window.load(std::memory_order_relaxed) != window) {
+        // racy across threads, at worst a few extra messages get through
+        site.window.store(window, std::memory_order_relaxed);
+        site.count.store(0, std::memory_order_relaxed);
+    }
+    if (site.count.fetch_add(1, std::memory_order_relaxed) >= MaxMessagesPerSecond) {
+        site.suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+    return true;
 }
 
-void OFS_FileLogger::LogToFileR(OFS_LogLevel level, const char* msg, uint32_t size, bool newLine) noexcept
+uint8_t* OFS_FileLogger::reserve(uint32_t size) noexcept
 {
-    OFS_PROFILE(__FUNCTION__);
-    LogToConsole(level, msg);
-    SDL_AtomicLock(&Thread.lock);
+    if (!Thread.running.load(std::memory_order_acquire) || size > MaxRecordSize) {
+        DirectPending = true;
+        DirectRecord.resize(size);
+        return DirectRecord.data();
+    }
 
-    auto& buffer = Thread.LogMsgBuffer;
-    {
-        constexpr const char* fmt = "[%6.3f][%s]: ";
-        char fileFmt[32];
-        int msgTypeLen;
-        const float time = SDL_GetTicks() / 1000.f;
-        switch(level) {
-            case OFS_LogLevel::OFS_LOG_INFO:
-                msgTypeLen = stbsp_snprintf(fileFmt, sizeof(fileFmt), fmt, time, "INFO "); 
-                break;
-            case OFS_LogLevel::OFS_LOG_WARN: 
-                msgTypeLen = stbsp_snprintf(fileFmt, sizeof(fileFmt), fmt, time, "WARN ");
-                break;
-            case OFS_LogLevel::OFS_LOG_DEBUG: 
-                msgTypeLen = stbsp_snprintf(fileFmt, sizeof(fileFmt), fmt, time, "DEBUG"); 
-                break;
-            case OFS_LogLevel::OFS_LOG_ERROR: 
-                msgTypeLen = stbsp_snprintf(fileFmt, sizeof(fileFmt), fmt, time, "ERROR");
-                break;
-            default:
-                msgTypeLen = stbsp_snprintf(fileFmt, sizeof(fileFmt), fmt, time, "-----");
-                break;
+    if (CurrentLog.log == nullptr) {
+        CurrentLog.log = AcquireThreadLog();
+    }
+    auto& log = *CurrentLog.log;
+    size = AlignRecord(size);
+
+    uint64_t head = log.head.load(std::memory_order_relaxed);
+    uint32_t offset = head % RingCapacity;
+    uint32_t contiguous = RingCapacity - offset;
+    // records never wrap, the rest of the ring gets skipped
+    uint32_t needed = contiguous < size ? contiguous + size : size;
+
+    while (head + needed - log.tail.load(std::memory_order_acquire) > RingCapacity) {
+        // nobody drains the ring during shutdown
+        if (Thread.overflow.load(std::memory_order_relaxed) == OFS_LogOverflow::Drop
+            || !Thread.running.load(std::memory_order_acquire)) {
+            log.dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
         }
-        AppendToBuf(buffer, fileFmt, msgTypeLen);
+        SDL_SemPost(Thread.wake);
+        SDL_Delay(0);
     }
-    
-    size = size == 0 ? strlen(msg) : size;
-    AppendToBuf(buffer, msg, size);
 
-    if(newLine) {
-        AddNewLine();
+    if (contiguous < size) {
+        RecordHeader padding = {};
+        padding.size = contiguous;
+        padding.flags = RecordFlags::Padding;
+        // only the size and flags fit for sure, the header has them first
+        memcpy(log.ring.get() + offset, &padding, sizeof(padding.size) + sizeof(padding.flags));
+        head += contiguous;
+        log.head.store(head, std::memory_order_release);
+        offset = 0;
     }
+    return log.ring.get() + offset;
+}
 
-    SDL_AtomicUnlock(&Thread.lock);
+void OFS_FileLogger::commit(uint32_t size) noexcept
+{
+    if (DirectPending) {
+        DirectPending = false;
+        // no writer thread or too big for the ring, formatted on the spot
+        RecordHeader header;
+        memcpy(&header, DirectRecord.data(), sizeof(header));
+        LogBatch batch;
+        AppendRecord(batch, header, DirectRecord.data() + sizeof(header), CurrentLog.log ? CurrentLog.log->index : 0);
+        EmitBatch(batch);
+        return;
+    }
+
+    auto& log = *CurrentLog.log;
+    log.head.store(log.head.load(std::memory_order_relaxed) + AlignRecord(size), std::memory_order_release);
 }
 
-void OFS_FileLogger::Flush() noexcept
+void OFS_FileLogger::Init() noexcept
+{
+    if(LogFileHandle) return;
+    #ifndef NDEBUG
+        SDL_LogSetAllPriority(SDL_LOG_PRIORITY_VERBOSE);
+    #endif
+    auto LogFilePath = Util::Prefpath("OFS.log");
+    LogFileHandle = SDL_RWFromFile(LogFilePath.c_str(), "w");
+
+    Thread.startTicks = SDL_GetPerformanceCounter();
+    Thread.ticksPerSecond = SDL_GetPerformanceFrequency();
+    Thread.shouldExit = false;
+    Thread.wake = SDL_CreateSemaphore(0);
+    Thread.thread = SDL_CreateThread(LogThreadFunction, "MessageLogging", nullptr);
+    Thread.running = true;
+}
+
+void OFS_FileLogger::Shutdown() noexcept
+{
+    if(!LogFileHandle) return;
+    // everything logged from here on gets written directly
+    Thread.running = false;
+    Thread.shouldExit = true;
+    SDL_SemPost(Thread.wake);
+    SDL_WaitThread(Thread.thread, nullptr);
+    Thread.thread = nullptr;
+    SDL_DestroySemaphore(Thread.wake);
+    Thread.wake = nullptr;
+    SDL_AtomicLock(&Thread.fileLock);
+    SDL_RWclose(LogFileHandle);
+    LogFileHandle = nullptr;
+    SDL_AtomicUnlock(&Thread.fileLock);
+}
+
+void OFS_FileLogger::SetOverflowMode(OFS_LogOverflow mode) noexcept
+{
+    Thread.overflow.store(mode, std::memory_order_relaxed);
+}
+
+void OFS_FileLogger::DrawLogWindow(bool* open) noexcept
+{
+    if(!*open) return;
+    OFS_MainLog.Draw(TR_ID("OFS_LOG_OUTPUT", Tr::OFS_LOG_OUTPUT), open);
+}
+
+void OFS_FileLogger::LogToFileR(const char* prefix, const char* msg) noexcept
 {
-    if(!Thread.LogMsgBuffer.empty()) SDL_CondSignal(Thread.WaitFlush);
+    uint16_t prefixLength = (uint16_t)strnlen(prefix, MaxStringLength);
+    uint16_t msgLength = (uint16_t)strnlen(msg, MaxStringLength);
+    uint32_t size = sizeof(RecordHeader) + 2 * (1 + sizeof(uint16_t)) + prefixLength + msgLength;
+    auto out = reserve(size);
+    if (out == nullptr) return;
+
+    RecordHeader header = {};
+    header.size = size;
+    header.flags = RecordFlags::Raw;
+    header.argCount = 2;
+    header.level = (uint8_t)OFS_LogLevel::OFS_LOG_INFO;
+    header.timestamp = SDL_GetPerformanceCounter();
+    memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    out = WriteString(out, prefix, prefixLength);
+    WriteString(out, msg, msgLength);
+    commit(size);
 }
 
-void OFS_FileLogger::LogToFileF(OFS_LogLevel level, const char* fmt, ...) noexcept
+void OFS_FileLogger::LogToFileR(OFS_LogLevel level, const char* msg, uint32_t size) noexcept
+{
+    uint16_t msgLength = (uint16_t)std::min<uint32_t>(size == 0 ? strlen(msg) : size, MaxStringLength);
+    uint32_t recordSize = sizeof(RecordHeader) + 1 + sizeof(uint16_t) + msgLength;
+    auto out = reserve(recordSize);
+    if (out == nullptr) return;
+
+    RecordHeader header = {};
+    header.size = recordSize;
+    header.argCount = 1;
+    header.level = (uint8_t)level;
+    header.timestamp = SDL_GetPerformanceCounter();
+    header.format = "%s";
+    memcpy(out, &header, sizeof(header));
+    WriteString(out + sizeof(header), msg, msgLength);
+    commit(recordSize);
+}
+
+void OFS_FileLogger::Flush() noexcept
 {
     OFS_PROFILE(__FUNCTION__);
-    char FormatBuffer[1024];
-    va_list args;
-    va_start(args, fmt);
-    auto len = stbsp_vsnprintf(FormatBuffer, sizeof(FormatBuffer), fmt, args);
-    va_end(args);
-    LogToFileR(level, FormatBuffer, len > sizeof(FormatBuffer) ? sizeof(FormatBuffer) : len);
-}
\ No newline at end of file
+    std::string window;
+    SDL_AtomicLock(&Thread.windowLock);
+    window.swap(Thread.windowBuffer);
+    SDL_AtomicUnlock(&Thread.windowLock);
+    if (!window.empty()) {
+        OFS_MainLog.AddLog("%s", window.c_str());
+    }
+}
@@ -1,8 +1,13 @@
 #pragma once
 #include <cstdint>
 #include <cstdarg>
+#include <cstring>
+#include <string>
+#include <atomic>
+#include <algorithm>
+#include <type_traits>
 
-enum class OFS_LogLevel : int32_t 
+enum class OFS_LogLevel : int32_t
 {
     OFS_LOG_INFO,
     OFS_LOG_WARN,
@@ -10,41 +15,179 @@ enum class OFS_LogLevel : int32_t
     OFS_LOG_ERROR,
 };
 
+enum class OFS_LogOverflow : int32_t
+{
+    Block, // lossless, the logging thread waits for the writer
+    Drop, // dropped messages get counted and reported
+};
+
+// every LOG_ macro has one of these, a call site can only log so often per second
+struct OFS_LogSite
+{
+    std::atomic<uint32_t> window = { 0 };
+    std::atomic<uint32_t> count = { 0 };
+    std::atomic<uint32_t> suppressed = { 0 };
+};
+
+namespace OFS_LogDetail
+{
+    enum class ArgType : uint8_t { Int, UInt, Double, String, Pointer };
+    constexpr uint32_t MaxStringLength = 2048;
+
+    enum RecordFlags : uint8_t {
+        Padding = 1 << 0,
+        Raw = 1 << 1, // no format, the string arguments get written as they are
+    };
+
+    struct RecordHeader
+    {
+        uint32_t size;
+        uint8_t flags;
+        uint8_t argCount;
+        uint8_t level;
+        uint32_t suppressed;
+        uint64_t timestamp;
+        // string literals, the address doubles as format id
+        const char* format;
+    };
+
+    template<typename T>
+    inline uint32_t ArgSize(const T& arg) noexcept
+    {
+        using D = std::decay_t<T>;
+        if constexpr (std::is_same_v<D, const char*> || std::is_same_v<D, char*>) {
+            return 1 + sizeof(uint16_t) + (arg ? (uint32_t)strnlen(arg, MaxStringLength) : 0);
+        }
+        else if constexpr (std::is_same_v<D, std::string>) {
+            return 1 + sizeof(uint16_t) + (uint32_t)std::min<size_t>(arg.size(), MaxStringLength);
+        }
+        else {
+            return 1 + sizeof(uint64_t);
+        }
+    }
+
+    inline uint8_t* WriteString(uint8_t* out, const char* str, uint16_t length) noexcept
+    {
+        *out++ = (uint8_t)ArgType::String;
+        memcpy(out, &length, sizeof(length));
+        out += sizeof(length);
+        memcpy(out, str, length);
+        return out + length;
+    }
+
+    template<typename T>
+    inline uint8_t* WriteValue(uint8_t* out, ArgType type, T value) noexcept
+    {
+        static_assert(sizeof(T) == sizeof(uint64_t));
+        *out++ = (uint8_t)type;
+        memcpy(out, &value, sizeof(value));
+        return out + sizeof(value);
+    }
+
+    template<typename T>
+    inline uint8_t* WriteArg(uint8_t* out, const T& arg) noexcept
+    {
+        using D = std::decay_t<T>;
+        if constexpr (std::is_same_v<D, const char*> || std::is_same_v<D, char*>) {
+            if (!arg) return WriteString(out, "(null)", 6);
+            return WriteString(out, arg, (uint16_t)strnlen(arg, MaxStringLength));
+        }
+        else if constexpr (std::is_same_v<D, std::string>) {
+            return WriteString(out, arg.data(), (uint16_t)std::min<size_t>(arg.size(), MaxStringLength));
+        }
+        else if constexpr (std::is_floating_point_v<D>) {
+            return WriteValue(out, ArgType::Double, (double)arg);
+        }
+        else if constexpr (std::is_enum_v<D>) {
+            return WriteValue(out, ArgType::Int, (int64_t)arg);
+        }
+        else if constexpr (std::is_integral_v<D> && std::is_signed_v<D>) {
+            return WriteValue(out, ArgType::Int, (int64_t)arg);
+        }
+        else if constexpr (std::is_integral_v<D>) {
+            return WriteValue(out, ArgType::UInt, (uint64_t)arg);
+        }
+        else {
+            static_assert(std::is_pointer_v<D>, "unsupported log argument");
+            return WriteValue(out, ArgType::Pointer, (uint64_t)(uintptr_t)arg);
+        }
+    }
+}
+
+// log calls write binary records into a ring buffer owned by the calling thread, no locks involved.
+// a background thread formats them, writes them to the log file in batches and forwards them to the console and log window.
 class OFS_FileLogger
 {
 public:
-    static constexpr int MaxLogThreads = 1;
     static struct SDL_RWops* LogFileHandle;
 
     static void Init() noexcept;
     static void Shutdown() noexcept;
 
+    // main thread, moves formatted messages into the log window
     static void Flush() noexcept;
     static void DrawLogWindow(bool* open) noexcept;
 
-    static void LogToFileR(const char* prefix, const char* msg, bool newLine = true) noexcept;
-    static void LogToFileR(OFS_LogLevel level, const char* msg, uint32_t size = 0, bool newLine = true) noexcept;
-    static void LogToFileF(OFS_LogLevel level, const char* fmt, ...) noexcept;
+    static void SetOverflowMode(OFS_LogOverflow mode) noexcept;
+
+    // prefix + msg without level and timestamp, never rate limited
+    static void LogToFileR(const char* prefix, const char* msg) noexcept;
+    static void LogToFileR(OFS_LogLevel level, const char* msg, uint32_t size = 0) noexcept;
+
+    template<typename... Args>
+    inline static void Log(OFS_LogSite& site, OFS_LogLevel level, const char* fmt, const Args&... args) noexcept
+    {
+        using namespace OFS_LogDetail;
+        uint64_t timestamp;
+        uint32_t suppressed;
+        if (!beginRecord(site, timestamp, suppressed)) return;
+
+        uint32_t size = sizeof(RecordHeader) + (ArgSize(args) + ... + 0);
+        auto out = reserve(size);
+        if (out == nullptr) return;
+
+        RecordHeader header;
+        header.size = size;
+        header.flags = 0;
+        header.argCount = sizeof...(Args);
+        header.level = (uint8_t)level;
+        header.suppressed = suppressed;
+        header.timestamp = timestamp;
+        header.format = fmt;
+        memcpy(out, &header, sizeof(header));
+        out += sizeof(header);
+        ((out = WriteArg(out, args)), ...);
+        commit(size);
+    }
+
+private:
+    static bool beginRecord(OFS_LogSite& site, uint64_t& timestamp, uint32_t& suppressed) noexcept;
+    // space for a record in the calling threads ring buffer, nullptr if it got dropped
+    static uint8_t* reserve(uint32_t size) noexcept;
+    static void commit(uint32_t size) noexcept;
 };
 
+#define OFS_LOG_AT_SITE(level, fmt, ...) \
+    do { static OFS_LogSite LogSite; OFS_FileLogger::Log(LogSite, level, fmt, __VA_ARGS__); } while(0)
+
 #ifndef NDEBUG
-#define LOG_INFO(msg) OFS_FileLogger::LogToFileR(OFS_LogLevel::OFS_LOG_INFO, msg)
-#define LOG_WARN(msg) OFS_FileLogger::LogToFileR(OFS_LogLevel::OFS_LOG_WARN, msg)
-#define LOG_DEBUG(msg)OFS_FileLogger::LogToFileR(OFS_LogLevel::OFS_LOG_DEBUG, msg)
-#define LOG_ERROR(msg)OFS_FileLogger::LogToFileR(OFS_LogLevel::OFS_LOG_ERROR, msg)
-
-#define LOGF_INFO( fmt, ...) OFS_FileLogger::LogToFileF(OFS_LogLevel::OFS_LOG_INFO, fmt, __VA_ARGS__)
-#define LOGF_WARN( fmt, ...) OFS_FileLogger::LogToFileF(OFS_LogLevel::OFS_LOG_WARN, fmt, __VA_ARGS__)
-#define LOGF_DEBUG(fmt, ...) OFS_FileLogger::LogToFileF(OFS_LogLevel::OFS_LOG_DEBUG, fmt, __VA_ARGS__)
-#define LOGF_ERROR(fmt, ...) OFS_FileLogger::LogToFileF(OFS_LogLevel::OFS_LOG_ERROR, fmt, __VA_ARGS__)
+#define LOG_INFO(msg) OFS_LOG_AT_SITE(OFS_LogLevel::OFS_LOG_INFO, "%s", msg)
+#define LOG_WARN(msg) OFS_LOG_AT_SITE(OFS_LogLevel::OFS_LOG_WARN, "%s", msg)
+#define LOG_DEBUG(msg)OFS_LOG_AT_SITE(OFS_LogLevel::OFS_LOG_DEBUG, "%s", msg)
+#define LOG_ERROR(msg)OFS_LOG_AT_SITE(OFS_LogLevel::OFS_LOG_ERROR, "%s", msg)
+
+#define LOGF_INFO( fmt, ...) OFS_LOG_AT_SITE(OFS_LogLevel::OFS_LOG_INFO, fmt, __VA_ARGS__)
+#define LOGF_WARN( fmt, ...) OFS_LOG_AT_SITE(OFS_LogLevel::OFS_LOG_WARN, fmt, __VA_ARGS__)
+#define LOGF_DEBUG(fmt, ...) OFS_LOG_AT_SITE(OFS_LogLevel::OFS_LOG_DEBUG, fmt, __VA_ARGS__)
+#define LOGF_ERROR(fmt, ...) OFS_LOG_AT_SITE(OFS_LogLevel::OFS_LOG_ERROR, fmt, __VA_ARGS__)
 #else
-#define LOG_INFO(msg) OFS_FileLogger::LogToFileR(OFS_LogLevel::OFS_LOG_INFO, msg)
-#define LOG_WARN(msg) OFS_FileLogger::LogToFileR(OFS_LogLevel::OFS_LOG_WARN, msg)
+#define LOG_INFO(msg) OFS_LOG_AT_SITE(OFS_LogLevel::OFS_LOG_INFO, "%s", msg)
+#define LOG_WARN(msg) OFS_LOG_AT_SITE(OFS_LogLevel::OFS_LOG_WARN, "%s", msg)
 #define LOG_DEBUG(msg)
-#define LOG_ERROR(msg)OFS_FileLogger::LogToFileR(OFS_LogLevel::OFS_LOG_ERROR, msg)
+#define LOG_ERROR(msg)OFS_LOG_AT_SITE(OFS_LogLevel::OFS_LOG_ERROR, "%s", msg)
 
-#define LOGF_INFO( fmt, ...) OFS_FileLogger::LogToFileF(OFS_LogLevel::OFS_LOG_INFO, fmt, __VA_ARGS__)
-#define LOGF_WARN( fmt, ...) OFS_FileLogger::LogToFileF(OFS_LogLevel::OFS_LOG_WARN, fmt, __VA_ARGS__)
+#define LOGF_INFO( fmt, ...) OFS_LOG_AT_SITE(OFS_LogLevel::OFS_LOG_INFO, fmt, __VA_ARGS__)
+#define LOGF_WARN( fmt, ...) OFS_LOG_AT_SITE(OFS_LogLevel::OFS_LOG_WARN, fmt, __VA_ARGS__)
 #define LOGF_DEBUG(fmt, ...)
-#define LOGF_ERROR(fmt, ...) OFS_FileLogger::LogToFileF(OFS_LogLevel::OFS_LOG_ERROR, fmt, __VA_ARGS__)
-#endif
\ No newline at end of file
+#define LOGF_ERROR(fmt, ...) OFS_LOG_AT_SITE(OFS_LogLevel::OFS_LOG_ERROR, fmt, __VA_ARGS__)
+#endif
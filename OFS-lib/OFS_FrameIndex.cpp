@@ -0,0 +1,364 @@
+#include "OFS_FrameIndex.h"
+#include "OFS_Util.h"
+#include "OFS_Profiling.h"
+#include "OFS_AsyncIO.h"
+#include "OFS_BinarySerialization.h"
+
+#include <algorithm>
+#include <filesystem>
+
+// the moov box of a few hours of 60fps video is a couple of megabytes
+constexpr uint64_t MaxMoovSize = 256 * 1024 * 1024;
+
+inline static constexpr uint32_t FourCC(const char (&str)[5]) noexcept
+{
+	return ((uint32_t)str[0] << 24) | ((uint32_t)str[1] << 16) | ((uint32_t)str[2] << 8) | (uint32_t)str[3];
+}
+
+inline static uint32_t ReadU32(const uint8_t* data) noexcept
+{
+	return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+}
+
+inline static uint64_t ReadU64(const uint8_t* data) noexcept
+{
+	return ((uint64_t)ReadU32(data) << 32) | (uint64_t)ReadU32(data + 4);
+}
+
+struct Box
+{
+	uint32_t type = 0;
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+};
+
+// calls func(Box) for every child box, false if the boxes don't fit into data
+template<typename F>
+static bool ForEachBox(const uint8_t* data, size_t size, F&& func) noexcept
+{
+	size_t pos = 0;
+	while (pos + 8 <= size) {
+		uint64_t boxSize = ReadU32(data + pos);
+		uint32_t type = ReadU32(data + pos + 4);
+		size_t headerSize = 8;
+		if (boxSize == 1) {
+			if (pos + 16 > size) return false;
+			boxSize = ReadU64(data + pos + 8);
+			headerSize = 16;
+		}
+		else if (boxSize == 0) {
+			boxSize = size - pos;
+		}
+		if (boxSize < headerSize || boxSize > size - pos) return false;
+
+		Box box;
+		box.type = type;
+		box.data = data + pos + headerSize;
+		box.size = boxSize - headerSize;
+		func(box);
+		pos += boxSize;
+	}
+	return true;
+}
+
+static bool FindBox(const Box& parent, uint32_t type, Box& result) noexcept
+{
+	bool found = false;
+	ForEachBox(parent.data, parent.size, [&](const Box& box) {
+		if (!found && box.type == type) {
+			result = box;
+			found = true;
+		}
+	});
+	return found;
+}
+
+// the first four bytes of a full box are the version and flags
+inline static uint8_t FullBoxVersion(const Box& box) noexcept
+{
+	return box.size > 0 ? box.data[0] : 0;
+}
+
+// entry tables of full boxes, func(entryData) gets called entryCount times
+template<typename F>
+static bool ForEachEntry(const Box& box, size_t tableOffset, size_t entrySize, F&& func) noexcept
+{
+	if (box.size < tableOffset + 4) return false;
+	uint32_t count = ReadU32(box.data + tableOffset);
+	const uint8_t* entry = box.data + tableOffset + 4;
+	if ((box.size - tableOffset - 4) / entrySize < count) return false;
+	for (uint32_t i = 0; i < count; i++, entry += entrySize) {
+		func(entry);
+	}
+	return true;
+}
+
+static bool ReadMoov(SDL_RWops* file, std::vector<uint8_t>& moov) noexcept
+{
+	int64_t fileSize = SDL_RWsize(file);
+	int64_t pos = 0;
+	uint8_t header[16];
+	while (pos + 8 <= fileSize) {
+		// the moov box can come after mdat, only headers get read on the way
+		if (SDL_RWseek(file, pos, RW_SEEK_SET) < 0) return false;
+		if (SDL_RWread(file, header, 1, 8) != 8) return false;
+		uint64_t size = ReadU32(header);
+		uint32_t type = ReadU32(header + 4);
+		int64_t headerSize = 8;
+		if (size == 1) {
+			if (SDL_RWread(file, header + 8, 1, 8) != 8) return false;
+			size = ReadU64(header + 8);
+			headerSize = 16;
+		}
+		else if (size == 0) {
+			size = fileSize - pos;
+		}
+		if (size < (uint64_t)headerSize || size > (uint64_t)(fileSize - pos)) return false;
+
+		if (type == FourCC("moov")) {
+			if (size - headerSize > MaxMoovSize) return false;
+			moov.resize(size - headerSize);
+			return SDL_RWread(file, moov.data(), 1, moov.size()) == moov.size();
+		}
+		pos += size;
+	}
+	return false;
+}
+
+// timescale of mvhd and mdhd
+static uint32_t ReadTimescale(const Box& box) noexcept
+{
+	// version 1 has 64 bit creation and modification times
+	size_t offset = FullBoxVersion(box) == 1 ? 4 + 16 : 4 + 8;
+	if (box.size < offset + 4) return 0;
+	return ReadU32(box.data + offset);
+}
+
+struct Track
+{
+	uint32_t handler = 0;
+	uint32_t timescale = 0;
+	// movie timescale, leading empty edits delay the whole track
+	int64_t emptyEdit = 0;
+	// track timescale, samples before it get discarded
+	int64_t mediaTime = 0;
+	Box stbl;
+};
+
+static bool ReadTrack(const Box& trak, Track& track) noexcept
+{
+	Box mdia, mdhd, hdlr, minf;
+	if (!FindBox(trak, FourCC("mdia"), mdia)) return false;
+	if (!FindBox(mdia, FourCC("mdhd"), mdhd) || !FindBox(mdia, FourCC("hdlr"), hdlr)) return false;
+	if (hdlr.size < 12) return false;
+	track.handler = ReadU32(hdlr.data + 8);
+	track.timescale = ReadTimescale(mdhd);
+	if (track.timescale == 0) return false;
+
+	Box edts, elst;
+	if (FindBox(trak, FourCC("edts"), edts) && FindBox(edts, FourCC("elst"), elst)) {
+		bool wide = FullBoxVersion(elst) == 1;
+		bool done = false;
+		ForEachEntry(elst, 4, wide ? 20 : 12, [&](const uint8_t* entry) {
+			if (done) return;
+			int64_t duration = wide ? (int64_t)ReadU64(entry) : ReadU32(entry);
+			int64_t mediaTime = wide ? (int64_t)ReadU64(entry + 8) : (int32_t)ReadU32(entry + 4);
+			if (mediaTime == -1) {
+				track.emptyEdit += duration;
+			}
+			else {
+				// only the first segment, edit lists which cut the video aren't supported
+				track.mediaTime = mediaTime;
+				done = true;
+			}
+		});
+	}
+
+	if (FindBox(mdia, FourCC("minf"), minf)) {
+		FindBox(minf, FourCC("stbl"), track.stbl);
+	}
+	return true;
+}
+
+struct Frame
+{
+	double pts;
+	uint8_t keyframe;
+};
+
+// decode timestamps from stts, composition offsets from ctts and sync samples from stss
+static bool ReadFrames(const Track& track, std::vector<int64_t>& cts, std::vector<uint8_t>& keyframes) noexcept
+{
+	Box stts, ctts, stss, stsz;
+	if (track.stbl.data == nullptr || !FindBox(track.stbl, FourCC("stts"), stts)) return false;
+
+	int64_t dts = 0;
+	bool valid = ForEachEntry(stts, 4, 8, [&](const uint8_t* entry) {
+		uint32_t count = ReadU32(entry);
+		uint32_t delta = ReadU32(entry + 4);
+		for (uint32_t i = 0; i < count && cts.size() < 100000000; i++) {
+			cts.emplace_back(dts);
+			dts += delta;
+		}
+	});
+	if (!valid || cts.empty()) return false;
+
+	// stts can claim more samples than there are
+	if (FindBox(track.stbl, FourCC("stsz"), stsz) && stsz.size >= 12) {
+		uint32_t sampleCount = ReadU32(stsz.data + 8);
+		if (sampleCount < cts.size()) cts.resize(sampleCount);
+	}
+
+	if (FindBox(track.stbl, FourCC("ctts"), ctts)) {
+		size_t sample = 0;
+		ForEachEntry(ctts, 4, 8, [&](const uint8_t* entry) {
+			uint32_t count = ReadU32(entry);
+			// version 0 is unsigned but plenty of muxers write negative offsets anyway
+			int32_t offset = (int32_t)ReadU32(entry + 4);
+			for (uint32_t i = 0; i < count && sample < cts.size(); i++) {
+				cts[sample++] += offset;
+			}
+		});
+	}
+
+	// without stss every sample is a keyframe
+	if (FindBox(track.stbl, FourCC("stss"), stss)) {
+		keyframes.assign(cts.size(), 0);
+		ForEachEntry(stss, 4, 4, [&](const uint8_t* entry) {
+			uint32_t sample = ReadU32(entry);
+			if (sample >= 1 && sample <= keyframes.size()) keyframes[sample - 1] = 1;
+		});
+	}
+	else {
+		keyframes.assign(cts.size(), 1);
+	}
+	return true;
+}
+
+bool OFS_FrameIndex::build(const std::string& videoPath, OFS_FrameIndex& index) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	std::vector<uint8_t> moovData;
+	auto file = Util::OpenFile(videoPath.c_str(), "rb", videoPath.size());
+	if (file == nullptr) return false;
+	bool hasMoov = ReadMoov(file, moovData);
+	SDL_RWclose(file);
+	if (!hasMoov) return false;
+
+	Box moov;
+	moov.type = FourCC("moov");
+	moov.data = moovData.data();
+	moov.size = moovData.size();
+
+	Box mvhd;
+	if (!FindBox(moov, FourCC("mvhd"), mvhd)) return false;
+	uint32_t movieTimescale = ReadTimescale(mvhd);
+	if (movieTimescale == 0) return false;
+
+	std::vector<Track> tracks;
+	ForEachBox(moov.data, moov.size, [&](const Box& box) {
+		Track track;
+		if (box.type == FourCC("trak") && ReadTrack(box, track)) tracks.emplace_back(track);
+	});
+
+	// mpv plays the first video track, cover art is a single frame
+	std::vector<int64_t> cts;
+	std::vector<uint8_t> keyframes;
+	const Track* video = nullptr;
+	for (auto& track : tracks) {
+		if (track.handler != FourCC("vide")) continue;
+		cts.clear();
+		keyframes.clear();
+		if (ReadFrames(track, cts, keyframes) && cts.size() > 1) {
+			video = &track;
+			break;
+		}
+	}
+	if (video == nullptr) return false;
+
+	std::vector<Frame> frames;
+	frames.reserve(cts.size());
+	double videoDelay = (double)video->emptyEdit / movieTimescale;
+	double videoStart = 0.0;
+	for (size_t i = 0; i < cts.size(); i++) {
+		// cut by the edit list
+		if (cts[i] < video->mediaTime) continue;
+		Frame frame;
+		frame.pts = videoDelay + (double)(cts[i] - video->mediaTime) / video->timescale;
+		frame.keyframe = keyframes[i];
+		if (frames.empty() || frame.pts < videoStart) videoStart = frame.pts;
+		frames.emplace_back(frame);
+	}
+	if (frames.empty()) return false;
+
+	// mpv starts time-pos at the earliest audio or video timestamp
+	double fileStart = videoStart;
+	for (auto& track : tracks) {
+		if (track.handler != FourCC("soun")) continue;
+		fileStart = std::min(fileStart, (double)track.emptyEdit / movieTimescale);
+	}
+
+	std::sort(frames.begin(), frames.end(), [](auto& a, auto& b) { return a.pts < b.pts; });
+	index.Pts.resize(frames.size());
+	index.Keyframe.resize(frames.size());
+	for (size_t i = 0; i < frames.size(); i++) {
+		index.Pts[i] = frames[i].pts - fileStart;
+		index.Keyframe[i] = frames[i].keyframe;
+	}
+	return true;
+}
+
+std::shared_ptr<OFS_FrameIndex> OFS_FrameIndex::Load(const std::string& videoPath) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	auto path = Util::PathFromString(videoPath);
+	std::error_code ec;
+	// streams and anything else which isn't a local file
+	int64_t fileInfo[2];
+	fileInfo[0] = (int64_t)std::filesystem::file_size(path, ec);
+	if (ec) return nullptr;
+	fileInfo[1] = (int64_t)std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+	if (ec) return nullptr;
+
+	// a changed file gets a new index
+	uint32_t hash = Util::Hash(videoPath.c_str(), videoPath.size());
+	hash = Util::Hash((const char*)fileInfo, sizeof(fileInfo), (int32_t)hash);
+	char name[32];
+	stbsp_snprintf(name, sizeof(name), "%08x.idx", hash);
+	auto cacheDir = Util::Prefpath("frame_index");
+	auto cachePath = (Util::PathFromString(cacheDir) / name).u8string();
+
+	auto index = std::make_shared<OFS_FrameIndex>();
+	ByteBuffer buffer;
+	if (Util::ReadFile(cachePath.c_str(), buffer) > 0) {
+		auto error = OFS_Binary::Deserialize(buffer, *index);
+		if (error == bitsery::ReaderError::NoError && index->Count() > 0 && index->Keyframe.size() == index->Pts.size()) {
+			return index;
+		}
+		index = std::make_shared<OFS_FrameIndex>();
+	}
+
+	if (!build(videoPath, *index)) {
+		LOGF_INFO("No frame index for \"%s\", frame stepping uses the frame rate.", videoPath.c_str());
+		return nullptr;
+	}
+	LOGF_INFO("Indexed %lld frames of \"%s\"", (long long)index->Count(), videoPath.c_str());
+
+	if (Util::CreateDirectories(Util::PathFromString(cacheDir))) {
+		OFS_AsyncIO::Write write;
+		write.Path = std::move(cachePath);
+		write.Priority = OFS_AsyncIO::PriorityClass::Cache;
+		// the adapter grows the buffer past what got written
+		write.Buffer.resize(OFS_Binary::Serialize(write.Buffer, *index));
+		OFS_AsyncIO::WriteOrQueue(std::move(write));
+	}
+	return index;
+}
+
+int64_t OFS_FrameIndex::FrameAt(double time) const noexcept
+{
+	if (Pts.empty()) return 0;
+	// positions take a detour through percentages, half a millisecond of slack
+	auto it = std::upper_bound(Pts.begin(), Pts.end(), time + 0.0005);
+	return std::max<int64_t>(0, (int64_t)(it - Pts.begin()) - 1);
+}
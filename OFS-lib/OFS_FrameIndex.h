@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+// presentation timestamps and keyframe flags of every video frame
+// built from the sample tables of mp4/mov files, nothing gets decoded.
+// other containers (and fragmented mp4) don't get an index, the player keeps estimating from the frame rate.
+// timestamps start at the beginning of the file like mpv's time-pos.
+class OFS_FrameIndex
+{
+public:
+	// sorted, seconds
+	std::vector<double> Pts;
+	// per frame in presentation order
+	std::vector<uint8_t> Keyframe;
+
+	// reads the cached index or builds and caches it, nullptr if the file can't be indexed
+	// blocks on disk io, call it on a worker
+	static std::shared_ptr<OFS_FrameIndex> Load(const std::string& videoPath) noexcept;
+
+	inline int64_t Count() const noexcept { return (int64_t)Pts.size(); }
+	inline bool IsKeyframe(int64_t frame) const noexcept { return Keyframe[frame]; }
+	// the frame which is on screen at time
+	int64_t FrameAt(double time) const noexcept;
+
+	template<typename S>
+	void serialize(S& s)
+	{
+		constexpr uint32_t MaxFrames = 100000000;
+		auto version = Version;
+		s.value4b(version);
+		if (version != Version) {
+			Pts.clear();
+			Keyframe.clear();
+			return;
+		}
+		s.container8b(Pts, MaxFrames);
+		s.container1b(Keyframe, MaxFrames);
+	}
+
+private:
+	static constexpr uint32_t Version = 1;
+	static bool build(const std::string& videoPath, OFS_FrameIndex& index) noexcept;
+};
@@ -0,0 +1,296 @@
+#include "OFS_MainThreadExecutor.h"
+#include "OFS_Util.h"
+#include "OFS_Profiling.h"
+#include "OFS_Redraw.h"
+
+#include "SDL_timer.h"
+#include "SDL_atomic.h"
+#include "SDL_mutex.h"
+
+#include <atomic>
+#include <vector>
+#include <climits>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define OFS_FUTEX 1
+#elif defined(WIN32)
+#include <windows.h>
+#define OFS_FUTEX 1
+#endif
+
+// one shot completion, reset when it gets handed out again
+class Completion
+{
+	std::atomic<uint32_t> signaled = { 0 };
+#ifndef OFS_FUTEX
+	SDL_sem* sem = SDL_CreateSemaphore(0);
+#endif
+public:
+	Completion* nextFree = nullptr;
+
+	inline void Reset() noexcept { signaled.store(0, std::memory_order_relaxed); }
+
+	inline void Signal() noexcept
+	{
+		signaled.store(1, std::memory_order_release);
+#if defined(__linux__)
+		syscall(SYS_futex, (uint32_t*)&signaled, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#elif defined(WIN32)
+		WakeByAddressAll((void*)&signaled);
+#else
+		SDL_SemPost(sem);
+#endif
+	}
+
+	inline void Wait() noexcept
+	{
+#ifdef OFS_FUTEX
+		uint32_t expected = 0;
+		while (signaled.load(std::memory_order_acquire) == expected) {
+#if defined(__linux__)
+			syscall(SYS_futex, (uint32_t*)&signaled, FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+			WaitOnAddress((volatile void*)&signaled, &expected, sizeof(expected), INFINITE);
+#endif
+		}
+#else
+		SDL_SemWait(sem);
+#endif
+	}
+};
+
+struct MainThreadNode
+{
+	std::atomic<MainThreadNode*> next = { nullptr };
+	OFS_MainThreadExecutor::Invoke invoke = nullptr;
+	void* ctx = nullptr;
+	OFS_MainThreadExecutor::Job job;
+	Completion* completion = nullptr;
+
+	// index + 1 of the next free node, 0 ends the list
+	std::atomic<uint32_t> nextFree = { 0 };
+	bool pooled = false;
+};
+
+// Vyukov's intrusive mpsc queue
+// push is a single exchange, only the main thread pops
+struct MainThreadQueue
+{
+	std::atomic<MainThreadNode*> head;
+	MainThreadNode* tail;
+	MainThreadNode stub;
+
+	MainThreadQueue() noexcept
+		: head(&stub), tail(&stub) {}
+
+	inline void Push(MainThreadNode* node) noexcept
+	{
+		node->next.store(nullptr, std::memory_order_relaxed);
+		auto prev = head.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	// nullptr when empty or a producer is halfway through a push
+	inline MainThreadNode* Pop() noexcept
+	{
+		auto current = tail;
+		auto next = current->next.load(std::memory_order_acquire);
+		if (current == &stub) {
+			if (next == nullptr) return nullptr;
+			tail = next;
+			current = next;
+			next = next->next.load(std::memory_order_acquire);
+		}
+		if (next != nullptr) {
+			tail = next;
+			return current;
+		}
+		if (current != head.load(std::memory_order_acquire)) return nullptr;
+
+		Push(&stub);
+		next = current->next.load(std::memory_order_acquire);
+		if (next != nullptr) {
+			tail = next;
+			return current;
+		}
+		return nullptr;
+	}
+
+	// main thread, a push which is still halfway through doesn't count
+	inline bool Empty() const noexcept
+	{
+		return tail == &stub && stub.next.load(std::memory_order_acquire) == nullptr;
+	}
+};
+
+static constexpr uint32_t NodePoolSize = 1024;
+
+static struct MainThreadExecutorData {
+	MainThreadQueue queue;
+
+	// tagged index stack, the upper half counts pops so a recycled node can't fool the cas
+	std::unique_ptr<MainThreadNode[]> nodes;
+	std::atomic<uint64_t> freeNodes = { 0 };
+
+	SDL_SpinLock completionLock = 0;
+	Completion* freeCompletions = nullptr;
+
+	std::atomic<bool> running = { false };
+} Executor;
+
+static MainThreadNode* AllocNode() noexcept
+{
+	uint64_t head = Executor.freeNodes.load(std::memory_order_acquire);
+	for (;;) {
+		uint32_t index = (uint32_t)head;
+		if (index == 0) break;
+		auto node = &Executor.nodes[index - 1];
+		uint64_t next = ((head >> 32) + 1) << 32 | node->nextFree.load(std::memory_order_relaxed);
+		if (Executor.freeNodes.compare_exchange_weak(head, next, std::memory_order_acq_rel)) {
+			return node;
+		}
+	}
+	// pool exhausted, this only costs an allocation
+	return new MainThreadNode();
+}
+
+static void FreeNode(MainThreadNode* node) noexcept
+{
+	if (!node->pooled) {
+		delete node;
+		return;
+	}
+	node->invoke = nullptr;
+	node->ctx = nullptr;
+	node->completion = nullptr;
+	uint32_t index = (uint32_t)(node - Executor.nodes.get()) + 1;
+	uint64_t head = Executor.freeNodes.load(std::memory_order_relaxed);
+	uint64_t next;
+	do {
+		node->nextFree.store((uint32_t)head, std::memory_order_relaxed);
+		next = (head & 0xFFFFFFFF00000000ull) | index;
+	} while (!Executor.freeNodes.compare_exchange_weak(head, next, std::memory_order_acq_rel));
+}
+
+static Completion* AcquireCompletion() noexcept
+{
+	SDL_AtomicLock(&Executor.completionLock);
+	auto completion = Executor.freeCompletions;
+	if (completion != nullptr) {
+		Executor.freeCompletions = completion->nextFree;
+	}
+	SDL_AtomicUnlock(&Executor.completionLock);
+
+	if (completion == nullptr) {
+		completion = new Completion();
+	}
+	completion->Reset();
+	return completion;
+}
+
+static void ReleaseCompletion(Completion* completion) noexcept
+{
+	// never freed, a late wake up might still touch it
+	SDL_AtomicLock(&Executor.completionLock);
+	completion->nextFree = Executor.freeCompletions;
+	Executor.freeCompletions = completion;
+	SDL_AtomicUnlock(&Executor.completionLock);
+}
+
+static void RunNode(MainThreadNode* node) noexcept
+{
+	if (node->job) {
+		node->job();
+		node->job = nullptr;
+	}
+	else {
+		node->invoke(node->ctx);
+	}
+	// the waiter owns ctx, it can't be touched after this
+	if (node->completion) {
+		node->completion->Signal();
+	}
+	FreeNode(node);
+}
+
+void OFS_MainThreadExecutor::Init() noexcept
+{
+	FUN_ASSERT(!Executor.running, "already initialized");
+	Executor.nodes = std::make_unique<MainThreadNode[]>(NodePoolSize);
+	for (uint32_t i = 0; i < NodePoolSize; i++) {
+		Executor.nodes[i].pooled = true;
+		Executor.nodes[i].nextFree.store(i + 1 < NodePoolSize ? i + 2 : 0, std::memory_order_relaxed);
+	}
+	Executor.freeNodes.store(1, std::memory_order_release);
+	Executor.running = true;
+}
+
+void OFS_MainThreadExecutor::Shutdown() noexcept
+{
+	if (!Executor.running) return;
+	Executor.running = false;
+	// the app is already torn down, running them now would touch dead objects
+	MainThreadNode* node;
+	while ((node = Executor.queue.Pop()) != nullptr) {
+		node->job = nullptr;
+		if (node->completion) {
+			node->completion->Signal();
+		}
+		FreeNode(node);
+	}
+}
+
+void OFS_MainThreadExecutor::Post(Job&& job) noexcept
+{
+	auto node = AllocNode();
+	node->job = std::move(job);
+	Executor.queue.Push(node);
+	// the main loop might be idling
+	OFS_Redraw::Request();
+}
+
+void OFS_MainThreadExecutor::RunAndWait(Invoke invoke, void* ctx) noexcept
+{
+	// without a main loop nobody would pick it up
+	if (Util::InMainThread() || !Executor.running) {
+		invoke(ctx);
+		return;
+	}
+
+	OFS_PROFILE(__FUNCTION__);
+	auto completion = AcquireCompletion();
+	auto node = AllocNode();
+	node->invoke = invoke;
+	node->ctx = ctx;
+	node->completion = completion;
+	Executor.queue.Push(node);
+	OFS_Redraw::Request();
+
+	completion->Wait();
+	ReleaseCompletion(completion);
+}
+
+void OFS_MainThreadExecutor::Drain(float budgetMs) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	FUN_ASSERT(Util::InMainThread(), "main thread only");
+	// the clock only gets checked between batches
+	constexpr int32_t BatchSize = 8;
+	uint64_t start = SDL_GetPerformanceCounter();
+	double budget = budgetMs * (SDL_GetPerformanceFrequency() / 1000.0);
+	for (;;) {
+		for (int32_t i = 0; i < BatchSize; i++) {
+			auto node = Executor.queue.Pop();
+			if (node == nullptr) return;
+			RunNode(node);
+		}
+		if (SDL_GetPerformanceCounter() - start >= budget) {
+			// the rest runs next frame, which has to happen without waiting for input
+			if (!Executor.queue.Empty()) OFS_Redraw::Request();
+			break;
+		}
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <memory>
+#include <functional>
+#include <type_traits>
+
+// runs jobs on the main thread
+// producers link preallocated nodes into an intrusive lock-free mpsc queue which the main thread drains once per frame.
+// nothing goes through the sdl event queue and waiting threads block on pooled completion handles (a futex where possible).
+class OFS_MainThreadExecutor
+{
+public:
+	using Job = std::function<void()>;
+	using Invoke = void(*)(void*) noexcept;
+
+	static void Init() noexcept;
+	// drops whatever is still queued, waiting threads get released
+	static void Shutdown() noexcept;
+
+	// runs during the next Drain, this includes calls from the main thread
+	static void Post(Job&& job) noexcept;
+
+	// blocks until func ran on the main thread, on the main thread it gets called right away
+	template<typename F>
+	inline static void RunAndWait(F&& func) noexcept
+	{
+		using Func = std::remove_reference_t<F>;
+		RunAndWait([](void* ctx) noexcept { (*static_cast<Func*>(ctx))(); }, (void*)std::addressof(func));
+	}
+	static void RunAndWait(Invoke invoke, void* ctx) noexcept;
+
+	// main thread only, whatever doesn't fit into the budget runs next frame
+	static void Drain(float budgetMs) noexcept;
+};
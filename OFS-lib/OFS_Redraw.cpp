@@ -0,0 +1,67 @@
+#include "OFS_Redraw.h"
+#include "OFS_Util.h"
+#include "OFS_Profiling.h"
+
+#include "SDL_events.h"
+
+#include <atomic>
+
+static struct RedrawData {
+	std::atomic<uint32_t> pendingFrames = { OFS_Redraw::SettleFrames };
+	// set while the main loop blocks, a request only pushes a wake up event when it's set
+	std::atomic<bool> waiting = { false };
+	std::atomic<bool> continuous = { false };
+	uint32_t wakeEvent = 0;
+} Redraw;
+
+void OFS_Redraw::Init() noexcept
+{
+	Redraw.wakeEvent = SDL_RegisterEvents(1);
+}
+
+void OFS_Redraw::Request(uint32_t frames) noexcept
+{
+	uint32_t pending = Redraw.pendingFrames.load(std::memory_order_relaxed);
+	while (pending < frames && !Redraw.pendingFrames.compare_exchange_weak(pending, frames)) {}
+
+	if (Redraw.waiting.exchange(false) && Redraw.wakeEvent != 0) {
+		SDL_Event ev = {};
+		ev.type = Redraw.wakeEvent;
+		SDL_PushEvent(&ev);
+	}
+}
+
+void OFS_Redraw::SetContinuous(bool continuous) noexcept
+{
+	Redraw.continuous.store(continuous, std::memory_order_relaxed);
+	if (continuous) Request();
+}
+
+void OFS_Redraw::Wait(int32_t timeoutMs) noexcept
+{
+	FUN_ASSERT(Util::InMainThread(), "main thread only");
+	if (Redraw.continuous.load(std::memory_order_relaxed)) return;
+
+	// one frame gets consumed per call
+	uint32_t pending = Redraw.pendingFrames.load(std::memory_order_relaxed);
+	while (pending > 0) {
+		if (Redraw.pendingFrames.compare_exchange_weak(pending, pending - 1)) return;
+	}
+
+	OFS_PROFILE(__FUNCTION__);
+	Redraw.waiting.store(true);
+	// a request between the check above and setting waiting wouldn't have pushed an event
+	if (Redraw.pendingFrames.load() > 0) {
+		Redraw.waiting.store(false);
+		return;
+	}
+
+	// the event stays in the queue for processEvents
+	if (timeoutMs < 0) {
+		SDL_WaitEvent(nullptr);
+	}
+	else {
+		SDL_WaitEventTimeout(nullptr, timeoutMs);
+	}
+	Redraw.waiting.store(false);
+}
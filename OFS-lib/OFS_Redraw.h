@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+
+// the main loop only draws frames when something asked for them
+// sdl input gets counted automatically, anything else which changes what's on screen calls Request.
+// every function is thread safe, a request from another thread wakes the main loop.
+class OFS_Redraw
+{
+public:
+	// imgui needs a couple of frames to settle after a change (hover state, popups, layout)
+	static constexpr uint32_t SettleFrames = 3;
+
+	static void Init() noexcept;
+
+	static void Request(uint32_t frames = SettleFrames) noexcept;
+	// disables idling, every frame gets drawn
+	static void SetContinuous(bool continuous) noexcept;
+
+	// main thread, returns once a frame should be drawn
+	// an event, a request or the timeout end the wait, a negative timeout waits forever
+	static void Wait(int32_t timeoutMs) noexcept;
+};
@@ -0,0 +1,288 @@
+#include "OFS_RenderThread.h"
+#include "OFS_Util.h"
+#include "OFS_Profiling.h"
+#include "OFS_GL.h"
+
+#include "imgui.h"
+#include "imgui_impl_opengl3.h"
+
+#include "SDL_thread.h"
+
+#include <vector>
+#include <atomic>
+#include <cstring>
+
+// copy of the draw data of one viewport
+struct ViewportFrame
+{
+	ImGuiViewport* viewport = nullptr;
+	bool clear = true;
+	ImDrawData drawData;
+	// owned, reused every frame so the copies stop allocating once they are big enough
+	std::vector<ImDrawList*> lists;
+};
+
+struct FrameSlot
+{
+	std::vector<ViewportFrame> viewports;
+	int32_t viewportCount = 0;
+	std::vector<OFS_RenderThread::Command> commands;
+	// signaled once the main thread's uploads for this frame are done
+	GLsync uploads = nullptr;
+};
+
+static struct RenderThreadData {
+	SDL_Window* window = nullptr;
+	SDL_GLContext context = nullptr;
+	SDL_GLContext uploadContext = nullptr;
+	SDL_Thread* thread = nullptr;
+	// starts at 1, the first Submit doesn't wait for anything
+	SDL_sem* frameDone = nullptr;
+	SDL_sem* frameReady = nullptr;
+	std::atomic<bool> shouldExit = { false };
+	bool running = false;
+
+	FrameSlot slots[2];
+	uint32_t recordSlot = 0;
+	uint32_t renderSlot = 0;
+
+	OFS_RenderThread::Command swapCallback;
+	const ImDrawData* currentDrawData = nullptr;
+} RenderThread;
+
+template<typename T>
+inline static void CopyVector(ImVector<T>& dst, const ImVector<T>& src) noexcept
+{
+	// ImVector's assignment frees the old buffer first, resize keeps it
+	dst.resize(src.Size);
+	if (src.Size > 0) std::memcpy(dst.Data, src.Data, src.size_in_bytes());
+}
+
+static void CopyViewport(ViewportFrame& frame, ImGuiViewport* viewport) noexcept
+{
+	const ImDrawData* src = viewport->DrawData;
+	frame.viewport = viewport;
+	frame.clear = !(viewport->Flags & ImGuiViewportFlags_NoRendererClear);
+
+	while ((int32_t)frame.lists.size() < src->CmdListsCount) {
+		frame.lists.emplace_back(IM_NEW(ImDrawList)(ImGui::GetDrawListSharedData()));
+	}
+	for (int32_t i = 0; i < src->CmdListsCount; i++) {
+		auto dst = frame.lists[i];
+		auto list = src->CmdLists[i];
+		CopyVector(dst->CmdBuffer, list->CmdBuffer);
+		CopyVector(dst->IdxBuffer, list->IdxBuffer);
+		CopyVector(dst->VtxBuffer, list->VtxBuffer);
+		dst->Flags = list->Flags;
+	}
+
+	frame.drawData = *src;
+	frame.drawData.CmdLists = frame.lists.data();
+}
+
+static void CopyFrame(FrameSlot& slot) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	auto& platformIO = ImGui::GetPlatformIO();
+	slot.viewportCount = 0;
+	for (auto viewport : platformIO.Viewports) {
+		if (viewport->DrawData == nullptr || (viewport->Flags & ImGuiViewportFlags_Minimized)) continue;
+		// the main viewport always comes first
+		if ((int32_t)slot.viewports.size() <= slot.viewportCount) slot.viewports.emplace_back();
+		CopyViewport(slot.viewports[slot.viewportCount], viewport);
+		slot.viewportCount++;
+	}
+}
+
+static void DrawViewport(ViewportFrame& frame, bool mainViewport) noexcept
+{
+	auto& data = frame.drawData;
+	if (mainViewport) {
+		glViewport(0, 0, (int)(data.DisplaySize.x * data.FramebufferScale.x), (int)(data.DisplaySize.y * data.FramebufferScale.y));
+		glClearColor(0.1f, 0.1f, 0.1f, 1.f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	}
+	else if (frame.clear) {
+		glClearColor(0.f, 0.f, 0.f, 1.f);
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+	RenderThread.currentDrawData = &data;
+	ImGui_ImplOpenGL3_RenderDrawData(&data);
+	RenderThread.currentDrawData = nullptr;
+}
+
+static void RenderFrame(FrameSlot& slot) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	auto& platformIO = ImGui::GetPlatformIO();
+	SDL_GL_MakeCurrent(RenderThread.window, RenderThread.context);
+	// waits on the gpu, not here
+	if (slot.uploads) glWaitSync(slot.uploads, 0, GL_TIMEOUT_IGNORED);
+
+	for (auto& command : slot.commands) {
+		command();
+	}
+	slot.commands.clear();
+
+	if (slot.viewportCount > 0) {
+		DrawViewport(slot.viewports[0], true);
+	}
+	for (int32_t i = 1; i < slot.viewportCount; i++) {
+		auto& frame = slot.viewports[i];
+		// makes the context of the platform window current
+		if (platformIO.Platform_RenderWindow) platformIO.Platform_RenderWindow(frame.viewport, nullptr);
+		if (slot.uploads) glWaitSync(slot.uploads, 0, GL_TIMEOUT_IGNORED);
+		DrawViewport(frame, false);
+		if (platformIO.Platform_SwapBuffers) platformIO.Platform_SwapBuffers(frame.viewport, nullptr);
+	}
+
+	SDL_GL_MakeCurrent(RenderThread.window, RenderThread.context);
+	{
+		OFS_PROFILE("SDL_GL_SwapWindow");
+		SDL_GL_SwapWindow(RenderThread.window);
+	}
+	if (RenderThread.swapCallback) RenderThread.swapCallback();
+
+	if (slot.uploads) {
+		glDeleteSync(slot.uploads);
+		slot.uploads = nullptr;
+	}
+}
+
+static int32_t RenderThreadFunction(void*) noexcept
+{
+	for (;;) {
+		SDL_SemWait(RenderThread.frameReady);
+		if (RenderThread.shouldExit.load()) break;
+		RenderFrame(RenderThread.slots[RenderThread.renderSlot]);
+		// imgui creates platform windows on the main thread with this context current for a moment
+		SDL_GL_MakeCurrent(RenderThread.window, nullptr);
+		SDL_SemPost(RenderThread.frameDone);
+	}
+	return 0;
+}
+
+bool OFS_RenderThread::Init(SDL_Window* window, SDL_GLContext glContext) noexcept
+{
+	FUN_ASSERT(Util::InMainThread(), "main thread only");
+	RenderThread.window = window;
+	RenderThread.context = glContext;
+
+	SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+	// becomes current on the main thread, which releases glContext for the render thread
+	RenderThread.uploadContext = SDL_GL_CreateContext(window);
+	if (RenderThread.uploadContext == nullptr) {
+		LOGF_WARN("Failed to create a shared gl context, rendering on the main thread. %s", SDL_GetError());
+		SDL_GL_MakeCurrent(window, glContext);
+		return false;
+	}
+
+	RenderThread.frameDone = SDL_CreateSemaphore(1);
+	RenderThread.frameReady = SDL_CreateSemaphore(0);
+	RenderThread.shouldExit = false;
+	RenderThread.running = true;
+	RenderThread.thread = SDL_CreateThread(RenderThreadFunction, "Render", nullptr);
+	return true;
+}
+
+void OFS_RenderThread::Shutdown() noexcept
+{
+	FUN_ASSERT(Util::InMainThread(), "main thread only");
+	if (RenderThread.running) {
+		SDL_SemWait(RenderThread.frameDone);
+		RenderThread.shouldExit = true;
+		SDL_SemPost(RenderThread.frameReady);
+		SDL_WaitThread(RenderThread.thread, nullptr);
+		RenderThread.thread = nullptr;
+		RenderThread.running = false;
+
+		SDL_GL_MakeCurrent(RenderThread.window, RenderThread.context);
+		SDL_GL_DeleteContext(RenderThread.uploadContext);
+		RenderThread.uploadContext = nullptr;
+		SDL_DestroySemaphore(RenderThread.frameDone);
+		SDL_DestroySemaphore(RenderThread.frameReady);
+		RenderThread.frameDone = nullptr;
+		RenderThread.frameReady = nullptr;
+	}
+
+	for (auto& slot : RenderThread.slots) {
+		// whatever got queued after the last frame
+		for (auto& command : slot.commands) {
+			command();
+		}
+		slot.commands.clear();
+		for (auto& frame : slot.viewports) {
+			for (auto list : frame.lists) { IM_DELETE(list); }
+		}
+		slot.viewports.clear();
+		slot.viewportCount = 0;
+		if (slot.uploads) {
+			glDeleteSync(slot.uploads);
+			slot.uploads = nullptr;
+		}
+	}
+	RenderThread.swapCallback = Command();
+}
+
+void OFS_RenderThread::Enqueue(Command&& command) noexcept
+{
+	FUN_ASSERT(Util::InMainThread(), "main thread only");
+	if (!RenderThread.running) {
+		command();
+		return;
+	}
+	RenderThread.slots[RenderThread.recordSlot].commands.emplace_back(std::move(command));
+}
+
+void OFS_RenderThread::Submit() noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	FUN_ASSERT(Util::InMainThread(), "main thread only");
+	auto& io = ImGui::GetIO();
+
+	if (!RenderThread.running) {
+		if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
+			ImGui::UpdatePlatformWindows();
+		}
+		auto& slot = RenderThread.slots[0];
+		CopyFrame(slot);
+		RenderFrame(slot);
+		return;
+	}
+
+	{
+		// the previous frame reads its slot, the platform windows and the callback data
+		OFS_PROFILE("WaitForRenderThread");
+		SDL_SemWait(RenderThread.frameDone);
+	}
+	if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
+		ImGui::UpdatePlatformWindows();
+	}
+
+	auto& slot = RenderThread.slots[RenderThread.recordSlot];
+	CopyFrame(slot);
+	slot.uploads = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	// the fence has to reach the gpu before the render thread can wait on it
+	glFlush();
+
+	RenderThread.renderSlot = RenderThread.recordSlot;
+	RenderThread.recordSlot = (RenderThread.recordSlot + 1) % 2;
+	SDL_SemPost(RenderThread.frameReady);
+}
+
+void OFS_RenderThread::SetSwapInterval(int32_t interval) noexcept
+{
+	// belongs to the window's context
+	Enqueue([interval]() { SDL_GL_SetSwapInterval(interval); });
+}
+
+void OFS_RenderThread::SetSwapCallback(Command&& callback) noexcept
+{
+	FUN_ASSERT(!RenderThread.running, "set it before Init");
+	RenderThread.swapCallback = std::move(callback);
+}
+
+const ImDrawData* OFS_RenderThread::CurrentDrawData() noexcept
+{
+	return RenderThread.currentDrawData;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+
+#include "SDL_video.h"
+
+struct ImDrawData;
+
+// the gpu submission of a frame happens on a dedicated thread which owns the window's gl context
+// the main thread switches to a shared context, resources (textures, buffers, shaders) can still be created there.
+// vaos, fbos and mpv render contexts aren't shared, the ones created before Init belong to the render thread.
+// work which has to happen in order with the frame (mpv rendering, per frame uploads) goes through Enqueue.
+// frames are double-buffered, Submit copies the draw data and only blocks while the previous frame is still being drawn.
+class OFS_RenderThread
+{
+public:
+	using Command = std::function<void()>;
+
+	// main thread with glContext current
+	// without a render thread everything happens on the main thread like before
+	static bool Init(SDL_Window* window, SDL_GLContext glContext) noexcept;
+	// finishes the last frame and makes glContext current on the main thread again
+	static void Shutdown() noexcept;
+
+	// main thread, runs before the next submitted frame gets drawn
+	// commands own everything they need, the main thread keeps going while they run
+	static void Enqueue(Command&& command) noexcept;
+	// main thread, after ImGui::Render
+	// updates the platform windows as well
+	static void Submit() noexcept;
+
+	static void SetSwapInterval(int32_t interval) noexcept;
+	// called on the render thread after every swap of the main window
+	static void SetSwapCallback(Command&& callback) noexcept;
+
+	// the copy of the draw data which is being rendered, for ImDrawCallbacks
+	static const ImDrawData* CurrentDrawData() noexcept;
+};
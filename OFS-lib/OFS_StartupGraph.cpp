@@ -0,0 +1,141 @@
+#include "OFS_StartupGraph.h"
+#include "OFS_TaskScheduler.h"
+#include "OFS_Util.h"
+#include "OFS_Profiling.h"
+
+#include <algorithm>
+
+inline static float ToMs(OFS_StartupGraph::Clock::duration duration) noexcept
+{
+	return std::chrono::duration<float, std::milli>(duration).count();
+}
+
+OFS_StartupGraph::OFS_StartupGraph() noexcept
+{
+	mainWake = SDL_CreateSemaphore(0);
+}
+
+OFS_StartupGraph::~OFS_StartupGraph() noexcept
+{
+	SDL_DestroySemaphore(mainWake);
+}
+
+OFS_StartupGraph::Stage OFS_StartupGraph::Add(const char* name, Thread thread, std::initializer_list<Stage> dependencies, Job&& job) noexcept
+{
+	Stage id = (Stage)stages.size();
+	auto& stage = *stages.emplace_back(std::make_unique<StageData>());
+	stage.name = name;
+	stage.thread = thread;
+	stage.job = std::move(job);
+	for (auto dependency : dependencies) {
+		FUN_ASSERT(dependency >= 0 && dependency < id, "unknown dependency");
+		stages[dependency]->dependents.emplace_back(id);
+		stage.dependencyCount++;
+	}
+	return id;
+}
+
+void OFS_StartupGraph::schedule(StageData& stage) noexcept
+{
+	if (stage.thread == Thread::Main) {
+		SDL_AtomicLock(&mainLock);
+		mainQueue.emplace_back(&stage);
+		SDL_AtomicUnlock(&mainLock);
+		SDL_SemPost(mainWake);
+	}
+	else {
+		OFS_TaskScheduler::Submit([this, &stage]() { execute(stage); }, OFS_TaskPriority::High);
+	}
+}
+
+void OFS_StartupGraph::execute(StageData& stage) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	stage.worker = OFS_TaskScheduler::WorkerIndex();
+	stage.start = Clock::now();
+	bool skipped = stage.skipped.load(std::memory_order_acquire);
+	bool success = !skipped && stage.job();
+	stage.end = Clock::now();
+	// whatever the job captured is done
+	stage.job = Job();
+
+	if (!success && !skipped) {
+		LOGF_ERROR("Startup stage \"%s\" failed.", stage.name);
+		stage.failed = true;
+		failed.store(true, std::memory_order_relaxed);
+	}
+
+	for (auto id : stage.dependents) {
+		auto& dependent = *stages[id];
+		if (!success) dependent.skipped.store(true, std::memory_order_release);
+		if (dependent.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			schedule(dependent);
+		}
+	}
+
+	// under the lock, Run can't return while the last stage still posts
+	SDL_AtomicLock(&mainLock);
+	if (finished.fetch_add(1, std::memory_order_acq_rel) + 1 == (int32_t)stages.size()) {
+		SDL_SemPost(mainWake);
+	}
+	SDL_AtomicUnlock(&mainLock);
+}
+
+bool OFS_StartupGraph::Run() noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	FUN_ASSERT(Util::InMainThread(), "main thread only");
+	start = Clock::now();
+	finished.store(0, std::memory_order_relaxed);
+	failed.store(false, std::memory_order_relaxed);
+
+	for (auto& stage : stages) {
+		stage->pending.store(stage->dependencyCount, std::memory_order_relaxed);
+	}
+	for (auto& stage : stages) {
+		if (stage->dependencyCount == 0) schedule(*stage);
+	}
+
+	for (;;) {
+		StageData* next = nullptr;
+		SDL_AtomicLock(&mainLock);
+		bool done = finished.load(std::memory_order_acquire) == (int32_t)stages.size();
+		if (!mainQueue.empty()) {
+			next = mainQueue.front();
+			mainQueue.erase(mainQueue.begin());
+		}
+		SDL_AtomicUnlock(&mainLock);
+
+		if (next != nullptr) {
+			execute(*next);
+			continue;
+		}
+		if (done) break;
+		SDL_SemWait(mainWake);
+	}
+
+	end = Clock::now();
+	return !failed.load(std::memory_order_relaxed);
+}
+
+void OFS_StartupGraph::Report() const noexcept
+{
+	std::vector<const StageData*> sorted;
+	sorted.reserve(stages.size());
+	for (auto& stage : stages) sorted.emplace_back(stage.get());
+	std::sort(sorted.begin(), sorted.end(), [](auto a, auto b) { return a->start < b->start; });
+
+	LOGF_INFO("Startup took %.2f ms", ToMs(end - start));
+	for (auto stage : sorted) {
+		char thread[16];
+		if (stage->worker < 0) stbsp_snprintf(thread, sizeof(thread), "main");
+		else stbsp_snprintf(thread, sizeof(thread), "worker %d", stage->worker);
+
+		const char* status = "";
+		if (stage->skipped.load(std::memory_order_relaxed)) status = " (skipped)";
+		else if (stage->failed) status = " (failed)";
+
+		LOGF_INFO("  %-24s at %8.2f ms took %8.2f ms on %s%s", stage->name,
+			ToMs(stage->start - start), ToMs(stage->end - stage->start), thread, status);
+	}
+}
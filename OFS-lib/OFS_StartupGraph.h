@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <initializer_list>
+
+#include "SDL_atomic.h"
+#include "SDL_mutex.h"
+
+// application startup as a graph of stages
+// worker stages go to the task scheduler as soon as their dependencies are done, main stages run on the thread calling Run.
+// a failed stage skips everything which depends on it.
+// worker stages must not wait on the main thread, it only runs stages until the graph is done.
+class OFS_StartupGraph
+{
+public:
+	using Stage = int32_t;
+	using Job = std::function<bool()>;
+	using Clock = std::chrono::steady_clock;
+
+	enum class Thread : int32_t
+	{
+		Main,
+		Worker
+	};
+
+	OFS_StartupGraph() noexcept;
+	~OFS_StartupGraph() noexcept;
+
+	// dependencies have to be added before, that keeps the graph free of cycles
+	Stage Add(const char* name, Thread thread, std::initializer_list<Stage> dependencies, Job&& job) noexcept;
+	// main thread, false if any stage failed
+	bool Run() noexcept;
+
+	// logs when every stage ran, on which thread and for how long
+	void Report() const noexcept;
+
+private:
+	struct StageData
+	{
+		const char* name = nullptr;
+		Thread thread = Thread::Main;
+		Job job;
+		std::vector<Stage> dependents;
+		int32_t dependencyCount = 0;
+
+		std::atomic<int32_t> pending = { 0 };
+		std::atomic<bool> skipped = { false };
+		bool failed = false;
+
+		// -1 for the main thread
+		int32_t worker = -1;
+		Clock::time_point start;
+		Clock::time_point end;
+	};
+	std::vector<std::unique_ptr<StageData>> stages;
+
+	SDL_SpinLock mainLock = 0;
+	std::vector<StageData*> mainQueue;
+	// posted for every queued main stage and once the last stage is done
+	SDL_sem* mainWake = nullptr;
+	std::atomic<int32_t> finished = { 0 };
+	std::atomic<bool> failed = { false };
+
+	Clock::time_point start;
+	Clock::time_point end;
+
+	void schedule(StageData& stage) noexcept;
+	void execute(StageData& stage) noexcept;
+};
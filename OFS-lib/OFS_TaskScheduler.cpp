@@ -0,0 +1,256 @@
+#include "OFS_TaskScheduler.h"
+#include "OFS_Profiling.h"
+#include "stb_sprintf.h"
+
+#include "SDL_thread.h"
+#include "SDL_timer.h"
+#include "SDL_cpuinfo.h"
+
+#include <deque>
+#include <array>
+
+void OFS_TaskDetail::StateBase::complete() noexcept
+{
+	std::vector<Job> pending;
+	SDL_AtomicLock(&lock);
+	done.store(true, std::memory_order_release);
+	pending.swap(continuations);
+	SDL_AtomicUnlock(&lock);
+	for (auto& continuation : pending) { continuation(); }
+}
+
+void OFS_TaskDetail::StateBase::onDone(Job&& func) noexcept
+{
+	SDL_AtomicLock(&lock);
+	if (!done.load(std::memory_order_acquire)) {
+		continuations.emplace_back(std::move(func));
+		SDL_AtomicUnlock(&lock);
+		return;
+	}
+	SDL_AtomicUnlock(&lock);
+	func();
+}
+
+struct JobQueue
+{
+	SDL_SpinLock lock = 0;
+	std::deque<OFS_TaskScheduler::Job> jobs;
+
+	inline void Push(OFS_TaskScheduler::Job&& job) noexcept
+	{
+		SDL_AtomicLock(&lock);
+		jobs.emplace_back(std::move(job));
+		SDL_AtomicUnlock(&lock);
+	}
+
+	// owner side, newest first so the working set stays warm
+	inline bool PopBack(OFS_TaskScheduler::Job& job) noexcept
+	{
+		SDL_AtomicLock(&lock);
+		bool found = !jobs.empty();
+		if (found) {
+			job = std::move(jobs.back());
+			jobs.pop_back();
+		}
+		SDL_AtomicUnlock(&lock);
+		return found;
+	}
+
+	// thief side, oldest first which tends to be the biggest piece of work
+	inline bool PopFront(OFS_TaskScheduler::Job& job) noexcept
+	{
+		SDL_AtomicLock(&lock);
+		bool found = !jobs.empty();
+		if (found) {
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		SDL_AtomicUnlock(&lock);
+		return found;
+	}
+};
+
+struct TaskWorker
+{
+	JobQueue queue;
+	SDL_Thread* thread = nullptr;
+};
+
+static struct TaskSchedulerData {
+	std::vector<std::unique_ptr<TaskWorker>> workers;
+	std::array<JobQueue, static_cast<size_t>(OFS_TaskPriority::TotalCount)> shared;
+
+	SDL_sem* wake = nullptr;
+	std::atomic<int32_t> sleeping = { 0 };
+	std::atomic<bool> running = { false };
+	std::atomic<bool> shouldExit = { false };
+} Scheduler;
+
+static thread_local int32_t CurrentWorker = -1;
+
+static bool FindJob(int32_t self, OFS_TaskScheduler::Job& job) noexcept
+{
+	auto& workers = Scheduler.workers;
+	if (self >= 0 && workers[self]->queue.PopBack(job)) return true;
+	if (Scheduler.shared[static_cast<size_t>(OFS_TaskPriority::High)].PopFront(job)) return true;
+
+	int32_t count = workers.size();
+	int32_t start = self >= 0 ? self + 1 : 0;
+	for (int32_t i = 0; i < count; i++) {
+		int32_t victim = (start + i) % count;
+		if (victim != self && workers[victim]->queue.PopFront(job)) return true;
+	}
+
+	if (Scheduler.shared[static_cast<size_t>(OFS_TaskPriority::Normal)].PopFront(job)) return true;
+	if (Scheduler.shared[static_cast<size_t>(OFS_TaskPriority::Background)].PopFront(job)) return true;
+	return false;
+}
+
+static void WakeWorker() noexcept
+{
+	if (Scheduler.sleeping.load() > 0) {
+		SDL_SemPost(Scheduler.wake);
+	}
+}
+
+static int32_t WorkerThread(void* data) noexcept
+{
+	CurrentWorker = (int32_t)(intptr_t)data;
+	OFS_TaskScheduler::Job job;
+	for (;;) {
+		if (FindJob(CurrentWorker, job)) {
+			job();
+			job = nullptr;
+			continue;
+		}
+		if (Scheduler.shouldExit.load()) break;
+
+		Scheduler.sleeping.fetch_add(1);
+		// checked again so a job pushed before sleeping got incremented isn't missed
+		if (FindJob(CurrentWorker, job)) {
+			Scheduler.sleeping.fetch_sub(1);
+			job();
+			job = nullptr;
+			continue;
+		}
+		SDL_SemWaitTimeout(Scheduler.wake, 100);
+		Scheduler.sleeping.fetch_sub(1);
+	}
+	return 0;
+}
+
+void OFS_TaskScheduler::Init(int32_t threadCount) noexcept
+{
+	FUN_ASSERT(!Scheduler.running, "already initialized");
+	if (threadCount <= 0) {
+		threadCount = std::max(1, SDL_GetCPUCount() - 1);
+	}
+
+	Scheduler.shouldExit = false;
+	Scheduler.wake = SDL_CreateSemaphore(0);
+	for (int32_t i = 0; i < threadCount; i++) {
+		Scheduler.workers.emplace_back(std::make_unique<TaskWorker>());
+	}
+	Scheduler.running = true;
+
+	char nameBuf[32];
+	for (int32_t i = 0; i < threadCount; i++) {
+		stbsp_snprintf(nameBuf, sizeof(nameBuf), "OFS_Worker%d", i);
+		Scheduler.workers[i]->thread = SDL_CreateThread(WorkerThread, nameBuf, (void*)(intptr_t)i);
+	}
+	LOGF_INFO("Started %d task workers.", threadCount);
+}
+
+void OFS_TaskScheduler::Shutdown() noexcept
+{
+	if (!Scheduler.running) return;
+	Scheduler.shouldExit = true;
+	for (auto& worker : Scheduler.workers) {
+		SDL_SemPost(Scheduler.wake);
+	}
+	for (auto& worker : Scheduler.workers) {
+		SDL_WaitThread(worker->thread, nullptr);
+	}
+	Scheduler.running = false;
+	Scheduler.workers.clear();
+	SDL_DestroySemaphore(Scheduler.wake);
+	Scheduler.wake = nullptr;
+}
+
+int32_t OFS_TaskScheduler::WorkerCount() noexcept
+{
+	return Scheduler.running ? (int32_t)Scheduler.workers.size() : 0;
+}
+
+int32_t OFS_TaskScheduler::WorkerIndex() noexcept
+{
+	return CurrentWorker;
+}
+
+void OFS_TaskScheduler::Submit(Job&& job, OFS_TaskPriority priority) noexcept
+{
+	if (!Scheduler.running) {
+		job();
+		return;
+	}
+
+	if (CurrentWorker >= 0 && priority != OFS_TaskPriority::Background) {
+		Scheduler.workers[CurrentWorker]->queue.Push(std::move(job));
+	}
+	else {
+		Scheduler.shared[static_cast<size_t>(priority)].Push(std::move(job));
+	}
+	WakeWorker();
+}
+
+void OFS_TaskScheduler::SubmitLongRunning(const char* name, Job&& job) noexcept
+{
+	auto thread = [](void* data) -> int32_t {
+		auto job = (Job*)data;
+		(*job)();
+		delete job;
+		return 0;
+	};
+	auto handle = SDL_CreateThread(thread, name, new Job(std::move(job)));
+	SDL_DetachThread(handle);
+}
+
+bool OFS_TaskScheduler::RunOne() noexcept
+{
+	if (!Scheduler.running) return false;
+	Job job;
+	if (FindJob(CurrentWorker, job)) {
+		job();
+		return true;
+	}
+	return false;
+}
+
+void OFS_TaskScheduler::Wait(OFS_TaskDetail::StateBase& state) noexcept
+{
+	if (state.done.load(std::memory_order_acquire)) return;
+	if (CurrentWorker >= 0) {
+		WaitUntil([&state]() { return state.done.load(std::memory_order_acquire); });
+		return;
+	}
+
+	OFS_PROFILE(__FUNCTION__);
+	// the continuation might still be posting when this thread wakes up
+	auto sem = std::shared_ptr<SDL_sem>(SDL_CreateSemaphore(0), SDL_DestroySemaphore);
+	state.onDone([sem]() { SDL_SemPost(sem.get()); });
+	SDL_SemWait(sem.get());
+}
+
+void OFS_TaskScheduler::WaitUntil(const std::function<bool()>& condition) noexcept
+{
+	int32_t idle = 0;
+	while (!condition()) {
+		// other threads never pick up random jobs, a frame could end up waiting on a save
+		if (CurrentWorker >= 0 && RunOne()) {
+			idle = 0;
+			continue;
+		}
+		if (++idle < 64) { OFS_PAUSE_INTRIN(); }
+		else { SDL_Delay(1); }
+	}
+}
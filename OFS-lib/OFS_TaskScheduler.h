@@ -0,0 +1,282 @@
+#pragma once
+#include "OFS_Util.h"
+#include "OFS_MainThreadExecutor.h"
+#include "OFS_Allocator.h"
+#include "SDL_atomic.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+// work stealing task scheduler
+// every worker owns a deque, it pushes and pops its own jobs at the back while idle workers steal from the front.
+// jobs submitted from any other thread go into a shared queue per priority.
+// long running jobs (device loops, subprocesses, dialogs) get a dedicated thread so they never occupy a worker.
+enum class OFS_TaskPriority : int32_t
+{
+	High,
+	Normal,
+	Background,
+
+	TotalCount
+};
+
+namespace OFS_TaskDetail
+{
+	using Job = std::function<void()>;
+
+	struct StateBase
+	{
+		std::atomic<bool> done = { false };
+		SDL_SpinLock lock = 0;
+		std::vector<Job> continuations;
+
+		// marks the state as done and runs the continuations on the calling thread
+		void complete() noexcept;
+		// runs func once the state is done, right away if it already is
+		void onDone(Job&& func) noexcept;
+	};
+
+	template<typename T>
+	struct State : StateBase
+	{
+		std::optional<T> value;
+	};
+
+	template<>
+	struct State<void> : StateBase {};
+
+	// states are created and dropped all the time, they come from a pool per result type
+	template<typename T>
+	inline std::shared_ptr<State<T>> MakeState() noexcept
+	{
+		return std::allocate_shared<State<T>>(OFS_PoolAllocator<State<T>>("Task state"));
+	}
+
+	template<typename T, typename F>
+	inline void Fulfill(State<T>& state, F& func) noexcept
+	{
+		if constexpr (std::is_void_v<T>) { func(); }
+		else { state.value.emplace(func()); }
+		state.complete();
+	}
+
+	template<typename T, typename F>
+	struct ContinuationResult { using type = std::invoke_result_t<F&, T&>; };
+	template<typename F>
+	struct ContinuationResult<void, F> { using type = std::invoke_result_t<F&>; };
+}
+
+template<typename T>
+class OFS_Task;
+
+class OFS_TaskScheduler
+{
+public:
+	using Job = OFS_TaskDetail::Job;
+
+	// 0 uses one worker per core minus the main thread
+	static void Init(int32_t threadCount = 0) noexcept;
+	// runs whatever is still queued and joins the workers
+	static void Shutdown() noexcept;
+
+	static int32_t WorkerCount() noexcept;
+	// -1 if the calling thread isn't a worker
+	static int32_t WorkerIndex() noexcept;
+
+	// without workers (headless tools, before Init) jobs run inline
+	static void Submit(Job&& job, OFS_TaskPriority priority = OFS_TaskPriority::Normal) noexcept;
+	static void SubmitLongRunning(const char* name, Job&& job) noexcept;
+	// runs one queued job on the calling thread, false if there was nothing to do
+	static bool RunOne() noexcept;
+
+	// workers keep executing other jobs while they wait
+	static void Wait(OFS_TaskDetail::StateBase& state) noexcept;
+	static void WaitUntil(const std::function<bool()>& condition) noexcept;
+
+	template<typename F>
+	static auto Spawn(F&& func, OFS_TaskPriority priority = OFS_TaskPriority::Normal) noexcept;
+	template<typename F>
+	static auto SpawnLongRunning(const char* name, F&& func) noexcept;
+
+	// calls func(chunkBegin, chunkEnd) for chunks of at most grain indices
+	// the calling thread works on chunks as well and returns once all of them are done
+	template<typename F>
+	static void ParallelFor(int64_t begin, int64_t end, int64_t grain, F&& func) noexcept;
+	// map(chunkBegin, chunkEnd) -> T, the partial results get reduced in chunk order
+	template<typename T, typename Map, typename Reduce>
+	static T ParallelReduce(int64_t begin, int64_t end, int64_t grain, T identity, Map&& map, Reduce&& reduce) noexcept;
+};
+
+template<typename T>
+class OFS_Task
+{
+	std::shared_ptr<OFS_TaskDetail::State<T>> state;
+public:
+	OFS_Task() noexcept = default;
+	explicit OFS_Task(std::shared_ptr<OFS_TaskDetail::State<T>>&& state) noexcept
+		: state(std::move(state)) {}
+
+	inline bool Valid() const noexcept { return state != nullptr; }
+	// an invalid task counts as done
+	inline bool Done() const noexcept { return !state || state->done.load(std::memory_order_acquire); }
+	inline void Wait() const noexcept { if (state) OFS_TaskScheduler::Wait(*state); }
+
+	template<typename U = T>
+	inline std::enable_if_t<!std::is_void_v<U>, U&> Get() const noexcept
+	{
+		FUN_ASSERT(state, "invalid task");
+		Wait();
+		return *state->value;
+	}
+
+	// func gets the result (if there is one) and runs on a worker once this task is done
+	template<typename F>
+	auto Then(F&& func, OFS_TaskPriority priority = OFS_TaskPriority::Normal) const noexcept;
+	// same but on the main thread
+	template<typename F>
+	void ThenOnMain(F&& func) const noexcept;
+};
+
+// jobs which get waited on and cancelled together
+// cancelling skips every job which hasn't started yet, running jobs can poll IsCancelled
+class OFS_TaskGroup
+{
+	std::atomic<int32_t> pending = { 0 };
+	std::atomic<bool> cancelled = { false };
+public:
+	OFS_TaskGroup() noexcept = default;
+	OFS_TaskGroup(const OFS_TaskGroup&) = delete;
+	OFS_TaskGroup& operator=(const OFS_TaskGroup&) = delete;
+	~OFS_TaskGroup() noexcept { Wait(); }
+
+	template<typename F>
+	inline void Run(F&& func, OFS_TaskPriority priority = OFS_TaskPriority::Normal) noexcept
+	{
+		pending.fetch_add(1, std::memory_order_relaxed);
+		OFS_TaskScheduler::Submit([this, func = std::forward<F>(func)]() mutable {
+			if (!cancelled.load(std::memory_order_relaxed)) { func(); }
+			pending.fetch_sub(1, std::memory_order_release);
+		}, priority);
+	}
+
+	inline void Cancel() noexcept { cancelled.store(true, std::memory_order_relaxed); }
+	inline bool IsCancelled() const noexcept { return cancelled.load(std::memory_order_relaxed); }
+
+	inline void Wait() noexcept
+	{
+		OFS_TaskScheduler::WaitUntil([this]() { return pending.load(std::memory_order_acquire) == 0; });
+	}
+};
+
+template<typename F>
+inline auto OFS_TaskScheduler::Spawn(F&& func, OFS_TaskPriority priority) noexcept
+{
+	using R = std::invoke_result_t<std::decay_t<F>&>;
+	auto state = OFS_TaskDetail::MakeState<R>();
+	Submit([state, func = std::forward<F>(func)]() mutable {
+		OFS_TaskDetail::Fulfill(*state, func);
+	}, priority);
+	return OFS_Task<R>(std::move(state));
+}
+
+template<typename F>
+inline auto OFS_TaskScheduler::SpawnLongRunning(const char* name, F&& func) noexcept
+{
+	using R = std::invoke_result_t<std::decay_t<F>&>;
+	auto state = OFS_TaskDetail::MakeState<R>();
+	SubmitLongRunning(name, [state, func = std::forward<F>(func)]() mutable {
+		OFS_TaskDetail::Fulfill(*state, func);
+	});
+	return OFS_Task<R>(std::move(state));
+}
+
+template<typename F>
+inline void OFS_TaskScheduler::ParallelFor(int64_t begin, int64_t end, int64_t grain, F&& func) noexcept
+{
+	if (end <= begin) return;
+	grain = std::max<int64_t>(grain, 1);
+	int64_t chunkCount = (end - begin + grain - 1) / grain;
+	int32_t helpers = (int32_t)std::min<int64_t>(WorkerCount(), chunkCount - 1);
+
+	struct Range {
+		std::atomic<int64_t> next = { 0 };
+		std::atomic<int64_t> remaining = { 0 };
+	};
+	// helpers which start after the last chunk only touch the range, never func
+	auto range = std::allocate_shared<Range>(OFS_PoolAllocator<Range>("Parallel range"));
+	range->remaining.store(chunkCount, std::memory_order_relaxed);
+	auto work = [range, &func, begin, end, grain, chunkCount]() {
+		int64_t chunk;
+		while ((chunk = range->next.fetch_add(1, std::memory_order_relaxed)) < chunkCount) {
+			int64_t chunkBegin = begin + chunk * grain;
+			func(chunkBegin, std::min(chunkBegin + grain, end));
+			range->remaining.fetch_sub(1, std::memory_order_release);
+		}
+	};
+
+	for (int32_t i = 0; i < helpers; i++) {
+		Submit(work, OFS_TaskPriority::High);
+	}
+	work();
+	WaitUntil([&range]() { return range->remaining.load(std::memory_order_acquire) == 0; });
+}
+
+template<typename T, typename Map, typename Reduce>
+inline T OFS_TaskScheduler::ParallelReduce(int64_t begin, int64_t end, int64_t grain, T identity, Map&& map, Reduce&& reduce) noexcept
+{
+	if (end <= begin) return identity;
+	grain = std::max<int64_t>(grain, 1);
+	int64_t chunkCount = (end - begin + grain - 1) / grain;
+
+	std::vector<T> partial(chunkCount, identity);
+	ParallelFor(0, chunkCount, 1, [&](int64_t first, int64_t last) {
+		for (int64_t chunk = first; chunk < last; chunk++) {
+			int64_t chunkBegin = begin + chunk * grain;
+			partial[chunk] = map(chunkBegin, std::min(chunkBegin + grain, end));
+		}
+	});
+
+	// always in the same order so floating point results don't depend on scheduling
+	T result = identity;
+	for (auto& value : partial) {
+		result = reduce(result, value);
+	}
+	return result;
+}
+
+template<typename T>
+template<typename F>
+inline auto OFS_Task<T>::Then(F&& func, OFS_TaskPriority priority) const noexcept
+{
+	using R = typename OFS_TaskDetail::ContinuationResult<T, std::decay_t<F>>::type;
+	FUN_ASSERT(state, "invalid task");
+	auto next = OFS_TaskDetail::MakeState<R>();
+	state->onDone([prev = state, next, func = std::forward<F>(func), priority]() mutable {
+		OFS_TaskScheduler::Submit([prev, next, func = std::move(func)]() mutable {
+			auto call = [&]() -> R {
+				if constexpr (std::is_void_v<T>) { return func(); }
+				else { return func(*prev->value); }
+			};
+			OFS_TaskDetail::Fulfill(*next, call);
+		}, priority);
+	});
+	return OFS_Task<R>(std::move(next));
+}
+
+template<typename T>
+template<typename F>
+inline void OFS_Task<T>::ThenOnMain(F&& func) const noexcept
+{
+	FUN_ASSERT(state, "invalid task");
+	state->onDone([prev = state, func = std::forward<F>(func)]() mutable {
+		OFS_MainThreadExecutor::Post([prev, func = std::move(func)]() mutable {
+			if constexpr (std::is_void_v<T>) { func(); }
+			else { func(*prev->value); }
+		});
+	});
+}
@@ -1,6 +1,7 @@
 #include "OFS_Util.h"
 
-#include "EventSystem.h"
+#include "OFS_MainThreadExecutor.h"
+#include "OFS_TaskScheduler.h"
 
 #include <filesystem>
 #include  "SDL_rwops.h"
@@ -26,7 +27,7 @@
 
 #include "EAStdC/EAString.h"
 
-char Util::FormatBuffer[4096];
+thread_local char Util::FormatBuffer[4096];
 
 static void SanitizeString(std::string& str) noexcept
 {
@@ -163,7 +164,7 @@ void Util::OpenFileDialog(const std::string& title, const std::string& path, Fil
 		std::string path;
 		std::vector<const char*> filters;
 		std::string filterText;
-		EventSystem::SingleShotEventHandler handler;
+		FileDialogResultHandler handler;
 	};
 	auto thread = [](void* ctx) {
 		auto data = (FileDialogThreadData*)ctx;
@@ -190,49 +191,39 @@ void Util::OpenFileDialog(const std::string& title, const std::string& path, Fil
 #else
 		auto result = tinyfd_openFileDialog(data->title.c_str(), data->path.c_str(), data->filters.size(), data->filters.data(), data->filterText.empty() ? NULL : data->filterText.c_str(), data->multiple);
 #endif
-		auto dialogResult = new FileDialogResult;
+		FileDialogResult dialogResult;
 		if (result != nullptr) {
 			if (data->multiple) {
 				int last = 0;
 				int index = 0;
 				for (char c : std::string(result)) {
 					if (c == '|') {
-						dialogResult->files.emplace_back(std::string(result + last, index - last));
+						dialogResult.files.emplace_back(std::string(result + last, index - last));
 						last = index+1;
 					}
 					index++;
 				}
-				dialogResult->files.emplace_back(std::string(result + last, index - last));
+				dialogResult.files.emplace_back(std::string(result + last, index - last));
 			}
 			else {
-				dialogResult->files.emplace_back(result);
+				dialogResult.files.emplace_back(result);
 			}
 		}
 
-		auto eventData = new EventSystem::SingleShotEventData;
-		eventData->ctx = dialogResult;
-		eventData->handler = std::move(data->handler);
-
-		SDL_Event ev{ 0 };
-		ev.type = EventSystem::SingleShotEvent;
-		ev.user.data1 = eventData;
-		SDL_PushEvent(&ev);
+		OFS_MainThreadExecutor::Post([handler = std::move(data->handler), dialogResult = std::move(dialogResult)]() mutable {
+			handler(dialogResult);
+		});
 		delete data;
 		return 0;
 	};
 	auto threadData = new FileDialogThreadData;
-	threadData->handler = [handler](void* ctx) {
-		auto result = (FileDialogResult*)ctx;
-		handler(*result);
-		delete result;
-	};
+	threadData->handler = std::move(handler);
 	threadData->filters = filters;
 	threadData->filterText = filterText;
 	threadData->multiple = multiple;
 	threadData->path = path;
 	threadData->title = title;
-	auto handle = SDL_CreateThread(thread, "OpenFileDialog", threadData);
-	SDL_DetachThread(handle);
+	OFS_TaskScheduler::SubmitLongRunning("OpenFileDialog", [thread, threadData]() { thread(threadData); });
 }
 
 void Util::SaveFileDialog(const std::string& title, const std::string& path, FileDialogResultHandler&& handler, const std::vector<const char*>& filters, const std::string& filterText) noexcept
@@ -242,7 +233,7 @@ void Util::SaveFileDialog(const std::string& title, const std::string& path, Fil
 		std::string path;
 		std::vector<const char*> filters;
 		std::string filterText;
-		EventSystem::SingleShotEventHandler handler;
+		FileDialogResultHandler handler;
 	};
 	auto thread = [](void* ctx) -> int32_t {
 		auto data = (SaveFileDialogThreadData*)ctx;
@@ -259,11 +250,13 @@ void Util::SaveFileDialog(const std::string& title, const std::string& path, Fil
 		auto result = tinyfd_saveFileDialog(data->title.c_str(), data->path.c_str(), data->filters.size(), data->filters.data(), !data->filterText.empty() ? data->filterText.c_str() : NULL);
 
 		FUN_ASSERT(result, "Ignore this if you pressed cancel.");
-		auto saveDialogResult = new FileDialogResult;
+		FileDialogResult saveDialogResult;
 		if (result != nullptr) {
-			saveDialogResult->files.emplace_back(result);
+			saveDialogResult.files.emplace_back(result);
 		}
-		EventSystem::SingleShot(std::move(data->handler), saveDialogResult);
+		OFS_MainThreadExecutor::Post([handler = std::move(data->handler), saveDialogResult = std::move(saveDialogResult)]() mutable {
+			handler(saveDialogResult);
+		});
 		delete data;
 		return 0;
 	};
@@ -272,13 +265,8 @@ void Util::SaveFileDialog(const std::string& title, const std::string& path, Fil
 	threadData->path = path;
 	threadData->filters = filters;
 	threadData->filterText = filterText;
-	threadData->handler = [handler](void* ctx) {
-		auto result = (FileDialogResult*)ctx;
-		handler(*result);
-		delete result;
-	};
-	auto handle = SDL_CreateThread(thread, "SaveFileDialog", threadData);
-	SDL_DetachThread(handle);
+	threadData->handler = std::move(handler);
+	OFS_TaskScheduler::SubmitLongRunning("SaveFileDialog", [thread, threadData]() { thread(threadData); });
 }
 
 void Util::OpenDirectoryDialog(const std::string& title, const std::string& path, FileDialogResultHandler&& handler) noexcept
@@ -286,7 +274,7 @@ void Util::OpenDirectoryDialog(const std::string& title, const std::string& path
 	struct OpenDirectoryDialogThreadData {
 		std::string title;
 		std::string path;
-		EventSystem::SingleShotEventHandler handler;
+		FileDialogResultHandler handler;
 	};
 	auto thread = [](void* ctx) -> int32_t {
 		auto data = (OpenDirectoryDialogThreadData*)ctx;
@@ -299,32 +287,22 @@ void Util::OpenDirectoryDialog(const std::string& title, const std::string& path
 		auto result = tinyfd_selectFolderDialog(data->title.c_str(), data->path.c_str());
 
 		FUN_ASSERT(result, "Ignore this if you pressed cancel.");
-		auto directoryDialogResult = new FileDialogResult;
+		FileDialogResult directoryDialogResult;
 		if (result != nullptr) {
-			directoryDialogResult->files.emplace_back(result);
+			directoryDialogResult.files.emplace_back(result);
 		}
-	
-		auto eventData = new EventSystem::SingleShotEventData;
-		eventData->ctx = directoryDialogResult;
-		eventData->handler = std::move(data->handler);
-
-		SDL_Event ev{ 0 };
-		ev.type = EventSystem::SingleShotEvent;
-		ev.user.data1 = eventData;
-		SDL_PushEvent(&ev);
+
+		OFS_MainThreadExecutor::Post([handler = std::move(data->handler), directoryDialogResult = std::move(directoryDialogResult)]() mutable {
+			handler(directoryDialogResult);
+		});
 		delete data;
 		return 0;
 	};
 	auto threadData = new OpenDirectoryDialogThreadData;
 	threadData->title = title;
 	threadData->path = path;
-	threadData->handler = [handler](void* ctx) {
-		auto result = (FileDialogResult*)ctx;
-		handler(*result);
-		delete result;
-	};
-	auto handle = SDL_CreateThread(thread, "SaveFileDialog", threadData);
-	SDL_DetachThread(handle);
+	threadData->handler = std::move(handler);
+	OFS_TaskScheduler::SubmitLongRunning("SaveFileDialog", [thread, threadData]() { thread(threadData); });
 }
 
 void Util::YesNoCancelDialog(const std::string& title, const std::string& message, YesNoDialogResultHandler&& handler)
@@ -333,7 +311,7 @@ void Util::YesNoCancelDialog(const std::string& title, const std::string& messag
 	{
 		std::string title;
 		std::string message;
-		EventSystem::SingleShotEventHandler handler;
+		YesNoDialogResultHandler handler;
 	};
 	auto thread = [](void* user) -> int
 	{
@@ -352,7 +330,9 @@ void Util::YesNoCancelDialog(const std::string& title, const std::string& messag
 			enumResult = Util::YesNoCancel::Cancel;
 			break;
 		}
-		EventSystem::SingleShot(std::move(data->handler), (void*)(intptr_t)enumResult);
+		OFS_MainThreadExecutor::Post([handler = std::move(data->handler), enumResult]() {
+			handler(enumResult);
+		});
 		delete data;
 		return 0;
 	};
@@ -360,12 +340,8 @@ void Util::YesNoCancelDialog(const std::string& title, const std::string& messag
 	auto threadData = new YesNoCancelThreadData;
 	threadData->title = title;
 	threadData->message = message;
-	threadData->handler = [handler](void* ctx) {
-		auto result = (Util::YesNoCancel)(intptr_t)ctx;
-		handler(result);
-	};
-	auto handle = SDL_CreateThread(thread, "YesNoCancelDialog", threadData);
-	SDL_DetachThread(handle);
+	threadData->handler = std::move(handler);
+	OFS_TaskScheduler::SubmitLongRunning("YesNoCancelDialog", [thread, threadData]() { thread(threadData); });
 }
 
 void Util::MessageBoxAlert(const std::string& title, const std::string& message) noexcept
@@ -391,8 +367,7 @@ void Util::MessageBoxAlert(const std::string& title, const std::string& message)
 	auto threadData = new MessageBoxData;
 	threadData->title = title;
 	threadData->message = message;
-	auto handle = SDL_CreateThread(thread, "MessageBoxAlert", threadData);
-	SDL_DetachThread(handle);
+	OFS_TaskScheduler::SubmitLongRunning("MessageBoxAlert", [thread, threadData]() { thread(threadData); });
 }
 
 std::string Util::Resource(const std::string& path) noexcept
@@ -414,7 +414,8 @@ public:
 
 	static std::filesystem::path FfmpegPath() noexcept;
 
-	static char FormatBuffer[4096];
+	// per thread, startup stages and workers format too
+	static thread_local char FormatBuffer[4096];
 	inline static const char* Format(const char* fmt, ...) noexcept
 	{
 		va_list argp;
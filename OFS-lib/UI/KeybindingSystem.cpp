@@ -17,7 +17,7 @@
 int32_t KeybindingEvents::ControllerButtonRepeat = 0;
 void KeybindingEvents::RegisterEvents() noexcept
 {
-    ControllerButtonRepeat = SDL_RegisterEvents(1);
+    ControllerButtonRepeat = EventSystem::RegisterEvent("ControllerButtonRepeat");
 }
 
 KeybindingSystem* KeybindingSystem::ptr = nullptr;
@@ -170,17 +170,30 @@ void KeybindingSystem::handlePassiveBindingModification(SDL_Event& ev, uint16_t
 
 bool KeybindingSystem::load(const std::string& path) noexcept
 {
-    keybindingPath = path;
+    Keybindings bindings;
+    bool succ = ReadBindings(path, bindings);
+    applyLoaded(path, succ ? &bindings : nullptr);
+    return succ;
+}
+
+bool KeybindingSystem::ReadBindings(const std::string& path, Keybindings& bindings) noexcept
+{
     bool succ = false;
     auto json = Util::LoadJson(path, &succ);
     if (succ) {
-        Keybindings bindings;
         OFS::serializer::load(&bindings, &json["keybindings"]);
-        setBindings(bindings);
     }
     return succ;
 }
 
+void KeybindingSystem::applyLoaded(const std::string& path, const Keybindings* bindings) noexcept
+{
+    keybindingPath = path;
+    if (bindings) {
+        setBindings(*bindings);
+    }
+}
+
 void KeybindingSystem::save() noexcept
 {
     nlohmann::json json;
@@ -232,6 +232,10 @@ public:
 	bool ShowWindow = false;
 
 	bool load(const std::string& path) noexcept;
+	// the file part of load, doesn't touch the system so it can happen on any thread
+	static bool ReadBindings(const std::string& path, Keybindings& bindings) noexcept;
+	// the rest of load with what ReadBindings returned, nullptr if there was nothing to read
+	void applyLoaded(const std::string& path, const Keybindings* bindings) noexcept;
 	void save() noexcept;
 
 	void setup(class EventSystem& events);
@@ -0,0 +1,272 @@
+#include "OFS_ActionRenderer.h"
+#include "ScriptPositionsOverlayMode.h"
+#include "FunscriptHeatmap.h"
+#include "OFS_Profiling.h"
+#include "OFS_GL.h"
+#include "OFS_RenderThread.h"
+#include "OFS_Allocator.h"
+
+#include <array>
+#include <algorithm>
+
+void OFS_ActionRenderer::ScriptBuffer::Sync(const FunscriptArray& actions) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	auto sameAction = [](ActionVertex vert, FunscriptAction action) noexcept {
+		return vert.atS == action.atS && vert.pos == (float)action.pos;
+	};
+
+	const int32_t newCount = actions.size();
+	const int32_t oldCount = vertices.empty() ? 0 : (int32_t)vertices.size() - 2;
+	if (newCount == 0) {
+		vertices.clear();
+		return;
+	}
+
+	// find the range of actions which changed
+	// action i lives at vertices[i + 1]
+	const int32_t minCount = std::min(newCount, oldCount);
+	int32_t first = 0;
+	while (first < minCount && sameAction(vertices[first + 1], actions[first])) { ++first; }
+
+	int32_t last = newCount;
+	if (newCount == oldCount) {
+		while (last > first && sameAction(vertices[last], actions[last - 1])) { --last; }
+		if (first == last) return;
+	}
+
+	vertices.resize(newCount + 2);
+	for (int32_t i = first; i < last; ++i) {
+		vertices[i + 1] = ActionVertex{ actions[i].atS, (float)actions[i].pos };
+	}
+	vertices.front() = vertices[1];
+	vertices.back() = vertices[newCount];
+
+	// the render thread might still be drawing the previous frame from this buffer
+	// the uploads happen over there in order with the draws
+	if (capacity < vertices.size()) {
+		capacity = vertices.size() + (vertices.size() / 2);
+		OFS_RenderThread::Enqueue([vbo = vbo, capacity = capacity, upload = vertices]() {
+			glBindBuffer(GL_ARRAY_BUFFER, vbo);
+			glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(ActionVertex), nullptr, GL_DYNAMIC_DRAW);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, upload.size() * sizeof(ActionVertex), upload.data());
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		});
+	}
+	else {
+		// the changed range plus the vertices next to it
+		// this covers the padding if the first or last action changed
+		const int32_t uploadCount = (last + 2) - first;
+		std::vector<ActionVertex> upload(vertices.begin() + first, vertices.begin() + first + uploadCount);
+		OFS_RenderThread::Enqueue([vbo = vbo, first, upload = std::move(upload)]() {
+			glBindBuffer(GL_ARRAY_BUFFER, vbo);
+			glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(ActionVertex), upload.size() * sizeof(ActionVertex), upload.data());
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		});
+	}
+}
+
+void OFS_ActionRenderer::Init() noexcept
+{
+	shader = std::make_unique<ActionLineShader>();
+
+	// every attribute reads a neighbouring action
+	// Action0 = previous, Action1 = start, Action2 = end, Action3 = next
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	for (uint32_t i = 0; i < 4; i++) {
+		glVertexAttribDivisor(i, 1);
+	}
+	glBindVertexArray(0);
+
+	glGenTextures(1, &gradientTex);
+	glBindTexture(GL_TEXTURE_1D, gradientTex);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+}
+
+void OFS_ActionRenderer::uploadGradient(const ImGradient& gradient) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	std::array<uint8_t, 256 * 4> pixels;
+	for (int i = 0; i < 256; i++) {
+		ImColor color;
+		gradient.getColorAt(i / 255.f, &color.Value.x);
+		pixels[i * 4 + 0] = color.Value.x * 255.f;
+		pixels[i * 4 + 1] = color.Value.y * 255.f;
+		pixels[i * 4 + 2] = color.Value.z * 255.f;
+		pixels[i * 4 + 3] = 255;
+	}
+	OFS_RenderThread::Enqueue([texture = gradientTex, pixels]() {
+		glBindTexture(GL_TEXTURE_1D, texture);
+		glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA8, 256, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	});
+	gradientUploaded = true;
+}
+
+void OFS_ActionRenderer::NewFrame() noexcept
+{
+	pendingPoints.clear();
+}
+
+void OFS_ActionRenderer::Sync(int32_t scriptIdx, const std::shared_ptr<Funscript>& script) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	while (buffers.size() <= scriptIdx) {
+		auto buffer = std::make_unique<ScriptBuffer>();
+		glGenBuffers(1, &buffer->vbo);
+		buffers.emplace_back(std::move(buffer));
+	}
+
+	auto& buffer = *buffers[scriptIdx];
+	if (buffer.script.lock() != script) {
+		// a different script took this slot
+		buffer.script = script;
+		buffer.vertices.clear();
+		buffer.revision = 0;
+	}
+
+	if (buffer.revision != script->ActionsRevision()) {
+		buffer.Sync(script->Actions());
+		buffer.revision = script->ActionsRevision();
+	}
+}
+
+void OFS_ActionRenderer::DrawLines(const OverlayDrawingCtx& ctx) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	if (ctx.scriptIdx >= buffers.size()) return;
+	auto buffer = buffers[ctx.scriptIdx].get();
+	if (buffer->vertices.empty() || ctx.actionToIdx <= ctx.actionFromIdx) return;
+
+	if (!gradientUploaded) {
+		uploadGradient(BaseOverlay::speedGradient);
+	}
+
+	DrawCall call;
+	call.renderer = this;
+	call.buffer = buffer;
+	call.mode = ActionLineShader::Mode::Line;
+	call.fromIdx = ctx.actionFromIdx;
+	call.toIdx = ctx.actionToIdx;
+	call.offsetTime = ctx.offsetTime;
+	call.visibleTime = ctx.visibleTime;
+	call.canvasPos = ctx.canvas_pos;
+	call.canvasSize = ctx.canvas_size;
+	call.splineMode = BaseOverlay::SplineMode;
+	call.highlightSpeed = BaseOverlay::ShowMaxSpeedHighlight ? BaseOverlay::MaxSpeedPerSecond : 0.f;
+	call.highlightColor = BaseOverlay::MaxSpeedColor;
+	call.pointSize = 0.f;
+	call.opacity = 1.f;
+
+	if (call.toIdx - call.fromIdx > 1) {
+		ctx.draw_list->AddCallback(renderCallback, OFS_FrameArena::Copy(call));
+		ctx.draw_list->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+	}
+
+	// points get drawn later on top of everything else
+	call.mode = ActionLineShader::Mode::Point;
+	pendingPoints.emplace_back(call);
+}
+
+void OFS_ActionRenderer::DrawPoints(ImDrawList* drawList, float pointSize, float opacity) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	if (pendingPoints.empty()) return;
+	for (auto& call : pendingPoints) {
+		call.pointSize = pointSize;
+		call.opacity = opacity;
+		drawList->AddCallback(renderCallback, OFS_FrameArena::Copy(call));
+	}
+	drawList->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+	pendingPoints.clear();
+}
+
+void OFS_ActionRenderer::renderCallback(const ImDrawList* parentList, const ImDrawCmd* cmd) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	auto& call = *(const DrawCall*)cmd->UserCallbackData;
+	auto& renderer = *call.renderer;
+	auto& shader = *renderer.shader;
+	auto drawData = OFS_RenderThread::CurrentDrawData();
+
+	// the backend only sets up the scissor rect for regular draw commands
+	const ImVec2 clipOff = drawData->DisplayPos;
+	const ImVec2 clipScale = drawData->FramebufferScale;
+	const float fbHeight = drawData->DisplaySize.y * clipScale.y;
+	const ImVec2 clipMin((cmd->ClipRect.x - clipOff.x) * clipScale.x, (cmd->ClipRect.y - clipOff.y) * clipScale.y);
+	const ImVec2 clipMax((cmd->ClipRect.z - clipOff.x) * clipScale.x, (cmd->ClipRect.w - clipOff.y) * clipScale.y);
+	if (clipMax.x <= clipMin.x || clipMax.y <= clipMin.y) return;
+	glScissor((int)clipMin.x, (int)(fbHeight - clipMax.y), (int)(clipMax.x - clipMin.x), (int)(clipMax.y - clipMin.y));
+
+	float L = drawData->DisplayPos.x;
+	float R = drawData->DisplayPos.x + drawData->DisplaySize.x;
+	float T = drawData->DisplayPos.y;
+	float B = drawData->DisplayPos.y + drawData->DisplaySize.y;
+	const float orthoProjection[4][4] =
+	{
+		{ 2.0f / (R - L), 0.0f, 0.0f, 0.0f },
+		{ 0.0f, 2.0f / (T - B), 0.0f, 0.0f },
+		{ 0.0f, 0.0f, -1.0f, 0.0f },
+		{ (R + L) / (L - R),  (T + B) / (B - T),  0.0f,   1.0f },
+	};
+
+	shader.use();
+	shader.ProjMtx(&orthoProjection[0][0]);
+	shader.Canvas(&call.canvasPos.x, &call.canvasSize.x);
+	shader.Window(call.offsetTime, call.visibleTime);
+
+	glBindVertexArray(renderer.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, call.buffer->vbo);
+	// instance n reads the vertices fromIdx + n ... fromIdx + n + 3
+	// action i lives at vertex i + 1 so Action1 of instance n is action fromIdx + n
+	for (uint32_t i = 0; i < 4; i++) {
+		glVertexAttribPointer(i, 2, GL_FLOAT, GL_FALSE, sizeof(ActionVertex), (void*)(intptr_t)((call.fromIdx + i) * sizeof(ActionVertex)));
+	}
+
+	if (call.mode == ActionLineShader::Mode::Point) {
+		// the other attributes would read past the last action
+		glDisableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glDisableVertexAttribArray(2);
+		glDisableVertexAttribArray(3);
+
+		const float color[4]{ 1.f, 0.f, 0.f, call.opacity };
+		const float borderColor[4]{ 0.f, 0.f, 0.f, call.opacity };
+		shader.DrawMode(ActionLineShader::Mode::Point);
+		shader.Width(call.pointSize);
+		shader.Color(color);
+		shader.BorderColor(borderColor);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 6, call.toIdx - call.fromIdx);
+	}
+	else {
+		for (uint32_t i = 0; i < 4; i++) {
+			glEnableVertexAttribArray(i);
+		}
+
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_1D, renderer.gradientTex);
+		shader.SpeedGradient(1);
+		shader.MaxSpeed(HeatmapGradient::MaxSpeedPerSecond);
+		shader.Highlight(call.highlightSpeed, &call.highlightColor.Value.x);
+		shader.SplineMode(call.splineMode);
+
+		const int32_t vertexCount = call.splineMode ? 6 * ActionLineShader::SplineSubdivisions : 6;
+		const int32_t segmentCount = call.toIdx - call.fromIdx - 1;
+
+		// black border below the coloured line
+		const float borderColor[4]{ 0.f, 0.f, 0.f, 1.f };
+		shader.DrawMode(ActionLineShader::Mode::LineBorder);
+		shader.Color(borderColor);
+		shader.Width(7.f);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, segmentCount);
+
+		shader.DrawMode(ActionLineShader::Mode::Line);
+		shader.Width(3.f);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, segmentCount);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	glBindVertexArray(0);
+}
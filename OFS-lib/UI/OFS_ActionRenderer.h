@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "Funscript.h"
+#include "OFS_Shader.h"
+#include "GradientBar.h"
+#include "imgui.h"
+
+// draws the action lines and points of the timeline on the gpu
+// every script keeps a persistent vertex buffer which only gets updated where the actions changed
+// scrolling and zooming are just uniforms
+class OFS_ActionRenderer
+{
+	struct ActionVertex {
+		float atS;
+		float pos;
+	};
+
+	struct ScriptBuffer {
+		std::weak_ptr<Funscript> script;
+		uint32_t revision = 0;
+		uint32_t vbo = 0;
+		int32_t capacity = 0;
+		// copy of what's on the gpu
+		// padded with the first and last action
+		std::vector<ActionVertex> vertices;
+
+		void Sync(const FunscriptArray& actions) noexcept;
+	};
+
+	struct DrawCall {
+		OFS_ActionRenderer* renderer;
+		ScriptBuffer* buffer;
+		ActionLineShader::Mode mode;
+		int32_t fromIdx;
+		int32_t toIdx;
+		float offsetTime;
+		float visibleTime;
+		ImVec2 canvasPos;
+		ImVec2 canvasSize;
+		bool splineMode;
+		float highlightSpeed;
+		ImColor highlightColor;
+		float pointSize;
+		float opacity;
+	};
+
+	std::vector<std::unique_ptr<ScriptBuffer>> buffers;
+	// the callbacks get a copy from the frame arena, they run on the render thread
+	std::vector<DrawCall> pendingPoints;
+
+	std::unique_ptr<ActionLineShader> shader;
+	uint32_t vao = 0;
+	uint32_t gradientTex = 0;
+	bool gradientUploaded = false;
+
+	void uploadGradient(const ImGradient& gradient) noexcept;
+	static void renderCallback(const ImDrawList* parentList, const ImDrawCmd* cmd) noexcept;
+public:
+	void Init() noexcept;
+	void NewFrame() noexcept;
+
+	void Sync(int32_t scriptIdx, const std::shared_ptr<Funscript>& script) noexcept;
+	void DrawLines(const struct OverlayDrawingCtx& ctx) noexcept;
+	void DrawPoints(ImDrawList* drawList, float pointSize, float opacity) noexcept;
+};
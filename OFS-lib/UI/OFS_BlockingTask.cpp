@@ -1,6 +1,8 @@
 #include "OFS_BlockingTask.h"
 #include "OFS_ImGui.h"
 #include "OFS_Localization.h"
+#include "OFS_TaskScheduler.h"
+#include "OFS_Redraw.h"
 #include "imgui.h"
 
 static int BlockingTaskThread(void* data) noexcept
@@ -16,14 +18,16 @@ void OFS_BlockingTask::ShowBlockingTask() noexcept
 {
 	if (currentTask) {
 		ImGui::OpenPopup(TR_ID("RUNNING_TASK", Tr::RUNNING_TASK), ImGuiPopupFlags_None);
+		// progress and the spinner keep changing
+		OFS_Redraw::Request();
 	}
 	else { return; }
 
 	if (!Running) {
 		RunningTimer = 0.f;
 		Running = true;
-		auto thread = SDL_CreateThread(BlockingTaskThread, "BlockingTaskThread", this);
-		SDL_DetachThread(thread);
+		// tasks usually wait on subprocesses or do their own parallel work
+		OFS_TaskScheduler::SubmitLongRunning("BlockingTaskThread", [this]() { BlockingTaskThread(this); });
 	}
 	RunningTimer += ImGui::GetIO().DeltaTime;
 
@@ -3,7 +3,10 @@
 #include "imgui_stdlib.h"
 #include "OFS_Profiling.h"
 #include "OFS_UndoSystem.h"
+#include "OFS_TaskScheduler.h"
 #include "OFS_Videoplayer.h"
+#include "OFS_RenderThread.h"
+#include "OFS_Allocator.h"
 
 #include "SDL.h"
 #include "stb_sprintf.h"
@@ -27,11 +30,11 @@ int32_t ScriptTimelineEvents::ActiveScriptChanged = 0;
 
 void ScriptTimelineEvents::RegisterEvents() noexcept
 {
-	FfmpegAudioProcessingFinished = SDL_RegisterEvents(1);
-	FunscriptActionClicked = SDL_RegisterEvents(1);
-	FunscriptSelectTime = SDL_RegisterEvents(1);
-	SetTimePosition = SDL_RegisterEvents(1);
-	ActiveScriptChanged = SDL_RegisterEvents(1);
+	FfmpegAudioProcessingFinished = EventSystem::RegisterEvent("FfmpegAudioProcessingFinished");
+	FunscriptActionClicked = EventSystem::RegisterEvent("FunscriptActionClicked");
+	FunscriptSelectTime = EventSystem::RegisterEvent("FunscriptSelectTime");
+	SetTimePosition = EventSystem::RegisterEvent("SetTimePosition");
+	ActiveScriptChanged = EventSystem::RegisterEvent("ActiveScriptChanged");
 }
 
 void ScriptTimeline::updateSelection(ScriptTimelineEvents::Mode mode, bool clear) noexcept
@@ -66,6 +69,7 @@ void ScriptTimeline::setup(UndoSystem* undoSystem)
 	EventSystem::ev().Subscribe(VideoEvents::MpvVideoLoaded, EVENT_SYSTEM_BIND(this, &ScriptTimeline::videoLoaded));
 
 	Wave.Init();
+	ActionRenderer.Init();
 }
 
 void ScriptTimeline::mousePressed(SDL_Event& ev) noexcept
@@ -89,15 +93,9 @@ void ScriptTimeline::mousePressed(SDL_Event& ev) noexcept
 		else if (button.button == SDL_BUTTON_LEFT && button.clicks == 1)	{
 			// test if an action has been clicked
 			if (overlay->PointSize > 0.f) {
-				int index = 0;
-				for (auto& vert : overlay->ActionScreenCoordinates) {
-					const ImVec2 size(overlay->PointSize, overlay->PointSize);
-					ImRect rect(vert - size, vert + size);
-					if (rect.Contains(mousePos)) {
-						clickedAction = &overlay->ActionPositionWindow[index];
-						break;
-					}
-					index++;
+				int32_t index = BaseOverlay::HitTestAction(mousePos, overlay->PointSize, hovereScriptIdx);
+				if (index >= 0) {
+					clickedAction = &overlay->ActionPositionWindow[index];
 				}
 			}
 
@@ -305,6 +303,8 @@ void ScriptTimeline::ShowScriptPositions(bool* open, float currentTime, float du
 	ImGui::Begin(TR_ID(WindowId, Tr::POSITIONS), open, ImGuiWindowFlags_None);
 	auto draw_list = ImGui::GetWindowDrawList();
 	drawingCtx.draw_list = draw_list;
+	drawingCtx.actionRenderer = &ActionRenderer;
+	ActionRenderer.NewFrame();
 	PositionsItemHovered = ImGui::IsWindowHovered();
 
 	drawingCtx.drawnScriptCount = 0;
@@ -375,20 +375,11 @@ void ScriptTimeline::ShowScriptPositions(bool* open, float currentTime, float du
 			);
 		}
 
-		auto startIt = std::find_if(script.Actions().begin(), script.Actions().end(),
-		    [this](auto act) { return act.atS >= offsetTime; });
-		if (startIt != script.Actions().begin()) {
-		    startIt -= 1;
-		}
-
-		auto endIt = std::find_if(startIt, script.Actions().end(),
-		    [this](auto act) { return act.atS >= offsetTime + visibleTime; });
-		if (endIt != script.Actions().end()) {
-		    endIt += 1;
-		}
-		drawingCtx.actionFromIdx = std::distance(script.Actions().begin(), startIt);
-		drawingCtx.actionToIdx = std::distance(script.Actions().begin(), endIt);
+		auto& visibleWindow = script.VisibleWindow(offsetTime, offsetTime + visibleTime);
+		drawingCtx.actionFromIdx = visibleWindow.FromIdx;
+		drawingCtx.actionToIdx = visibleWindow.ToIdx;
 		drawingCtx.script = scriptPtr.get();
+		ActionRenderer.Sync(i, scriptPtr);
 
 		// draws mode specific things in the timeline
 		// by default it draws the frame and time dividers
@@ -523,19 +514,16 @@ void ScriptTimeline::ShowScriptPositions(bool* open, float currentTime, float du
 				ImGui::EndMenu();
 			}
 
-			auto updateAudioWaveformThread = [](void* userData) -> int {
-				auto& ctx = *((ScriptTimeline*)userData);
-				std::error_code ec;
+			auto updateAudioWaveform = [this]() {
 				auto ffmpegPath = Util::FfmpegPath();
 				auto outputPath = Util::Prefpath("tmp");
 				if (!Util::CreateDirectories(outputPath)) {
-					return 0;
+					return;
 				}
 				
 				outputPath = (Util::PathFromString(outputPath) / "audio.flac").u8string();
-				bool succ = ctx.Wave.data.GenerateAndLoadFlac(ffmpegPath.u8string(), ctx.videoPath, outputPath);
+				bool succ = Wave.data.GenerateAndLoadFlac(ffmpegPath.u8string(), videoPath, outputPath);
 				EventSystem::PushEvent(ScriptTimelineEvents::FfmpegAudioProcessingFinished);
-				return 0;
 			};
 			if (ImGui::BeginMenu(TR_ID("WAVEFORM", Tr::WAVEFORM))) {
 				if(ImGui::BeginMenu(TR_ID("SETTINGS", Tr::SETTINGS))) {
@@ -553,8 +541,8 @@ void ScriptTimeline::ShowScriptPositions(bool* open, float currentTime, float du
 				else if(ImGui::MenuItem(TR(UPDATE_WAVEFORM), NULL, false, !Wave.data.BusyGenerating() && videoPath != nullptr)) {
 					if (!Wave.data.BusyGenerating()) {
 						ShowAudioWaveform = false; // gets switched true after processing
-						auto handle = SDL_CreateThread(updateAudioWaveformThread, "OFS_GenWaveform", this);
-						SDL_DetachThread(handle);
+						// waits on ffmpeg most of the time
+						OFS_TaskScheduler::SubmitLongRunning("OFS_GenWaveform", std::move(updateAudioWaveform));
 					}
 				}
 				ImGui::EndMenu();
@@ -575,16 +563,21 @@ void ScriptTimeline::ShowScriptPositions(bool* open, float currentTime, float du
 			(startCursor + ImGui::GetWindowSize() - (style.FramePadding*2.f) - (style.ItemInnerSpacing * 2.f))
 			+ ImVec2(0.f, 20.f), true);
 		int opcacityInt = 255 * opacity;
-		for (auto&& p : overlay->ActionScreenCoordinates) {
-			draw_list->AddCircleFilled(p, overlay->PointSize, IM_COL32(0, 0, 0, opcacityInt), 8); // border
-			draw_list->AddCircleFilled(p, overlay->PointSize*0.7f, IM_COL32(255, 0, 0, opcacityInt), 8);
-		}
+		ActionRenderer.DrawPoints(draw_list, overlay->PointSize, opacity);
 
 		// draw selected points
 		for (auto&& p : overlay->SelectedActionScreenCoordinates) {
 			const auto selectedDots = IM_COL32(11, 252, 3, opcacityInt);
 			draw_list->AddCircleFilled(p, overlay->PointSize * 0.7f, selectedDots, 8);
 		}
+
+		// hovered point
+		if (PositionsItemHovered) {
+			int32_t hoveredIdx = BaseOverlay::HitTestAction(ImGui::GetMousePos(), overlay->PointSize, hovereScriptIdx);
+			if (hoveredIdx >= 0) {
+				draw_list->AddCircle(overlay->ActionScreenCoordinates[hoveredIdx], overlay->PointSize, IM_COL32(255, 255, 255, opcacityInt), 8, 2.f);
+			}
+		}
 		draw_list->PopClipRect();
 	}
 	ImGui::End();
@@ -611,20 +604,34 @@ void ScriptTimeline::DrawAudioWaveform(const OverlayDrawingCtx& ctx) noexcept
 	if (ShowAudioWaveform && Wave.data.SampleCount() > 0) {
 		FUN_ASSERT(Wave.data.SampleCount() < 16777217, "switch to doubles"); 
 
-		Wave.WaveformViewport = ImGui::GetWindowViewport();
 		auto renderWaveform = [](ScriptTimeline* timeline, const OverlayDrawingCtx& ctx) noexcept
 		{
 			OFS_PROFILE("DrawAudioWaveform::renderWaveform");
 			
 			timeline->Wave.Update(ctx);
+
+			// the callback runs on the render thread while the next frame updates the waveform
+			struct WaveState {
+				WaveformShader* shader;
+				uint32_t texture;
+				float samplingOffset;
+				float scale;
+				ImColor color;
+			};
+			WaveState state;
+			state.shader = timeline->Wave.WaveShader.get();
+			state.texture = timeline->Wave.WaveformTex;
+			state.samplingOffset = timeline->Wave.samplingOffset;
+			state.scale = timeline->ScaleAudio;
+			state.color = timeline->Wave.WaveformColor;
 			
 			ctx.draw_list->AddCallback([](const ImDrawList* parent_list, const ImDrawCmd* cmd) noexcept {
-				ScriptTimeline* ctx = (ScriptTimeline*)cmd->UserCallbackData;
+				auto& state = *(WaveState*)cmd->UserCallbackData;
 				
 				glActiveTexture(GL_TEXTURE1);
-				glBindTexture(GL_TEXTURE_1D, ctx->Wave.WaveformTex);
-				ctx->Wave.WaveShader->use();
-				auto draw_data = ctx->Wave.WaveformViewport->DrawData;
+				glBindTexture(GL_TEXTURE_1D, state.texture);
+				state.shader->use();
+				auto draw_data = OFS_RenderThread::CurrentDrawData();
 				float L = draw_data->DisplayPos.x;
 				float R = draw_data->DisplayPos.x + draw_data->DisplaySize.x;
 				float T = draw_data->DisplayPos.y;
@@ -636,12 +643,12 @@ void ScriptTimeline::DrawAudioWaveform(const OverlayDrawingCtx& ctx) noexcept
 					{ 0.0f, 0.0f, -1.0f, 0.0f },
 					{ (R + L) / (L - R),  (T + B) / (B - T),  0.0f,   1.0f },
 				};
-				ctx->Wave.WaveShader->ProjMtx(&ortho_projection[0][0]);
-				ctx->Wave.WaveShader->AudioData(1);
-				ctx->Wave.WaveShader->SampleOffset(ctx->Wave.samplingOffset);
-				ctx->Wave.WaveShader->ScaleFactor(ctx->ScaleAudio);
-				ctx->Wave.WaveShader->Color(&ctx->Wave.WaveformColor.Value.x);
-			}, timeline);
+				state.shader->ProjMtx(&ortho_projection[0][0]);
+				state.shader->AudioData(1);
+				state.shader->SampleOffset(state.samplingOffset);
+				state.shader->ScaleFactor(state.scale);
+				state.shader->Color(&state.color.Value.x);
+			}, OFS_FrameArena::Copy(state));
 
 			ctx.draw_list->AddImage(0, ctx.canvas_pos, ctx.canvas_pos + ctx.canvas_size);
 			ctx.draw_list->AddCallback(ImDrawCallback_ResetRenderState, 0);
@@ -5,6 +5,7 @@
 #include <tuple>
 
 #include "OFS_Waveform.h"
+#include "OFS_ActionRenderer.h"
 #include "OFS_Shader.h"
 #include "ScriptPositionsOverlayMode.h"
 
@@ -116,6 +117,7 @@ private:
 
 public:
 	OFS_WaveformLOD Wave;
+	OFS_ActionRenderer ActionRenderer;
 	static constexpr const char* WindowId = "###POSITIONS";
 
 	static constexpr float MAX_WINDOW_SIZE = 300.f;
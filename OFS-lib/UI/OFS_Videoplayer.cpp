@@ -10,7 +10,11 @@
 #include "EventSystem.h"
 #include "OFS_ImGui.h"
 #include "OFS_Profiling.h"
+#include "OFS_Redraw.h"
+#include "OFS_RenderThread.h"
+#include "OFS_Allocator.h"
 #include "OFS_Shader.h"
+#include "OFS_TaskScheduler.h"
 
 #define OFS_MPV_LOADER_MACROS
 #include "OFS_MpvLoader.h"
@@ -76,6 +80,12 @@ void VideoplayerWindow::MpvEvents(SDL_Event& ev) noexcept
 			MpvData.videoLoaded = true; 	
 			continue;
 		}
+		case MPV_EVENT_PLAYBACK_RESTART:
+		{
+			// a seek finished
+			seekCount++;
+			continue;
+		}
 		case MPV_EVENT_PROPERTY_CHANGE:
 		{
 			mpv_event_property* prop = (mpv_event_property*)mp_event->data;
@@ -134,7 +144,8 @@ void VideoplayerWindow::MpvEvents(SDL_Event& ev) noexcept
 				clearLoop();
 				break;
 			case MpvTotalFrames:
-				MpvData.totalNumFrames = *(int64_t*)prop->data;
+				// the index counts the actual frames
+				if (!frameIndex) MpvData.totalNumFrames = *(int64_t*)prop->data;
 				break;
 			case MpvPosition:
 			{
@@ -173,6 +184,7 @@ void VideoplayerWindow::MpvEvents(SDL_Event& ev) noexcept
                 // Copy string to ensure we own the memory and control the lifetime
 				MpvData.filePath = std::string(*((const char**)(prop->data)));
 				notifyVideoLoaded();
+				buildFrameIndex();
 				break;
 			case MpvAbLoopA:
 			{
@@ -198,11 +210,9 @@ void VideoplayerWindow::MpvEvents(SDL_Event& ev) noexcept
 void VideoplayerWindow::MpvRenderUpdate(SDL_Event& ev) noexcept
 {
 	if (ev.user.data1 != this) return;
-	OFS_PROFILE(__FUNCTION__);
-	uint64_t flags = mpv_render_context_update(mpv_gl);
-	if (flags & MPV_RENDER_UPDATE_FRAME) {
-		redrawVideo = true;
-	}
+	// mpv_render_context_update happens on the render thread together with the render
+	redrawVideo = true;
+	OFS_Redraw::Request();
 }
 
 void VideoplayerWindow::observeProperties() noexcept
@@ -231,14 +241,21 @@ void VideoplayerWindow::renderToTexture() noexcept
 	fbo.h = MpvData.videoHeight;
 	fbo.internal_format = OFS_InternalTexFormat;
 
-	uint32_t disable = 0;
-	mpv_render_param params[] = {
-		{MPV_RENDER_PARAM_OPENGL_FBO, &fbo},
-		// without this the whole application slows down to the framerate of the video
-		{MPV_RENDER_PARAM_BLOCK_FOR_TARGET_TIME, &disable}, 
-		mpv_render_param{}
-	};
-	mpv_render_context_render(mpv_gl, params);
+	// the render context was created with the context the render thread owns
+	OFS_RenderThread::Enqueue([mpv_gl = mpv_gl, fbo]() mutable {
+		OFS_PROFILE("VideoplayerWindow::renderToTexture");
+		uint64_t flags = mpv_render_context_update(mpv_gl);
+		if (!(flags & MPV_RENDER_UPDATE_FRAME)) return;
+
+		uint32_t disable = 0;
+		mpv_render_param params[] = {
+			{MPV_RENDER_PARAM_OPENGL_FBO, &fbo},
+			// without this the whole application slows down to the framerate of the video
+			{MPV_RENDER_PARAM_BLOCK_FOR_TARGET_TIME, &disable}, 
+			mpv_render_param{}
+		};
+		mpv_render_context_render(mpv_gl, params);
+	});
 }
 
 void VideoplayerWindow::updateRenderTexture() noexcept
@@ -272,21 +289,20 @@ void VideoplayerWindow::updateRenderTexture() noexcept
 	}
 	else if(MpvData.videoHeight > 0 && MpvData.videoWidth > 0) {
 		// update size of render texture based on video resolution
-		glBindTexture(GL_TEXTURE_2D, renderTexture);
-		glTexImage2D(GL_TEXTURE_2D, 0, OFS_InternalTexFormat, MpvData.videoWidth, MpvData.videoHeight, 0, OFS_TexFormat, GL_UNSIGNED_BYTE, 0);
+		// in order with the mpv renders into it
+		OFS_RenderThread::Enqueue([texture = renderTexture, width = MpvData.videoWidth, height = MpvData.videoHeight]() {
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, OFS_InternalTexFormat, width, height, 0, OFS_TexFormat, GL_UNSIGNED_BYTE, 0);
+		});
 	}
 	else {
 		FUN_ASSERT(false, "Video height/width was 0");
 	}
 }
 
-bool VideoplayerWindow::setup(bool force_hw_decoding)
+bool VideoplayerWindow::createMpv(bool force_hw_decoding) noexcept
 {
-	EventSystem::ev().Subscribe(VideoEvents::WakeupOnMpvEvents, EVENT_SYSTEM_BIND(this, &VideoplayerWindow::MpvEvents));
-	EventSystem::ev().Subscribe(VideoEvents::WakeupOnMpvRenderUpdate, EVENT_SYSTEM_BIND(this, &VideoplayerWindow::MpvRenderUpdate));
-	EventSystem::ev().Subscribe(SDL_MOUSEWHEEL, EVENT_SYSTEM_BIND(this, &VideoplayerWindow::mouseScroll));
-
-	updateRenderTexture();
+	OFS_PROFILE(__FUNCTION__);
 	mpv = mpv_create();
 	auto confPath = Util::Prefpath();
 	bool suc;
@@ -332,6 +348,19 @@ bool VideoplayerWindow::setup(bool force_hw_decoding)
 #else 
 	mpv_request_log_messages(mpv, "info");
 #endif
+	return true;
+}
+
+bool VideoplayerWindow::setup(bool force_hw_decoding)
+{
+	EventSystem::ev().Subscribe(VideoEvents::WakeupOnMpvEvents, EVENT_SYSTEM_BIND(this, &VideoplayerWindow::MpvEvents));
+	EventSystem::ev().Subscribe(VideoEvents::WakeupOnMpvRenderUpdate, EVENT_SYSTEM_BIND(this, &VideoplayerWindow::MpvRenderUpdate));
+	EventSystem::ev().Subscribe(SDL_MOUSEWHEEL, EVENT_SYSTEM_BIND(this, &VideoplayerWindow::mouseScroll));
+
+	updateRenderTexture();
+	if (mpv == nullptr && !createMpv(force_hw_decoding)) {
+		return false;
+	}
 
 	mpv_opengl_init_params init_params = {0};
 	init_params.get_proc_address = getProcAddressMpv;
@@ -453,6 +482,18 @@ void VideoplayerWindow::notifyVideoLoaded() noexcept
 	EventSystem::PushEvent(VideoEvents::MpvVideoLoaded, (void*)MpvData.filePath.c_str());
 }
 
+void VideoplayerWindow::buildFrameIndex() noexcept
+{
+	frameIndex.reset();
+	auto generation = ++frameIndexGeneration;
+	OFS_TaskScheduler::Spawn([path = MpvData.filePath]() { return OFS_FrameIndex::Load(path); }, OFS_TaskPriority::Background)
+		.ThenOnMain([this, generation](auto& index) {
+			if (generation != frameIndexGeneration || !index) return;
+			frameIndex = index;
+			MpvData.totalNumFrames = index->Count();
+		});
+}
+
 void VideoplayerWindow::drawVrVideo(ImDrawList* draw_list) noexcept
 {
 	OFS_PROFILE(__FUNCTION__);
@@ -468,13 +509,26 @@ void VideoplayerWindow::drawVrVideo(ImDrawList* draw_list) noexcept
 				/ ImVec2((10000.f * settings.vrZoom), (videoDrawSize.y / videoDrawSize.x) * 10000.f * settings.vrZoom));
 	}
 
-	playerViewport = ImGui::GetCurrentWindowRead()->Viewport;
+	// the callback runs on the render thread while the next frame changes these
+	struct VrState {
+		VrShader* shader;
+		ImVec2 rotation;
+		float zoom;
+		float aspectRatio;
+		float videoAspectRatio;
+	};
+	VrState state;
+	state.shader = vrShader.get();
+	state.rotation = settings.currentVrRotation;
+	state.zoom = settings.vrZoom;
+	state.aspectRatio = videoDrawSize.x / videoDrawSize.y;
+	state.videoAspectRatio = MpvData.videoHeight > 0 ? MpvData.videoWidth / (float)MpvData.videoHeight : 0.f;
 	draw_list->AddCallback(
 		[](const ImDrawList* parent_list, const ImDrawCmd* cmd) {
-			auto& ctx = *(VideoplayerWindow*)cmd->UserCallbackData;
+			auto& state = *(const VrState*)cmd->UserCallbackData;
 
-			auto draw_data = ctx.playerViewport->DrawData;
-			ctx.vrShader->use();
+			auto draw_data = OFS_RenderThread::CurrentDrawData();
+			state.shader->use();
 
 			float L = draw_data->DisplayPos.x;
 			float R = draw_data->DisplayPos.x + draw_data->DisplaySize.x;
@@ -487,15 +541,15 @@ void VideoplayerWindow::drawVrVideo(ImDrawList* draw_list) noexcept
 				{ 0.0f, 0.0f, -1.0f, 0.0f },
 				{ (R + L) / (L - R),  (T + B) / (B - T),  0.0f,   1.0f },
 			};
-			ctx.vrShader->ProjMtx(&ortho_projection[0][0]);
-			ctx.vrShader->Rotation(&ctx.settings.currentVrRotation.x);
-			ctx.vrShader->Zoom(ctx.settings.vrZoom);
-			ctx.vrShader->AspectRatio(ctx.videoDrawSize.x / ctx.videoDrawSize.y);
+			state.shader->ProjMtx(&ortho_projection[0][0]);
+			state.shader->Rotation(&state.rotation.x);
+			state.shader->Zoom(state.zoom);
+			state.shader->AspectRatio(state.aspectRatio);
 			// TODO: set this somewhere else get rid of the branch
-			if (ctx.MpvData.videoHeight > 0.f) {
-				ctx.vrShader->VideoAspectRatio(ctx.MpvData.videoWidth /(float)ctx.MpvData.videoHeight);
+			if (state.videoAspectRatio > 0.f) {
+				state.shader->VideoAspectRatio(state.videoAspectRatio);
 			}
-		}, this);
+		}, OFS_FrameArena::Copy(state));
 	//ImGui::Image((void*)(intptr_t)renderTexture, ImGui::GetContentRegionAvail(), ImVec2(0.f, 0.f), ImVec2(1.f, 1.f));
 	OFS::ImageWithId(videoImageId, (void*)(intptr_t)renderTexture, ImGui::GetContentRegionAvail(), ImVec2(0.f, 0.f), ImVec2(1.f, 1.f));
 	videoRightClickMenu();
@@ -553,7 +607,6 @@ void VideoplayerWindow::draw2dVideo(ImDrawList* draw_list) noexcept
 		settings.currentTranslation = settings.prevTranslation + ImGui::GetMouseDragDelta(ImGuiMouseButton_Left);
 	}
 
-	playerViewport = ImGui::GetCurrentWindowRead()->Viewport;
 	OFS::ImageWithId(videoImageId, (void*)(intptr_t)renderTexture, videoSize, uv0, uv1);
 
 	videoRightClickMenu();
@@ -611,7 +664,7 @@ void VideoplayerWindow::DrawVideoPlayer(bool* open, bool* draw_video) noexcept
 		else if(*draw_video) {
 			drawVrVideo(draw_list);
 		}
-		if (OnRenderCallback != nullptr) { draw_list->AddCallback(OnRenderCallback, this); }
+		if (OnRender) { OnRender(draw_list); }
 		// this reset is for the simulator 3d, vr mode or both
 		draw_list->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
 	
@@ -713,6 +766,7 @@ void VideoplayerWindow::setVolume(float volume) noexcept
 void VideoplayerWindow::setPositionPercent(float pos, bool pausesVideo) noexcept
 {
 	MpvData.percentPos = pos;
+	seekCount++;
 	stbsp_snprintf(tmpBuf, sizeof(tmpBuf), "%.08f", (float)(pos * 100.0f));
 	const char* cmd[]{ "seek", tmpBuf, "absolute-percent+exact", NULL };
 	if (pausesVideo) {
@@ -735,9 +789,24 @@ void VideoplayerWindow::setPaused(bool paused) noexcept
 	mpv_set_property_async(mpv, 0, "pause", MPV_FORMAT_FLAG, &MpvData.paused);
 }
 
+void VideoplayerWindow::seekToFrame(int64_t frame) noexcept
+{
+	frame = Util::Clamp<int64_t>(frame, 0, frameIndex->Count() - 1);
+	double time = frameIndex->Pts[frame];
+	MpvData.percentPos = Util::Clamp(time / MpvData.duration, 0.0, 1.0);
+	seekCount++;
+	// mpv shows the first frame within 5ms of the target, the exact pts can't land on a neighbour
+	stbsp_snprintf(tmpBuf, sizeof(tmpBuf), "%.06f", time);
+	const char* cmd[]{ "seek", tmpBuf, "absolute+exact", NULL };
+	mpv_command_async(mpv, 0, cmd);
+}
+
 void VideoplayerWindow::nextFrame() noexcept
 {
-	if (isPaused()) {
+	if (isPaused() && frameIndex) {
+		seekToFrame(getCurrentFrameEstimate() + 1);
+	}
+	else if (isPaused()) {
 		// use same method as previousFrame for consistency
 		double relSeek = getFrameTime() * 1.000001;
 		MpvData.percentPos += (relSeek / MpvData.duration);
@@ -748,7 +817,10 @@ void VideoplayerWindow::nextFrame() noexcept
 
 void VideoplayerWindow::previousFrame() noexcept
 {
-	if (isPaused()) {
+	if (isPaused() && frameIndex) {
+		seekToFrame(getCurrentFrameEstimate() - 1);
+	}
+	else if (isPaused()) {
 		// this seeks much faster
 		// https://github.com/mpv-player/mpv/issues/4019#issuecomment-358641908
 		double relSeek = getFrameTime() * 1.000001;
@@ -760,7 +832,10 @@ void VideoplayerWindow::previousFrame() noexcept
 
 void VideoplayerWindow::relativeFrameSeek(int32_t seek) noexcept
 {
-	if (isPaused()) {
+	if (isPaused() && frameIndex) {
+		seekToFrame(getCurrentFrameEstimate() + seek);
+	}
+	else if (isPaused()) {
 		float relSeek = (getFrameTime() * 1.000001f) * seek;
 		MpvData.percentPos += (relSeek / MpvData.duration);
 		MpvData.percentPos = Util::Clamp(MpvData.percentPos, 0.0, 1.0);
@@ -798,6 +873,8 @@ void VideoplayerWindow::closeVideo() noexcept
 	const char* cmd[] = { "stop", NULL };
 	mpv_command_async(mpv, 0, cmd);
 	MpvData.videoLoaded = false;
+	frameIndex.reset();
+	frameIndexGeneration++;
 	setPaused(true);
 }
 
@@ -813,8 +890,9 @@ int32_t VideoEvents::PlayPauseChanged = 0;
 
 void VideoEvents::RegisterEvents() noexcept
 {
-	MpvVideoLoaded = SDL_RegisterEvents(1);
-	WakeupOnMpvEvents = SDL_RegisterEvents(1);
-	WakeupOnMpvRenderUpdate = SDL_RegisterEvents(1);
-	PlayPauseChanged = SDL_RegisterEvents(1);
+	MpvVideoLoaded = EventSystem::RegisterEvent("MpvVideoLoaded");
+	// the handlers drain everything mpv has, one wakeup per frame is enough
+	WakeupOnMpvEvents = EventSystem::RegisterEvent("WakeupOnMpvEvents", EventCoalesce::LatestWins);
+	WakeupOnMpvRenderUpdate = EventSystem::RegisterEvent("WakeupOnMpvRenderUpdate", EventCoalesce::LatestWins);
+	PlayPauseChanged = EventSystem::RegisterEvent("PlayPauseChanged");
 }
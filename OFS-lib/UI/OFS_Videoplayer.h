@@ -8,6 +8,7 @@
 #include "OFS_Util.h"
 #include "OFS_Shader.h"
 #include "OFS_Localization.h"
+#include "OFS_FrameIndex.h"
 
 #include <string>
 #include <functional>
@@ -44,14 +45,13 @@ public:
 	VideoplayerWindow();
 	~VideoplayerWindow();
 private:
-	mpv_handle* mpv;
-	mpv_render_context* mpv_gl;
+	mpv_handle* mpv = nullptr;
+	mpv_render_context* mpv_gl = nullptr;
 	bool redrawVideo = false;
 	uint32_t framebufferObj = 0;
 	uint32_t renderTexture = 0;
 	char tmpBuf[32];
 	std::unique_ptr<VrShader> vrShader;
-	ImGuiViewport* playerViewport;
 	
 	ImGuiID videoImageId;
 	ImVec2 videoDrawSize;
@@ -61,6 +61,8 @@ private:
 	float lastVideoStep = 0.f;
 	float baseScaleFactor = 1.f;
 	float smoothTime = 0.f;
+	// counts every seek, ours and mpv's own (loops), so followers of the position can tell them from drift
+	uint32_t seekCount = 0;
 	bool correctPlaybackErrorActive = false;
 	bool videoHovered = false;
 	bool dragStarted = false;
@@ -73,6 +75,10 @@ private:
 	};
 	LoopEnum LoopState = LoopEnum::Clear;
 
+	std::shared_ptr<OFS_FrameIndex> frameIndex;
+	// bumped for every video, an index which finishes late gets dropped
+	uint32_t frameIndexGeneration = 0;
+
 	enum MpvPropertyGet : uint64_t {
 		MpvDuration,
 		MpvPosition,
@@ -124,6 +130,8 @@ private:
 	void setupVrMode() noexcept;
 
 	void notifyVideoLoaded() noexcept;
+	void buildFrameIndex() noexcept;
+	void seekToFrame(int64_t frame) noexcept;
 
 	void drawVrVideo(ImDrawList* draw_list) noexcept;
 	void draw2dVideo(ImDrawList* draw_list) noexcept;
@@ -135,7 +143,8 @@ public:
 	ImVec2 TranslateMouse(ImVec2 pos);
 	static constexpr const char* PlayerId = "Player";
 	static constexpr const char* WindowId = "###VIDEOPLAYER";
-	ImDrawCallback OnRenderCallback = nullptr;
+	// adds draw callbacks right after the video
+	std::function<void(ImDrawList*)> OnRender;
 	std::vector<std::function<void(void)>> renderCallbacks;
 
 	struct OFS_VideoPlayerSettings {
@@ -193,6 +202,9 @@ public:
 
 	OFS_VideoPlayerSettings settings;
 
+	// creates and initializes mpv without gl or events, safe on any thread
+	bool createMpv(bool force_hw_decoding) noexcept;
+	// main thread, creates mpv first if createMpv wasn't called
 	bool setup(bool force_hw_decoding);
 	void DrawVideoPlayer(bool* open, bool* draw_video) noexcept;
 
@@ -276,11 +288,17 @@ public:
 	inline float getFrameTime() const noexcept { return MpvData.averageFrameTime; }
 
 	inline float getSpeed() const noexcept { return MpvData.currentSpeed; }
+	inline uint32_t getSeekCount() const noexcept { return seekCount; }
 	inline double getDuration() const noexcept { return MpvData.duration; }
 	inline int64_t getTotalNumFrames() const  noexcept { return MpvData.totalNumFrames; }
 	inline bool isPaused() const noexcept { return MpvData.paused; };
 	inline float getPosition() const noexcept { return MpvData.percentPos; }
-	inline int64_t getCurrentFrameEstimate() const noexcept { return MpvData.percentPos * MpvData.totalNumFrames; }
+	inline int64_t getCurrentFrameEstimate() const noexcept {
+		if (frameIndex) return frameIndex->FrameAt(getCurrentPositionSeconds());
+		return Util::Clamp<int64_t>(MpvData.percentPos * MpvData.totalNumFrames, 0, std::max<int64_t>(MpvData.totalNumFrames - 1, 0));
+	}
+	// nullptr until the index of the current video is ready or if it can't be indexed
+	inline const OFS_FrameIndex* getFrameIndex() const noexcept { return frameIndex.get(); }
 	inline float getFps() const noexcept { return MpvData.fps; }
 	inline bool isLoaded() const noexcept { return MpvData.videoLoaded; }
 	
@@ -2,24 +2,63 @@
 #include "OFS_Util.h"
 #include "OFS_Profiling.h"
 #include "OFS_ImGui.h"
+#include "OFS_GL.h"
+#include "OFS_RenderThread.h"
 #include "SDL_timer.h"
+
+#include <vector>
+
 static char tmp_buf[2][32];
 
 void OFS_VideoplayerControls::VideoLoaded(SDL_Event& ev) noexcept
 {
     OFS_PROFILE(__FUNCTION__);
     if (ev.user.data1 != nullptr) {
-        videoPreview->previewVideo((const char*)ev.user.data1, 0.f);
+        previewPath = (const char*)ev.user.data1;
+        if (videoPreview) videoPreview->previewVideo(previewPath, 0.f);
     }
 }
 
 void OFS_VideoplayerControls::setup() noexcept
 {
-    videoPreview = std::make_unique<VideoPreview>();
-    videoPreview->setup(false);
+    // the preview itself gets created once the timeline is hovered
+    VideoPreviewEvents::RegisterEvents();
     EventSystem::ev().Subscribe(VideoEvents::MpvVideoLoaded, EVENT_SYSTEM_BIND(this, &OFS_VideoplayerControls::VideoLoaded));
 }
 
+void OFS_VideoplayerControls::uploadHeatmap() noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    if (heatmapTexture.Id == 0) {
+        heatmapTexture = OFS_Texture::CreateTexture();
+        uint32_t texId = 0;
+        glGenTextures(1, &texId);
+        glBindTexture(GL_TEXTURE_2D, texId);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        heatmapTexture.SetTexId(texId);
+    }
+
+    // the shadow is a black row above the colors
+    // linear filtering between both rows fades from black to the heatmap
+    std::vector<uint32_t> pixels(HeatmapTextureWidth * 2, IM_COL32(0, 0, 0, 255));
+    ImColor color(0.f, 0.f, 0.f, 1.f);
+    for (int32_t i = 0; i < HeatmapTextureWidth; ++i) {
+        Heatmap.Gradient.computeColorAt((i + 0.5f) / HeatmapTextureWidth, &color.Value.x);
+        pixels[HeatmapTextureWidth + i] = ImGui::ColorConvertFloat4ToU32(color);
+    }
+
+    // the render thread might still draw last frame's heatmap
+    OFS_RenderThread::Enqueue([texture = heatmapTexture.GetTexId(), pixels = std::move(pixels)]() {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, HeatmapTextureWidth, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    });
+    heatmapDirty = false;
+}
+
 bool OFS_VideoplayerControls::DrawTimelineWidget(const char* label, float* position, TimelineCustomDrawFunc&& customDraw) noexcept
 {
     OFS_PROFILE(__FUNCTION__);
@@ -66,12 +105,13 @@ bool OFS_VideoplayerControls::DrawTimelineWidget(const char* label, float* posit
     draw_list->AddLine(p1 + ImVec2(0.f, h / 3.f), p2 + ImVec2(0.f, h / 3.f), IM_COL32(255, 0, 0, 255), timeline_pos_cursor_w / 2.f);
 
     // gradient + shadow
-    ImGradient::DrawGradientBar(&Heatmap.Gradient, frame_bb.Min, frame_bb.GetWidth(), frame_bb.GetHeight());
-    draw_list->AddRectFilledMultiColor(frame_bb.Min, frame_bb.Max, 
-        IM_COL32(0, 0, 0, 255),
-        IM_COL32(0, 0, 0, 255),
-        IM_COL32(0, 0, 0, 0),
-        IM_COL32(0, 0, 0, 0));
+    if (heatmapDirty) {
+        uploadHeatmap();
+    }
+    draw_list->AddRectFilled(frame_bb.Min - ImVec2(2.f, 2.f), frame_bb.Max + ImVec2(2.f, 2.f), IM_COL32(100, 100, 100, 255));
+    // v from the center of the shadow row to the center of the color row
+    draw_list->AddImage((void*)(intptr_t)heatmapTexture.GetTexId(), frame_bb.Min, frame_bb.Max, ImVec2(0.f, 0.25f), ImVec2(1.f, 0.75f));
+    ImGui::SetCursorScreenPos(ImVec2(frame_bb.Min.x, frame_bb.Max.y + 10.f));
 
     const ImColor timeline_cursor_back = IM_COL32(255, 255, 255, 255);
     const ImColor timeline_cursor_front = IM_COL32(0, 0, 0, 255);
@@ -94,6 +134,11 @@ bool OFS_VideoplayerControls::DrawTimelineWidget(const char* label, float* posit
                 dragging = true;
             }
 
+            if (!videoPreview) {
+                videoPreview = std::make_unique<VideoPreview>();
+                videoPreview->setup(false);
+                if (!previewPath.empty()) videoPreview->previewVideo(previewPath, relTimelinePos);
+            }
             videoPreview->update();
             if (SDL_GetTicks() - lastPreviewUpdate >= PreviewUpdateMs) {
                 videoPreview->setPosition(relTimelinePos);
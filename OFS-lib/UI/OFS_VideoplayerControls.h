@@ -4,7 +4,10 @@
 #include "GradientBar.h"
 #include "OFS_Videopreview.h"
 #include "FunscriptHeatmap.h"
+#include "OFS_Texture.h"
+#include "EventSystem.h"
 
+#include <string>
 #include <functional>
 
 // ImDrawList* draw_list, const ImRect& frame_bb, bool item_hovered
@@ -23,8 +26,17 @@ private:
 	
 	static constexpr int32_t PreviewUpdateMs = 1000;
 	uint32_t lastPreviewUpdate = 0;
+	// the video the preview loads once it exists
+	std::string previewPath;
+
+	// the heatmap only gets rasterized when the speeds change
+	// row 0 is the shadow, row 1 the heatmap colors
+	static constexpr int32_t HeatmapTextureWidth = 1024;
+	OFS_Texture::Handle heatmapTexture;
+	bool heatmapDirty = true;
 
 	void VideoLoaded(SDL_Event& ev) noexcept;
+	void uploadHeatmap() noexcept;
 public:
 	static constexpr const char* ControlId = "###CONTROLS";
 	static constexpr const char* TimeId = "###TIME";
@@ -34,11 +46,23 @@ public:
 
 	OFS_VideoplayerControls() noexcept {}
 	void setup() noexcept;
-	inline void Destroy() noexcept { videoPreview.reset(); }
+	inline void Destroy() noexcept { videoPreview.reset(); heatmapTexture = OFS_Texture::Handle(); }
+	inline void ClosePreview() noexcept
+	{
+		previewPath.clear();
+		if (videoPreview) videoPreview->closeVideo();
+	}
 
 	inline void UpdateHeatmap(float totalDuration, const FunscriptArray& actions) noexcept
 	{
 		Heatmap.Update(totalDuration, actions);
+		heatmapDirty = true;
+	}
+
+	inline void UpdateHeatmap(float totalDuration, const FunscriptArray& actions, const EventRange& range) noexcept
+	{
+		Heatmap.Update(totalDuration, actions, range.begin, range.end);
+		heatmapDirty = true;
 	}
 
 	bool DrawTimelineWidget(const char* label, float* position, TimelineCustomDrawFunc&& customDraw) noexcept;
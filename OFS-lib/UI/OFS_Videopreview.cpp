@@ -5,6 +5,8 @@
 
 #include "OFS_GL.h"
 #include "EventSystem.h"
+#include "OFS_RenderThread.h"
+#include "OFS_Profiling.h"
 
 #define OFS_MPV_LOADER_MACROS
 #include "OFS_MpvLoader.h"
@@ -15,8 +17,8 @@ int32_t VideoPreviewEvents::PreviewWakeUpMpvRender = 0;
 void VideoPreviewEvents::RegisterEvents() noexcept
 {
 	if (PreviewWakeUpMpvEvents != 0) return;
-	PreviewWakeUpMpvEvents = SDL_RegisterEvents(1);
-	PreviewWakeUpMpvRender = SDL_RegisterEvents(1);
+	PreviewWakeUpMpvEvents = EventSystem::RegisterEvent("PreviewWakeUpMpvEvents", EventCoalesce::LatestWins);
+	PreviewWakeUpMpvRender = EventSystem::RegisterEvent("PreviewWakeUpMpvRender", EventCoalesce::LatestWins);
 }
 
 static void* get_proc_address_mpv(void* fn_ctx, const char* name)
@@ -36,10 +38,8 @@ static void on_mpv_render_update(void* ctx)
 
 void VideoPreview::updateRenderTexture() noexcept
 {
-	if (framebufferObj == 0) {
-		glGenFramebuffers(1, &framebufferObj);
-		glBindFramebuffer(GL_FRAMEBUFFER, framebufferObj);
-
+	if (renderTexture == 0) {
+		// shared with the render thread which attaches it to the framebuffer
 		glGenTextures(1, &renderTexture);
 		glBindTexture(GL_TEXTURE_2D, renderTexture);
 		
@@ -49,25 +49,62 @@ void VideoPreview::updateRenderTexture() noexcept
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		
-		// Set "renderedTexture" as our colour attachement #0
-		glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, renderTexture, 0);
-
-		// Set the list of draw buffers.
-		GLenum DrawBuffers[1] = { GL_COLOR_ATTACHMENT0 };
-		glDrawBuffers(1, DrawBuffers);
-
-		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-			LOG_ERROR("Failed to create framebuffer for video!");
-		}
 	}
 	else {
 		// update size of render texture based on video resolution
-		glBindTexture(GL_TEXTURE_2D, renderTexture);
-		glTexImage2D(GL_TEXTURE_2D, 0, OFS_InternalTexFormat, videoWidth, videoHeight, 0, OFS_TexFormat, GL_UNSIGNED_BYTE, 0);
+		OFS_RenderThread::Enqueue([texture = renderTexture, width = videoWidth, height = videoHeight]() {
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, OFS_InternalTexFormat, width, height, 0, OFS_TexFormat, GL_UNSIGNED_BYTE, 0);
+		});
 	}
 }
 
+void VideoPreview::createRenderContext() noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	glGenFramebuffers(1, &framebufferObj);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferObj);
+
+	// Set "renderedTexture" as our colour attachement #0
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, renderTexture, 0);
+
+	// Set the list of draw buffers.
+	GLenum DrawBuffers[1] = { GL_COLOR_ATTACHMENT0 };
+	glDrawBuffers(1, DrawBuffers);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		LOG_ERROR("Failed to create framebuffer for video!");
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	mpv_opengl_init_params init_params{ 0 };
+	init_params.get_proc_address = get_proc_address_mpv;
+
+	const int enable = 1;
+	mpv_render_param params[] = {
+		mpv_render_param{MPV_RENDER_PARAM_API_TYPE, (void*)MPV_RENDER_API_TYPE_OPENGL},
+		mpv_render_param{MPV_RENDER_PARAM_OPENGL_INIT_PARAMS, &init_params},
+
+		// Tell libmpv that you will call mpv_render_context_update() on render
+		// context update callbacks, and that you will _not_ block on the core
+		// ever (see <libmpv/render.h> "Threading" section for what libmpv
+		// functions you can call at all when this is active).
+		// In particular, this means you must call e.g. mpv_command_async()
+		// instead of mpv_command().
+		// If you want to use synchronous calls, either make them on a separate
+		// thread, or remove the option below (this will disable features like
+		// DR and is not recommended anyway).
+		mpv_render_param{MPV_RENDER_PARAM_ADVANCED_CONTROL, (void*)&enable },
+		mpv_render_param{}
+	};
+	if (mpv_render_context_create(&mpv_gl, mpv, params) < 0) {
+		LOG_ERROR("failed to initialize mpv GL context");
+		mpv_gl = nullptr;
+		return;
+	}
+	mpv_render_context_set_update_callback(mpv_gl, on_mpv_render_update, this);
+}
+
 void VideoPreview::observeProperties() noexcept
 {
 	mpv_observe_property(mpv, VideoHeightProp, "height", MPV_FORMAT_INT64);
@@ -79,20 +116,28 @@ void VideoPreview::redraw() noexcept
 {
 	OFS_PROFILE(__FUNCTION__);
 	needsRedraw = false;
-	mpv_opengl_fbo fbo{ 0 };
-	fbo.fbo = framebufferObj;
-	fbo.w = videoWidth;
-	fbo.h = videoHeight;
-	fbo.internal_format = OFS_InternalTexFormat;
-
-	uint32_t disable = 0;
-	mpv_render_param params[] = {
-		{MPV_RENDER_PARAM_OPENGL_FBO, &fbo},
-		// without this the whole application slows down to the framerate of the video
-		{MPV_RENDER_PARAM_BLOCK_FOR_TARGET_TIME, &disable},
-		mpv_render_param{}
-	};
-	mpv_render_context_render(mpv_gl, params);
+	// same as the player, the render context and the framebuffer belong to the render thread
+	OFS_RenderThread::Enqueue([this, width = videoWidth, height = videoHeight]() {
+		OFS_PROFILE("VideoPreview::redraw");
+		if (mpv_gl == nullptr) return;
+		uint64_t flags = mpv_render_context_update(mpv_gl);
+		if (!(flags & MPV_RENDER_UPDATE_FRAME)) return;
+
+		mpv_opengl_fbo fbo{ 0 };
+		fbo.fbo = framebufferObj;
+		fbo.w = width;
+		fbo.h = height;
+		fbo.internal_format = OFS_InternalTexFormat;
+
+		uint32_t disable = 0;
+		mpv_render_param params[] = {
+			{MPV_RENDER_PARAM_OPENGL_FBO, &fbo},
+			// without this the whole application slows down to the framerate of the video
+			{MPV_RENDER_PARAM_BLOCK_FOR_TARGET_TIME, &disable},
+			mpv_render_param{}
+		};
+		mpv_render_context_render(mpv_gl, params);
+	});
 	if (videoPos >= seek_to) {
 		if (renderComplete) {
 			ready = true;
@@ -103,7 +148,7 @@ void VideoPreview::redraw() noexcept
 
 VideoPreview::~VideoPreview()
 {
-	mpv_render_context_free(mpv_gl);
+	if (mpv_gl) mpv_render_context_free(mpv_gl);
 	mpv_destroy(mpv);
 	EventSystem::ev().UnsubscribeAll(this);
 	
@@ -113,6 +158,7 @@ VideoPreview::~VideoPreview()
 
 void VideoPreview::setup(bool autoplay) noexcept
 {
+	OFS_PROFILE(__FUNCTION__);
 	VideoPreviewEvents::RegisterEvents();
 	EventSystem::ev().Subscribe(VideoPreviewEvents::PreviewWakeUpMpvEvents, EVENT_SYSTEM_BIND(this, &VideoPreview::MpvEvents));
 	EventSystem::ev().Subscribe(VideoPreviewEvents::PreviewWakeUpMpvRender, EVENT_SYSTEM_BIND(this, &VideoPreview::MpvRenderUpdate));
@@ -128,33 +174,9 @@ void VideoPreview::setup(bool autoplay) noexcept
 	bool suc = mpv_set_property_string(mpv, "keep-open", "yes") == 0;
 	suc = mpv_set_property_string(mpv, "loop-file", "inf") == 0;
 	
-	mpv_opengl_init_params init_params{ 0 };
-	init_params.get_proc_address = get_proc_address_mpv;
-
-	const int enable = 1;
-	mpv_render_param params[] = {
-		mpv_render_param{MPV_RENDER_PARAM_API_TYPE, (void*)MPV_RENDER_API_TYPE_OPENGL},
-		mpv_render_param{MPV_RENDER_PARAM_OPENGL_INIT_PARAMS, &init_params},
-
-		// Tell libmpv that you will call mpv_render_context_update() on render
-		// context update callbacks, and that you will _not_ block on the core
-		// ever (see <libmpv/render.h> "Threading" section for what libmpv
-		// functions you can call at all when this is active).
-		// In particular, this means you must call e.g. mpv_command_async()
-		// instead of mpv_command().
-		// If you want to use synchronous calls, either make them on a separate
-		// thread, or remove the option below (this will disable features like
-		// DR and is not recommended anyway).
-		mpv_render_param{MPV_RENDER_PARAM_ADVANCED_CONTROL, (void*)&enable },
-		mpv_render_param{}
-	};
-	if (mpv_render_context_create(&mpv_gl, mpv, params) < 0) {
-		LOG_ERROR("failed to initialize mpv GL context");
-		return;
-	}
-
 	mpv_set_wakeup_callback(mpv, on_mpv_events, this);
-	mpv_render_context_set_update_callback(mpv_gl, on_mpv_render_update, this);
+	// the preview gets created long after startup, neither fbos nor render contexts are shared
+	OFS_RenderThread::Enqueue([this]() { createRenderContext(); });
 
 	if (autoplay)
 	{
@@ -256,11 +278,8 @@ void VideoPreview::MpvEvents(SDL_Event& ev) noexcept
 void VideoPreview::MpvRenderUpdate(SDL_Event& ev) noexcept
 {
 	if (ev.user.data1 != this) return;
-	OFS_PROFILE(__FUNCTION__);
-	uint64_t flags = mpv_render_context_update(mpv_gl);
-	if (flags & MPV_RENDER_UPDATE_FRAME) {
-		needsRedraw = true;
-	}
+	// mpv_render_context_update happens on the render thread together with the render
+	needsRedraw = true;
 }
 
 
@@ -19,6 +19,8 @@ class VideoPreview {
 private:
 	char tmp_buf[32];
 	void updateRenderTexture() noexcept;
+	// render thread
+	void createRenderContext() noexcept;
 	void observeProperties() noexcept;
 	float seek_to = 0.f;
 
@@ -37,10 +39,11 @@ private:
 	bool needsRedraw = false;
 	void redraw() noexcept;
 public:
-	mpv_handle* mpv;
-	mpv_render_context* mpv_gl;
-
+	mpv_handle* mpv = nullptr;
+	// both only get touched on the render thread
+	mpv_render_context* mpv_gl = nullptr;
 	uint32_t framebufferObj = 0;
+
 	uint32_t renderTexture = 0;
 
 	bool ready = false;
@@ -2,6 +2,7 @@
 #include "OFS_Util.h"
 #include "OFS_Profiling.h"
 #include "OFS_GL.h"
+#include "OFS_RenderThread.h"
 #include "OFS_ScriptTimeline.h"
 
 #define DR_FLAC_IMPLEMENTATION
@@ -200,7 +201,11 @@ void OFS_WaveformLOD::Update(const OverlayDrawingCtx& ctx) noexcept
 void OFS_WaveformLOD::Upload() noexcept
 {
 	OFS_PROFILE(__FUNCTION__);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_1D, WaveformTex);
-	glTexImage1D(GL_TEXTURE_1D, 0, GL_R32F, WaveformLineBuffer.size(), 0, GL_RED, GL_FLOAT, WaveformLineBuffer.data());
+	// the render thread might still sample the old lines
+	OFS_RenderThread::Enqueue([texture = WaveformTex, lines = WaveformLineBuffer]() {
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_1D, texture);
+		glTexImage1D(GL_TEXTURE_1D, 0, GL_R32F, lines.size(), 0, GL_RED, GL_FLOAT, lines.data());
+		glActiveTexture(GL_TEXTURE0);
+	});
 }
\ No newline at end of file
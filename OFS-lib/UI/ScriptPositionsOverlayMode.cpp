@@ -3,14 +3,17 @@
 #include "OFS_Profiling.h"
 #include "OFS_Localization.h"
 #include "FunscriptHeatmap.h"
+#include "OFS_ActionRenderer.h"
 
 #include <cmath>
+#include <algorithm>
 
 ImGradient BaseOverlay::speedGradient;
-std::vector<BaseOverlay::ColoredLine> BaseOverlay::ColoredLines;
-std::vector<ImVec2> BaseOverlay::SelectedActionScreenCoordinates;
-std::vector<ImVec2> BaseOverlay::ActionScreenCoordinates;
-std::vector<FunscriptAction> BaseOverlay::ActionPositionWindow;
+OFS_FrameVector<BaseOverlay::ColoredLine> BaseOverlay::ColoredLines;
+OFS_FrameVector<ImVec2> BaseOverlay::SelectedActionScreenCoordinates;
+OFS_FrameVector<ImVec2> BaseOverlay::ActionScreenCoordinates;
+OFS_FrameVector<BaseOverlay::ScreenCoordinateRange> BaseOverlay::ActionScreenRanges;
+OFS_FrameVector<FunscriptAction> BaseOverlay::ActionPositionWindow;
 float BaseOverlay::PointSize = 7.f;
 bool BaseOverlay::SplineMode = true;
 bool BaseOverlay::ShowActions = true;
@@ -45,9 +48,31 @@ BaseOverlay::BaseOverlay(ScriptTimeline* timeline) noexcept
 void BaseOverlay::update() noexcept
 {
     OFS_PROFILE(__FUNCTION__);
-    ActionScreenCoordinates.clear();
-    ActionPositionWindow.clear();
-    SelectedActionScreenCoordinates.clear();
+    // the storage from the last frame still belongs to the frame arena
+    OFS_RenewFrameVector(ActionScreenCoordinates);
+    OFS_RenewFrameVector(ActionPositionWindow);
+    OFS_RenewFrameVector(ActionScreenRanges);
+    OFS_RenewFrameVector(SelectedActionScreenCoordinates);
+    OFS_RenewFrameVector(ColoredLines);
+}
+
+int32_t BaseOverlay::HitTestAction(ImVec2 point, float radius, int32_t scriptIdx) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    const ImRect hitRect(point - ImVec2(radius, radius), point + ImVec2(radius, radius));
+    for (auto& range : ActionScreenRanges) {
+        if (range.scriptIdx != scriptIdx) continue;
+        auto begin = ActionScreenCoordinates.begin() + range.begin;
+        auto end = ActionScreenCoordinates.begin() + range.end;
+        auto it = std::lower_bound(begin, end, hitRect.Min.x,
+            [](const ImVec2& p, float x) noexcept { return p.x < x; });
+        for (; it != end && it->x <= hitRect.Max.x; ++it) {
+            if (hitRect.Contains(*it)) {
+                return std::distance(ActionScreenCoordinates.begin(), it);
+            }
+        }
+    }
+    return -1;
 }
 
 void BaseOverlay::DrawSettings() noexcept
@@ -72,18 +97,6 @@ float EmptyOverlay::steppingIntervalBackward(float fromTime) noexcept
     return -timeline->frameTime;
 }
 
-static void getActionLineColor(ImColor* speedColor, ImGradient& speedGradient, FunscriptAction action, FunscriptAction prevAction) noexcept
-{
-    float speed = std::abs(action.pos - prevAction.pos) / ((action.atS - prevAction.atS));
-    float relSpeed = Util::Clamp<float>(speed / HeatmapGradient::MaxSpeedPerSecond, 0.f, 1.f);
-    if(BaseOverlay::ShowMaxSpeedHighlight && speed >= BaseOverlay::MaxSpeedPerSecond) {
-        *speedColor = BaseOverlay::MaxSpeedColor;
-        return;
-    }
-    speedGradient.getColorAt(relSpeed, &speedColor->Value.x);
-    speedColor->Value.w = 1.f;
-}
-
 void BaseOverlay::DrawActionLines(const OverlayDrawingCtx& ctx) noexcept
 {
     if (!BaseOverlay::ShowActions) return;
@@ -181,60 +194,26 @@ void BaseOverlay::DrawActionLines(const OverlayDrawingCtx& ctx) noexcept
         }
     };
 
-    auto drawLine = [](const OverlayDrawingCtx& ctx, ImVec2 p1, ImVec2 p2, uint32_t color) noexcept
-    {
-        ctx.draw_list->AddLine(p1, p2, IM_COL32(0, 0, 0, 255), 7.0f); // border
-        ColoredLines.emplace_back(std::move(BaseOverlay::ColoredLine{ p1, p2, color }));
-    };
-
-    if (SplineMode) {
-        const FunscriptAction* prevAction = nullptr;
-        for (; startIt != endIt; startIt++) {
-            auto& action = *startIt;
-            auto p1 = getPointForAction(ctx, action);
-            ActionScreenCoordinates.emplace_back(p1);
-            ActionPositionWindow.emplace_back(action);
-
-            if (prevAction != nullptr) {
-                // calculate speed relative to maximum speed
-                ImColor speedColor;
-                getActionLineColor(&speedColor, speedGradient, action, *prevAction);
-                drawSpline(ctx, *prevAction, action, ImGui::ColorConvertFloat4ToU32(speedColor), 3.f);
-            }
-            prevAction = &action;
-        }
-    }
-    else {
-        const FunscriptAction* prevAction = nullptr;
-        for (; startIt != endIt; startIt++) {
-            auto& action = *startIt;
-
-            auto p1 = getPointForAction(ctx, action);
-            ActionScreenCoordinates.emplace_back(p1);
-            ActionPositionWindow.emplace_back(action);
-
-            if (prevAction != nullptr) {
-                // draw line
-                auto p2 = getPointForAction(ctx, *prevAction);
-                // calculate speed relative to maximum speed
-                ImColor speedColor;
-                getActionLineColor(&speedColor, speedGradient, action, *prevAction);
-                drawLine(ctx, p1, p2, ImGui::ColorConvertFloat4ToU32(speedColor));
-            }
-
-            prevAction = &action;
-        }
-
+    // lines and points are drawn on the gpu
+    // only collect screen coordinates for hit testing
+    ctx.actionRenderer->DrawLines(ctx);
+    ScreenCoordinateRange range;
+    range.scriptIdx = ctx.scriptIdx;
+    range.begin = ActionScreenCoordinates.size();
+    for (; startIt != endIt; startIt++) {
+        auto& action = *startIt;
+        ActionScreenCoordinates.emplace_back(getPointForAction(ctx, action));
+        ActionPositionWindow.emplace_back(action);
     }
+    range.end = ActionScreenCoordinates.size();
+    if (range.end > range.begin) { ActionScreenRanges.emplace_back(range); }
 
     if (script.HasSelection()) {
-        auto startIt = std::find_if(script.Selection().begin(), script.Selection().end(),
-            [&](auto act) { return act.atS >= ctx.offsetTime; });
+        auto startIt = script.Selection().lower_bound(FunscriptAction(ctx.offsetTime, 0));
         if (startIt != script.Selection().begin())
             startIt -= 1;
 
-        auto endIt = std::find_if(startIt, script.Selection().end(),
-            [&](auto act) { return act.atS >= ctx.offsetTime + ctx.visibleTime; });
+        auto endIt = script.Selection().lower_bound(FunscriptAction(ctx.offsetTime + ctx.visibleTime, 0));
         if (endIt != script.Selection().end())
             endIt += 1;
 
@@ -6,6 +6,7 @@
 #include "imgui.h"
 #include "imgui_internal.h"
 #include "GradientBar.h"
+#include "OFS_Allocator.h"
 
 struct OverlayDrawingCtx {
 	Funscript* script;
@@ -19,6 +20,7 @@ struct OverlayDrawingCtx {
 	float totalDuration;
 	ImVec2 canvas_pos;
 	ImVec2 canvas_size;
+	class OFS_ActionRenderer* actionRenderer;
 };
 
 class BaseOverlay {
@@ -30,11 +32,24 @@ public:
 		ImVec2 p2;
 		uint32_t color;
 	};
-	static std::vector<ColoredLine> ColoredLines;
-	static std::vector<FunscriptAction> ActionPositionWindow;
-	static std::vector<ImVec2> SelectedActionScreenCoordinates;
-	static std::vector<ImVec2> ActionScreenCoordinates;
+	// frame scratch, valid until the end of the next frame so mouse events can hit test against it
+	static OFS_FrameVector<ColoredLine> ColoredLines;
+	static OFS_FrameVector<FunscriptAction> ActionPositionWindow;
+	static OFS_FrameVector<ImVec2> SelectedActionScreenCoordinates;
+	static OFS_FrameVector<ImVec2> ActionScreenCoordinates;
 	static float PointSize;
+
+	// the coordinates of every drawn script are sorted along the x axis
+	// which allows hit testing them with a binary search
+	struct ScreenCoordinateRange {
+		int32_t scriptIdx;
+		int32_t begin;
+		int32_t end;
+	};
+	static OFS_FrameVector<ScreenCoordinateRange> ActionScreenRanges;
+	// returns an index into ActionScreenCoordinates or -1
+	// only points of scriptIdx get tested, the scripts are drawn in separate lanes
+	static int32_t HitTestAction(ImVec2 point, float radius, int32_t scriptIdx) noexcept;
 	
 	static bool ShowMaxSpeedHighlight;
 	static float MaxSpeedPerSecond;
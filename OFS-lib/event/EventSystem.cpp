@@ -1,97 +1,220 @@
 #include "EventSystem.h"
+#include "OFS_Localization.h"
+
+#include "SDL_timer.h"
+#include "imgui.h"
 
 EventSystem* EventSystem::instance = nullptr;
 
-int32_t EventSystem::SingleShotEvent = 0;
-int32_t EventSystem::WaitableSingleShotEvent = 0;
+void EventSystem::setup() noexcept
+{
+	FUN_ASSERT(instance == nullptr, "only one instance");
+	instance = this;
+}
+
+EventSystem::EventSlot& EventSystem::slot(uint32_t type) noexcept
+{
+	FUN_ASSERT(type < 0x10000, "invalid event type");
+	auto& page = slots[type / SlotPageSize];
+	if (!page) {
+		page = std::make_unique<EventSlotPage>();
+	}
+	return (*page)[type % SlotPageSize];
+}
 
-void EventSystem::SingleShotHandler(SDL_Event& ev) noexcept
+void EventSystem::dispatch(EventSlot& slot, SDL_Event& event) noexcept
+{
+	auto start = SDL_GetPerformanceCounter();
+	// indexed because handlers are allowed to subscribe and unsubscribe
+	for (size_t i = 0; i < slot.handlers.size(); i++) {
+		slot.handlers[i].func(event);
+	}
+	auto ticks = SDL_GetPerformanceCounter() - start;
+
+	slot.stats.delivered++;
+	slot.stats.handlerTicks += ticks;
+	slot.stats.maxHandlerTicks = std::max(slot.stats.maxHandlerTicks, ticks);
+}
+
+void EventSystem::enqueue(const SDL_Event& event, const EventRange& range, EventCoalesce coalesce) noexcept
+{
+	// there are only ever a handful pending
+	auto it = std::find_if(pending.begin(), pending.end(),
+		[&event](auto& p) {
+			return p.event.type == event.type && p.event.user.data1 == event.user.data1;
+		});
+	if (it == pending.end()) {
+		pending.emplace_back(PendingEvent{ event, range });
+	}
+	else if (coalesce == EventCoalesce::MergeRanges) {
+		it->range.Merge(range);
+	}
+	else {
+		it->event = event;
+	}
+}
+
+void EventSystem::Propagate(SDL_Event& event) noexcept
 {
 	OFS_PROFILE(__FUNCTION__);
-	SingleShotEventData* data = (SingleShotEventData*)ev.user.data1;
-	data->handler(data->ctx);
-	delete data;
+	auto slot = findSlot(event.type);
+	if (slot == nullptr) return;
+	slot->stats.received++;
+
+	if (slot->coalesce != EventCoalesce::None) {
+		enqueue(event, EventRange::All(), slot->coalesce);
+		return;
+	}
+	dispatch(*slot, event);
 }
 
-void EventSystem::WaitableSingleShotHandler(SDL_Event& ev) noexcept
+void EventSystem::DeliverCoalesced() noexcept
 {
+	if (pending.empty()) return;
 	OFS_PROFILE(__FUNCTION__);
-	WaitableSingleShotEventData* data = (WaitableSingleShotEventData*)ev.user.data1;
-	data->handler(data->ctx);
-	SDL_SemPost(data->waitSemaphore);
-	// gets deleted by the waiting thread
+	// events posted by the handlers get delivered next frame
+	delivering.swap(pending);
+	for (auto& p : delivering) {
+		auto& slot = *findSlot(p.event.type);
+		if (slot.coalesce == EventCoalesce::MergeRanges) {
+			p.event.user.data2 = &p.range;
+		}
+		dispatch(slot, p.event);
+	}
+	delivering.clear();
 }
 
-void EventSystem::setup() noexcept
+void EventSystem::Post(int32_t type, void* user1, const EventRange& range) noexcept
 {
-	FUN_ASSERT(instance == nullptr, "only one instance");
-	instance = this;
-	SingleShotEvent = SDL_RegisterEvents(1);
-	WaitableSingleShotEvent = SDL_RegisterEvents(1);
-	Subscribe(SingleShotEvent, EVENT_SYSTEM_BIND(this, &EventSystem::SingleShotHandler));
-	Subscribe(WaitableSingleShotEvent, EVENT_SYSTEM_BIND(this, &EventSystem::WaitableSingleShotHandler));
+	FUN_ASSERT(Util::InMainThread(), "main thread only");
+	auto& slot = this->slot(type);
+	slot.stats.received++;
+
+	SDL_Event ev;
+	ev.type = type;
+	ev.user.timestamp = SDL_GetTicks();
+	ev.user.data1 = user1;
+	ev.user.data2 = nullptr;
+	if (slot.coalesce != EventCoalesce::None) {
+		enqueue(ev, range, slot.coalesce);
+	}
+	else {
+		if (type >= SDL_USEREVENT) ev.user.data2 = (void*)&range;
+		dispatch(slot, ev);
+	}
 }
 
 void EventSystem::Subscribe(int32_t eventType, void* listener, EventHandlerFunc&& handler) noexcept
 {
 	// this excects the listener to never relocate
-	handlers.emplace_back(eventType, listener, std::move(handler));
+	slot(eventType).handlers.emplace_back(listener, std::move(handler));
 }
 
 void EventSystem::Unsubscribe(int32_t eventType, void* listener) noexcept
 {
 	// this excects the listener to never relocate
-	auto it = std::find_if(handlers.begin(), handlers.end(),
-		[eventType, listener](auto& handler) {
-			return handler.listener == listener && handler.eventType == eventType;
-	});
+	auto slot = findSlot(eventType);
+	if (slot != nullptr) {
+		auto& handlers = slot->handlers;
+		auto it = std::find_if(handlers.begin(), handlers.end(),
+			[listener](auto& handler) {
+				return handler.listener == listener;
+		});
 
-	if (it != handlers.end()) {
-		handlers.erase(it);
-	}
-	else {
-		LOGF_ERROR("Failed to unsubscribe event. \"%d\"", eventType);
-		FUN_ASSERT(false, "please investigate");
+		if (it != handlers.end()) {
+			handlers.erase(it);
+			return;
+		}
 	}
+	LOGF_ERROR("Failed to unsubscribe event. \"%d\"", eventType);
+	FUN_ASSERT(false, "please investigate");
 }
 
 void EventSystem::UnsubscribeAll(void* listener) noexcept
 {
-	auto it = handlers.erase(std::remove_if(handlers.begin(), handlers.end(),
-		[listener](auto&& h) {
-			return h.listener == listener;
-		}), handlers.end());
+	for (auto& page : slots) {
+		if (!page) continue;
+		for (auto& slot : *page) {
+			auto& handlers = slot.handlers;
+			handlers.erase(std::remove_if(handlers.begin(), handlers.end(),
+				[listener](auto&& h) {
+					return h.listener == listener;
+				}), handlers.end());
+		}
+	}
 }
 
-void EventSystem::SingleShot(SingleShotEventHandler&& handler, void* ctx) noexcept
+int32_t EventSystem::RegisterEvent(const char* name, EventCoalesce coalesce) noexcept
 {
-	OFS_PROFILE(__FUNCTION__);
-	// evData is freed after the event got processed
-	auto evData = new SingleShotEventData();
-	evData->ctx = ctx;
-	evData->handler = std::move(handler);
-	SDL_Event ev;
-	ev.type = EventSystem::SingleShotEvent;
-	ev.user.data1 = evData;
-	SDL_PushEvent(&ev);
+	int32_t type = SDL_RegisterEvents(1);
+	FUN_ASSERT(type != -1, "ran out of user events");
+	auto& slot = ev().slot(type);
+	slot.name = name;
+	slot.coalesce = coalesce;
+	return type;
 }
 
-std::unique_ptr<EventSystem::WaitableSingleShotEventData> EventSystem::WaitableSingleShot(SingleShotEventHandler&& handler, void* ctx) noexcept
+static const char* SdlEventName(uint32_t type) noexcept
 {
-	OFS_PROFILE(__FUNCTION__);
-	auto data = std::make_unique<WaitableSingleShotEventData>(ctx, std::move(handler));
-	SDL_SemWait(data->waitSemaphore);
-	PushEvent(EventSystem::WaitableSingleShotEvent, data.get());
-	return std::move(data);
+	switch (type) {
+		case SDL_KEYDOWN: return "SDL_KEYDOWN";
+		case SDL_MOUSEMOTION: return "SDL_MOUSEMOTION";
+		case SDL_MOUSEBUTTONDOWN: return "SDL_MOUSEBUTTONDOWN";
+		case SDL_MOUSEBUTTONUP: return "SDL_MOUSEBUTTONUP";
+		case SDL_MOUSEWHEEL: return "SDL_MOUSEWHEEL";
+		case SDL_CONTROLLERAXISMOTION: return "SDL_CONTROLLERAXISMOTION";
+		case SDL_CONTROLLERBUTTONDOWN: return "SDL_CONTROLLERBUTTONDOWN";
+		case SDL_CONTROLLERBUTTONUP: return "SDL_CONTROLLERBUTTONUP";
+		case SDL_CONTROLLERDEVICEADDED: return "SDL_CONTROLLERDEVICEADDED";
+		case SDL_CONTROLLERDEVICEREMOVED: return "SDL_CONTROLLERDEVICEREMOVED";
+		case SDL_DROPFILE: return "SDL_DROPFILE";
+	}
+	return nullptr;
 }
 
-std::unique_ptr<EventSystem::WaitableSingleShotEventData> EventSystem::RunOnMain(SingleShotEventHandler&& handler, void* ctx) noexcept
+void EventSystem::ShowMetrics(bool* open) noexcept
 {
-	if(Util::InMainThread()) {
-		handler(ctx);
-		return std::move(std::make_unique<WaitableSingleShotEventData>(ctx, std::move(handler)));
+	if (!*open) return;
+	OFS_PROFILE(__FUNCTION__);
+	ImGui::Begin(TR_ID("EVENT_METRICS", Tr::EVENT_METRICS), open);
+	if (ImGui::Button(TR(RESET))) {
+		for (auto& page : slots) {
+			if (!page) continue;
+			for (auto& slot : *page) { slot.stats = EventStats(); }
+		}
 	}
-	else {
-		return std::move(WaitableSingleShot(std::move(handler), ctx));
+
+	double toMs = 1000.0 / SDL_GetPerformanceFrequency();
+	ImGui::Columns(6, "EventMetrics");
+	ImGui::TextUnformatted("Event"); ImGui::NextColumn();
+	ImGui::TextUnformatted("Handlers"); ImGui::NextColumn();
+	ImGui::TextUnformatted("Received"); ImGui::NextColumn();
+	ImGui::TextUnformatted("Delivered"); ImGui::NextColumn();
+	ImGui::TextUnformatted("Total ms"); ImGui::NextColumn();
+	ImGui::TextUnformatted("Max ms"); ImGui::NextColumn();
+	ImGui::Separator();
+
+	for (uint32_t pageIdx = 0; pageIdx < slots.size(); pageIdx++) {
+		if (!slots[pageIdx]) continue;
+		for (uint32_t i = 0; i < SlotPageSize; i++) {
+			auto& slot = (*slots[pageIdx])[i];
+			if (slot.handlers.empty() && slot.stats.received == 0) continue;
+			uint32_t type = pageIdx * SlotPageSize + i;
+			const char* name = slot.name ? slot.name : SdlEventName(type);
+			if (name) ImGui::TextUnformatted(name);
+			else ImGui::Text("0x%x", type);
+			if (slot.coalesce != EventCoalesce::None) {
+				ImGui::SameLine();
+				ImGui::TextDisabled(slot.coalesce == EventCoalesce::LatestWins ? "(latest)" : "(merged)");
+			}
+			ImGui::NextColumn();
+			ImGui::Text("%d", (int32_t)slot.handlers.size()); ImGui::NextColumn();
+			ImGui::Text("%llu", (unsigned long long)slot.stats.received); ImGui::NextColumn();
+			ImGui::Text("%llu", (unsigned long long)slot.stats.delivered); ImGui::NextColumn();
+			ImGui::Text("%.3f", slot.stats.handlerTicks * toMs); ImGui::NextColumn();
+			ImGui::Text("%.3f", slot.stats.maxHandlerTicks * toMs); ImGui::NextColumn();
+		}
 	}
-}
\ No newline at end of file
+	ImGui::Columns(1);
+	ImGui::End();
+}
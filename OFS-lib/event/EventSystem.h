@@ -4,75 +4,121 @@
 #include "SDL_thread.h"
 #include "OFS_Profiling.h"
 
+#include <array>
+#include <limits>
 #include <vector>
+#include <algorithm>
 #include <functional>
 #include <memory>
 
-// insanely basic event system
-// it doesn't get any simpler than this
-using EventHandlerFunc = std::function<void(SDL_Event&)>;
+// a member function bound to its listener
+// cheaper to copy and call than a std::function wrapping std::bind
+class EventHandlerFunc {
+	using Thunk = void(*)(void*, SDL_Event&) noexcept;
+	void* obj = nullptr;
+	Thunk thunk = nullptr;
+public:
+	template<auto Method, typename T>
+	inline static EventHandlerFunc Bind(T* obj) noexcept
+	{
+		EventHandlerFunc func;
+		func.obj = obj;
+		func.thunk = [](void* obj, SDL_Event& ev) noexcept { (static_cast<T*>(obj)->*Method)(ev); };
+		return func;
+	}
+
+	inline void operator()(SDL_Event& ev) const noexcept { thunk(obj, ev); }
+};
 
 class EventHandler {
 public:
-	int32_t eventType;
 	EventHandlerFunc func;
 	void* listener = nullptr;
 
-	EventHandler(int32_t type, void* listener, EventHandlerFunc&& func) noexcept
-		: eventType(type), func(std::move(func)), listener(listener) { }
+	EventHandler(void* listener, EventHandlerFunc&& func) noexcept
+		: func(std::move(func)), listener(listener) { }
 };
 
-class EventSystem {
-private:
-	std::vector<EventHandler> handlers;
+// how multiple events of the same type and data1 within a frame get delivered
+enum class EventCoalesce : uint8_t {
+	None,
+	// only the last one gets delivered
+	LatestWins,
+	// delivered once, data2 points to the union of all EventRanges
+	MergeRanges,
+};
+
+struct EventRange {
+	float begin;
+	float end;
+
+	static constexpr EventRange All() noexcept { return { -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity() }; }
+	inline void Merge(const EventRange& other) noexcept
+	{
+		begin = std::min(begin, other.begin);
+		end = std::max(end, other.end);
+	}
+};
 
-	void SingleShotHandler(SDL_Event& ev) noexcept;
-	void WaitableSingleShotHandler(SDL_Event& ev) noexcept;
+class EventSystem {
 public:
-	using SingleShotEventHandler = std::function<void(void*)>;
-	struct SingleShotEventData {
-		void* ctx = nullptr;
-		SingleShotEventHandler handler;
+	struct EventStats {
+		uint64_t received = 0;
+		uint64_t delivered = 0;
+		// in SDL_GetPerformanceCounter ticks
+		uint64_t handlerTicks = 0;
+		uint64_t maxHandlerTicks = 0;
 	};
-	// this event + SingleShotEventData + SingleShotHandler allows execute arbitrary code
-	// back on the main thread comming from another. currently this is used to return filepaths from file dialogs.
-	static int32_t SingleShotEvent;
-	
-	struct WaitableSingleShotEventData {
-		void* ctx;
-		SingleShotEventHandler handler;
-		SDL_sem* waitSemaphore;
-
-		WaitableSingleShotEventData(void* ctx, SingleShotEventHandler&& handler) noexcept
-			: ctx(ctx), handler(handler)
-		{
-			waitSemaphore = SDL_CreateSemaphore(1);
-		}
-		~WaitableSingleShotEventData() noexcept
-		{
-			SDL_DestroySemaphore(waitSemaphore);
-		}
-
-		void Wait() noexcept { SDL_SemWait(waitSemaphore); }
-		bool TryWait() noexcept { return SDL_SemTryWait(waitSemaphore) == 0; }
+private:
+	struct EventSlot {
+		std::vector<EventHandler> handlers;
+		EventCoalesce coalesce = EventCoalesce::None;
+		const char* name = nullptr;
+		EventStats stats;
 	};
-	static int32_t WaitableSingleShotEvent;
+	// sdl event types are 16 bit, the table gets split in pages so it stays small
+	static constexpr uint32_t SlotPageSize = 256;
+	using EventSlotPage = std::array<EventSlot, SlotPageSize>;
+	std::array<std::unique_ptr<EventSlotPage>, 0x10000 / SlotPageSize> slots;
 
-	void setup() noexcept;
+	struct PendingEvent {
+		SDL_Event event;
+		EventRange range;
+	};
+	std::vector<PendingEvent> pending;
+	std::vector<PendingEvent> delivering;
 
-	inline void Propagate(SDL_Event& event) noexcept
+	inline EventSlot* findSlot(uint32_t type) noexcept
 	{
-		OFS_PROFILE(__FUNCTION__);
-		for (auto& handler : handlers) {
-			if (handler.eventType == event.type)
-				handler.func(event);
-		}
+		if (type >= 0x10000) return nullptr;
+		auto& page = slots[type / SlotPageSize];
+		return page ? &(*page)[type % SlotPageSize] : nullptr;
 	}
+	EventSlot& slot(uint32_t type) noexcept;
+
+	void dispatch(EventSlot& slot, SDL_Event& event) noexcept;
+	void enqueue(const SDL_Event& event, const EventRange& range, EventCoalesce coalesce) noexcept;
+public:
+	// code which has to run on the main thread goes through OFS_MainThreadExecutor
+	void setup() noexcept;
+
+	// coalesced events are held back until DeliverCoalesced
+	void Propagate(SDL_Event& event) noexcept;
+	// call once per frame after all sdl events were propagated
+	void DeliverCoalesced() noexcept;
+
+	// main thread only, skips the sdl queue
+	void Post(int32_t type, void* user1, const EventRange& range = EventRange::All()) noexcept;
 
 	void Subscribe(int32_t eventType, void* listener, EventHandlerFunc&& handler) noexcept;
 	void Unsubscribe(int32_t eventType, void* listener) noexcept;
 	void UnsubscribeAll(void* listener) noexcept;
 
+	void ShowMetrics(bool* open) noexcept;
+
+	// SDL_RegisterEvents with a name for the metrics window
+	static int32_t RegisterEvent(const char* name, EventCoalesce coalesce = EventCoalesce::None) noexcept;
+
 	// helper
 	inline static void PushEvent(int32_t type, void* user1 = nullptr) noexcept {
 		SDL_Event ev;
@@ -80,10 +126,6 @@ public:
 		ev.user.data1 = user1;
 		SDL_PushEvent(&ev);
 	}
-	static void SingleShot(SingleShotEventHandler&& handler, void* ctx) noexcept;
-	[[nodiscard/*("this must be waited on")*/]]static std::unique_ptr<WaitableSingleShotEventData> WaitableSingleShot(SingleShotEventHandler&& handler, void* ctx) noexcept;
-
-	[[nodiscard]] static std::unique_ptr<WaitableSingleShotEventData> RunOnMain(SingleShotEventHandler&& handler, void* ctx) noexcept;
 
 	static EventSystem* instance;
 	static EventSystem& ev() noexcept {
@@ -92,4 +134,4 @@ public:
 	}
 };
 
-#define EVENT_SYSTEM_BIND(listener, handler) listener, std::move(std::bind(handler, listener, std::placeholders::_1))
\ No newline at end of file
+#define EVENT_SYSTEM_BIND(listener, handler) listener, EventHandlerFunc::Bind<handler>(listener)
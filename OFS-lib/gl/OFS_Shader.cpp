@@ -1,10 +1,130 @@
 #include "OFS_Shader.h"
 #include "OFS_Util.h"
+#include "OFS_AsyncIO.h"
 
 #include "glad/gl.h"
+#include "SDL_video.h"
+
+#include <string>
+#include <vector>
+#include <cstring>
+
+// glad only loads gl 3.3, program binaries are 4.1 or GL_ARB_get_program_binary
+#define OFS_GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define OFS_GL_PROGRAM_BINARY_LENGTH 0x8741
+#define OFS_GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+
+typedef void (GLAD_API_PTR* OFS_PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (GLAD_API_PTR* OFS_PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (GLAD_API_PTR* OFS_PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+static struct ProgramBinaryCache {
+	bool initialized = false;
+	bool supported = false;
+	OFS_PFNGLGETPROGRAMBINARYPROC getProgramBinary = nullptr;
+	OFS_PFNGLPROGRAMBINARYPROC programBinary = nullptr;
+	OFS_PFNGLPROGRAMPARAMETERIPROC programParameteri = nullptr;
+	std::string directory;
+	// GL_RENDERER and GL_VERSION, a driver update invalidates every binary
+	std::string driver;
+
+	void Init() noexcept
+	{
+		if (initialized) return;
+		initialized = true;
+
+		int major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		bool core = major > 4 || (major == 4 && minor >= 1);
+		if (!core && !SDL_GL_ExtensionSupported("GL_ARB_get_program_binary")) return;
+
+		getProgramBinary = (OFS_PFNGLGETPROGRAMBINARYPROC)SDL_GL_GetProcAddress("glGetProgramBinary");
+		programBinary = (OFS_PFNGLPROGRAMBINARYPROC)SDL_GL_GetProcAddress("glProgramBinary");
+		programParameteri = (OFS_PFNGLPROGRAMPARAMETERIPROC)SDL_GL_GetProcAddress("glProgramParameteri");
+		if (!getProgramBinary || !programBinary || !programParameteri) return;
+
+		// some drivers expose the extension without any format
+		int formats = 0;
+		glGetIntegerv(OFS_GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		if (formats <= 0) return;
+
+		auto renderer = (const char*)glGetString(GL_RENDERER);
+		auto version = (const char*)glGetString(GL_VERSION);
+		driver = std::string(renderer ? renderer : "") + '\n' + (version ? version : "");
+		directory = Util::Prefpath("shader_cache");
+		supported = Util::CreateDirectories(Util::PathFromString(directory));
+	}
+
+	std::string Path(const char* vtxShader, const char* fragShader) noexcept
+	{
+		// two differently seeded 32 bit hashes, a collision would load the wrong program
+		uint32_t hash[2];
+		int32_t seeds[2] = { 0x42069, 0x5EED };
+		for (int i = 0; i < 2; i++) {
+			uint32_t h = Util::Hash(vtxShader, 0, seeds[i]);
+			h = Util::Hash(fragShader, 0, (int32_t)h);
+			hash[i] = Util::Hash(driver.c_str(), driver.size(), (int32_t)h);
+		}
+		char name[32];
+		stbsp_snprintf(name, sizeof(name), "%08x%08x.bin", hash[0], hash[1]);
+		return (Util::PathFromString(directory) / name).u8string();
+	}
+} BinaryCache;
+
+static bool LoadProgramBinary(unsigned int program, const std::string& path) noexcept
+{
+	std::vector<uint8_t> file;
+	if (Util::ReadFile(path.c_str(), file) <= sizeof(GLenum)) return false;
+
+	// the binary format followed by the binary
+	GLenum format;
+	memcpy(&format, file.data(), sizeof(GLenum));
+	BinaryCache.programBinary(program, format, file.data() + sizeof(GLenum), (GLsizei)(file.size() - sizeof(GLenum)));
+
+	int success = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	return success;
+}
+
+static void StoreProgramBinary(unsigned int program, std::string&& path) noexcept
+{
+	int length = 0;
+	glGetProgramiv(program, OFS_GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	std::vector<uint8_t> file(sizeof(GLenum) + length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	BinaryCache.getProgramBinary(program, length, &written, &format, file.data() + sizeof(GLenum));
+	if (written <= 0) return;
+	memcpy(file.data(), &format, sizeof(GLenum));
+	file.resize(sizeof(GLenum) + written);
+
+	OFS_AsyncIO::Write write;
+	write.Path = std::move(path);
+	write.Buffer = std::move(file);
+	write.Priority = OFS_AsyncIO::PriorityClass::Cache;
+	OFS_AsyncIO::WriteOrQueue(std::move(write));
+}
 
 ShaderBase::ShaderBase(const char* vtx_shader, const char* frag_shader)
 {
+	BinaryCache.Init();
+	std::string cachePath;
+	if (BinaryCache.supported) {
+		cachePath = BinaryCache.Path(vtx_shader, frag_shader);
+		program = glCreateProgram();
+		if (LoadProgramBinary(program, cachePath)) {
+			glUseProgram(program);
+			glUniform1i(glGetUniformLocation(program, "Texture"), GL_TEXTURE0);
+			return;
+		}
+		// rejected by the driver or not cached yet
+		glDeleteProgram(program);
+		program = 0;
+	}
+
 	unsigned int vertex, fragment;
 	int success;
 	char infoLog[512];
@@ -37,6 +157,9 @@ ShaderBase::ShaderBase(const char* vtx_shader, const char* frag_shader)
 	program = glCreateProgram();
 	glAttachShader(program, vertex);
 	glAttachShader(program, fragment);
+	if (BinaryCache.supported) {
+		BinaryCache.programParameteri(program, OFS_GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
 	glLinkProgram(program);
 	// print linking errors if any
 	glGetProgramiv(program, GL_LINK_STATUS, &success);
@@ -45,6 +168,10 @@ ShaderBase::ShaderBase(const char* vtx_shader, const char* frag_shader)
 		glGetProgramInfoLog(program, 512, NULL, infoLog);
 		LOGF_ERROR("ERROR::SHADER::PROGRAM::LINKING_FAILED\n%s", infoLog);
 	}
+	else if (BinaryCache.supported)
+	{
+		StoreProgramBinary(program, std::move(cachePath));
+	}
 
 	glUseProgram(program);
 	glUniform1i(glGetUniformLocation(program, "Texture"), GL_TEXTURE0);
@@ -185,3 +312,79 @@ void WaveformShader::Color(float* vec3) noexcept
 {
 	glUniform3fv(ColorLoc, 1, vec3);
 }
+
+void ActionLineShader::initUniformLocations() noexcept
+{
+	ProjMtxLoc = glGetUniformLocation(program, "ProjMtx");
+	CanvasPosLoc = glGetUniformLocation(program, "CanvasPos");
+	CanvasSizeLoc = glGetUniformLocation(program, "CanvasSize");
+	OffsetTimeLoc = glGetUniformLocation(program, "OffsetTime");
+	VisibleTimeLoc = glGetUniformLocation(program, "VisibleTime");
+	ModeLoc = glGetUniformLocation(program, "Mode");
+	SplineModeLoc = glGetUniformLocation(program, "SplineMode");
+	WidthLoc = glGetUniformLocation(program, "Width");
+	ColorLoc = glGetUniformLocation(program, "Color");
+	BorderColorLoc = glGetUniformLocation(program, "BorderColor");
+	SpeedGradientLoc = glGetUniformLocation(program, "SpeedGradient");
+	MaxSpeedLoc = glGetUniformLocation(program, "MaxSpeed");
+	HighlightSpeedLoc = glGetUniformLocation(program, "HighlightSpeed");
+	HighlightColorLoc = glGetUniformLocation(program, "HighlightColor");
+}
+
+void ActionLineShader::ProjMtx(const float* mat4) noexcept
+{
+	glUniformMatrix4fv(ProjMtxLoc, 1, GL_FALSE, mat4);
+}
+
+void ActionLineShader::Canvas(const float* pos, const float* size) noexcept
+{
+	glUniform2fv(CanvasPosLoc, 1, pos);
+	glUniform2fv(CanvasSizeLoc, 1, size);
+}
+
+void ActionLineShader::Window(float offsetTime, float visibleTime) noexcept
+{
+	glUniform1f(OffsetTimeLoc, offsetTime);
+	glUniform1f(VisibleTimeLoc, visibleTime);
+}
+
+void ActionLineShader::DrawMode(Mode mode) noexcept
+{
+	glUniform1i(ModeLoc, (int32_t)mode);
+}
+
+void ActionLineShader::SplineMode(bool spline) noexcept
+{
+	glUniform1i(SplineModeLoc, spline);
+}
+
+void ActionLineShader::Width(float width) noexcept
+{
+	glUniform1f(WidthLoc, width);
+}
+
+void ActionLineShader::Color(const float* vec4) noexcept
+{
+	glUniform4fv(ColorLoc, 1, vec4);
+}
+
+void ActionLineShader::BorderColor(const float* vec4) noexcept
+{
+	glUniform4fv(BorderColorLoc, 1, vec4);
+}
+
+void ActionLineShader::SpeedGradient(uint32_t unit) noexcept
+{
+	glUniform1i(SpeedGradientLoc, unit);
+}
+
+void ActionLineShader::MaxSpeed(float speed) noexcept
+{
+	glUniform1f(MaxSpeedLoc, speed);
+}
+
+void ActionLineShader::Highlight(float speed, const float* vec4) noexcept
+{
+	glUniform1f(HighlightSpeedLoc, speed);
+	glUniform4fv(HighlightColorLoc, 1, vec4);
+}
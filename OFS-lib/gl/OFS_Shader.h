@@ -343,6 +343,184 @@ public:
 	void Color(float* vec3) noexcept;
 };
 
+// renders the actions of a script straight from a vertex buffer
+// every instance is one action (points) or one line segment (lines)
+// the buffer holds (atS, pos) pairs padded with a copy of the first and last action
+// this way every segment can read the four actions needed for the spline
+class ActionLineShader : public ShaderBase
+{
+private:
+	static constexpr const char* vtx_shader = R"(
+			#version 330 core
+			uniform mat4 ProjMtx;
+			uniform vec2 CanvasPos;
+			uniform vec2 CanvasSize;
+			uniform float OffsetTime;
+			uniform float VisibleTime;
+			uniform int Mode;
+			uniform int SplineMode;
+			uniform float Width;
+			uniform vec4 Color;
+			uniform sampler1D SpeedGradient;
+			uniform float MaxSpeed;
+			uniform float HighlightSpeed;
+			uniform vec4 HighlightColor;
+
+			layout (location = 0) in vec2 Action0;
+			layout (location = 1) in vec2 Action1;
+			layout (location = 2) in vec2 Action2;
+			layout (location = 3) in vec2 Action3;
+
+			out vec2 Frag_UV;
+			out vec4 Frag_Color;
+
+			#define MODE_LINE_BORDER 0
+			#define MODE_LINE 1
+			#define MODE_POINT 2
+			#define SPLINE_SUBDIVISIONS 16
+
+			const vec2 Corners[6] = vec2[6](
+				vec2(0.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+				vec2(0.0, -1.0), vec2(1.0, 1.0), vec2(0.0, 1.0)
+			);
+
+			vec2 toScreen(float atS, float pos) {
+				return CanvasPos + vec2(((atS - OffsetTime) / VisibleTime) * CanvasSize.x, CanvasSize.y * (1.0 - (pos / 100.0)));
+			}
+
+			// same as FunscriptSpline::catmul_rom_spline_alt
+			float catmullRom(float v0, float v1, float v2, float v3, float s) {
+				if(v1 == v2) return v1;
+				float s2 = s * s;
+				float s3 = s2 * s;
+				float f1 = -s3 + 2.0 * s2 - s;
+				float f2 = 3.0 * s3 - 5.0 * s2 + 2.0;
+				float f3 = -3.0 * s3 + 4.0 * s2 + s;
+				float f4 = s3 - s2;
+				return clamp((f1 * v0 + f2 * v1 + f3 * v2 + f4 * v3) / 2.0, 0.0, 100.0);
+			}
+
+			void main()	{
+				vec2 corner = Corners[gl_VertexID % 6];
+
+				if(Mode == MODE_POINT) {
+					Frag_UV = vec2(corner.x * 2.0 - 1.0, corner.y);
+					Frag_Color = Color;
+					vec2 center = toScreen(Action1.x, Action1.y);
+					gl_Position = ProjMtx * vec4(center + (Frag_UV * Width), 0.0, 1.0);
+					return;
+				}
+
+				vec2 p1;
+				vec2 p2;
+				if(SplineMode != 0) {
+					float s1 = float(gl_VertexID / 6) / float(SPLINE_SUBDIVISIONS);
+					float s2 = float(gl_VertexID / 6 + 1) / float(SPLINE_SUBDIVISIONS);
+					p1 = toScreen(mix(Action1.x, Action2.x, s1), catmullRom(Action0.y, Action1.y, Action2.y, Action3.y, s1));
+					p2 = toScreen(mix(Action1.x, Action2.x, s2), catmullRom(Action0.y, Action1.y, Action2.y, Action3.y, s2));
+				}
+				else {
+					p1 = toScreen(Action1.x, Action1.y);
+					p2 = toScreen(Action2.x, Action2.y);
+				}
+
+				vec2 dir = p2 - p1;
+				float len = length(dir);
+				dir = len > 0.0 ? dir / len : vec2(1.0, 0.0);
+				vec2 normal = vec2(-dir.y, dir.x);
+				vec2 p = mix(p1, p2, corner.x) + (normal * corner.y * Width * 0.5);
+				gl_Position = ProjMtx * vec4(p, 0.0, 1.0);
+				Frag_UV = corner;
+
+				if(Mode == MODE_LINE_BORDER) {
+					Frag_Color = Color;
+				}
+				else {
+					float speed = abs(Action2.y - Action1.y) / (Action2.x - Action1.x);
+					if(HighlightSpeed > 0.0 && speed >= HighlightSpeed) {
+						Frag_Color = HighlightColor;
+					}
+					else {
+						Frag_Color = vec4(texture(SpeedGradient, clamp(speed / MaxSpeed, 0.0, 1.0)).rgb, 1.0);
+					}
+				}
+			}
+	)";
+
+	static constexpr const char* frag_shader = R"(
+			#version 330 core
+			uniform int Mode;
+			uniform vec4 BorderColor;
+
+			in vec2 Frag_UV;
+			in vec4 Frag_Color;
+
+			out vec4 Out_Color;
+
+			#define MODE_POINT 2
+
+			void main()	{
+				if(Mode == MODE_POINT) {
+					// black border with a 70% sized dot
+					float dist = length(Frag_UV);
+					float aa = fwidth(dist);
+					float alpha = 1.0 - smoothstep(1.0 - aa, 1.0, dist);
+					if(alpha <= 0.0) discard;
+					float inner = 1.0 - smoothstep(0.7 - aa, 0.7, dist);
+					Out_Color = mix(vec4(BorderColor.rgb, BorderColor.a * alpha), Frag_Color, inner);
+				}
+				else {
+					Out_Color = Frag_Color;
+				}
+			}
+	)";
+
+	int32_t ProjMtxLoc = 0;
+	int32_t CanvasPosLoc = 0;
+	int32_t CanvasSizeLoc = 0;
+	int32_t OffsetTimeLoc = 0;
+	int32_t VisibleTimeLoc = 0;
+	int32_t ModeLoc = 0;
+	int32_t SplineModeLoc = 0;
+	int32_t WidthLoc = 0;
+	int32_t ColorLoc = 0;
+	int32_t BorderColorLoc = 0;
+	int32_t SpeedGradientLoc = 0;
+	int32_t MaxSpeedLoc = 0;
+	int32_t HighlightSpeedLoc = 0;
+	int32_t HighlightColorLoc = 0;
+
+	void initUniformLocations() noexcept;
+public:
+	enum class Mode : int32_t {
+		LineBorder,
+		Line,
+		Point
+	};
+
+	// number of line segments every spline segment gets split into
+	// has to match SPLINE_SUBDIVISIONS
+	static constexpr int32_t SplineSubdivisions = 16;
+
+	ActionLineShader()
+		: ShaderBase(vtx_shader, frag_shader)
+	{
+		initUniformLocations();
+	}
+
+	void ProjMtx(const float* mat4) noexcept;
+	void Canvas(const float* pos, const float* size) noexcept;
+	void Window(float offsetTime, float visibleTime) noexcept;
+	void DrawMode(Mode mode) noexcept;
+	void SplineMode(bool spline) noexcept;
+	void Width(float width) noexcept;
+	void Color(const float* vec4) noexcept;
+	void BorderColor(const float* vec4) noexcept;
+	void SpeedGradient(uint32_t unit) noexcept;
+	void MaxSpeed(float speed) noexcept;
+	void Highlight(float speed, const float* vec4) noexcept;
+};
+
 class LightingShader : public ShaderBase
 {
 private:
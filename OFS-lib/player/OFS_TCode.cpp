@@ -4,41 +4,161 @@
 #include "OFS_ImGui.h"
 #include "OFS_Profiling.h"
 #include "OFS_Localization.h"
+#include "OFS_TCodeTransport.h"
+#include "OFS_TCodeTrace.h"
+#include "OFS_TCodeQueue.h"
+#include "OFS_TCodeClock.h"
+#include "OFS_Redraw.h"
 
 #include "imgui.h"
+#include "imgui_stdlib.h"
+
+#include <chrono>
+#include <algorithm>
+
+#if defined(__linux__)
+#include <time.h>
+#include <errno.h>
+#endif
 
 #include "libserialport.h"
 #include "libserialport_internal.h"
 
-bool TCodePlayer::openPort(struct sp_port* openthis) noexcept
+TCodeOutput::TCodeOutput() noexcept
 {
-    if (port != nullptr) {
-        sp_close(port);
-        sp_free_port(port);
-        port = nullptr;
+    for (int32_t i = 0; i < ChannelCount; i++) {
+        channelMap[i] = i;
     }
+}
 
-    if (sp_get_port_by_name(openthis->name, &port) != SP_OK) {
-        LOGF_ERROR("Failed to get port \"%s\"", openthis->description);
+bool TCodeOutput::openTransport() noexcept
+{
+    closeTransport();
+    SDL_AtomicSet(&transportFailed, 0);
+    transportType = std::clamp(transportType, 0, static_cast<int32_t>(TCodeTransport::Type::TotalCount) - 1);
+    transport = TCodeTransport::Create(static_cast<TCodeTransport::Type>(transportType));
+    if (!transport) return false;
+
+    if (!transport->Open(address.c_str())) {
+        transport.reset();
         return false;
     }
+    return true;
+}
 
-    if (sp_open(port, sp_mode::SP_MODE_WRITE) != SP_OK) {
-        LOGF_ERROR("Failed to open port \"%s\"", port->description);
-        sp_free_port(port);
-        port = nullptr;
-        return false;
+void TCodeOutput::closeTransport() noexcept
+{
+    if (transport) {
+        transport->Close();
+        transport.reset();
     }
+    SDL_AtomicSet(&transportFailed, 0);
+}
 
-    if (sp_set_baudrate(port, 115200) != SP_OK) {
-        LOG_ERROR("Failed to set baud rate to 115200.");
-        sp_close(port);
-        sp_free_port(port);
-        port = nullptr;
-        return false;
+TCodeOutput::Settings TCodeOutput::getSettings() const noexcept
+{
+    Settings settings;
+    for (int32_t i = 0; i < ChannelCount; i++) {
+        settings.channels[i] = tcode.channels[i].GetSettings();
     }
+    settings.channelMap = channelMap;
+    settings.delay = delay;
+    return settings;
+}
 
-    return true;
+void TCodeOutput::publishSettings() noexcept
+{
+    auto settings = getSettings();
+    auto current = std::atomic_load(&published);
+    if (current && *current == settings) return;
+    std::atomic_store(&published, std::shared_ptr<const Settings>(std::make_shared<Settings>(settings)));
+}
+
+void TCodeOutput::applySettings() noexcept
+{
+    auto latest = std::atomic_load(&published);
+    if (!latest || latest == applied) return;
+    for (int32_t i = 0; i < ChannelCount; i++) {
+        live.channels[i].CopySettings(latest->channels[i]);
+    }
+    applied = std::move(latest);
+}
+
+void TCodeOutput::update(const TCodeProducer& prod) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    for (int32_t i = 0; i < ChannelCount; i++) {
+        int32_t source = applied->channelMap[i];
+        if (source < 0 || source >= ChannelCount) continue;
+        auto& p = prod.producers[source];
+        if (p.ScriptIdx() < 0) continue;
+        live.channels[i].SetNextPos(p.NextPos, p.NextInterval);
+    }
+}
+
+static void AddMotionLimits(const TCodeOutput::Settings& settings, TCodeProducer& prod) noexcept
+{
+    auto combine = [](float current, float limit) noexcept {
+        if (limit <= 0.f) return current;
+        return current <= 0.f ? limit : std::min(current, limit);
+    };
+
+    for (int32_t i = 0; i < TCodeOutput::ChannelCount; i++) {
+        auto& c = settings.channels[i];
+        int32_t source = settings.channelMap[i];
+        if (!c.Enabled || source < 0 || source >= TCodeOutput::ChannelCount) continue;
+        auto& p = prod.producers[source];
+        p.MaxSpeed = combine(p.MaxSpeed, c.MaxSpeed);
+        p.MaxAcceleration = combine(p.MaxAcceleration, c.MaxAcceleration);
+    }
+}
+
+void TCodeOutput::applyMotionLimits(TCodeProducer& prod) const noexcept
+{
+    AddMotionLimits(getSettings(), prod);
+}
+
+void TCodeOutput::applyLiveMotionLimits(TCodeProducer& prod) const noexcept
+{
+    AddMotionLimits(*applied, prod);
+}
+
+TCodeProducer& TCodeOutput::producerFor(TCodeProducer& shared, bool discontinuity) noexcept
+{
+    if (applied->delay <= 0.f) {
+        delayedProd.reset();
+        return shared;
+    }
+    if (!delayedProd) {
+        delayedProd = std::make_unique<TCodeProducer>();
+        delayedProd->LoadedScripts = shared.LoadedScripts;
+    }
+
+    // follows the scripts picked for the shared producers
+    for (int32_t i = 0; i < ChannelCount; i++) {
+        auto& p = delayedProd->producers[i];
+        int32_t scriptIdx = shared.producers[i].ScriptIdx();
+        if (p.ScriptIdx() != scriptIdx) { p.SetScript(scriptIdx); }
+        else if (discontinuity) { p.NeedsResync = true; }
+        p.MaxSpeed = 0.f;
+        p.MaxAcceleration = 0.f;
+    }
+    applyLiveMotionLimits(*delayedProd);
+    return *delayedProd;
+}
+
+// producers are shared by all devices so the strictest limit of every channel they drive wins
+static void UpdateMotionLimits(TCodePlayer& player) noexcept
+{
+    for (auto& p : player.prod.producers) {
+        p.MaxSpeed = 0.f;
+        p.MaxAcceleration = 0.f;
+    }
+    for (auto& output : player.outputs) {
+        // delayed devices limit their own producers
+        if (output.delayedProd) continue;
+        output.applyLiveMotionLimits(player.prod);
+    }
 }
 
 TCodePlayer::TCodePlayer() noexcept
@@ -49,125 +169,134 @@ TCodePlayer::TCodePlayer() noexcept
 TCodePlayer::~TCodePlayer() noexcept
 {
     stop();
+    traceTask.Wait();
     save();
+    for (auto& output : outputs) {
+        output.closeTransport();
+    }
 }
 
-void TCodePlayer::loadSettings(const std::string& path) noexcept
+void TCodePlayer::loadSettings(const std::string& path, bool readOnly) noexcept
 {
     bool succ;
     auto json = Util::LoadJson(path, &succ);
     if (succ) {
         OFS::serializer::load(this, &json["tcode_player"]);
     }
-    loadPath = path;
+    if (outputs.empty()) {
+        outputs.emplace_back();
+        // settings from before multiple devices were supported
+        if (succ && json["tcode_player"].contains("tcode")) {
+            OFS::serializer::load(&outputs.front().tcode, &json["tcode_player"]["tcode"]);
+        }
+    }
+    loadPath = readOnly ? std::string() : path;
 }
 
 void TCodePlayer::save() noexcept
 {
+    if (loadPath.empty()) return;
     nlohmann::json json;
     OFS::serializer::save(this, &json["tcode_player"]);
     Util::WriteJson(json, loadPath, true);
 }
 
 static struct TCodeThreadData {
-    volatile bool requestStop = false;
-    bool running = false;
-    
-    SDL_atomic_t scriptTime = { 0 };
+    std::atomic<bool> requestStop = { false };
+    // set by the main thread, cleared by the tcode thread once everything stopped
+    std::atomic<bool> running = { false };
+    OFS_Task<void> task;
     
-    volatile float speed = 1.f;
+    // video time as seen by the main thread
+    TCodeClockSync clock;
 
     TCodePlayer* player = nullptr;
-    TCodeChannels* channel = nullptr;
     TCodeProducer* producer = nullptr;
+
+    TCodeHistogram tickJitter; // us
 } Thread;
 
-void TCodePlayer::DrawWindow(bool* open, float currentTime) noexcept
+using TCodeClock = std::chrono::steady_clock;
+
+inline static int64_t ToMicroseconds(TCodeClock::duration duration) noexcept
 {
-    if (!*open) return;
-    OFS_PROFILE(__FUNCTION__);
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
 
-    ImGui::Begin(TR_ID("T_CODE", Tr::T_CODE), open, ImGuiWindowFlags_AlwaysAutoResize);
-    ImGui::Combo(TR(PORT), &current_port, [](void* data, int idx, const char** out_text) -> bool {
-        const char** port_list = (const char**)data;
-        *out_text = ((sp_port*)port_list[idx])->description;
-        return true;
-        }, port_list, port_count);
-    if (ImGui::IsItemClicked(ImGuiMouseButton_Left)) {
-        if (port_list != nullptr) {
-            sp_free_port_list(port_list);
-        }
-        if (sp_list_ports(&port_list) == SP_OK) {
-            // count ports
-            int x = 0;
-            LOG_DEBUG("Available serial ports:\n");
-            while (port_list[x] != NULL) {
-                LOGF_DEBUG("%s\n", port_list[x]->description);
-                x++;
-            }
-            port_count = x;
-        }
+// sleeps until an absolute deadline so time spent ticking doesn't add up
+static void WaitUntil(TCodeClock::time_point deadline) noexcept
+{
+#if defined(__linux__)
+    // steady_clock is CLOCK_MONOTONIC on linux
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+    timespec ts;
+    ts.tv_sec = ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+#else
+    for (;;) {
+        auto remaining = deadline - TCodeClock::now();
+        if (remaining.count() <= 0) break;
+        int32_t ms = (int32_t)(ToMicroseconds(remaining) / 1000) - 1;
+        if (ms > 0) { SDL_Delay(ms); }
+        else { OFS_PAUSE_INTRIN(); }
     }
-    ImGui::SameLine();
+#endif
+}
 
-    if (port_list != nullptr
-        && port_list[0] != nullptr
-        && current_port < port_count
-        && port_list[current_port] != nullptr) {
-        if (ImGui::Button(TR(OPEN_PORT), ImVec2(-1.f, 0.f))) {
-            openPort(port_list[current_port]);
-        }
-    }
-    if (port != nullptr && ImGui::Button(TR(OPEN_PORT), ImVec2(-1.f, 0.f))) {
-        sp_close(port);
-        sp_free_port(port);
-        port = nullptr;
+// traces get rendered and analyzed on workers with these instead of the live producers and settings
+static std::shared_ptr<TCodeProducer> CopyScripts(const TCodeProducer& prod) noexcept
+{
+    auto copy = std::make_shared<TCodeProducer>();
+    copy->LoadedScripts = prod.LoadedScripts;
+    for (int32_t i = 0; i < TCodeOutput::ChannelCount; i++) {
+        copy->producers[i].SetScript(prod.producers[i].ScriptIdx());
     }
+    return copy;
+}
 
-    ImGui::Spacing(); ImGui::Separator(); ImGui::Spacing();
-
-    if (ImGui::CollapsingHeader(TR_ID("ChannelLimits", Tr::LIMITS)))
-    {
-        auto limitsGui = [this](TChannel chan) noexcept {
-            char buf[32];
-            auto& c = tcode.Get(chan);
-            float availWidth = ImGui::GetContentRegionAvail().x;
-
-            ImGui::SetNextItemWidth(availWidth * 0.6f);
-            stbsp_snprintf(buf, sizeof(buf),"##%s_Limit", c.Id);
-            ImGui::DragIntRange2(buf,
-                &c.limits[0], &c.limits[1], 1,
-                TCodeChannel::MinChannelValue, TCodeChannel::MaxChannelValue,
-                TR(MIN_INT_FMT), TR(MAX_INT_FMT), ImGuiSliderFlags_AlwaysClamp);
-
-            ImGui::SameLine();
-            ImGui::SetNextItemWidth(0.3f * availWidth);
-            stbsp_snprintf(buf, sizeof(buf), "%-6s (%s)##%s_Enable", TCodeChannels::Aliases[static_cast<int32_t>(chan)][2], c.Id, c.Id);
-            ImGui::Checkbox(buf, &c.Enabled);
-        };
+static std::shared_ptr<TCodeOutput> CopySettings(const TCodeOutput& output) noexcept
+{
+    auto copy = std::make_shared<TCodeOutput>();
+    copy->tcode = output.tcode;
+    copy->channelMap = output.channelMap;
+    return copy;
+}
 
-        ImGui::TextUnformatted(TR(LINEAR_LIMITS));
-        limitsGui(TChannel::L0);
-        limitsGui(TChannel::L1);
-        limitsGui(TChannel::L2);
-        limitsGui(TChannel::L3);
+static void DrawHistogram(const char* label, const TCodeHistogram& histogram) noexcept
+{
+    char overlay[32];
+    std::array<float, TCodeHistogram::BucketCount> buckets;
+    histogram.Get(buckets);
+    stbsp_snprintf(overlay, sizeof(overlay), "max: %d", histogram.Max());
+    ImGui::PlotHistogram(label, buckets.data(), buckets.size(), 0, overlay, 0.f, FLT_MAX, ImVec2(0.f, 50.f));
+    OFS::Tooltip(TR(TCODE_HISTOGRAM_TOOLTIP));
+}
 
-        ImGui::Separator();
+void TCodePlayer::DrawWindow(bool* open, float currentTime) noexcept
+{
+    if (!*open) return;
+    OFS_PROFILE(__FUNCTION__);
 
-        ImGui::TextUnformatted(TR(ROTATION_LIMITS));
-        limitsGui(TChannel::R0);
-        limitsGui(TChannel::R1);
-        limitsGui(TChannel::R2);
+    if (!Thread.running) {
+        for (auto& output : outputs) {
+            if (output.transport && SDL_AtomicGet(&output.transportFailed)) { output.closeTransport(); }
+        }
+    }
+    if (traceTask.Valid() && traceTask.Done()) {
+        // empty if the trace couldn't be read
+        auto& report = traceTask.Get();
+        if (!report.empty()) { traceReport = std::move(report); }
+        traceTask = OFS_Task<std::string>();
+    }
 
-        ImGui::Separator();
+    // live positions and histograms of connected devices
+    if (std::any_of(outputs.begin(), outputs.end(), [](auto& output) { return output.isOpen(); })) {
+        OFS_Redraw::Request();
+    }
 
-        ImGui::TextUnformatted(TR(VIBRATION_LIMITS));
-        limitsGui(TChannel::V0);
-        limitsGui(TChannel::V1);
-        limitsGui(TChannel::V2);
+    ImGui::Begin(TR_ID("T_CODE", Tr::T_CODE), open, ImGuiWindowFlags_AlwaysAutoResize);
 
-        ImGui::Separator();
-    }
     if (ImGui::CollapsingHeader(TR(GLOBAL_SETTINGS)))
     {
         ImGui::InputFloat(TR(DELAY), (float*)&delay, 0.01f, 0.01f); OFS::Tooltip(TR(DELAY_TOOLTIP));
@@ -176,59 +305,327 @@ void TCodePlayer::DrawWindow(bool* open, float currentTime) noexcept
         OFS::Tooltip(TR(SPLINE_TOOLTIP));
         ImGui::SameLine(); ImGui::Checkbox(TR(REMAP), &TCodeChannel::RemapToFullRange);
         OFS::Tooltip(TR(REMAP_TOOLTIP));
+        ImGui::SameLine(); ImGui::Checkbox(TR(INTERVAL), &TCodeChannel::IntervalMode);
+        OFS::Tooltip(TR(INTERVAL_TOOLTIP));
     }
 
-    ImGui::Spacing(); ImGui::Separator(); ImGui::Spacing();
-    ImGui::TextUnformatted(TR(OUTPUTS));
-    ImGui::SameLine(); ImGui::TextDisabled("(?)");
-    OFS::Tooltip(TR(YOU_CAN_RIGHT_CLICK_SLIDERS_TOOLTIP));
-
-    for (int i = 0; i < tcode.channels.size(); i++) {
-        if(i == 4 || i == 7) ImGui::Spacing();
-        auto& c = tcode.channels[i];
-        if (!c.Enabled) continue;
-        auto& p = prod.producers[i];
-        ImGui::PushID(i);
-        if (OFS::BoundedSliderInt(c.Id, &c.NextTCodeValue, TCodeChannel::MinChannelValue, TCodeChannel::MaxChannelValue, c.limits[0], c.limits[1], "%d", ImGuiSliderFlags_AlwaysClamp));
-        if (ImGui::BeginPopupContextItem())
+    int32_t removeOutput = -1;
+    for (int32_t outputIdx = 0; outputIdx < outputs.size(); outputIdx++) {
+        auto& output = outputs[outputIdx];
+        auto& tcode = output.tcode;
+        char headerBuf[128];
+        stbsp_snprintf(headerBuf, sizeof(headerBuf), "%s %d: %s###Device%d", TR(DEVICE), outputIdx + 1,
+            output.isOpen() ? output.address.c_str() : "-", outputIdx);
+        ImGui::PushID(outputIdx);
+        if (!ImGui::CollapsingHeader(headerBuf, ImGuiTreeNodeFlags_DefaultOpen)) {
+            ImGui::PopID();
+            continue;
+        }
+
+        // the writer thread uses the transport, it can only be swapped while the player is stopped
+        ImGui::BeginDisabled(Thread.running);
+        ImGui::BeginDisabled(output.isOpen());
+        ImGui::Combo(TR(TRANSPORT), &output.transportType, TCodeTransport::TypeNames, static_cast<int32_t>(TCodeTransport::Type::TotalCount));
+        ImGui::EndDisabled();
+
+        if (output.transportType == static_cast<int32_t>(TCodeTransport::Type::Serial)) {
+            ImGui::Combo(TR(PORT), &output.selectedPort, [](void* data, int idx, const char** out_text) -> bool {
+                const char** port_list = (const char**)data;
+                *out_text = ((sp_port*)port_list[idx])->description;
+                return true;
+                }, port_list, port_count);
+            if (ImGui::IsItemClicked(ImGuiMouseButton_Left)) {
+                if (port_list != nullptr) {
+                    sp_free_port_list(port_list);
+                    port_list = nullptr;
+                }
+                if (sp_list_ports(&port_list) == SP_OK) {
+                    // count ports
+                    int x = 0;
+                    LOG_DEBUG("Available serial ports:\n");
+                    while (port_list[x] != NULL) {
+                        LOGF_DEBUG("%s\n", port_list[x]->description);
+                        x++;
+                    }
+                    port_count = x;
+                }
+            }
+            ImGui::SameLine();
+
+            if (port_list != nullptr
+                && port_list[0] != nullptr
+                && output.selectedPort < port_count
+                && port_list[output.selectedPort] != nullptr) {
+                if (ImGui::Button(TR(OPEN_PORT), ImVec2(-1.f, 0.f))) {
+                    output.address = port_list[output.selectedPort]->name;
+                    output.openTransport();
+                }
+            }
+        }
+        else if (output.transportType == static_cast<int32_t>(TCodeTransport::Type::Loopback)) {
+            if (!output.isOpen() && ImGui::Button(TR(OPEN_PORT), ImVec2(-1.f, 0.f))) {
+                output.openTransport();
+            }
+        }
+        else {
+            ImGui::InputText(TR(ADDRESS), &output.address);
+            OFS::Tooltip(TR(TCODE_ADDRESS_TOOLTIP));
+            if (!output.isOpen() && ImGui::Button(TR(OPEN_PORT), ImVec2(-1.f, 0.f))) {
+                output.openTransport();
+            }
+        }
+        if (output.isOpen() && ImGui::Button(TR(CLOSE_PORT), ImVec2(-1.f, 0.f))) {
+            output.closeTransport();
+        }
+        ImGui::EndDisabled();
+        if (output.isOpen() && output.transport->GetType() == TCodeTransport::Type::Loopback) {
+            auto loopback = static_cast<TCodeLoopbackTransport*>(output.transport.get());
+            ImGui::Text("%s: %zu", TR(RECORDED_COMMANDS), loopback->RecordCount());
+            ImGui::SameLine();
+            if (ImGui::SmallButton(TR(CLEAR))) { loopback->TakeRecords(); }
+        }
+        ImGui::InputFloat(TR(DELAY), &output.delay, 0.01f, 0.01f);
+        output.delay = std::max(output.delay, 0.f);
+        OFS::Tooltip(TR(DEVICE_DELAY_TOOLTIP));
+
+        if (ImGui::CollapsingHeader(TR_ID("ChannelLimits", Tr::LIMITS)))
         {
-            ImGui::MenuItem(TR(INVERT), NULL, &c.Invert);
-            ImGui::MenuItem(TR(REBALANCE), NULL, &c.Rebalance); OFS::Tooltip(TR(REBALANCE_TOOLTIP));
+            auto limitsGui = [&tcode](TChannel chan) noexcept {
+                char buf[32];
+                auto& c = tcode.Get(chan);
+                float availWidth = ImGui::GetContentRegionAvail().x;
+
+                ImGui::SetNextItemWidth(availWidth * 0.6f);
+                stbsp_snprintf(buf, sizeof(buf),"##%s_Limit", c.Id);
+                ImGui::DragIntRange2(buf,
+                    &c.limits[0], &c.limits[1], 1,
+                    TCodeChannel::MinChannelValue, TCodeChannel::MaxChannelValue,
+                    TR(MIN_INT_FMT), TR(MAX_INT_FMT), ImGuiSliderFlags_AlwaysClamp);
+
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(0.3f * availWidth);
+                stbsp_snprintf(buf, sizeof(buf), "%-6s (%s)##%s_Enable", TCodeChannels::Aliases[static_cast<int32_t>(chan)][2], c.Id, c.Id);
+                ImGui::Checkbox(buf, &c.Enabled);
+
+                ImGui::SetNextItemWidth(availWidth * 0.3f);
+                stbsp_snprintf(buf, sizeof(buf), "##%s_MaxSpeed", c.Id);
+                ImGui::DragFloat(buf, &c.MaxSpeed, 5.f, 0.f, 5000.f, TR(MAX_SPEED_FMT), ImGuiSliderFlags_AlwaysClamp);
+                OFS::Tooltip(TR(MOTION_LIMITS_TOOLTIP));
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(availWidth * 0.3f);
+                stbsp_snprintf(buf, sizeof(buf), "##%s_MaxAccel", c.Id);
+                ImGui::DragFloat(buf, &c.MaxAcceleration, 50.f, 0.f, 100000.f, TR(MAX_ACCELERATION_FMT), ImGuiSliderFlags_AlwaysClamp);
+                OFS::Tooltip(TR(MOTION_LIMITS_TOOLTIP));
+            };
+
+            ImGui::TextUnformatted(TR(LINEAR_LIMITS));
+            limitsGui(TChannel::L0);
+            limitsGui(TChannel::L1);
+            limitsGui(TChannel::L2);
+            limitsGui(TChannel::L3);
+
+            ImGui::Separator();
+
+            ImGui::TextUnformatted(TR(ROTATION_LIMITS));
+            limitsGui(TChannel::R0);
+            limitsGui(TChannel::R1);
+            limitsGui(TChannel::R2);
+
+            ImGui::Separator();
+
+            ImGui::TextUnformatted(TR(VIBRATION_LIMITS));
+            limitsGui(TChannel::V0);
+            limitsGui(TChannel::V1);
+            limitsGui(TChannel::V2);
+
             ImGui::Separator();
-            auto activeIdx = prod.GetProd(static_cast<TChannel>(i)).ScriptIdx();
-            
-            for (int32_t scriptIdx = 0; scriptIdx < prod.LoadedScripts.size(); scriptIdx++) {
-                if (auto& script = prod.LoadedScripts[scriptIdx]) {
-                    if (ImGui::MenuItem(script->Title.c_str(), NULL, scriptIdx == activeIdx))
-                    {
-                        if (scriptIdx != activeIdx) { p.SetScript(scriptIdx); }
-                        else { p.SetScript(-2); } // -1 for uninitialized & -2 for unset
-                        break;
+        }
+
+        ImGui::Spacing();
+        ImGui::TextUnformatted(TR(OUTPUTS));
+        ImGui::SameLine(); ImGui::TextDisabled("(?)");
+        OFS::Tooltip(TR(YOU_CAN_RIGHT_CLICK_SLIDERS_TOOLTIP));
+
+        for (int i = 0; i < tcode.channels.size(); i++) {
+            if(i == 4 || i == 7) ImGui::Spacing();
+            auto& c = tcode.channels[i];
+            auto& l = output.live.channels[i];
+            if (!c.Enabled) continue;
+            ImGui::PushID(i);
+            // the tcode thread owns the live position while it runs
+            int32_t value = l.NextTCodeValue;
+            if (OFS::BoundedSliderInt(c.Id, &value, TCodeChannel::MinChannelValue, TCodeChannel::MaxChannelValue, c.limits[0], c.limits[1], "%d", ImGuiSliderFlags_AlwaysClamp)
+                && !Thread.running) {
+                l.NextTCodeValue = value;
+            }
+            if (ImGui::BeginPopupContextItem())
+            {
+                ImGui::MenuItem(TR(INVERT), NULL, &c.Invert);
+                ImGui::MenuItem(TR(REBALANCE), NULL, &c.Rebalance); OFS::Tooltip(TR(REBALANCE_TOOLTIP));
+                ImGui::Separator();
+                if (ImGui::BeginMenu(TR(SOURCE))) {
+                    for (int32_t source = 0; source < TCodeOutput::ChannelCount; source++) {
+                        if (ImGui::MenuItem(TCodeChannels::Aliases[source][2], TCodeChannels::Aliases[source][1], output.channelMap[i] == source)) {
+                            output.channelMap[i] = source;
+                        }
+                    }
+                    ImGui::EndMenu();
+                }
+                ImGui::Separator();
+
+                // the script is picked for the source producer which is shared by all devices
+                // the tcode thread ticks those producers, they can only be changed while it's stopped
+                auto& p = prod.producers[output.channelMap[i]];
+                auto activeIdx = p.ScriptIdx();
+                ImGui::BeginDisabled(Thread.running);
+                for (int32_t scriptIdx = 0; scriptIdx < prod.LoadedScripts.size(); scriptIdx++) {
+                    if (auto& script = prod.LoadedScripts[scriptIdx]) {
+                        if (ImGui::MenuItem(script->Title.c_str(), NULL, scriptIdx == activeIdx))
+                        {
+                            if (scriptIdx != activeIdx) { p.SetScript(scriptIdx); }
+                            else { p.SetScript(-2); } // -1 for uninitialized & -2 for unset
+                            break;
+                        }
                     }
                 }
+                ImGui::EndDisabled();
+                ImGui::EndPopup();
+            }
+            ImGui::SameLine(); ImGui::Text(" " ICON_ARROW_RIGHT " %s", l.LastCommand);
+            if (ImGui::IsItemHovered()) {
+                ImGui::BeginTooltip();
+                ImGui::TextUnformatted(TCodeChannels::Aliases[i][2]);
+                ImGui::EndTooltip();
             }
-            ImGui::EndPopup();
+
+            ImGui::PopID();
         }
-        ImGui::SameLine(); ImGui::Text(" " ICON_ARROW_RIGHT " %s", c.LastCommand);
-        if (ImGui::IsItemHovered()) {
-            ImGui::BeginTooltip();
-            ImGui::TextUnformatted(TCodeChannels::Aliases[i][2]);
-            ImGui::EndTooltip();
+
+        ImGui::Spacing();
+        if (ImGui::TreeNode(TR(STATISTICS))) {
+            DrawHistogram(TR(TCODE_QUEUE_DEPTH), output.queueDepth);
+            DrawHistogram(TR(TCODE_WRITE_LATENCY), output.writeLatency);
+            ImGui::Text("%s: %d", TR(TCODE_DROPPED_COMMANDS), SDL_AtomicGet(&output.droppedCommands));
+            ImGui::Text("%s: %d", TR(TCODE_STALLED_WRITES), SDL_AtomicGet(&output.stalledWrites));
+            if (ImGui::Button(TR(RESET), ImVec2(-1.f, 0.f))) {
+                output.queueDepth.Reset();
+                output.writeLatency.Reset();
+                SDL_AtomicSet(&output.droppedCommands, 0);
+                SDL_AtomicSet(&output.stalledWrites, 0);
+            }
+
+            ImGui::Separator();
+            ImGui::BeginDisabled(!traceTask.Done());
+            if (!Thread.running && ImGui::Button(TR(TCODE_RENDER_TRACE), ImVec2(-1.f, 0.f))) {
+                Util::SaveFileDialog(TR(TCODE_RENDER_TRACE), "tcode_trace.txt", [this, outputIdx](auto& result) {
+                    if (result.files.empty() || Thread.running || outputIdx >= outputs.size() || !traceTask.Done()) return;
+                    // the whole script gets rendered, that's too slow for the ui thread
+                    auto producer = CopyScripts(prod);
+                    auto output = CopySettings(outputs[outputIdx]);
+                    float rate = tickrate;
+                    traceTask = OFS_TaskScheduler::Spawn([producer, output, rate, path = result.files.front()]() {
+                        TCodeTrace trace;
+                        trace.Render(*producer, *output, rate);
+                        trace.Save(path);
+                        OFS_Redraw::Request();
+                        return trace.Report(*producer, *output);
+                    }, OFS_TaskPriority::Background);
+                }, { "*.txt" }, "TCode trace (*.txt)");
+            }
+            ImGui::EndDisabled();
+            OFS::Tooltip(TR(TCODE_RENDER_TRACE_TOOLTIP));
+            if (output.isOpen() && output.transport->GetType() == TCodeTransport::Type::Loopback
+                && ImGui::Button(TR(TCODE_SAVE_RECORDING), ImVec2(-1.f, 0.f))) {
+                auto trace = std::make_shared<TCodeTrace>();
+                trace->FromRecords(static_cast<TCodeLoopbackTransport*>(output.transport.get())->TakeRecords());
+                Util::SaveFileDialog(TR(TCODE_SAVE_RECORDING), "tcode_recording.txt", [trace](auto& result) {
+                    if (result.files.empty()) return;
+                    trace->Save(result.files.front());
+                }, { "*.txt" }, "TCode trace (*.txt)");
+            }
+            ImGui::BeginDisabled(!traceTask.Done());
+            if (ImGui::Button(TR(TCODE_ANALYZE_TRACE), ImVec2(-1.f, 0.f))) {
+                Util::OpenFileDialog(TR(TCODE_ANALYZE_TRACE), "", [this, outputIdx](auto& result) {
+                    if (result.files.empty() || outputIdx >= outputs.size() || !traceTask.Done()) return;
+                    // the tcode thread may be ticking the live producers
+                    auto producer = CopyScripts(prod);
+                    auto output = CopySettings(outputs[outputIdx]);
+                    traceTask = OFS_TaskScheduler::Spawn([producer, output, path = result.files.front()]() {
+                        TCodeTrace trace;
+                        if (!trace.Load(path)) return std::string();
+                        OFS_Redraw::Request();
+                        return trace.Report(*producer, *output);
+                    }, OFS_TaskPriority::Background);
+                }, false, { "*.txt" }, "TCode trace (*.txt)");
+            }
+            ImGui::EndDisabled();
+            OFS::Tooltip(TR(TCODE_ANALYZE_TRACE_TOOLTIP));
+            ImGui::TreePop();
         }
 
+        if (!Thread.running && outputs.size() > 1 && ImGui::Button(TR(REMOVE), ImVec2(-1.f, 0.f))) {
+            removeOutput = outputIdx;
+        }
         ImGui::PopID();
     }
+
+    if (removeOutput >= 0) {
+        outputs[removeOutput].closeTransport();
+        outputs.erase(outputs.begin() + removeOutput);
+    }
+    if (!Thread.running && ImGui::Button(TR(ADD_DEVICE), ImVec2(-1.f, 0.f))) {
+        outputs.emplace_back();
+    }
+
+    ImGui::Spacing(); ImGui::Separator(); ImGui::Spacing();
+    if (ImGui::CollapsingHeader(TR(STATISTICS))) {
+        DrawHistogram(TR(TCODE_TICK_JITTER), Thread.tickJitter);
+        auto clockStats = Thread.clock.GetStats();
+        ImGui::Text("%s: %.2f ms / %.2f ms", TR(TCODE_CLOCK_ERROR), clockStats.meanAbsError * 1000.0, clockStats.maxAbsError * 1000.0);
+        OFS::Tooltip(TR(TCODE_CLOCK_ERROR_TOOLTIP));
+        ImGui::Text("%s: %d", TR(TCODE_CLOCK_RESETS), clockStats.discontinuities);
+        if (ImGui::Button(TR(RESET), ImVec2(-1.f, 0.f))) {
+            Thread.tickJitter.Reset();
+            Thread.clock.ResetStats();
+        }
+        if (ImGui::Checkbox(TR(TCODE_RECORD_CLOCK), &recordClock) && recordClock) {
+            clockSamples.clear();
+        }
+        OFS::Tooltip(TR(TCODE_RECORD_CLOCK_TOOLTIP));
+        if (!clockSamples.empty()) {
+            ImGui::SameLine();
+            ImGui::Text("%d", (int32_t)clockSamples.size());
+            if (ImGui::Button(TR(TCODE_SAVE_CLOCK_SAMPLES), ImVec2(-1.f, 0.f))) {
+                auto samples = std::make_shared<std::vector<TCodeClockSample>>(clockSamples);
+                Util::SaveFileDialog(TR(TCODE_SAVE_CLOCK_SAMPLES), "tcode_clock.txt", [samples](auto& result) {
+                    if (result.files.empty()) return;
+                    TCodeTrace::SaveClockSamples(result.files.front(), *samples);
+                }, { "*.txt" }, "Clock samples (*.txt)");
+            }
+        }
+        if (!traceReport.empty()) {
+            ImGui::Separator();
+            ImGui::TextUnformatted(TR(TCODE_TRACE_FIDELITY));
+            OFS::Tooltip(TR(TCODE_TRACE_FIDELITY_TOOLTIP));
+            ImGui::TextUnformatted(traceReport.c_str());
+        }
+    }
     ImGui::Spacing();
     
+    for (auto& output : outputs) {
+        output.publishSettings();
+    }
     if (!Thread.running) {
         // move to the current position
+        for (auto& output : outputs) { output.applySettings(); }
+        UpdateMotionLimits(*this);
         prod.sync(currentTime, 1.f);
         prod.tick(currentTime, 1.f);
-        const char* cmd = tcode.GetCommandSpeed(500);
-        if (cmd != nullptr && port != nullptr) {
-            int len = strlen(cmd);
-            if (sp_blocking_write(port, cmd, len, 0) < SP_OK) {
-                LOG_ERROR("Failed to write to serial port.");
+        for (auto& output : outputs) {
+            output.update(prod);
+            const char* cmd = output.live.GetCommandSpeed(500);
+            if (cmd != nullptr && output.isOpen() && !output.transport->WriteAll(cmd, strlen(cmd))) {
+                output.closeTransport();
             }
         }
     }
@@ -237,83 +634,147 @@ void TCodePlayer::DrawWindow(bool* open, float currentTime) noexcept
 }
 
 
-static int32_t TCodeThread(void* threadData) noexcept {
-    TCodeThreadData* data = (TCodeThreadData*)threadData;
+static void TCodeWriterThread(TCodeOutput* output) noexcept {
+    int32_t written = 0;
+
+    while (!output->writerStop.value.load(std::memory_order_acquire)) {
+        auto cmd = output->queue.Front();
+        if (cmd == nullptr) {
+            SDL_SemWaitTimeout(output->writeSem, 10);
+            continue;
+        }
+
+        auto transport = output->transport.get();
+        if (transport == nullptr || SDL_AtomicGet(&output->transportFailed)) {
+            output->queue.Pop();
+            written = 0;
+            continue;
+        }
+
+        if (written == 0 && transport->GetType() == TCodeTransport::Type::Loopback) {
+            static_cast<TCodeLoopbackTransport*>(transport)->SetMediaTime(cmd->mediaTime);
+        }
+
+        int32_t result = transport->Write(cmd->data + written, cmd->length - written);
+        if (result < 0) {
+            // don't keep writing to a dead device every tick
+            SDL_AtomicSet(&output->transportFailed, 1);
+            output->queue.Pop();
+            written = 0;
+            continue;
+        }
+
+        written += result;
+        if (written < cmd->length) {
+            // the output buffer is full, give the device time to catch up
+            SDL_AtomicAdd(&output->stalledWrites, 1);
+            SDL_Delay(1);
+            continue;
+        }
+
+        auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(TCodeClock::now().time_since_epoch()).count();
+        output->writeLatency.Add((int32_t)((now - cmd->enqueuedNs) / 1000));
+        output->queue.Pop();
+        written = 0;
+    }
+}
+
+void TCodeOutput::startWriter() noexcept
+{
+    if (writeSem == nullptr) { writeSem = SDL_CreateSemaphore(0); }
+    queue.Clear();
+    writerStop.value.store(false, std::memory_order_relaxed);
+    writer = OFS_TaskScheduler::SpawnLongRunning("TCodeWriter", [this]() { TCodeWriterThread(this); });
+}
+
+void TCodeOutput::stopWriter() noexcept
+{
+    if (!writer.Valid()) return;
+    writerStop.value.store(true, std::memory_order_release);
+    SDL_SemPost(writeSem);
+    writer.Wait();
+    writer = OFS_Task<void>();
+}
+
+void TCodeOutput::send(int64_t timeNs, double mediaTime) noexcept
+{
+    const char* cmd = live.GetCommand();
+    if (cmd == nullptr) return;
+
+    queueDepth.Add(queue.Size());
+    if (queue.Push(cmd, strlen(cmd), timeNs, mediaTime)) {
+        SDL_SemPost(writeSem);
+    }
+    else {
+        // resend every channel once there's room again
+        SDL_AtomicAdd(&droppedCommands, 1);
+        for (auto& c : live.channels) { c.LastTCodeValue = -1; }
+    }
+}
+
+static void TCodeThread(TCodeThreadData* data) noexcept {
 
     LOG_INFO("T-Code thread started...");
 
-    float currentTime;
-    {
-        int32_t tmp = SDL_AtomicGet(&data->scriptTime);
-        float scriptTime = *((float*)&tmp) - data->player->delay;
-        data->producer->sync(scriptTime, data->player->tickrate);
-        currentTime = scriptTime;
+    auto& outputs = data->player->outputs;
+    for (auto& output : outputs) {
+        output.startWriter();
     }
 
-    constexpr float maxError = 0.03f;
-    bool correctError = false;
+    data->clock.Update();
+    data->producer->sync(data->clock.Time(TCodeClock::now()) - data->player->delay, data->player->tickrate);
 
-    auto startTimePoint = std::chrono::high_resolution_clock::now();
-    auto currentTimePoint = startTimePoint;
+    auto deadline = TCodeClock::now();
 
-    while (!data->requestStop) {
+    while (!data->requestStop.load(std::memory_order_acquire)) {
         float tickrate = data->player->tickrate;
         float tickDurationSeconds = 1.f / tickrate;
         
 
-        float delay = data->player->delay;
-        int32_t data_tmp = SDL_AtomicGet(&data->scriptTime);
-        float actualScriptTime = (*(float*)&data_tmp) - delay;
-        
-        std::chrono::duration<float> duration = startTimePoint - currentTimePoint;
-        currentTimePoint = std::chrono::high_resolution_clock::now();
-        currentTime += (duration.count() * data->speed);
-        
-        float playbackError = currentTime - actualScriptTime;
-        if (std::abs(playbackError) >= maxError && !correctError) {
-            // correct error
-            correctError = true;
-            LOG_DEBUG("T-Code: correcting playback error...");
-        }
-
-        if (playbackError >= maxError * 100) {
-            currentTime -= playbackError;
+        auto tickTime = TCodeClock::now();
+        bool discontinuity = data->clock.Update();
+        float currentTime = (float)data->clock.Time(tickTime) - data->player->delay;
+        if (discontinuity) {
+            // seek or speed change, the current stroke is interrupted
+            for (auto& p : data->producer->producers) { p.NeedsResync = true; }
             data->producer->sync(currentTime, tickrate);
-            LOG_DEBUG("T-Code: resync");
-        }
-
-        if (correctError) {
-            currentTime -= playbackError * (1.f / tickrate);
-            if (std::abs(currentTime - actualScriptTime) < 0.01f) {
-                correctError = false;
-                LOG_DEBUG("T-Code: playback error corrected!");
-            }
         }
 
-        data->producer->tick(currentTime, tickrate);
+        for (auto& output : outputs) { output.applySettings(); }
+        UpdateMotionLimits(*data->player);
+        data->producer->tick(currentTime, tickrate, data->clock.Rate());
         
         // update channels
-        const char* cmd = data->channel->GetCommand();
-        if (cmd != nullptr && data->player->port != nullptr) {
-            int len = strlen(cmd);
-            if (sp_blocking_write(data->player->port, cmd, len, 0) < SP_OK) {
-                LOG_ERROR("Failed to write to serial port.");
+        auto tickNs = std::chrono::duration_cast<std::chrono::nanoseconds>(tickTime.time_since_epoch()).count();
+        for (auto& output : outputs) {
+            // the device delay shifts the time it gets sampled at, the queue only buffers writes
+            float outputTime = currentTime - output.applied->delay;
+            auto& prod = output.producerFor(*data->producer, discontinuity);
+            if (&prod != data->producer) {
+                prod.tick(outputTime, tickrate, data->clock.Rate());
             }
+            output.update(prod);
+            output.send(tickNs, outputTime);
         }
 
-        while((duration = std::chrono::high_resolution_clock::now() - currentTimePoint).count() < tickDurationSeconds) {
-            /* Spin wait */
-            OFS_PAUSE_INTRIN();
-            int ms = (duration.count() / 0.001f) - 1;
-            if (ms > 0) { SDL_Delay(ms); }
+        auto tickDuration = std::chrono::duration_cast<TCodeClock::duration>(std::chrono::duration<float>(tickDurationSeconds));
+        deadline += tickDuration;
+        if (TCodeClock::now() - deadline > tickDuration) {
+            // too far behind, don't try to catch up
+            deadline = TCodeClock::now();
         }
-        startTimePoint = std::chrono::high_resolution_clock::now();
+        WaitUntil(deadline);
+        data->tickJitter.Add((int32_t)ToMicroseconds(TCodeClock::now() - deadline));
     } 
-    data->running = false;
-    data->requestStop = false;
-    LOG_INFO("T-Code thread stopped.");
 
-    return 0;
+    for (auto& output : outputs) {
+        output.stopWriter();
+        output.delayedProd.reset();
+    }
+
+    data->requestStop.store(false, std::memory_order_relaxed);
+    data->running.store(false, std::memory_order_release);
+    LOG_INFO("T-Code thread stopped.");
 }
 
 void TCodePlayer::setScripts(std::vector<std::shared_ptr<const Funscript>>&& scripts) noexcept
@@ -341,44 +802,69 @@ void TCodePlayer::setScripts(std::vector<std::shared_ptr<const Funscript>>&& scr
             }
         }
     }
-    prod.SetChannels(&tcode);
 }
 
 void TCodePlayer::play(float currentTime, std::vector<std::shared_ptr<const Funscript>>&& scripts) noexcept
 {
     OFS_PROFILE(__FUNCTION__);
 #ifdef NDEBUG
-    // in release we only start the thread if a serial port is connected
-    if (!this->port) return;    
+    // in release we only start the thread if a device is connected
+    bool anyPort = std::any_of(outputs.begin(), outputs.end(), [](auto& output) { return output.isOpen(); });
+    if (!anyPort) return;
 #endif
-    if (!Thread.running) {
-        Thread.running = true;
+    if (!Thread.running.load(std::memory_order_acquire)) {
+        Thread.running.store(true, std::memory_order_relaxed);
         Thread.player = this;
-        Thread.channel = &this->tcode;
-        SDL_AtomicSet(&Thread.scriptTime, *((int*)&currentTime));
+        auto now = TCodeClock::now();
+        Thread.clock.Reset(currentTime, Thread.clock.Rate(), now);
+        recordClockSample(now, currentTime, Thread.clock.Rate(), true);
         Thread.producer = &this->prod;
-        tcode.reset();
+        for (auto& output : outputs) {
+            output.publishSettings();
+            output.applySettings();
+            output.live.reset();
+        }
         
         setScripts(std::move(scripts));
-        auto t = SDL_CreateThread(TCodeThread, "TCodePlayer", &Thread);
-        SDL_DetachThread(t);
+        // the tick loop sleeps between ticks, it gets its own thread instead of a worker
+        Thread.task = OFS_TaskScheduler::SpawnLongRunning("TCodePlayer", []() { TCodeThread(&Thread); });
     }
 }
 
 void TCodePlayer::stop() noexcept
 {
     OFS_PROFILE(__FUNCTION__);
-    if (Thread.running) {
-        Thread.requestStop = true;
-        while (!Thread.running) { SDL_Delay(1); }
+    if (Thread.running.load(std::memory_order_acquire)) {
+        Thread.requestStop.store(true, std::memory_order_release);
+        Thread.task.Wait();
     }
 }
 
-void TCodePlayer::sync(float currentTime, float speed) noexcept
+void TCodePlayer::sync(float currentTime, float speed, uint32_t seekCount) noexcept
 {
     OFS_PROFILE(__FUNCTION__);
-    Thread.speed = speed;
-    SDL_AtomicSet(&Thread.scriptTime, *((int*)&currentTime));
+    auto now = TCodeClock::now();
+    bool seeked = seekCount != lastSeekCount;
+    lastSeekCount = seekCount;
+    if (seeked) {
+        Thread.clock.Reset(currentTime, speed, now);
+    }
+    else {
+        Thread.clock.Push(currentTime, speed, now);
+    }
+    recordClockSample(now, currentTime, speed, seeked);
+}
+
+void TCodePlayer::recordClockSample(TCodeClock::time_point hostTime, float currentTime, float speed, bool reset) noexcept
+{
+    if (!recordClock) return;
+    if (clockSamples.size() >= MaxClockSamples) {
+        recordClock = false;
+        LOG_WARN("Stopped recording clock samples, the limit was reached.");
+        return;
+    }
+    std::chrono::duration<double> host = hostTime.time_since_epoch();
+    clockSamples.emplace_back(TCodeClockSample{ host.count(), currentTime, speed, reset });
 }
 
 void TCodePlayer::reset() noexcept
@@ -1,28 +1,149 @@
 #pragma once
 #include "OFS_TCodeProducer.h"
+#include "OFS_TCodeQueue.h"
+#include "OFS_TCodeTransport.h"
+#include "OFS_TCodeClock.h"
 #include "OFS_Util.h"
+#include "OFS_TaskScheduler.h"
 #include "FunscriptAction.h"
 
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+
+// a single device with its own transport, channel settings and writer thread
+// the producers are shared so every script is only evaluated once per tick
+class TCodeOutput {
+public:
+	static constexpr int32_t ChannelCount = static_cast<int32_t>(TChannel::TotalCount);
+
+	// TCodeTransport::Type
+	int32_t transportType = 0;
+	// serial port name, host:port or socket path
+	std::string address;
+	// only swapped while the player isn't running, the writer thread uses it without a lock
+	std::unique_ptr<TCodeTransport> transport;
+	// set by the writer after a hard error, the transport gets closed once the player stopped
+	SDL_atomic_t transportFailed = { 0 };
+	int32_t selectedPort = 0;
+
+	// edited by the ui, the tcode thread reads the published copy
+	TCodeChannels tcode;
+	// producer which drives each channel of this device
+	std::array<int32_t, ChannelCount> channelMap;
+	// seconds added on top of the global delay
+	float delay = 0.f;
+
+	struct Settings {
+		std::array<TCodeChannel::Settings, ChannelCount> channels;
+		std::array<int32_t, ChannelCount> channelMap;
+		float delay = 0.f;
+
+		inline bool operator==(const Settings& other) const noexcept
+		{
+			return channels == other.channels && channelMap == other.channelMap && delay == other.delay;
+		}
+	};
+	// only ever accessed through std::atomic_load/std::atomic_store
+	std::shared_ptr<const Settings> published;
+
+	// owned by the tcode thread while it runs, by the main thread otherwise
+	// positions and commands live here so the ui never races the value tables
+	TCodeChannels live;
+	std::shared_ptr<const Settings> applied;
+	// a delayed device samples the scripts at its own time and producers keep per stroke state
+	// so it gets its own while the tcode thread runs, everything else shares the player's
+	std::unique_ptr<TCodeProducer> delayedProd;
+
+	// the tick thread produces commands and the writer thread sends them
+	// a slow device only backs up its own queue instead of delaying ticks
+	TCodeCommandQueue queue;
+	struct SDL_semaphore* writeSem = nullptr;
+	OFS_Task<void> writer;
+	// outputs only get moved while their writer is stopped, the flag stays behind
+	struct StopFlag {
+		std::atomic<bool> value = { false };
+		StopFlag() noexcept = default;
+		StopFlag(StopFlag&&) noexcept {}
+		inline StopFlag& operator=(StopFlag&&) noexcept { return *this; }
+	};
+	StopFlag writerStop;
+
+	TCodeHistogram queueDepth;
+	TCodeHistogram writeLatency; // us
+	SDL_atomic_t droppedCommands = { 0 };
+	SDL_atomic_t stalledWrites = { 0 };
+
+	TCodeOutput() noexcept;
+
+	bool openTransport() noexcept;
+	void closeTransport() noexcept;
+	inline bool isOpen() const noexcept
+	{
+		return transport && transport->IsOpen() && !SDL_AtomicGet((SDL_atomic_t*)&transportFailed);
+	}
+
+	void startWriter() noexcept;
+	void stopWriter() noexcept;
+
+	Settings getSettings() const noexcept;
+	// main thread, publishes the ui settings if they changed
+	void publishSettings() noexcept;
+	// picks up the last published settings for the live channels
+	void applySettings() noexcept;
+
+	// copies the producer values into the live channels of this device
+	void update(const TCodeProducer& prod) noexcept;
+	// adds the limits of the channels driven by each producer
+	// from the ui settings, applyLiveMotionLimits uses the applied ones
+	void applyMotionLimits(TCodeProducer& prod) const noexcept;
+	void applyLiveMotionLimits(TCodeProducer& prod) const noexcept;
+	// tcode thread, the producers this device reads from at its delay
+	TCodeProducer& producerFor(TCodeProducer& shared, bool discontinuity) noexcept;
+	// queues the changed channels for the writer thread
+	void send(int64_t timeNs, double mediaTime) noexcept;
+
+	template <class Archive>
+	inline void reflect(Archive& ar) {
+		OFS_REFLECT(transportType, ar);
+		OFS_REFLECT(address, ar);
+		OFS_REFLECT(tcode, ar);
+		OFS_REFLECT(channelMap, ar);
+		OFS_REFLECT(delay, ar);
+	}
+};
 
 class TCodePlayer {
 	std::string loadPath;
+	uint32_t lastSeekCount = 0;
+	void recordClockSample(TCodeClockSync::Clock::time_point hostTime, float currentTime, float speed, bool reset) noexcept;
 public:
-	int current_port = 0;
 	int port_count = 0;
 	struct sp_port** port_list = nullptr;
-	struct sp_port* port = nullptr;
 
 	volatile int32_t tickrate = 250;
 	volatile float delay = 0;
 
-	TCodeChannels tcode;
+	// outputs can only be added or removed while the player isn't running
+	std::vector<TCodeOutput> outputs;
 	TCodeProducer prod;
 
+	// fidelity of the last rendered or analyzed trace
+	std::string traceReport;
+	// renders on a worker with copies of the producers and device settings, returns the report
+	OFS_Task<std::string> traceTask;
+
+	// positions handed to the clock, saved for --tcode-clock-replay
+	static constexpr size_t MaxClockSamples = 1000000;
+	bool recordClock = false;
+	std::vector<TCodeClockSample> clockSamples;
+
 	TCodePlayer() noexcept;
 	~TCodePlayer() noexcept;
-	
-	bool openPort(struct sp_port* port) noexcept;
-	void loadSettings(const std::string& path) noexcept;
+
+	// readOnly settings never get written back, for headless tools
+	void loadSettings(const std::string& path, bool readOnly = false) noexcept;
 	void save() noexcept;
 
 	void DrawWindow(bool* open, float currentTimeMs) noexcept;
@@ -30,15 +151,17 @@ public:
 	void setScripts(std::vector<std::shared_ptr<const Funscript>>&& scripts) noexcept;
 	void play(float currentTime, std::vector<std::shared_ptr<const Funscript>>&& scripts) noexcept;
 	void stop() noexcept;
-	void sync(float currentTime, float speed) noexcept;
+	// seekCount changes with every seek, the clock resets instead of smoothing over the jump
+	void sync(float currentTime, float speed, uint32_t seekCount) noexcept;
 	void reset() noexcept;
 
 	template <class Archive>
 	inline void reflect(Archive& ar) {
-		OFS_REFLECT(tcode, ar);
+		OFS_REFLECT(outputs, ar);
 		OFS_REFLECT(tickrate, ar);
 		OFS_REFLECT(delay, ar);
 		OFS_REFLECT_NAMED("SplineMode", TCodeChannel::SplineMode, ar);
 		OFS_REFLECT_NAMED("RemapToFullRange", TCodeChannel::RemapToFullRange, ar);
+		OFS_REFLECT_NAMED("IntervalMode", TCodeChannel::IntervalMode, ar);
 	}
 };
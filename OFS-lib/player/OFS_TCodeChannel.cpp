@@ -2,6 +2,7 @@
 
 bool TCodeChannel::SplineMode = false;
 bool TCodeChannel::RemapToFullRange = false;
+bool TCodeChannel::IntervalMode = false;
 
 std::array<const std::vector<const char*>, static_cast<size_t>(TChannel::TotalCount)> TCodeChannels::Aliases
 {
@@ -5,6 +5,7 @@
 #include "OFS_Reflection.h"
 
 #include <array>
+#include <algorithm>
 
 #include "EASTL/string.h"
 
@@ -14,20 +15,82 @@ public:
 	char Id[3] = "\0";
 	int32_t LastTCodeValue = -1;
 	int32_t NextTCodeValue = -1;
+	// time in ms the device should take to reach NextTCodeValue
+	// 0 sends a plain position
+	int32_t NextInterval = 0;
 
 	char LastCommand[16] = "?????\0";
 
 	static constexpr int32_t MaxChannelValue = 999;
 	static constexpr int32_t MinChannelValue = 0;
 	std::array<int32_t, 2> limits = { MinChannelValue, MaxChannelValue };
+	// physical limits of the device in script units (0 to 100) per second, 0 disables them
+	float MaxSpeed = 0.f;
+	float MaxAcceleration = 0.f;
 	
 	static bool SplineMode;
 	static bool RemapToFullRange;
+	static bool IntervalMode;
 
 	bool Enabled = true;
 	bool Rebalance = false;
 	bool Invert = false;
 
+	// everything the user can change, the tcode thread only sees published copies of it
+	struct Settings {
+		std::array<int32_t, 2> limits;
+		float MaxSpeed;
+		float MaxAcceleration;
+		bool Enabled;
+		bool Rebalance;
+		bool Invert;
+
+		inline bool operator==(const Settings& other) const noexcept
+		{
+			return limits == other.limits && MaxSpeed == other.MaxSpeed && MaxAcceleration == other.MaxAcceleration
+				&& Enabled == other.Enabled && Rebalance == other.Rebalance && Invert == other.Invert;
+		}
+	};
+
+	inline Settings GetSettings() const noexcept
+	{
+		return Settings{ limits, MaxSpeed, MaxAcceleration, Enabled, Rebalance, Invert };
+	}
+
+	// the position is kept and the value table gets rebuilt on the next SetNextPos
+	inline void CopySettings(const Settings& settings) noexcept
+	{
+		limits = settings.limits;
+		MaxSpeed = settings.MaxSpeed;
+		MaxAcceleration = settings.MaxAcceleration;
+		Enabled = settings.Enabled;
+		Rebalance = settings.Rebalance;
+		Invert = settings.Invert;
+	}
+
+private:
+	// GetPos for every relative position in steps of 1/ValueTableSize with Invert applied
+	// rebuilt whenever limits, Invert or Rebalance change
+	static constexpr int32_t ValueTableSize = 1024;
+	std::array<int16_t, ValueTableSize + 1> valueTable;
+	std::array<int32_t, 2> tableLimits = { -1, -1 };
+	bool tableRebalance = false;
+	bool tableInvert = false;
+
+	inline void prepareValueTable() noexcept
+	{
+		if (tableLimits == limits && tableRebalance == Rebalance && tableInvert == Invert) return;
+		tableLimits = limits;
+		tableRebalance = Rebalance;
+		tableInvert = Invert;
+		for (int32_t i = 0; i <= ValueTableSize; i++) {
+			float relative = (float)i / ValueTableSize;
+			if (Invert) { relative = 1.f - relative; }
+			valueTable[i] = (int16_t)GetPos(relative);
+		}
+	}
+public:
+
 	inline void SetId(const char id[3]) noexcept {
 		strcpy(Id, id);
 	}
@@ -53,16 +116,51 @@ public:
 		return tcodeVal;
 	}
 
+	// inverse of GetPos including Invert
+	inline float GetRelative(int32_t tcodeVal) const noexcept
+	{
+		auto ratio = [](float value, float from, float to) noexcept {
+			return to != from ? (value - from) / (to - from) : 0.f;
+		};
+		float relative;
+		if (Rebalance)
+		{
+			relative = tcodeVal < 500
+				? ratio(tcodeVal, limits[0], 500) * 0.5f
+				: 0.5f + ratio(tcodeVal, 500, limits[1]) * 0.5f;
+		}
+		else
+		{
+			relative = ratio(tcodeVal, limits[0], limits[1]);
+		}
+		relative = Util::Clamp<float>(relative, 0.f, 1.f);
+		return Invert ? 1.f - relative : relative;
+	}
+
 	inline void SetNextPos(float relativePos) noexcept
 	{
 		if (std::isnan(relativePos)) return;
-		if (Invert) { relativePos = std::abs(relativePos - 1.f); }
-		NextTCodeValue = GetPos(relativePos);
+		prepareValueTable();
+		relativePos = Util::Clamp<float>(relativePos, 0.f, 1.f);
+		NextTCodeValue = valueTable[(int32_t)(relativePos * ValueTableSize + 0.5f)];
+		NextInterval = 0;
+	}
+
+	inline void SetNextPos(float relativePos, int32_t intervalMs) noexcept
+	{
+		if (std::isnan(relativePos)) return;
+		SetNextPos(relativePos);
+		NextInterval = std::max(intervalMs, 0);
 	}
 
 	inline const char* getCommand() noexcept {
 		if (Enabled && NextTCodeValue != LastTCodeValue) {
-			stbsp_snprintf(LastCommand, sizeof(LastCommand), "%s%03d", Id, NextTCodeValue);
+			if (NextInterval > 0) {
+				stbsp_snprintf(LastCommand, sizeof(LastCommand), "%s%03dI%d", Id, NextTCodeValue, NextInterval);
+			}
+			else {
+				stbsp_snprintf(LastCommand, sizeof(LastCommand), "%s%03d", Id, NextTCodeValue);
+			}
 			LastTCodeValue = NextTCodeValue;
 			return LastCommand;
 		}
@@ -82,6 +180,7 @@ public:
 	inline void reset() noexcept {
 		LastTCodeValue = 499;
 		NextTCodeValue = 500;
+		NextInterval = 0;
 	}
 
 	template <class Archive>
@@ -93,6 +192,8 @@ public:
 		OFS_REFLECT(Rebalance, ar);
 		OFS_REFLECT(Invert, ar);
 		OFS_REFLECT(Enabled, ar);
+		OFS_REFLECT(MaxSpeed, ar);
+		OFS_REFLECT(MaxAcceleration, ar);
 	}
 };
 
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "SDL_atomic.h"
+
+// a position as the main thread handed it to the clock
+struct TCodeClockSample {
+	double hostTime; // seconds
+	double mediaTime; // seconds
+	float speed;
+	bool reset;
+};
+
+// estimates the video time on the tcode thread from the positions the main thread sees every frame
+// a second order phase locked loop tracks offset and rate between samples
+// seeks and speed changes reset the loop instead of being smoothed over
+class TCodeClockSync
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr double PhaseGain = 0.1;
+	static constexpr double RateGain = 0.01;
+	static constexpr double MaxRateError = 0.05;
+	// seeks get reported through Reset, this only catches jumps nobody reported
+	static constexpr double SeekThreshold = 1.0;
+
+	struct ErrorStats {
+		double meanAbsError = 0.0; // seconds
+		double maxAbsError = 0.0; // seconds
+		int32_t samples = 0;
+		int32_t discontinuities = 0;
+	};
+
+private:
+	struct Sample {
+		Clock::time_point hostTime;
+		double mediaTime = 0.0;
+		float speed = 1.f;
+		uint32_t seq = 0;
+		bool reset = true;
+	};
+
+	// written by the main thread
+	SDL_SpinLock sampleLock = 0;
+	Sample latest;
+
+	// only touched by the tcode thread
+	uint32_t lastSeq = 0;
+	Clock::time_point refTime;
+	double refMediaTime = 0.0;
+	double rate = 1.0;
+
+	SDL_SpinLock statsLock = 0;
+	double errorSum = 0.0;
+	ErrorStats stats;
+
+	inline double predict(Clock::time_point time) const noexcept
+	{
+		std::chrono::duration<double> elapsed = time - refTime;
+		return refMediaTime + rate * elapsed.count();
+	}
+
+public:
+	// main thread
+	inline void Reset(double mediaTime, float speed) noexcept { Reset(mediaTime, speed, Clock::now()); }
+	inline void Reset(double mediaTime, float speed, Clock::time_point hostTime) noexcept
+	{
+		SDL_AtomicLock(&sampleLock);
+		latest.hostTime = hostTime;
+		latest.mediaTime = mediaTime;
+		latest.speed = speed;
+		latest.reset = true;
+		latest.seq++;
+		SDL_AtomicUnlock(&sampleLock);
+	}
+
+	// main thread
+	inline void Push(double mediaTime, float speed) noexcept { Push(mediaTime, speed, Clock::now()); }
+	// the host time is explicit so recorded samples can be replayed
+	inline void Push(double mediaTime, float speed, Clock::time_point now) noexcept
+	{
+		SDL_AtomicLock(&sampleLock);
+		std::chrono::duration<double> elapsed = now - latest.hostTime;
+		double expected = latest.mediaTime + elapsed.count() * latest.speed;
+		// resets stay pending until the tcode thread saw them
+		bool reset = latest.reset || speed != latest.speed || std::abs(mediaTime - expected) >= SeekThreshold;
+		latest.hostTime = now;
+		latest.mediaTime = mediaTime;
+		latest.speed = speed;
+		latest.reset = reset;
+		latest.seq++;
+		SDL_AtomicUnlock(&sampleLock);
+	}
+
+	// tcode thread, returns true if the time jumped since the last call
+	inline bool Update() noexcept
+	{
+		SDL_AtomicLock(&sampleLock);
+		Sample sample = latest;
+		latest.reset = false;
+		SDL_AtomicUnlock(&sampleLock);
+
+		if (sample.seq == lastSeq) return false;
+		lastSeq = sample.seq;
+
+		if (sample.reset) {
+			refTime = sample.hostTime;
+			refMediaTime = sample.mediaTime;
+			rate = sample.speed;
+			SDL_AtomicLock(&statsLock);
+			stats.discontinuities++;
+			SDL_AtomicUnlock(&statsLock);
+			return true;
+		}
+
+		double predicted = predict(sample.hostTime);
+		double error = sample.mediaTime - predicted;
+		std::chrono::duration<double> sampleDelta = sample.hostTime - refTime;
+
+		refTime = sample.hostTime;
+		refMediaTime = predicted + PhaseGain * error;
+		rate += RateGain * error / std::max(sampleDelta.count(), 0.001);
+		rate = std::clamp(rate, sample.speed * (1.0 - MaxRateError), sample.speed * (1.0 + MaxRateError));
+
+		SDL_AtomicLock(&statsLock);
+		errorSum += std::abs(error);
+		stats.samples++;
+		stats.meanAbsError = errorSum / stats.samples;
+		stats.maxAbsError = std::max(stats.maxAbsError, std::abs(error));
+		SDL_AtomicUnlock(&statsLock);
+		return false;
+	}
+
+	// tcode thread
+	inline double Time(Clock::time_point now) const noexcept { return predict(now); }
+	inline float Rate() const noexcept { return (float)rate; }
+
+	inline ErrorStats GetStats() noexcept
+	{
+		SDL_AtomicLock(&statsLock);
+		ErrorStats copy = stats;
+		SDL_AtomicUnlock(&statsLock);
+		return copy;
+	}
+
+	inline void ResetStats() noexcept
+	{
+		SDL_AtomicLock(&statsLock);
+		errorSum = 0.0;
+		stats = ErrorStats();
+		SDL_AtomicUnlock(&statsLock);
+	}
+};
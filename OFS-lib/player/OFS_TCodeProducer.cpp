@@ -1,9 +1,156 @@
 #include "OFS_TCodeProducer.h"
-#include "EventSystem.h"
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+void TCodeStrokeTable::Compile(const FunscriptArray& actions, bool remap) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	times.resize(actions.size());
+	positions.resize(actions.size());
+	remapped = remap;
+	minPos = 0.f;
+	maxPos = 100.f;
+	if (actions.empty()) return;
+
+	if (remap) {
+		auto [min, max] = std::minmax_element(actions.begin(), actions.end(),
+			[](auto act1, auto act2) {
+				return act1.pos < act2.pos;
+		});
+		minPos = min->pos;
+		maxPos = max->pos;
+	}
+
+	for (int32_t i = 0; i < actions.size(); i++) {
+		auto& action = actions[i];
+		times[i] = action.atS;
+		float pos = remap ? Util::MapRange<float>(action.pos, minPos, maxPos, 0.f, 100.f) : action.pos;
+		positions[i] = pos / 100.f;
+	}
+}
+
+int32_t TCodeStrokeTable::StrokeAt(float time) const noexcept
+{
+	if (times.size() <= 1) return 0;
+	auto it = std::upper_bound(times.begin(), times.end(), time);
+	int32_t index = (int32_t)std::distance(times.begin(), it) - 1;
+	return Util::Clamp(index, 0, Size() - 2);
+}
 
 TCodeChannelProducer::TCodeChannelProducer() noexcept
-	: startAction(0, 50), nextAction(1, 50)
 {
-	EventSystem::ev().Subscribe(FunscriptEvents::FunscriptActionsChangedEvent, 
-		EVENT_SYSTEM_BIND(this, &TCodeChannelProducer::FunscriptChanged));
-}
\ No newline at end of file
+}
+
+// the furthest distance which can be covered within duration starting and ending at rest
+static float MotionReach(float duration, float maxSpeed, float maxAccel) noexcept
+{
+	if (duration <= 0.f) return 0.f;
+	float reach = std::numeric_limits<float>::max();
+	if (maxSpeed > 0.f) {
+		reach = maxSpeed * duration;
+	}
+	if (maxAccel > 0.f) {
+		if (maxSpeed > 0.f && duration > 2.f * maxSpeed / maxAccel) {
+			// accelerate, cruise at max speed, brake
+			reach = std::min(reach, maxSpeed * (duration - maxSpeed / maxAccel));
+		}
+		else {
+			// accelerate for the first half and brake for the second
+			reach = std::min(reach, 0.25f * maxAccel * duration * duration);
+		}
+	}
+	return reach;
+}
+
+void TCodeChannelProducer::planStroke(float currentTime) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	limited.active = false;
+	if (MaxSpeed <= 0.f && MaxAcceleration <= 0.f) return;
+
+	float speed = std::max(playbackSpeed, 0.01f);
+	float maxSpeed = MaxSpeed / 100.f;
+	float maxAccel = MaxAcceleration / 100.f;
+
+	// the device starts wherever it currently is
+	std::array<float, LimiterLookahead + 1> times;
+	std::array<float, LimiterLookahead + 1> positions;
+	times[0] = std::min(currentTime, strokeEndTime());
+	positions[0] = LastValue;
+	times[1] = strokeEndTime();
+	positions[1] = strokeEndPos();
+	int32_t count = 2;
+	for (int32_t idx = currentIndex + 2; idx < table.Size() && count < positions.size(); idx++, count++) {
+		times[count] = table.times[idx];
+		positions[count] = table.positions[idx];
+	}
+
+	auto reach = [&](int32_t i) noexcept {
+		// script time to real time
+		return MotionReach((times[i] - times[i - 1]) / speed, maxSpeed, maxAccel);
+	};
+
+	// backward pass, pull targets towards the following ones so upcoming strokes stay reachable
+	for (int32_t i = count - 2; i >= 1; i--) {
+		float r = reach(i + 1);
+		positions[i] = Util::Clamp(positions[i], positions[i + 1] - r, positions[i + 1] + r);
+	}
+	// forward pass, make every target reachable from where the device is
+	for (int32_t i = 1; i < count; i++) {
+		float r = reach(i);
+		positions[i] = Util::Clamp(positions[i], positions[i - 1] - r, positions[i - 1] + r);
+	}
+
+	limited.startTime = times[0];
+	limited.endTime = times[1];
+	limited.startPos = positions[0];
+	limited.endPos = Util::Clamp(positions[1], 0.f, 1.f);
+	limited.speed = speed;
+
+	float duration = (limited.endTime - limited.startTime) / speed;
+	float distance = std::abs(limited.endPos - limited.startPos);
+	if (maxAccel > 0.f && duration > 0.f) {
+		// trapezoidal profile which takes exactly the stroke duration
+		// peak velocity v solves distance = v * (duration - v / maxAccel)
+		float disc = std::max(0.f, maxAccel * maxAccel * duration * duration - 4.f * maxAccel * distance);
+		limited.peakVelocity = 0.5f * (maxAccel * duration - std::sqrt(disc));
+		limited.accelTime = limited.peakVelocity / maxAccel;
+	}
+	else {
+		limited.peakVelocity = duration > 0.f ? distance / duration : 0.f;
+		limited.accelTime = 0.f;
+	}
+
+	// untouched strokes keep the regular interpolation unless acceleration has to be shaped
+	bool endChanged = std::abs(limited.endPos - strokeEndPos()) > 0.0001f;
+	limited.active = endChanged || (maxAccel > 0.f && !TCodeChannel::SplineMode);
+}
+
+float TCodeChannelProducer::sampleStroke(float currentTime) const noexcept
+{
+	float duration = (limited.endTime - limited.startTime) / limited.speed;
+	float t = Util::Clamp((currentTime - limited.startTime) / limited.speed, 0.f, duration);
+	float distance = limited.endPos - limited.startPos;
+	float travelled;
+	if (limited.accelTime > 0.f) {
+		float maxAccel = limited.peakVelocity / limited.accelTime;
+		if (t < limited.accelTime) {
+			travelled = 0.5f * maxAccel * t * t;
+		}
+		else if (t < duration - limited.accelTime) {
+			travelled = 0.5f * maxAccel * limited.accelTime * limited.accelTime + limited.peakVelocity * (t - limited.accelTime);
+		}
+		else {
+			float remaining = duration - t;
+			travelled = std::abs(distance) - 0.5f * maxAccel * remaining * remaining;
+		}
+	}
+	else {
+		travelled = limited.peakVelocity * t;
+	}
+	travelled = Util::Clamp(travelled, 0.f, std::abs(distance));
+	return limited.startPos + (distance < 0.f ? -travelled : travelled);
+}
@@ -5,15 +5,62 @@
 
 #include <vector>
 #include <memory>
+#include <array>
 
 #include "SDL_timer.h"
 
+// a script snapshot compiled for playback
+// rebuilt only when a new snapshot gets published or the remap setting changes
+struct TCodeStrokeTable
+{
+	std::vector<float> times;
+	std::vector<float> positions; // 0 to 1, already remapped
+	float minPos = 0.f; // 0 to 100
+	float maxPos = 100.f;
+	bool remapped = false;
+
+	inline int32_t Size() const noexcept { return (int32_t)times.size(); }
+
+	void Compile(const FunscriptArray& actions, bool remap) noexcept;
+	// index of the action the stroke containing time starts at
+	int32_t StrokeAt(float time) const noexcept;
+};
+
+// the current linear segment of every channel as a structure of arrays
+// so all channels get interpolated in one loop the compiler can vectorize
+struct TCodeSegmentBlock
+{
+	// TChannel::TotalCount rounded up to a multiple of 4
+	static constexpr int32_t Count = 12;
+
+	alignas(16) std::array<float, Count> startTime;
+	alignas(16) std::array<float, Count> endTime;
+	alignas(16) std::array<float, Count> startPos;
+	alignas(16) std::array<float, Count> slope; // per second of script time
+	alignas(16) std::array<float, Count> pos;
+
+	TCodeSegmentBlock() noexcept
+	{
+		startTime.fill(0.f);
+		endTime.fill(0.f);
+		startPos.fill(0.5f);
+		slope.fill(0.f);
+		pos.fill(0.5f);
+	}
+
+	inline void Evaluate(float time) noexcept
+	{
+		OFS_PROFILE(__FUNCTION__);
+		for (int32_t i = 0; i < Count; i++) {
+			float t = std::min(std::max(time, startTime[i]), endTime[i]);
+			pos[i] = startPos[i] + slope[i] * (t - startTime[i]);
+		}
+	}
+};
+
 class TCodeChannelProducer
 {
 private:
-	FunscriptAction startAction;
-	FunscriptAction nextAction;
-
 	bool InterpTowards = false;
 	float InterpStart = 0.f;
 	float InterpEnd = 0.f;
@@ -30,44 +77,84 @@ public:
 #endif
 
 	bool NeedsResync = false;
+
+	// what the channels mapped to this producer get set to
+	// NextInterval is only non zero at the start of a stroke in interval mode
+	float NextPos = 0.5f;
+	int32_t NextInterval = 0;
+
+	// strictest motion limits of the channels mapped to this producer
+	// in script units per second, 0 disables them
+	float MaxSpeed = 0.f;
+	float MaxAcceleration = 0.f;
+	static constexpr int32_t LimiterLookahead = 8;
 private:
-	float ScriptMinPos;
-	float ScriptMaxPos;
+	TCodeStrokeTable table;
+	// the current stroke goes from table index currentIndex to currentIndex + 1
+	int32_t currentIndex = 0;
+	// false if the position can't be taken from the segment block
+	bool linear = false;
 
-	// remaps actions to 0 to 100 range
-	inline void MapNewActions() noexcept
+	inline float strokeStartTime() const noexcept { return table.times[currentIndex]; }
+	inline float strokeStartPos() const noexcept { return table.positions[currentIndex]; }
+	inline float strokeEndTime() const noexcept
 	{
-		startAction.pos = Util::MapRange<float>(startAction.pos, ScriptMinPos, ScriptMaxPos, 0.f, 100.f);
-		nextAction.pos = Util::MapRange<float>(nextAction.pos, ScriptMinPos, ScriptMaxPos, 0.f, 100.f);
+		return currentIndex + 1 < table.Size() ? table.times[currentIndex + 1] : table.times[currentIndex] + 0.001f;
+	}
+	inline float strokeEndPos() const noexcept
+	{
+		return currentIndex + 1 < table.Size() ? table.positions[currentIndex + 1] : table.positions[currentIndex];
 	}
 
-	inline float getPos(float currentTime, float freq) noexcept {
-		if (currentTime > nextAction.atS) { return LastValue; }
-		OFS_PROFILE(__FUNCTION__);
+	// the stroke as the device can physically follow it
+	// planned once per stroke over the next LimiterLookahead actions
+	struct LimitedStroke {
+		bool active = false;
+		float startTime = 0.f;
+		float endTime = 0.f;
+		float startPos = 0.f; // 0 to 1
+		float endPos = 0.f; // 0 to 1
+		float speed = 1.f; // playback speed the stroke was planned for
+		float peakVelocity = 0.f; // per real second
+		float accelTime = 0.f; // real seconds
+	} limited;
+	float playbackSpeed = 1.f;
+
+	void planStroke(float currentTime) noexcept;
+	float sampleStroke(float currentTime) const noexcept;
+
+	// in interval mode the device interpolates a whole stroke on its own
+	// strokes which got interrupted by a resync are streamed every tick
+	bool streamStroke = true;
+
+	inline bool useIntervals() const noexcept
+	{
+		return TCodeChannel::IntervalMode && !TCodeChannel::SplineMode;
+	}
 
-		float progress = Util::Clamp((float)(currentTime - startAction.atS) / (nextAction.atS - startAction.atS), 0.f, 1.f);
-		
-		float pos;
-		if (TCodeChannel::SplineMode)	{
-			pos = FunscriptSpline::SampleAtIndex(Script->Actions(), currentIndex, currentTime);
-			if (TCodeChannel::RemapToFullRange) { pos = Util::MapRange<float>(pos, ScriptMinPos / 100.f, ScriptMaxPos / 100.f, 0.f, 1.f); }
-		}
-		else {
-			pos = Util::Lerp<float>(startAction.pos / 100.f, nextAction.pos / 100.f, progress);
-		}
+	inline void sendStroke(float currentTime, float speed) noexcept
+	{
+		streamStroke = !useIntervals();
+		if (streamStroke) return;
+		float remainingMs = ((strokeEndTime() - currentTime) * 1000.f) / std::max(speed, 0.01f);
+		NextPos = limited.active ? limited.endPos : strokeEndPos();
+		NextInterval = (int32_t)remainingMs;
+	}
 
-		RawSpeed = std::abs(pos - LastValue) / (1.f/freq);
-		LastValue = pos;
-		
-#ifndef NDEBUG
-		LastValueRaw = pos;
-#endif
-		return LastValue;
+	// positions which don't follow the current linear segment
+	inline float samplePos(float currentTime) noexcept
+	{
+		OFS_PROFILE(__FUNCTION__);
+		if (limited.active) {
+			return sampleStroke(currentTime);
+		}
+		float pos = FunscriptSpline::SampleAtIndex(*Actions, currentIndex, currentTime);
+		if (table.remapped) { pos = Util::MapRange<float>(pos, table.minPos / 100.f, table.maxPos / 100.f, 0.f, 1.f); }
+		return pos;
 	}
 
-	int32_t currentIndex = 0;
 	int32_t scriptIndex = -1;
-	
+
 	inline bool GetScript(std::shared_ptr<const Funscript>& ptr) noexcept
 	{
 		OFS_PROFILE(__FUNCTION__);
@@ -79,9 +166,31 @@ private:
 		return false;
 	}
 	std::shared_ptr<const Funscript> Script;
+	// the tcode thread only reads from published snapshots
+	// the editor is free to change the script in the meantime
+	FunscriptSnapshot Actions;
+
+	inline void updateSnapshot() noexcept
+	{
+		auto latest = Script->ActionsSnapshot();
+		if (latest != Actions || table.remapped != TCodeChannel::RemapToFullRange) {
+			Actions = std::move(latest);
+			table.Compile(*Actions, TCodeChannel::RemapToFullRange);
+			NeedsResync = true;
+		}
+	}
+
+	inline void writeSegment(TCodeSegmentBlock& block, int32_t slot) const noexcept
+	{
+		float startTime = strokeStartTime();
+		float endTime = strokeEndTime();
+		block.startTime[slot] = startTime;
+		block.endTime[slot] = endTime;
+		block.startPos[slot] = strokeStartPos();
+		block.slope[slot] = endTime > startTime ? (strokeEndPos() - strokeStartPos()) / (endTime - startTime) : 0.f;
+	}
 public:
 	std::vector<std::shared_ptr<const Funscript>>* scripts = nullptr;
-	TCodeChannel* channel = nullptr;
 
 	TCodeChannelProducer() noexcept;
 
@@ -93,126 +202,105 @@ public:
 		this->currentIndex = 0;
 		if (GetScript(Script)) {
 			if (Script->Actions().size() <= 1) { this->scriptIndex = -1; return; }
-			auto [min, max] = std::minmax_element(Script->Actions().begin(), Script->Actions().end(),
-				[](auto act1, auto act2) {
-					return act1.pos < act2.pos;
-			});
-			ScriptMinPos = min->pos;
-			ScriptMaxPos = max->pos;
-			LOGF_DEBUG("Script min %f and max %f", ScriptMinPos, ScriptMaxPos);
-
 			NeedsResync = true;
 		}
 	}
 
-	void FunscriptChanged(union SDL_Event& ev) noexcept
-	{
-		NeedsResync = true;
-	}
-
 	inline void sync(float currentTime, float freq) noexcept {
-		if (channel == nullptr || scripts == nullptr) return;
-		if (!NeedsResync && currentTime >= startAction.atS && currentTime <= nextAction.atS) return;
+		if (scripts == nullptr) return;
 		if (!Script) return;
+		if (!NeedsResync && table.Size() > 1
+			&& currentTime >= strokeStartTime() && currentTime <= strokeEndTime()) return;
 		OFS_PROFILE(__FUNCTION__);
 
-		auto& actions = Script->Actions();
-		if (!actions.empty()) {
-			auto startIt = actions.upper_bound(FunscriptAction(currentTime, 0));
-			if (startIt-1 >= actions.begin()) {
-				currentIndex = std::distance(actions.begin(), startIt-1);
-				startAction = *(startIt-1);
-				nextAction = *(startIt);
-				if (TCodeChannel::RemapToFullRange) { MapNewActions(); }
-			}
-			else {
-				currentIndex = 0;
-				startAction = *actions.begin();
-				nextAction = *(actions.begin()+1);
-				if (TCodeChannel::RemapToFullRange) { MapNewActions(); }
-			}
+		updateSnapshot();
+		if (table.Size() > 1) {
+			currentIndex = table.StrokeAt(currentTime);
+			planStroke(currentTime);
 		}
 
+		streamStroke = true;
 		NeedsResync = false;
 	}
 
-#ifndef NDEBUG
-	bool foo = false;
-#endif
-
-	inline void tick(float currentTime, float freq) noexcept {
-		if (scripts == nullptr || channel == nullptr) return;
-		if (!Script) return;
+	// everything which only happens at stroke boundaries
+	// returns false if there's nothing to play
+	inline bool prepare(float currentTime, float freq, float speed, TCodeSegmentBlock& block, int32_t slot) noexcept {
+		if (scripts == nullptr) return false;
+		if (!Script) return false;
 
 		OFS_PROFILE(__FUNCTION__);
+		playbackSpeed = speed;
+		updateSnapshot();
 		if (NeedsResync) { sync(currentTime, freq); }
-		auto& actions = Script->Actions();
+		if (table.Size() <= 1) return false;
 
-		int newIndex = currentIndex;
-		if (currentTime > nextAction.atS) {
+		int32_t newIndex = currentIndex;
+		while (newIndex + 1 < table.Size() && currentTime > table.times[newIndex + 1]) {
 			newIndex++;
 		}
 
-		if (currentIndex != newIndex && newIndex < actions.size()) {
-#ifndef NDEBUG
-			if (foo && newIndex-currentIndex <= -1) {
-				FUN_ASSERT(false, "bug???");
-			}
-			foo = true;
-#endif
+		if (currentIndex != newIndex) {
 			currentIndex = newIndex;
-			startAction = actions[currentIndex];
-			if (currentIndex + 1 < actions.size()) {
-				nextAction = actions[currentIndex+1];
-			}
-			else {
-				nextAction = startAction;
-				nextAction.atS += 0.001f;
-			}
-			MapNewActions();
-			//LOGF_DEBUG("%s: New stroke! %d -> %d", channel->Id, startAction.pos, nextAction.pos);
+			planStroke(currentTime);
+			sendStroke(currentTime, speed);
 		}
+
+		linear = !limited.active && !TCodeChannel::SplineMode;
+		writeSegment(block, slot);
+		return true;
+	}
+
+	inline void finish(float currentTime, float freq, const TCodeSegmentBlock& block, int32_t slot) noexcept {
+		float pos = linear ? block.pos[slot] : samplePos(currentTime);
+
+		RawSpeed = std::abs(pos - LastValue) / (1.f / freq);
+		LastValue = pos;
 #ifndef NDEBUG
-		else {
-			foo = false;
-		}
+		LastValueRaw = pos;
 #endif
-		float interp = getPos(currentTime, freq);
-		channel->SetNextPos(interp);
+
+		if (streamStroke) {
+			NextPos = pos;
+			NextInterval = 0;
+		}
 	}
 
 	inline int32_t ScriptIdx() const noexcept { return scriptIndex; }
 };
 
 class TCodeProducer {
+	static_assert(TCodeSegmentBlock::Count >= static_cast<int32_t>(TChannel::TotalCount));
+	TCodeSegmentBlock block;
+	std::array<bool, static_cast<size_t>(TChannel::TotalCount)> active;
 public:
 	std::array<TCodeChannelProducer, static_cast<size_t>(TChannel::TotalCount)> producers;
 	std::vector<std::shared_ptr<const Funscript>> LoadedScripts;
 
 	TCodeChannelProducer& GetProd(TChannel ch) { return producers[static_cast<size_t>(ch)]; }
-	
+
 	TCodeProducer() noexcept
 	{
+		active.fill(false);
 		for (auto& p : producers) {
 			p.scripts = &LoadedScripts;
 		}
 	}
 
-	inline void SetChannels(TCodeChannels* tcode) noexcept {
-		for (int i = 0; i < producers.size(); i++) {
-			producers[i].channel = &tcode->channels[i];
-		}
-	}
-
 	inline void ClearChannels() noexcept {
 		for (auto& prod : producers) {
 			prod.Reset();
 		}
 	}
 
-	inline void tick(float currentTime, float freq) noexcept {
-		for (auto& prod : producers) {
-			prod.tick(currentTime, freq);
+	inline void tick(float currentTime, float freq, float speed = 1.f) noexcept {
+		OFS_PROFILE(__FUNCTION__);
+		for (int32_t i = 0; i < producers.size(); i++) {
+			active[i] = producers[i].prepare(currentTime, freq, speed, block, i);
+		}
+		block.Evaluate(currentTime);
+		for (int32_t i = 0; i < producers.size(); i++) {
+			if (active[i]) { producers[i].finish(currentTime, freq, block, i); }
 		}
 	}
 
@@ -221,4 +309,4 @@ public:
 			prod.sync(currentTime, freq);
 		}
 	}
-};
\ No newline at end of file
+};
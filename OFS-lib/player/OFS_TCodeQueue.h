@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#include "SDL_atomic.h"
+
+// single producer single consumer ring between the tcode tick thread and the serial writer
+// the producer only writes head and the consumer only writes tail
+class TCodeCommandQueue
+{
+public:
+	static constexpr int32_t Capacity = 64; // must be a power of two
+	static constexpr int32_t MaxCommandLength = 256;
+
+	struct Command {
+		char data[MaxCommandLength];
+		int32_t length = 0;
+		int64_t enqueuedNs = 0; // steady_clock
+		double mediaTime = 0.0; // seconds, the video time the command was produced for
+	};
+
+private:
+	std::array<Command, Capacity> commands;
+	SDL_atomic_t head = { 0 };
+	SDL_atomic_t tail = { 0 };
+
+public:
+	inline void Clear() noexcept
+	{
+		SDL_AtomicSet(&head, 0);
+		SDL_AtomicSet(&tail, 0);
+	}
+
+	inline int32_t Size() const noexcept
+	{
+		return SDL_AtomicGet((SDL_atomic_t*)&head) - SDL_AtomicGet((SDL_atomic_t*)&tail);
+	}
+
+	// producer
+	inline bool Push(const char* cmd, int32_t length, int64_t timeNs, double mediaTime) noexcept
+	{
+		int32_t h = SDL_AtomicGet(&head);
+		if (h - SDL_AtomicGet(&tail) >= Capacity) { return false; }
+		if (length >= MaxCommandLength) { return false; }
+
+		auto& slot = commands[h & (Capacity - 1)];
+		memcpy(slot.data, cmd, length);
+		slot.data[length] = '\0';
+		slot.length = length;
+		slot.enqueuedNs = timeNs;
+		slot.mediaTime = mediaTime;
+		SDL_AtomicSet(&head, h + 1);
+		return true;
+	}
+
+	// consumer, the command stays valid until Pop
+	inline Command* Front() noexcept
+	{
+		int32_t t = SDL_AtomicGet(&tail);
+		if (SDL_AtomicGet(&head) == t) { return nullptr; }
+		return &commands[t & (Capacity - 1)];
+	}
+
+	inline void Pop() noexcept
+	{
+		SDL_AtomicAdd(&tail, 1);
+	}
+};
+
+// lock free histogram with power of two buckets
+// written from the tcode threads and drawn on the main thread
+class TCodeHistogram
+{
+public:
+	static constexpr int32_t BucketCount = 16;
+
+private:
+	std::array<SDL_atomic_t, BucketCount> buckets;
+	SDL_atomic_t maxValue;
+
+public:
+	TCodeHistogram() noexcept { Reset(); }
+
+	inline void Reset() noexcept
+	{
+		for (auto& b : buckets) { SDL_AtomicSet(&b, 0); }
+		SDL_AtomicSet(&maxValue, 0);
+	}
+
+	// bucket 0 holds 0, bucket n holds [2^(n-1), 2^n)
+	inline void Add(int32_t value) noexcept
+	{
+		if (value < 0) { value = 0; }
+		int32_t bucket = 0;
+		while (bucket < BucketCount - 1 && (1 << bucket) <= value) { ++bucket; }
+		SDL_AtomicAdd(&buckets[bucket], 1);
+
+		int32_t currentMax = SDL_AtomicGet(&maxValue);
+		while (value > currentMax && !SDL_AtomicCAS(&maxValue, currentMax, value)) {
+			currentMax = SDL_AtomicGet(&maxValue);
+		}
+	}
+
+	inline void Get(std::array<float, BucketCount>& out) const noexcept
+	{
+		for (int32_t i = 0; i < BucketCount; ++i) {
+			out[i] = (float)SDL_AtomicGet((SDL_atomic_t*)&buckets[i]);
+		}
+	}
+
+	inline int32_t Max() const noexcept { return SDL_AtomicGet((SDL_atomic_t*)&maxValue); }
+};
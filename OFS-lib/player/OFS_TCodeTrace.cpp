@@ -0,0 +1,439 @@
+#include "OFS_TCodeTrace.h"
+#include "OFS_Util.h"
+#include "OFS_Profiling.h"
+#include "FunscriptSpline.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+void TCodeTrace::Render(TCodeProducer& prod, const TCodeOutput& output, float tickrate) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    entries.clear();
+
+    float endTime = 0.f;
+    for (auto& p : prod.producers) {
+        p.MaxSpeed = 0.f;
+        p.MaxAcceleration = 0.f;
+        p.NeedsResync = true;
+        int32_t scriptIdx = p.ScriptIdx();
+        if (scriptIdx < 0 || scriptIdx >= prod.LoadedScripts.size()) continue;
+        auto& script = prod.LoadedScripts[scriptIdx];
+        if (!script) continue;
+        // may run on a worker, only the published actions are safe to read
+        auto actions = script->ActionsSnapshot();
+        if (!actions->empty()) {
+            endTime = std::max(endTime, actions->back().atS);
+        }
+    }
+    output.applyMotionLimits(prod);
+
+    // the device settings are copied so the live output isn't touched
+    TCodeChannels channels = output.tcode;
+    channels.reset();
+
+    float tickDuration = 1.f / tickrate;
+    prod.sync(0.f, tickrate);
+    for (int64_t tick = 0; tick * tickDuration <= endTime; tick++) {
+        float time = tick * tickDuration;
+        prod.tick(time, tickrate, 1.f);
+        for (int32_t i = 0; i < ChannelCount; i++) {
+            int32_t source = output.channelMap[i];
+            if (source < 0 || source >= ChannelCount) continue;
+            auto& p = prod.producers[source];
+            if (p.ScriptIdx() < 0) continue;
+            channels.channels[i].SetNextPos(p.NextPos, p.NextInterval);
+        }
+
+        const char* cmd = channels.GetCommand();
+        if (cmd != nullptr) {
+            std::string command = cmd;
+            if (!command.empty() && command.back() == '\n') command.pop_back();
+            entries.emplace_back(Entry{ time, std::move(command) });
+        }
+    }
+
+    // the player resyncs before the next use
+    for (auto& p : prod.producers) { p.NeedsResync = true; }
+}
+
+void TCodeTrace::FromRecords(std::vector<TCodeLoopbackTransport::Record>&& records) noexcept
+{
+    entries.clear();
+    entries.reserve(records.size());
+    for (auto& record : records) {
+        auto& command = record.command;
+        if (!command.empty() && command.back() == '\n') command.pop_back();
+        entries.emplace_back(Entry{ record.mediaTime, std::move(command) });
+    }
+}
+
+bool TCodeTrace::Save(const std::string& path) const noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    std::string text;
+    text.reserve(entries.size() * 16);
+    char buf[32];
+    for (auto& entry : entries) {
+        int len = stbsp_snprintf(buf, sizeof(buf), "%.3f ", entry.time * 1000.0);
+        text.append(buf, len);
+        text.append(entry.command);
+        text.append(1, '\n');
+    }
+    return Util::WriteFile(path.c_str(), (uint8_t*)text.data(), text.size()) == text.size();
+}
+
+bool TCodeTrace::Load(const std::string& path) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    std::vector<uint8_t> buffer;
+    if (Util::ReadFile(path.c_str(), buffer) == 0) {
+        LOGF_ERROR("Failed to read tcode trace \"%s\"", path.c_str());
+        return false;
+    }
+    buffer.emplace_back('\0');
+
+    entries.clear();
+    char* line = (char*)buffer.data();
+    while (*line != '\0') {
+        char* lineEnd = strchr(line, '\n');
+        if (lineEnd != nullptr) { *lineEnd = '\0'; }
+
+        char* command = nullptr;
+        double timeMs = strtod(line, &command);
+        if (command != line) {
+            while (*command == ' ') { command++; }
+            std::string cmd = command;
+            if (!cmd.empty() && cmd.back() == '\r') cmd.pop_back();
+            entries.emplace_back(Entry{ timeMs / 1000.0, std::move(cmd) });
+        }
+
+        if (lineEnd == nullptr) break;
+        line = lineEnd + 1;
+    }
+    return true;
+}
+
+std::array<TCodeTrace::Curve, TCodeTrace::ChannelCount> TCodeTrace::Reconstruct(const TCodeChannels& channels) const noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    std::array<Curve, ChannelCount> curves;
+
+    auto addTarget = [](Curve& curve, double time, float pos, double intervalSeconds) noexcept {
+        // a new command interrupts whatever the device was still moving towards
+        float current = curve.empty() ? pos : SampleCurve(curve, time);
+        while (!curve.empty() && curve.back().time > time) { curve.pop_back(); }
+        if (intervalSeconds > 0.0) {
+            curve.emplace_back(Point{ time, current });
+            curve.emplace_back(Point{ time + intervalSeconds, pos });
+        }
+        else {
+            curve.emplace_back(Point{ time, pos });
+        }
+    };
+
+    for (auto& entry : entries) {
+        const char* token = entry.command.c_str();
+        while (*token != '\0') {
+            while (*token == ' ') { token++; }
+            if (token[0] == '\0' || token[1] == '\0') break;
+
+            int32_t channelIdx = -1;
+            for (int32_t i = 0; i < ChannelCount; i++) {
+                auto& id = channels.channels[i].Id;
+                if (id[0] == token[0] && id[1] == token[1]) { channelIdx = i; break; }
+            }
+
+            char* end = nullptr;
+            int32_t value = (int32_t)strtol(token + 2, &end, 10);
+            double intervalSeconds = 0.0;
+            if (*end == 'I' || *end == 'i') {
+                intervalSeconds = strtol(end + 1, &end, 10) / 1000.0;
+            }
+            else if (*end == 'S' || *end == 's') {
+                // speed commands only happen while paused
+                strtol(end + 1, &end, 10);
+            }
+
+            if (channelIdx >= 0 && end != token + 2) {
+                float pos = channels.channels[channelIdx].GetRelative(value);
+                addTarget(curves[channelIdx], entry.time, pos, intervalSeconds);
+            }
+
+            while (*end != ' ' && *end != '\0') { end++; }
+            token = end;
+        }
+    }
+    return curves;
+}
+
+float TCodeTrace::SampleCurve(const Curve& curve, double time) noexcept
+{
+    if (curve.empty()) return 0.f;
+    auto it = std::upper_bound(curve.begin(), curve.end(), time,
+        [](double time, const Point& point) { return time < point.time; });
+    if (it == curve.begin()) return curve.front().pos;
+    if (it == curve.end()) return curve.back().pos;
+    auto& prev = *(it - 1);
+    auto& next = *it;
+    double duration = next.time - prev.time;
+    float t = duration > 0.0 ? (float)((time - prev.time) / duration) : 1.f;
+    return Util::Lerp<float>(prev.pos, next.pos, t);
+}
+
+TCodeTrace::Fidelity TCodeTrace::Compare(const Curve& curve, const FunscriptArray& actions, bool spline) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    Fidelity result;
+    if (curve.empty() || actions.size() <= 1) return result;
+
+    // same mapping the producer uses
+    float minPos = 0.f;
+    float maxPos = 100.f;
+    if (TCodeChannel::RemapToFullRange) {
+        auto [min, max] = std::minmax_element(actions.begin(), actions.end(),
+            [](auto act1, auto act2) { return act1.pos < act2.pos; });
+        minPos = min->pos;
+        maxPos = max->pos;
+    }
+
+    constexpr double Step = 0.001;
+    double sum = 0.0;
+    int32_t index = 0;
+    double endTime = actions.back().atS;
+    for (double time = actions.front().atS; time <= endTime; time += Step) {
+        while (index + 2 < actions.size() && actions[index + 1].atS < time) { index++; }
+        auto& a = actions[index];
+        auto& b = actions[index + 1];
+
+        float pos;
+        if (spline) {
+            pos = FunscriptSpline::SampleAtIndex(actions, index, (float)time) * 100.f;
+        }
+        else {
+            float progress = Util::Clamp((float)(time - a.atS) / (b.atS - a.atS), 0.f, 1.f);
+            pos = Util::Lerp<float>(a.pos, b.pos, progress);
+        }
+        if (minPos != 0.f || maxPos != 100.f) {
+            pos = Util::MapRange<float>(pos, minPos, maxPos, 0.f, 100.f);
+        }
+
+        double error = std::abs(SampleCurve(curve, time) * 100.0 - pos);
+        sum += error * error;
+        result.peakError = std::max(result.peakError, error);
+        result.samples++;
+    }
+    result.rmsError = std::sqrt(sum / std::max(result.samples, 1));
+    return result;
+}
+
+std::string TCodeTrace::Report(const TCodeProducer& prod, const TCodeOutput& output) const noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    std::string report;
+    char buf[256];
+    auto curves = Reconstruct(output.tcode);
+    for (int32_t i = 0; i < ChannelCount; i++) {
+        auto& c = output.tcode.channels[i];
+        int32_t source = output.channelMap[i];
+        if (!c.Enabled || source < 0 || source >= ChannelCount) continue;
+        int32_t scriptIdx = prod.producers[source].ScriptIdx();
+        if (scriptIdx < 0 || scriptIdx >= prod.LoadedScripts.size()) continue;
+        auto& script = prod.LoadedScripts[scriptIdx];
+        if (!script || curves[i].empty()) continue;
+
+        auto actions = script->ActionsSnapshot();
+        auto linear = Compare(curves[i], *actions, false);
+        auto spline = Compare(curves[i], *actions, true);
+        stbsp_snprintf(buf, sizeof(buf), "%s %-24s linear rms %6.2f peak %6.2f | spline rms %6.2f peak %6.2f\n",
+            c.Id, script->Title.c_str(), linear.rmsError, linear.peakError, spline.rmsError, spline.peakError);
+        report.append(buf);
+    }
+    return report;
+}
+
+bool TCodeTrace::SaveClockSamples(const std::string& path, const std::vector<TCodeClockSample>& samples) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    std::string text;
+    text.reserve(samples.size() * 32);
+    char buf[64];
+    for (auto& sample : samples) {
+        int len = stbsp_snprintf(buf, sizeof(buf), "%.3f %.6f %.3f %d\n",
+            sample.hostTime * 1000.0, sample.mediaTime, sample.speed, sample.reset ? 1 : 0);
+        text.append(buf, len);
+    }
+    return Util::WriteFile(path.c_str(), (uint8_t*)text.data(), text.size()) == text.size();
+}
+
+bool TCodeTrace::LoadClockSamples(const std::string& path, std::vector<TCodeClockSample>& samples) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    std::vector<uint8_t> buffer;
+    if (Util::ReadFile(path.c_str(), buffer) == 0) {
+        LOGF_ERROR("Failed to read clock samples \"%s\"", path.c_str());
+        return false;
+    }
+    buffer.emplace_back('\0');
+
+    samples.clear();
+    char* line = (char*)buffer.data();
+    while (*line != '\0') {
+        char* lineEnd = strchr(line, '\n');
+        if (lineEnd != nullptr) { *lineEnd = '\0'; }
+
+        double hostMs = 0.0;
+        double mediaTime = 0.0;
+        float speed = 1.f;
+        int reset = 0;
+        // speed and reset are optional
+        if (sscanf(line, "%lf %lf %f %d", &hostMs, &mediaTime, &speed, &reset) >= 2) {
+            samples.emplace_back(TCodeClockSample{ hostMs / 1000.0, mediaTime, speed, reset != 0 });
+        }
+
+        if (lineEnd == nullptr) break;
+        line = lineEnd + 1;
+    }
+    std::stable_sort(samples.begin(), samples.end(),
+        [](auto& a, auto& b) { return a.hostTime < b.hostTime; });
+    return true;
+}
+
+int32_t TCodeTrace::Benchmark(const std::vector<std::string>& args) noexcept
+{
+    std::vector<std::shared_ptr<const Funscript>> scripts;
+    std::string tracePath;
+    std::string settingsPath = Util::Prefpath("tcode.json");
+    std::vector<int32_t> tickrates = { 60, 120, 250 };
+
+    for (int32_t i = 0; i < args.size(); i++) {
+        auto& arg = args[i];
+        if (arg == "--trace" && i + 1 < args.size()) {
+            tracePath = args[++i];
+        }
+        else if (arg == "--tickrate" && i + 1 < args.size()) {
+            tickrates = { std::max(1, atoi(args[++i].c_str())) };
+        }
+        else if (arg == "--settings" && i + 1 < args.size()) {
+            settingsPath = args[++i];
+        }
+        else {
+            auto script = std::make_shared<Funscript>();
+            if (!script->open(arg)) {
+                printf("Failed to open \"%s\"\n", arg.c_str());
+                return -1;
+            }
+            // publishes the loaded actions
+            script->update();
+            scripts.emplace_back(std::move(script));
+        }
+    }
+
+    if (scripts.empty()) {
+        printf("usage: --tcode-benchmark <script.funscript>... [--tickrate <hz>] [--settings <tcode.json>] [--trace <output>]\n");
+        return -1;
+    }
+
+    TCodePlayer player;
+    // the benchmark must not write the settings back
+    player.loadSettings(settingsPath, true);
+    player.setScripts(std::move(scripts));
+    auto& output = player.outputs.front();
+
+    struct Mode {
+        const char* name;
+        bool spline;
+        bool interval;
+    };
+    const std::array<Mode, 3> modes = { {
+        { "linear", false, false },
+        { "spline", true, false },
+        { "interval", false, true },
+    } };
+
+    bool splineMode = TCodeChannel::SplineMode;
+    bool intervalMode = TCodeChannel::IntervalMode;
+    for (auto tickrate : tickrates) {
+        for (auto& mode : modes) {
+            TCodeChannel::SplineMode = mode.spline;
+            TCodeChannel::IntervalMode = mode.interval;
+
+            TCodeTrace trace;
+            trace.Render(player.prod, output, tickrate);
+            printf("%s @ %d Hz, %d commands\n", mode.name, tickrate, (int32_t)trace.entries.size());
+            printf("%s\n", trace.Report(player.prod, output).c_str());
+        }
+    }
+    TCodeChannel::SplineMode = splineMode;
+    TCodeChannel::IntervalMode = intervalMode;
+
+    if (!tracePath.empty()) {
+        // with the saved settings
+        TCodeTrace trace;
+        trace.Render(player.prod, output, player.tickrate);
+        if (!trace.Save(tracePath)) {
+            printf("Failed to write \"%s\"\n", tracePath.c_str());
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int32_t TCodeTrace::ClockReplay(const std::vector<std::string>& args) noexcept
+{
+    std::string samplePath;
+    int32_t tickrate = 250;
+
+    for (int32_t i = 0; i < args.size(); i++) {
+        auto& arg = args[i];
+        if (arg == "--tickrate" && i + 1 < args.size()) {
+            tickrate = std::max(1, atoi(args[++i].c_str()));
+        }
+        else {
+            samplePath = arg;
+        }
+    }
+
+    if (samplePath.empty()) {
+        printf("usage: --tcode-clock-replay <clock samples> [--tickrate <hz>]\n");
+        return -1;
+    }
+
+    std::vector<TCodeClockSample> samples;
+    if (!LoadClockSamples(samplePath, samples) || samples.empty()) {
+        printf("Failed to read \"%s\"\n", samplePath.c_str());
+        return -1;
+    }
+
+    using Clock = TCodeClockSync::Clock;
+    double startTime = samples.front().hostTime;
+    auto hostTime = [startTime](double time) noexcept {
+        return Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(time - startTime)));
+    };
+
+    // same as the tcode thread, samples pushed between two ticks collapse into the latest one
+    auto clock = std::make_unique<TCodeClockSync>();
+    double tickDuration = 1.0 / tickrate;
+    size_t next = 0;
+    for (int64_t tick = 0; next < samples.size(); tick++) {
+        double tickTime = startTime + tick * tickDuration;
+        for (; next < samples.size() && samples[next].hostTime <= tickTime; next++) {
+            auto& sample = samples[next];
+            if (sample.reset) {
+                clock->Reset(sample.mediaTime, sample.speed, hostTime(sample.hostTime));
+            }
+            else {
+                clock->Push(sample.mediaTime, sample.speed, hostTime(sample.hostTime));
+            }
+        }
+        clock->Update();
+    }
+
+    auto stats = clock->GetStats();
+    printf("%d samples over %.1f s @ %d Hz\n", (int32_t)samples.size(), samples.back().hostTime - startTime, tickrate);
+    printf("mean error %.3f ms, max error %.3f ms, %d discontinuities\n",
+        stats.meanAbsError * 1000.0, stats.maxAbsError * 1000.0, stats.discontinuities);
+    return 0;
+}
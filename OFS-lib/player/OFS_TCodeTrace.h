@@ -0,0 +1,68 @@
+#pragma once
+
+#include "OFS_TCode.h"
+
+#include <array>
+#include <string>
+#include <vector>
+
+// a timestamped list of tcode commands
+// rendered offline from the scripts or recorded with the loopback transport
+// used to measure how closely the device output follows the script
+class TCodeTrace
+{
+public:
+	static constexpr int32_t ChannelCount = TCodeOutput::ChannelCount;
+
+	struct Entry {
+		double time; // video time in seconds
+		std::string command;
+	};
+
+	struct Point {
+		double time;
+		float pos; // 0 to 1
+	};
+	using Curve = std::vector<Point>;
+
+	struct Fidelity {
+		// in script units (0 to 100)
+		double rmsError = 0.0;
+		double peakError = 0.0;
+		int32_t samples = 0;
+	};
+
+	std::vector<Entry> entries;
+
+	// simulates the tick loop of the player for one device without any timing jitter
+	// uses the current interpolation mode and the limits of the device
+	void Render(TCodeProducer& prod, const TCodeOutput& output, float tickrate) noexcept;
+	void FromRecords(std::vector<TCodeLoopbackTransport::Record>&& records) noexcept;
+
+	// one "<time ms> <commands>" line per entry
+	bool Save(const std::string& path) const noexcept;
+	bool Load(const std::string& path) noexcept;
+
+	// the position of each channel as the device would move to it
+	// plain positions are connected linearly and intervals are followed until the next command
+	std::array<Curve, ChannelCount> Reconstruct(const TCodeChannels& channels) const noexcept;
+
+	static float SampleCurve(const Curve& curve, double time) noexcept;
+	// compares against the script sampled every millisecond, either linearly or as a spline
+	static Fidelity Compare(const Curve& curve, const FunscriptArray& actions, bool spline) noexcept;
+
+	// fidelity of every channel of the device which is driven by a script
+	std::string Report(const TCodeProducer& prod, const TCodeOutput& output) const noexcept;
+
+	// one "<host ms> <media s> <speed> <reset>" line per sample
+	static bool SaveClockSamples(const std::string& path, const std::vector<TCodeClockSample>& samples) noexcept;
+	static bool LoadClockSamples(const std::string& path, std::vector<TCodeClockSample>& samples) noexcept;
+
+	// headless entry point for --tcode-benchmark
+	// renders the scripts for every interpolation mode and tickrate and prints the error
+	static int32_t Benchmark(const std::vector<std::string>& args) noexcept;
+
+	// headless entry point for --tcode-clock-replay
+	// feeds recorded positions through the clock at the tickrate and prints the prediction error
+	static int32_t ClockReplay(const std::vector<std::string>& args) noexcept;
+};
@@ -0,0 +1,344 @@
+#include "OFS_TCodeTransport.h"
+#include "OFS_Util.h"
+
+#include "SDL_timer.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+
+#include "libserialport.h"
+#include "libserialport_internal.h"
+
+#ifdef WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using SocketHandle = SOCKET;
+#define OFS_CLOSE_SOCKET closesocket
+#define OFS_SEND_FLAGS 0
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+using SocketHandle = int;
+#define INVALID_SOCKET (-1)
+#define OFS_CLOSE_SOCKET close
+// a closed connection should fail the write instead of raising SIGPIPE
+#define OFS_SEND_FLAGS MSG_NOSIGNAL
+#endif
+
+const char* TCodeTransport::TypeNames[static_cast<int32_t>(Type::TotalCount)] = {
+    "Serial",
+    "UDP",
+    "TCP",
+    "Unix socket",
+    "Loopback"
+};
+
+bool TCodeTransport::WriteAll(const char* data, int32_t size) noexcept
+{
+    int32_t written = 0;
+    while (written < size) {
+        int32_t result = Write(data + written, size - written);
+        if (result < 0) return false;
+        written += result;
+        if (written < size) { SDL_Delay(1); }
+    }
+    return true;
+}
+
+class TCodeSerialTransport : public TCodeTransport
+{
+    struct sp_port* port = nullptr;
+public:
+    ~TCodeSerialTransport() noexcept { Close(); }
+
+    bool Open(const char* address) noexcept override
+    {
+        Close();
+
+        if (sp_get_port_by_name(address, &port) != SP_OK) {
+            LOGF_ERROR("Failed to get port \"%s\"", address);
+            return false;
+        }
+
+        if (sp_open(port, sp_mode::SP_MODE_WRITE) != SP_OK) {
+            LOGF_ERROR("Failed to open port \"%s\"", port->description);
+            sp_free_port(port);
+            port = nullptr;
+            return false;
+        }
+
+        if (sp_set_baudrate(port, 115200) != SP_OK) {
+            LOG_ERROR("Failed to set baud rate to 115200.");
+            sp_close(port);
+            sp_free_port(port);
+            port = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    void Close() noexcept override
+    {
+        if (port != nullptr) {
+            sp_close(port);
+            sp_free_port(port);
+            port = nullptr;
+        }
+    }
+
+    bool IsOpen() const noexcept override { return port != nullptr; }
+    Type GetType() const noexcept override { return Type::Serial; }
+
+    int32_t Write(const char* data, int32_t size) noexcept override
+    {
+        if (port == nullptr) return -1;
+        int result = sp_nonblocking_write(port, data, size);
+        if (result < SP_OK) {
+            LOG_ERROR("Failed to write to serial port.");
+            return -1;
+        }
+        return result;
+    }
+};
+
+#ifdef WIN32
+static bool InitSockets() noexcept
+{
+    static bool initialized = false;
+    if (!initialized) {
+        WSADATA wsaData;
+        initialized = WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+        if (!initialized) { LOG_ERROR("Failed to initialize winsock."); }
+    }
+    return initialized;
+}
+#else
+static bool InitSockets() noexcept { return true; }
+#endif
+
+static bool SetNonBlocking(SocketHandle sock) noexcept
+{
+#ifdef WIN32
+    u_long mode = 1;
+    return ioctlsocket(sock, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(sock, F_GETFL, 0);
+    return flags >= 0 && fcntl(sock, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+static bool WouldBlock() noexcept
+{
+#ifdef WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+// udp & tcp
+class TCodeNetworkTransport : public TCodeTransport
+{
+    SocketHandle sock = INVALID_SOCKET;
+    bool stream;
+public:
+    TCodeNetworkTransport(bool stream) noexcept : stream(stream) {}
+    ~TCodeNetworkTransport() noexcept { Close(); }
+
+    bool Open(const char* address) noexcept override
+    {
+        Close();
+        if (!InitSockets()) return false;
+
+        // host:port
+        std::string host = address;
+        auto colon = host.rfind(':');
+        if (colon == std::string::npos) {
+            LOGF_ERROR("Expected host:port but got \"%s\"", address);
+            return false;
+        }
+        std::string service = host.substr(colon + 1);
+        host.resize(colon);
+
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = stream ? SOCK_STREAM : SOCK_DGRAM;
+        addrinfo* result = nullptr;
+        if (getaddrinfo(host.c_str(), service.c_str(), &hints, &result) != 0) {
+            LOGF_ERROR("Failed to resolve \"%s\"", address);
+            return false;
+        }
+
+        for (auto info = result; info != nullptr; info = info->ai_next) {
+            sock = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+            if (sock == INVALID_SOCKET) continue;
+            // connect blocks once for tcp, afterwards every write is non blocking
+            // for udp this only sets the default destination
+            if (connect(sock, info->ai_addr, (int)info->ai_addrlen) == 0) break;
+            OFS_CLOSE_SOCKET(sock);
+            sock = INVALID_SOCKET;
+        }
+        freeaddrinfo(result);
+
+        if (sock == INVALID_SOCKET) {
+            LOGF_ERROR("Failed to connect to \"%s\"", address);
+            return false;
+        }
+
+        if (stream) {
+            int noDelay = 1;
+            setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+        }
+        SetNonBlocking(sock);
+        return true;
+    }
+
+    void Close() noexcept override
+    {
+        if (sock != INVALID_SOCKET) {
+            OFS_CLOSE_SOCKET(sock);
+            sock = INVALID_SOCKET;
+        }
+    }
+
+    bool IsOpen() const noexcept override { return sock != INVALID_SOCKET; }
+    Type GetType() const noexcept override { return stream ? Type::Tcp : Type::Udp; }
+
+    int32_t Write(const char* data, int32_t size) noexcept override
+    {
+        if (sock == INVALID_SOCKET) return -1;
+        auto result = send(sock, data, size, OFS_SEND_FLAGS);
+        if (result < 0) {
+            if (WouldBlock()) {
+                // a datagram is sent whole or not at all
+                return stream ? 0 : size;
+            }
+            LOG_ERROR("Failed to send tcode.");
+            return -1;
+        }
+        return (int32_t)result;
+    }
+};
+
+#ifndef WIN32
+class TCodeUnixSocketTransport : public TCodeTransport
+{
+    SocketHandle sock = INVALID_SOCKET;
+public:
+    ~TCodeUnixSocketTransport() noexcept { Close(); }
+
+    bool Open(const char* address) noexcept override
+    {
+        Close();
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if (strlen(address) >= sizeof(addr.sun_path)) {
+            LOGF_ERROR("Socket path too long \"%s\"", address);
+            return false;
+        }
+        strcpy(addr.sun_path, address);
+
+        sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sock == INVALID_SOCKET || connect(sock, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            LOGF_ERROR("Failed to connect to \"%s\"", address);
+            Close();
+            return false;
+        }
+        SetNonBlocking(sock);
+        return true;
+    }
+
+    void Close() noexcept override
+    {
+        if (sock != INVALID_SOCKET) {
+            OFS_CLOSE_SOCKET(sock);
+            sock = INVALID_SOCKET;
+        }
+    }
+
+    bool IsOpen() const noexcept override { return sock != INVALID_SOCKET; }
+    Type GetType() const noexcept override { return Type::UnixSocket; }
+
+    int32_t Write(const char* data, int32_t size) noexcept override
+    {
+        if (sock == INVALID_SOCKET) return -1;
+        auto result = send(sock, data, size, OFS_SEND_FLAGS);
+        if (result < 0) {
+            if (WouldBlock()) return 0;
+            LOG_ERROR("Failed to send tcode.");
+            return -1;
+        }
+        return (int32_t)result;
+    }
+};
+#endif
+
+TCodeLoopbackTransport::TCodeLoopbackTransport() noexcept
+{
+    recordMutex = SDL_CreateMutex();
+}
+
+TCodeLoopbackTransport::~TCodeLoopbackTransport() noexcept
+{
+    SDL_DestroyMutex(recordMutex);
+}
+
+int32_t TCodeLoopbackTransport::Write(const char* data, int32_t size) noexcept
+{
+    if (!open) return -1;
+    auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    SDL_LockMutex(recordMutex);
+    if (records.size() < MaxRecords) {
+        records.push_back(Record{ now, mediaTime, std::string(data, size) });
+    }
+    else {
+        records[oldest] = Record{ now, mediaTime, std::string(data, size) };
+        oldest = (oldest + 1) % MaxRecords;
+    }
+    SDL_UnlockMutex(recordMutex);
+    return size;
+}
+
+size_t TCodeLoopbackTransport::RecordCount() noexcept
+{
+    SDL_LockMutex(recordMutex);
+    size_t count = records.size();
+    SDL_UnlockMutex(recordMutex);
+    return count;
+}
+
+std::vector<TCodeLoopbackTransport::Record> TCodeLoopbackTransport::TakeRecords() noexcept
+{
+    std::vector<Record> taken;
+    size_t start;
+    SDL_LockMutex(recordMutex);
+    taken.swap(records);
+    start = oldest;
+    oldest = 0;
+    SDL_UnlockMutex(recordMutex);
+    std::rotate(taken.begin(), taken.begin() + start, taken.end());
+    return taken;
+}
+
+std::unique_ptr<TCodeTransport> TCodeTransport::Create(Type type) noexcept
+{
+    switch (type) {
+        case Type::Serial: return std::make_unique<TCodeSerialTransport>();
+        case Type::Udp: return std::make_unique<TCodeNetworkTransport>(false);
+        case Type::Tcp: return std::make_unique<TCodeNetworkTransport>(true);
+#ifndef WIN32
+        case Type::UnixSocket: return std::make_unique<TCodeUnixSocketTransport>();
+#endif
+        case Type::Loopback: return std::make_unique<TCodeLoopbackTransport>();
+        default:
+            LOGF_ERROR("Transport \"%s\" isn't supported on this platform.", TypeNames[static_cast<int32_t>(type)]);
+            return nullptr;
+    }
+}
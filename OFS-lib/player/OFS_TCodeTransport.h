@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SDL_mutex.h"
+
+// where a tcode device gets its commands from
+// every tick produces at most one command line per device which is written in one go
+class TCodeTransport
+{
+public:
+	enum class Type : int32_t {
+		Serial,
+		Udp,
+		Tcp,
+		UnixSocket,
+		Loopback,
+
+		TotalCount
+	};
+	static const char* TypeNames[static_cast<int32_t>(Type::TotalCount)];
+
+	virtual ~TCodeTransport() noexcept {}
+
+	// serial: port name, udp & tcp: host:port, unix socket: path
+	virtual bool Open(const char* address) noexcept = 0;
+	virtual void Close() noexcept = 0;
+	virtual bool IsOpen() const noexcept = 0;
+	virtual Type GetType() const noexcept = 0;
+
+	// doesn't block, returns the amount of bytes written or -1 on error
+	virtual int32_t Write(const char* data, int32_t size) noexcept = 0;
+
+	// retries until everything is written
+	bool WriteAll(const char* data, int32_t size) noexcept;
+
+	static std::unique_ptr<TCodeTransport> Create(Type type) noexcept;
+};
+
+// keeps the last MaxRecords commands in memory instead of sending them anywhere
+// used to benchmark and inspect the output without a device
+class TCodeLoopbackTransport : public TCodeTransport
+{
+public:
+	struct Record {
+		int64_t timeNs; // steady_clock
+		double mediaTime; // seconds
+		std::string command;
+	};
+
+private:
+	// a bit over 6 minutes at 250 hz with every tick producing a command
+	static constexpr size_t MaxRecords = 100000;
+
+	SDL_mutex* recordMutex = nullptr;
+	// a ring once it's full, oldest is where the next record goes
+	std::vector<Record> records;
+	size_t oldest = 0;
+	bool open = false;
+	double mediaTime = 0.0;
+
+public:
+	TCodeLoopbackTransport() noexcept;
+	~TCodeLoopbackTransport() noexcept;
+
+	bool Open(const char* address) noexcept override { open = true; return true; }
+	void Close() noexcept override { open = false; }
+	bool IsOpen() const noexcept override { return open; }
+	Type GetType() const noexcept override { return Type::Loopback; }
+	int32_t Write(const char* data, int32_t size) noexcept override;
+
+	// the video time the following writes belong to
+	inline void SetMediaTime(double time) noexcept { mediaTime = time; }
+
+	size_t RecordCount() noexcept;
+	// in the order they were written
+	std::vector<Record> TakeRecords() noexcept;
+};
@@ -114,12 +114,10 @@ void OFS_Project::LoadScripts(const std::string& funscriptPath) noexcept
 
 OFS_Project::OFS_Project() noexcept
 {
-	ProjectMut = SDL_CreateMutex();
 }
 
 OFS_Project::~OFS_Project() noexcept
 {
-	SDL_DestroyMutex(ProjectMut);
 }
 
 void OFS_Project::Clear() noexcept
@@ -160,11 +158,13 @@ bool OFS_Project::Load(const std::string& path) noexcept
 
 	Valid = false;
 	LastPath = path;
-	ProjectBuffer.clear();
-	if (Util::ReadFile(ProjectPath.u8string().c_str(), ProjectBuffer) > 0) {
+	// the io thread doesn't read a path while a save to it is still in flight
+	auto read = OpenFunscripter::ptr->IO->PushRead(ProjectPath.u8string());
+	auto& result = read.Get();
+	if (result.Success && !result.Buffer.empty()) {
 		OFS_DynFontAtlas::AddText(path);
 		Funscripts.clear();
-		auto state = OFS_Binary::Deserialize(ProjectBuffer, *this);
+		auto state = OFS_Binary::Deserialize(result.Buffer, *this);
 		if (state == bitsery::ReaderError::NoError && Valid) {
 			OFS_DynFontAtlas::AddText(Metadata.type);
 			OFS_DynFontAtlas::AddText(Metadata.title);
@@ -186,7 +186,7 @@ bool OFS_Project::Load(const std::string& path) noexcept
 	return false;
 }
 
-void OFS_Project::Save(const std::string& path, bool clearUnsavedChanges) noexcept
+void OFS_Project::Save(const std::string& path, bool clearUnsavedChanges, OFS_AsyncIO::PriorityClass priority) noexcept
 {
 	if (!Loaded) return;
 	OFS_PROFILE(__FUNCTION__);
@@ -202,26 +202,16 @@ void OFS_Project::Save(const std::string& path, bool clearUnsavedChanges) noexce
 	Metadata.duration = app->player->getDuration();
 	Settings.lastPlayerPosition = app->player->getCurrentPositionSeconds();
 
-	size_t writtenSize = 0;
-	{
-		SDL_LockMutex(ProjectMut);
-		ProjectBuffer.clear();
-		writtenSize = OFS_Binary::Serialize(ProjectBuffer, *this);
-	}
-	
 	OFS_AsyncIO::Write write;
 	write.Path = path;
-	write.Buffer = ProjectBuffer.data();
-	write.Size = writtenSize;
-	write.Userdata = (void*)ProjectMut;
-	write.Callback = [](auto& w)
-	{
-		EventSystem::SingleShot([](void* mutex) {
-			 //mutex gets unlocked back on the main thread via event
-			SDL_UnlockMutex((SDL_mutex*)mutex);
-		}, w.Userdata);
-	};
-	app->IO->PushWrite(std::move(write));
+	write.Priority = priority;
+	// the adapter grows the buffer past what got written
+	write.Buffer.resize(OFS_Binary::Serialize(write.Buffer, *this));
+	app->IO->PushWrite(std::move(write)).ThenOnMain([priority](auto& result) {
+		if (!result.Success && priority == OFS_AsyncIO::PriorityClass::UserSave) {
+			Util::MessageBoxAlert(TR(ERROR_STR), FMT(TR(FAILED_TO_SAVE_FMT), result.Path.c_str()));
+		}
+	});
 
 	// this resets HasUnsavedEdits()
 	if (clearUnsavedChanges) {
@@ -379,6 +369,8 @@ void OFS_Project::ExportClips(const std::string& outputDirectory) noexcept
 		bTaskData->Progress = 0;
 		bTaskData->MaxProgress = bookmarks.size();
 		eastl::string formatBuffer;
+		// the script slices don't depend on ffmpeg and get written by the workers meanwhile
+		OFS_TaskGroup scriptSlices;
 
 		int i = 0;
 		while (i < bookmarks.size())
@@ -423,22 +415,25 @@ void OFS_Project::ExportClips(const std::string& outputDirectory) noexcept
 				auto videoOutputString = videoOutputPath.u8string();
 
 				// Slice Funscripts
-				auto newScript = Funscript();
-				newScript.LocalMetadata = app->LoadedProject->Metadata;
-				for (auto& script : app->LoadedFunscripts()) {
-					std::filesystem::path scriptOutputPath = outputPath / formatBuffer.sprintf("%s_%s.funscript", bookmarkName.c_str(), script->Title.c_str()).c_str();
-					auto scriptOutputString = scriptOutputPath.u8string();
-
-					auto scriptSlice = script->GetSelection(startTime, endTime);
-					newScript.SetActions(FunscriptArray());
-					newScript.UpdatePath(scriptOutputString);
-					newScript.AddActionRange(scriptSlice, false);
-					newScript.AddAction(FunscriptAction(startTime, script->GetPositionAtTime(startTime)));
-					newScript.AddAction(FunscriptAction(endTime, script->GetPositionAtTime(endTime)));
-					newScript.SelectAll();
-					newScript.MoveSelectionTime(-startTime, 0);
-					newScript.save(scriptOutputString, false);
-				}
+				scriptSlices.Run([app, outputPath, bookmarkName = bookmarkName, startTime, endTime]() {
+					eastl::string pathBuffer;
+					auto newScript = Funscript();
+					newScript.LocalMetadata = app->LoadedProject->Metadata;
+					for (auto& script : app->LoadedFunscripts()) {
+						std::filesystem::path scriptOutputPath = outputPath / pathBuffer.sprintf("%s_%s.funscript", bookmarkName.c_str(), script->Title.c_str()).c_str();
+						auto scriptOutputString = scriptOutputPath.u8string();
+
+						auto scriptSlice = script->GetSelection(startTime, endTime);
+						newScript.SetActions(FunscriptArray());
+						newScript.UpdatePath(scriptOutputString);
+						newScript.AddActionRange(scriptSlice, false);
+						newScript.AddAction(FunscriptAction(startTime, script->GetPositionAtTime(startTime)));
+						newScript.AddAction(FunscriptAction(endTime, script->GetPositionAtTime(endTime)));
+						newScript.SelectAll();
+						newScript.MoveSelectionTime(-startTime, 0);
+						newScript.save(scriptOutputString, false);
+					}
+				});
 
 				// Slice Video
 				std::array<const char*, 14> args =
@@ -455,6 +450,9 @@ void OFS_Project::ExportClips(const std::string& outputDirectory) noexcept
 				};
 				struct subprocess_s proc;
 				if(subprocess_create(args.data(), subprocess_option_no_window, &proc) != 0) {
+					// no point in slicing scripts for clips which won't exist
+					scriptSlices.Cancel();
+					scriptSlices.Wait();
 					delete exportData;
 					return 0;
 				}
@@ -477,6 +475,7 @@ void OFS_Project::ExportClips(const std::string& outputDirectory) noexcept
 			}
 			i++;
 		}
+		scriptSlices.Wait();
 		delete exportData;
 		return 0;
 	};
@@ -491,6 +490,51 @@ void OFS_Project::ExportClips(const std::string& outputDirectory) noexcept
 	OpenFunscripter::ptr->blockingTask.DoTask(std::move(task));
 }
 
+void OFS_Project::ExportResampled(const std::string& outputPath, float rate,
+	FunscriptResampler::Interpolation interpolation, FunscriptResampler::Format format) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	struct ResampleTaskData
+	{
+		std::string outputPath;
+		std::vector<FunscriptResampler::Axis> axes;
+		float duration;
+		float rate;
+		FunscriptResampler::Interpolation interpolation;
+		FunscriptResampler::Format format;
+	};
+
+	auto blockingTask = [](void* data) -> int
+	{
+		auto bTaskData = (BlockingTaskData*)data;
+		auto exportData = (ResampleTaskData*)bTaskData->User;
+		FunscriptResampler::Export(exportData->outputPath, exportData->axes,
+			exportData->duration, exportData->rate, exportData->interpolation, exportData->format,
+			&bTaskData->Progress, &bTaskData->MaxProgress);
+		delete exportData;
+		return 0;
+	};
+
+	// the snapshots stay valid while the scripts get edited
+	auto taskData = new ResampleTaskData;
+	taskData->outputPath = outputPath;
+	taskData->duration = OpenFunscripter::ptr->player->getDuration();
+	taskData->rate = rate;
+	taskData->interpolation = interpolation;
+	taskData->format = format;
+	for (auto& script : Funscripts) {
+		auto actions = script->ActionsSnapshot();
+		if (!actions->empty()) { taskData->duration = std::max(taskData->duration, actions->back().atS); }
+		taskData->axes.emplace_back(FunscriptResampler::Axis{ script->Title, std::move(actions) });
+	}
+
+	auto task = std::make_unique<BlockingTaskData>();
+	task->TaskThreadFunc = blockingTask;
+	task->TaskDescription = TR(TASK_EXPORTING_RESAMPLED);
+	task->User = taskData;
+	OpenFunscripter::ptr->blockingTask.DoTask(std::move(task));
+}
+
 bool OFS_Project::HasUnsavedEdits() noexcept
 {
 	OFS_PROFILE(__FUNCTION__);
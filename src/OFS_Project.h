@@ -2,12 +2,12 @@
 #include "OFS_BinarySerialization.h"
 #include "OFS_ScriptSettings.h"
 #include "Funscript.h"
+#include "FunscriptResampler.h"
 #include "OFS_ScriptSimulator.h"
+#include "OFS_AsyncIO.h"
 
 #include <vector>
 
-#include "SDL_mutex.h"
-
 #define OFS_PROJECT_EXT ".ofsp"
 
 enum OFS_Project_Version : int32_t
@@ -54,9 +54,6 @@ public:
 	std::vector<std::shared_ptr<Funscript>> Funscripts;
 	std::string MediaPath;
 
-	SDL_mutex* ProjectMut = nullptr;
-	ByteBuffer ProjectBuffer;
-
 	OFS_Project() noexcept;
 	~OFS_Project() noexcept;
 
@@ -64,7 +61,8 @@ public:
 	bool Load(const std::string& path) noexcept;
 
 	void Save(bool clearUnsavedChanges) noexcept { Save(LastPath, clearUnsavedChanges); }
-	void Save(const std::string& path, bool clearUnsavedChanges) noexcept;
+	void Save(const std::string& path, bool clearUnsavedChanges,
+		OFS_AsyncIO::PriorityClass priority = OFS_AsyncIO::PriorityClass::UserSave) noexcept;
 
 	void AddFunscript(const std::string& path) noexcept;
 	void RemoveFunscript(int idx) noexcept;
@@ -76,6 +74,9 @@ public:
 	void ExportFunscripts() noexcept;
 
 	void ExportClips(const std::string& outputDirectory) noexcept;
+	// all scripts on one fixed rate grid
+	void ExportResampled(const std::string& outputPath, float rate,
+		FunscriptResampler::Interpolation interpolation, FunscriptResampler::Format format) noexcept;
 
 	bool HasUnsavedEdits() noexcept;
 
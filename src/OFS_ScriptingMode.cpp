@@ -347,6 +347,10 @@ inline void RecordingImpl::singleAxisRecording() noexcept
     OFS_PROFILE(__FUNCTION__);
     auto app = OpenFunscripter::ptr;
     uint32_t frameEstimate = app->player->getCurrentFrameEstimate();
+    // the frame index can finish after recording started
+    if (frameEstimate >= app->scriptTimeline.RecordingBuffer.size()) {
+        app->scriptTimeline.RecordingBuffer.resize(frameEstimate + 1, std::make_pair(FunscriptAction(), FunscriptAction()));
+    }
     app->scriptTimeline.RecordingBuffer[frameEstimate]
         = std::make_pair(FunscriptAction(app->player->getCurrentPositionSecondsInterp(), currentPosY), FunscriptAction());
     app->simulator.positionOverride = currentPosY;
@@ -358,6 +362,9 @@ inline void RecordingImpl::twoAxisRecording() noexcept
     auto app = OpenFunscripter::ptr;
     uint32_t frameEstimate = app->player->getCurrentFrameEstimate();
     float atS = app->player->getCurrentPositionSecondsInterp();
+    if (frameEstimate >= app->scriptTimeline.RecordingBuffer.size()) {
+        app->scriptTimeline.RecordingBuffer.resize(frameEstimate + 1, std::make_pair(FunscriptAction(), FunscriptAction()));
+    }
     app->scriptTimeline.RecordingBuffer[frameEstimate]
         = std::make_pair(FunscriptAction(atS, currentPosX), FunscriptAction(atS, 100 - currentPosY));
     app->sim3D->RollOverride = currentPosX;
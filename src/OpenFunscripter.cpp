@@ -9,8 +9,13 @@
 #include "OFS_Shader.h"
 #include "OFS_MpvLoader.h"
 #include "OFS_Localization.h"
+#include "OFS_Allocator.h"
+#include "OFS_Redraw.h"
+#include "OFS_RenderThread.h"
+#include "OFS_StartupGraph.h"
 
 #include <filesystem>
+#include <cstring>
 
 #include "stb_sprintf.h"
 
@@ -64,6 +69,8 @@ constexpr int DefaultWidth = 1920;
 constexpr int DefaultHeight= 1080;
 
 constexpr int AutoBackupIntervalSeconds = 60;
+// jobs posted from other threads which didn't fit run next frame
+constexpr float MainThreadJobBudgetMs = 2.f;
 
 bool OpenFunscripter::imguiSetup() noexcept
 {
@@ -96,13 +103,6 @@ bool OpenFunscripter::imguiSetup() noexcept
 
     OFS_DynFontAtlas::FontOverride = settings->data().font_override;
     OFS_DynFontAtlas::Init();
-    OFS_Translator::Init();
-    if(!settings->data().language_csv.empty()) {
-        if(OFS_Translator::ptr->LoadTranslation(settings->data().language_csv.c_str()))
-        {
-            OFS_DynFontAtlas::AddTranslationText();
-        }
-    }
 
     {
 		// hook into paste for the dynamic atlas
@@ -122,7 +122,7 @@ bool OpenFunscripter::imguiSetup() noexcept
 
 OpenFunscripter::~OpenFunscripter()
 {
-    tcode->save();
+    if (tcode) tcode->save();
 
     // needs a certain destruction order
     playerControls.Destroy();
@@ -136,159 +136,243 @@ OpenFunscripter::~OpenFunscripter()
     
     player.reset();
     events.reset();
+    // last, pending saves are still running on the workers
+    OFS_TaskScheduler::Shutdown();
+    OFS_MainThreadExecutor::Shutdown();
+    OFS_FrameArena::Shutdown();
 }
 
 bool OpenFunscripter::setup(int argc, char* argv[])
 {
     OFS_FileLogger::Init();
+    OFS_TaskScheduler::Init();
+    OFS_MainThreadExecutor::Init();
     Util::InMainThread();
     FUN_ASSERT(ptr == nullptr, "there can only be one instance");
     ptr = this;
     auto prefPath = Util::Prefpath("");
     Util::CreateDirectories(prefPath);
 
-    settings = std::make_unique<OFS_Settings>(Util::Prefpath("config.json"));
-    
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER) != 0) {
-        LOGF_ERROR("Error: %s\n", SDL_GetError());
-        return false;
-    }
-    if(!OFS_MpvLoader::Load()) {
-        LOG_ERROR("Failed to load mpv library.");
-        return false;
-    }
+    bool startupTrace = false;
+    const char* openPath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--startup-trace") == 0) { startupTrace = true; }
+        else if (openPath == nullptr) { openPath = argv[i]; }
+    }
+
+    // files, mpv and the extensions get loaded on the workers while the main thread sets up sdl, gl and imgui
+    // the 3d simulator, tcode and the video preview get set up the first time they're used
+    using Thread = OFS_StartupGraph::Thread;
+    OFS_StartupGraph startup;
+    bool translationLoaded = false;
+    bool bindingsLoaded = false;
+    Keybindings loadedBindings;
+
+    auto settingsStage = startup.Add("Settings", Thread::Worker, {}, [this]() {
+        settings = std::make_unique<OFS_Settings>(Util::Prefpath("config.json"));
+        return true;
+    });
+    auto mpvLibraryStage = startup.Add("Mpv library", Thread::Worker, {}, []() {
+        if (!OFS_MpvLoader::Load()) {
+            LOG_ERROR("Failed to load mpv library.");
+            return false;
+        }
+        return true;
+    });
+    auto translationStage = startup.Add("Translation", Thread::Worker, { settingsStage }, [this, &translationLoaded]() {
+        OFS_Translator::Init();
+        if (!settings->data().language_csv.empty()) {
+            translationLoaded = OFS_Translator::ptr->LoadTranslation(settings->data().language_csv.c_str());
+        }
+        return true;
+    });
+    auto bindingFileStage = startup.Add("Keybinding file", Thread::Worker, {}, [&bindingsLoaded, &loadedBindings]() {
+        bindingsLoaded = KeybindingSystem::ReadBindings(Util::Prefpath("keybinds.json"), loadedBindings);
+        return true;
+    });
+    auto extensionFileStage = startup.Add("Extension scripts", Thread::Worker, {}, [this]() {
+        extensions = std::make_unique<OFS_LuaExtensions>();
+        extensions->Prepare();
+        return true;
+    });
+    auto mpvStage = startup.Add("Mpv", Thread::Worker, { settingsStage, mpvLibraryStage }, [this]() {
+        player = std::make_unique<VideoplayerWindow>();
+        if (!player->createMpv(settings->data().force_hw_decoding)) {
+            LOG_ERROR("Failed to init video player");
+            return false;
+        }
+        return true;
+    });
+
+    auto sdlStage = startup.Add("SDL", Thread::Main, {}, []() {
+        if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER) != 0) {
+            LOGF_ERROR("Error: %s\n", SDL_GetError());
+            return false;
+        }
+        OFS_Redraw::Init();
+        return true;
+    });
+    auto windowStage = startup.Add("Window", Thread::Main, { sdlStage, settingsStage }, [this]() {
+        OFS_Redraw::SetContinuous(!settings->data().idle_mode);
 
 #if __APPLE__
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG); // Always required on Mac according to imgui example
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG); // Always required on Mac according to imgui example
 #else
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, 0 /*| SDL_GL_CONTEXT_DEBUG_FLAG*/);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, 0 /*| SDL_GL_CONTEXT_DEBUG_FLAG*/);
 #endif
 
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
 
-    // antialiasing
-    // this caused problems in my linux testing
+        // antialiasing
+        // this caused problems in my linux testing
 #ifdef WIN32
-    SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
-    SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 2);
+        SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
+        SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 2);
 #endif
 
-    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
-    SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
+        SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+        SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+        SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
 
-    window = SDL_CreateWindow(
-        "OpenFunscripter " OFS_LATEST_GIT_TAG "@" OFS_LATEST_GIT_HASH,
-        SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-        DefaultWidth, DefaultHeight,
-        SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_HIDDEN
-    );
-
-    SDL_Rect display;
-    int windowDisplay = SDL_GetWindowDisplayIndex(window);
-    SDL_GetDisplayBounds(windowDisplay, &display);
-    if (DefaultWidth >= display.w || DefaultHeight >= display.h) {
-        SDL_MaximizeWindow(window);
-    }
-    
-    glContext = SDL_GL_CreateContext(window);
-    SDL_GL_MakeCurrent(window, glContext);
-    SDL_GL_SetSwapInterval(settings->data().vsync);
-
-    if (!gladLoadGL((GLADloadfunc)SDL_GL_GetProcAddress)) {
-        LOG_ERROR("Failed to load glad.");
-        return false;
-    }
-    
-    if (!imguiSetup()) {
-        LOG_ERROR("Failed to setup ImGui");
-        return false;
-    }
-
-    events = std::make_unique<EventSystem>();
-    events->setup();
-    // register custom events with sdl
-    OFS_Events::RegisterEvents();
-    FunscriptEvents::RegisterEvents();
-    VideoEvents::RegisterEvents();
-    KeybindingEvents::RegisterEvents();
-    ScriptTimelineEvents::RegisterEvents();
-
-    IO = std::make_unique<OFS_AsyncIO>();
-    IO->Init();
-    LoadedProject = std::make_unique<OFS_Project>();
-	
-    player = std::make_unique<VideoplayerWindow>();
-    if (!player->setup(settings->data().force_hw_decoding)) {
-        LOG_ERROR("Failed to init video player");
-        return false;
-    }
-    OFS_ScriptSettings::player = &player->settings;
-    playerControls.setup();
-    playerControls.player = player.get();
-    closeProject(true);
-
-    undoSystem = std::make_unique<UndoSystem>(&LoadedProject->Funscripts);
-
-    keybinds.setup(*events);
-    registerBindings(); // needs to happen before setBindings
-    keybinds.load(Util::Prefpath("keybinds.json"));
-
-    scriptTimeline.setup(undoSystem.get());
-
-    scripting = std::make_unique<ScriptingMode>();
-    scripting->setup();
-    events->Subscribe(FunscriptEvents::FunscriptActionsChangedEvent, EVENT_SYSTEM_BIND(this, &OpenFunscripter::FunscriptChanged));
-    events->Subscribe(SDL_DROPFILE, EVENT_SYSTEM_BIND(this, &OpenFunscripter::DragNDrop));
-    events->Subscribe(VideoEvents::MpvVideoLoaded, EVENT_SYSTEM_BIND(this, &OpenFunscripter::MpvVideoLoaded));
-    events->Subscribe(SDL_CONTROLLERAXISMOTION, EVENT_SYSTEM_BIND(this, &OpenFunscripter::ControllerAxisPlaybackSpeed));
-    events->Subscribe(ScriptTimelineEvents::FunscriptActionClicked, EVENT_SYSTEM_BIND(this, &OpenFunscripter::ScriptTimelineActionClicked));
-    events->Subscribe(ScriptTimelineEvents::SetTimePosition, EVENT_SYSTEM_BIND(this, &OpenFunscripter::ScriptTimelineDoubleClick));
-    events->Subscribe(ScriptTimelineEvents::FunscriptSelectTime, EVENT_SYSTEM_BIND(this, &OpenFunscripter::ScriptTimelineSelectTime));
-    events->Subscribe(VideoEvents::PlayPauseChanged, EVENT_SYSTEM_BIND(this, &OpenFunscripter::MpvPlayPauseChange));
-    events->Subscribe(ScriptTimelineEvents::ActiveScriptChanged, EVENT_SYSTEM_BIND(this, &OpenFunscripter::ScriptTimelineActiveScriptChanged));
+        window = SDL_CreateWindow(
+            "OpenFunscripter " OFS_LATEST_GIT_TAG "@" OFS_LATEST_GIT_HASH,
+            SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+            DefaultWidth, DefaultHeight,
+            SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_HIDDEN
+        );
 
-    // hook up settings
-    OFS_Project::ProjSettings::Simulator = &simulator.simulator;
+        SDL_Rect display;
+        int windowDisplay = SDL_GetWindowDisplayIndex(window);
+        SDL_GetDisplayBounds(windowDisplay, &display);
+        if (DefaultWidth >= display.w || DefaultHeight >= display.h) {
+            SDL_MaximizeWindow(window);
+        }
+        
+        glContext = SDL_GL_CreateContext(window);
+        SDL_GL_MakeCurrent(window, glContext);
+        SDL_GL_SetSwapInterval(settings->data().vsync);
 
-    if (argc > 1) {
-        const char* path = argv[1];
-        openFile(path, false);
-    } else if (!settings->data().recentFiles.empty()) {
-        auto& project = settings->data().recentFiles.back().projectPath;
-        if (!project.empty()) {
-            openProject(project, false);           
+        if (!gladLoadGL((GLADloadfunc)SDL_GL_GetProcAddress)) {
+            LOG_ERROR("Failed to load glad.");
+            return false;
+        }
+        return true;
+    });
+    auto imguiStage = startup.Add("ImGui", Thread::Main, { windowStage, translationStage }, [this, &translationLoaded]() {
+        if (!imguiSetup()) {
+            LOG_ERROR("Failed to setup ImGui");
+            return false;
+        }
+        if (translationLoaded) {
+            OFS_DynFontAtlas::AddTranslationText();
+        }
+        return true;
+    });
+    auto eventStage = startup.Add("Events", Thread::Main, { sdlStage }, [this]() {
+        events = std::make_unique<EventSystem>();
+        events->setup();
+        // register custom events with sdl
+        OFS_Events::RegisterEvents();
+        FunscriptEvents::RegisterEvents();
+        VideoEvents::RegisterEvents();
+        KeybindingEvents::RegisterEvents();
+        ScriptTimelineEvents::RegisterEvents();
+        return true;
+    });
+    auto playerStage = startup.Add("Player", Thread::Main, { imguiStage, eventStage, mpvStage }, [this]() {
+        IO = std::make_unique<OFS_AsyncIO>();
+        IO->SetSyncPolicy(OFS_AsyncIO::PriorityClass::UserSave, (OFS_AsyncIO::SyncPolicy)settings->data().save_sync_policy);
+        IO->Init();
+        LoadedProject = std::make_unique<OFS_Project>();
+
+        if (!player->setup(settings->data().force_hw_decoding)) {
+            LOG_ERROR("Failed to init video player");
+            return false;
+        }
+        OFS_ScriptSettings::player = &player->settings;
+        playerControls.setup();
+        playerControls.player = player.get();
+        closeProject(true);
+
+        undoSystem = std::make_unique<UndoSystem>(&LoadedProject->Funscripts);
+        return true;
+    });
+    auto bindingStage = startup.Add("Keybindings", Thread::Main, { eventStage, translationStage, bindingFileStage }, [this, &bindingsLoaded, &loadedBindings]() {
+        keybinds.setup(*events);
+        registerBindings(); // needs to happen before setBindings
+        keybinds.applyLoaded(Util::Prefpath("keybinds.json"), bindingsLoaded ? &loadedBindings : nullptr);
+        return true;
+    });
+    auto interfaceStage = startup.Add("Interface", Thread::Main, { playerStage, bindingStage }, [this, openPath]() {
+        scriptTimeline.setup(undoSystem.get());
+
+        scripting = std::make_unique<ScriptingMode>();
+        scripting->setup();
+        events->Subscribe(FunscriptEvents::FunscriptActionsChangedEvent, EVENT_SYSTEM_BIND(this, &OpenFunscripter::FunscriptChanged));
+        events->Subscribe(SDL_DROPFILE, EVENT_SYSTEM_BIND(this, &OpenFunscripter::DragNDrop));
+        events->Subscribe(VideoEvents::MpvVideoLoaded, EVENT_SYSTEM_BIND(this, &OpenFunscripter::MpvVideoLoaded));
+        events->Subscribe(SDL_CONTROLLERAXISMOTION, EVENT_SYSTEM_BIND(this, &OpenFunscripter::ControllerAxisPlaybackSpeed));
+        events->Subscribe(ScriptTimelineEvents::FunscriptActionClicked, EVENT_SYSTEM_BIND(this, &OpenFunscripter::ScriptTimelineActionClicked));
+        events->Subscribe(ScriptTimelineEvents::SetTimePosition, EVENT_SYSTEM_BIND(this, &OpenFunscripter::ScriptTimelineDoubleClick));
+        events->Subscribe(ScriptTimelineEvents::FunscriptSelectTime, EVENT_SYSTEM_BIND(this, &OpenFunscripter::ScriptTimelineSelectTime));
+        events->Subscribe(VideoEvents::PlayPauseChanged, EVENT_SYSTEM_BIND(this, &OpenFunscripter::MpvPlayPauseChange));
+        events->Subscribe(ScriptTimelineEvents::ActiveScriptChanged, EVENT_SYSTEM_BIND(this, &OpenFunscripter::ScriptTimelineActiveScriptChanged));
+
+        // hook up settings
+        OFS_Project::ProjSettings::Simulator = &simulator.simulator;
+
+        if (openPath != nullptr) {
+            openFile(openPath, false);
+        } else if (!settings->data().recentFiles.empty()) {
+            auto& project = settings->data().recentFiles.back().projectPath;
+            if (!project.empty()) {
+                openProject(project, false);           
+            }
         }
-    }
 
-    specialFunctions = std::make_unique<SpecialFunctionsWindow>();
-    controllerInput = std::make_unique<ControllerInput>();
-    controllerInput->setup(*events);
-    simulator.setup();
+        specialFunctions = std::make_unique<SpecialFunctionsWindow>();
+        controllerInput = std::make_unique<ControllerInput>();
+        controllerInput->setup(*events);
+        simulator.setup();
 
-    sim3D = std::make_unique<Simulator3D>();
-    sim3D->setup();
+        // sets itself up once it's shown
+        sim3D = std::make_unique<Simulator3D>();
 
-    // callback that renders the simulator right after the video
-    
-    player->OnRenderCallback = [](const ImDrawList * parent_list, const ImDrawCmd * cmd) {
-        auto app = OpenFunscripter::ptr;
-        if (app->settings->data().show_simulator_3d) {
-            app->sim3D->renderSim();
-        }
-    };
+        // callback that renders the simulator right after the video
+        player->OnRender = [](ImDrawList* drawList) {
+            auto app = OpenFunscripter::ptr;
+            if (app->settings->data().show_simulator_3d) {
+                app->sim3D->AddRenderCallback(drawList);
+            }
+        };
 
-    HeatmapGradient::Init();
-    tcode = std::make_unique<TCodePlayer>();
-    tcode->loadSettings(Util::Prefpath("tcode.json"));
-    extensions = std::make_unique<OFS_LuaExtensions>();
-    extensions->Init();
+        HeatmapGradient::Init();
 
 #ifdef WIN32
-    OFS_DownloadFfmpeg::FfmpegMissing = !Util::FileExists(Util::FfmpegPath().u8string());
+        OFS_DownloadFfmpeg::FfmpegMissing = !Util::FileExists(Util::FfmpegPath().u8string());
 #endif
+        return true;
+    });
+    auto extensionStage = startup.Add("Extensions", Thread::Main, { interfaceStage, extensionFileStage }, [this]() {
+        return extensions->Init();
+    });
+    startup.Add("Render thread", Thread::Main, { extensionStage }, [this]() {
+        // everything which can't be shared between contexts (vaos, fbos, mpv) exists by now
+        // later ones get created through OFS_RenderThread::Enqueue
+        OFS_RenderThread::SetSwapCallback([]() { OpenFunscripter::ptr->player->NotifySwap(); });
+        OFS_RenderThread::Init(window, glContext);
+        return true;
+    });
+
+    bool success = startup.Run();
+    if (startupTrace) {
+        startup.Report();
+    }
+    if (!success) {
+        return false;
+    }
 
     SDL_ShowWindow(window);
     return true;
@@ -1509,11 +1593,6 @@ void OpenFunscripter::registerBindings()
 void OpenFunscripter::newFrame() noexcept
 {
     OFS_PROFILE(__FUNCTION__);
-    ImGuiIO& io = ImGui::GetIO();
-    glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
-    glClearColor(0.1f, 0.1f, 0.1f, 1.f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
     // Start the Dear ImGui frame
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplSDL2_NewFrame();
@@ -1528,21 +1607,8 @@ void OpenFunscripter::render() noexcept
 {
     OFS_PROFILE(__FUNCTION__);
     ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-    // Update and Render additional Platform Windows
-    // (Platform functions may change the current OpenGL context, so we save/restore it to make it easier to paste this code elsewhere.
-    //  For this specific demo app we could also call SDL_GL_MakeCurrent(window, gl_context) directly)
-    ImGuiIO& io = ImGui::GetIO();
-    if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
-    {
-        SDL_Window* backup_current_window = SDL_GL_GetCurrentWindow();
-        SDL_GLContext backup_current_context = SDL_GL_GetCurrentContext();
-        ImGui::UpdatePlatformWindows();
-        ImGui::RenderPlatformWindowsDefault();
-        SDL_GL_MakeCurrent(backup_current_window, backup_current_context);
-    }
-    glFlush();
-    glFinish();
+    // the render thread draws this while the next frame gets built
+    OFS_RenderThread::Submit();
 }
 
 void OpenFunscripter::processEvents() noexcept
@@ -1551,6 +1617,7 @@ void OpenFunscripter::processEvents() noexcept
     SDL_Event event;
     bool IsExiting = false;
     while (SDL_PollEvent(&event)) {
+        OFS_Redraw::Request();
         ImGui_ImplSDL2_ProcessEvent(&event);
         switch (event.type) {
         case SDL_QUIT:
@@ -1588,6 +1655,7 @@ void OpenFunscripter::processEvents() noexcept
         }
         events->Propagate(event);
     }
+    events->DeliverCoalesced();
 }
 
 void OpenFunscripter::FunscriptChanged(SDL_Event& ev) noexcept
@@ -1602,7 +1670,21 @@ void OpenFunscripter::FunscriptChanged(SDL_Event& ev) noexcept
             break;
         }
     }
-    
+
+    if (ptr == ActiveFunscript().get()) {
+        // data2 holds the merged range of all changes since the last delivery
+        invalidateHeatmap(ev.user.data2 ? *(EventRange*)ev.user.data2 : EventRange::All());
+    }
+}
+
+void OpenFunscripter::invalidateHeatmap(const EventRange& range) noexcept
+{
+    if (Status & OFS_GradientNeedsUpdate) {
+        heatmapRange.Merge(range);
+    }
+    else {
+        heatmapRange = range;
+    }
     Status = Status | OFS_Status::OFS_GradientNeedsUpdate;
 }
 
@@ -1639,14 +1721,14 @@ void OpenFunscripter::MpvVideoLoaded(SDL_Event& ev) noexcept
     LoadedProject->Metadata.duration = player->getDuration();
     player->setPositionExact(LoadedProject->Settings.lastPlayerPosition);
 
-    Status |= OFS_Status::OFS_GradientNeedsUpdate;
+    invalidateHeatmap(EventRange::All());
     const char* VideoName = (const char*)ev.user.data1;
     if (VideoName) {
         scriptTimeline.ClearAudioWaveform();
     }
 
-    tcode->reset();
-    {
+    if (tcode) {
+        tcode->reset();
         std::vector<std::shared_ptr<const Funscript>> scripts;
         scripts.assign(LoadedFunscripts().begin(), LoadedFunscripts().end());
         tcode->setScripts(std::move(scripts));
@@ -1656,6 +1738,7 @@ void OpenFunscripter::MpvVideoLoaded(SDL_Event& ev) noexcept
 void OpenFunscripter::MpvPlayPauseChange(SDL_Event& ev) noexcept
 {
     OFS_PROFILE(__FUNCTION__);
+    if (!tcode) return;
     if ((intptr_t)ev.user.data1) // true == paused
     {
         tcode->stop();
@@ -1673,7 +1756,9 @@ void OpenFunscripter::update() noexcept {
     float& delta = ImGui::GetIO().DeltaTime;
     extensions->Update(delta);
     player->update(delta);
-    ActiveFunscript()->update();
+    for (auto& script : LoadedFunscripts()) {
+        script->update();
+    }
     ControllerInput::UpdateControllers(settings->data().buttonRepeatIntervalMs);
     scripting->update();
     scriptTimeline.Update();
@@ -1682,7 +1767,25 @@ void OpenFunscripter::update() noexcept {
         autoBackup();
     }
 
-    tcode->sync(player->getCurrentPositionSecondsInterp(), player->getSpeed());
+    if (tcode) {
+        tcode->sync(player->getCurrentPositionSecondsInterp(), player->getSpeed(), player->getSeekCount());
+    }
+
+    // playback and dragging change things without any new events
+    if (!player->isPaused() || ImGui::IsAnyMouseDown()) {
+        OFS_Redraw::Request();
+    }
+}
+
+void OpenFunscripter::setupTCode() noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    // ports only get opened from the window, until it's shown there is nothing to play to
+    tcode = std::make_unique<TCodePlayer>();
+    tcode->loadSettings(Util::Prefpath("tcode.json"));
+    std::vector<std::shared_ptr<const Funscript>> scripts;
+    scripts.assign(LoadedFunscripts().begin(), LoadedFunscripts().end());
+    tcode->setScripts(std::move(scripts));
 }
 
 void OpenFunscripter::autoBackup() noexcept
@@ -1731,7 +1834,7 @@ void OpenFunscripter::autoBackup() noexcept
     auto fileName = Util::PathFromString(Util::Format("%s_%02d-%02d-%02d" OFS_PROJECT_EXT ".backup", name.c_str(), time.hour(), time.minute(), time.second()));
     auto savePath = backupDir / fileName; 
     LOGF_INFO("Backup at \"%s\"", savePath.u8string().c_str());
-    LoadedProject->Save(savePath.u8string(), false);
+    LoadedProject->Save(savePath.u8string(), false, OFS_AsyncIO::PriorityClass::Autosave);
 }
 
 void OpenFunscripter::exitApp(bool force) noexcept
@@ -1838,7 +1941,10 @@ void OpenFunscripter::step() noexcept {
     OFS_BEGINPROFILING();
     {
         OFS_PROFILE(__FUNCTION__);
+        // everything from two frames ago gets dropped
+        OFS_FrameArena::NextFrame();
         processEvents();
+        OFS_MainThreadExecutor::Drain(MainThreadJobBudgetMs);
         newFrame();
         update();
         {
@@ -1866,7 +1972,10 @@ void OpenFunscripter::step() noexcept {
             LoadedProject->ShowProjectWindow(&ShowProjectEditor);
 
             extensions->ShowExtensions();
-            tcode->DrawWindow(&settings->data().show_tcode, player->getCurrentPositionSecondsInterp());
+            if (settings->data().show_tcode) {
+                if (!tcode) setupTCode();
+                tcode->DrawWindow(&settings->data().show_tcode, player->getCurrentPositionSecondsInterp());
+            }
 
             OFS_FileLogger::DrawLogWindow(&settings->data().show_debug_log);
 
@@ -1882,7 +1991,7 @@ void OpenFunscripter::step() noexcept {
 
             if (Status & OFS_GradientNeedsUpdate) {
                 Status &= ~(OFS_GradientNeedsUpdate);
-                playerControls.UpdateHeatmap(player->getDuration(), ActiveFunscript()->Actions());
+                playerControls.UpdateHeatmap(player->getDuration(), ActiveFunscript()->Actions(), heatmapRange);
             }
 
             auto drawBookmarks = [&](ImDrawList* draw_list, const ImRect& frame_bb, bool item_hovered) noexcept
@@ -2019,6 +2128,8 @@ void OpenFunscripter::step() noexcept {
 #endif
             if (DebugMetrics) {
                 ImGui::ShowMetricsWindow(&DebugMetrics);
+                events->ShowMetrics(&DebugMetrics);
+                OFS_Memory::ShowMetrics(&DebugMetrics);
             }
 
             player->DrawVideoPlayer(NULL, &settings->data().draw_video);
@@ -2029,8 +2140,6 @@ void OpenFunscripter::step() noexcept {
 
     OFS_FileLogger::Flush();
     OFS_ENDPROFILING();
-    SDL_GL_SwapWindow(window);
-    player->NotifySwap();
 }
 
 int OpenFunscripter::run() noexcept
@@ -2040,6 +2149,17 @@ int OpenFunscripter::run() noexcept
     render();
     const uint64_t PerfFreq = SDL_GetPerformanceFrequency();
     while (!(Status & OFS_Status::OFS_ShouldExit)) {
+        // the text cursor blinks and backups are due on time, everything else requests a redraw
+        int32_t idleTimeoutMs = -1;
+        if (ImGui::GetIO().WantTextInput) {
+            idleTimeoutMs = 500;
+        }
+        else if (Status & OFS_Status::OFS_AutoBackup && LoadedProject->Loaded) {
+            auto sinceBackup = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - lastBackup);
+            idleTimeoutMs = std::max<int32_t>(AutoBackupIntervalSeconds * 1000 - (int32_t)sinceBackup.count(), 0);
+        }
+        OFS_Redraw::Wait(idleTimeoutMs);
+
         const uint64_t minFrameTime = (float)PerfFreq / (float)settings->data().framerateLimit;
         uint64_t FrameStart = SDL_GetPerformanceCounter();
         step();
@@ -2061,6 +2181,7 @@ int OpenFunscripter::run() noexcept
 
 void OpenFunscripter::shutdown() noexcept
 {
+    OFS_RenderThread::Shutdown();
     OFS_DynFontAtlas::Shutdown();
     OFS_Translator::Shutdown();
     
@@ -2193,7 +2314,7 @@ void OpenFunscripter::UpdateNewActiveScript(int32_t activeIndex) noexcept
 {
     ActiveFunscriptIdx = activeIndex;
     updateTitle();
-    Status = Status | OFS_Status::OFS_GradientNeedsUpdate;
+    invalidateHeatmap(EventRange::All());
 }
 
 void OpenFunscripter::updateTitle() noexcept
@@ -2251,7 +2372,7 @@ bool OpenFunscripter::closeProject(bool closeWithUnsavedChanges) noexcept
         ActiveFunscriptIdx = 0;
         LoadedProject->Clear();
         player->closeVideo();
-        playerControls.videoPreview->closeVideo();
+        playerControls.ClosePreview();
         updateTitle();
     }
     return true;
@@ -2651,6 +2772,30 @@ void OpenFunscripter::ShowMainMenuBar() noexcept
                             });
                     }
                 }
+                if (ImGui::BeginMenu(FMT(ICON_SHARE " %s", TR(EXPORT_RESAMPLED)))) {
+                    auto& resample = settings->data().resampleSettings;
+                    ImGui::InputInt(TR(SAMPLE_RATE), &resample.rate, 100, 1000);
+                    resample.rate = Util::Clamp(resample.rate, 1, 10000);
+                    ImGui::Combo(TR(INTERPOLATION), &resample.interpolation,
+                        FunscriptResampler::InterpolationNames, static_cast<int32_t>(FunscriptResampler::Interpolation::TotalCount));
+                    ImGui::Combo(TR(FORMAT), &resample.format,
+                        FunscriptResampler::FormatNames, static_cast<int32_t>(FunscriptResampler::Format::TotalCount));
+                    if (ImGui::MenuItem(TR(EXPORT_MENU))) {
+                        auto format = static_cast<FunscriptResampler::Format>(Util::Clamp(resample.format, 0, static_cast<int32_t>(FunscriptResampler::Format::TotalCount) - 1));
+                        auto interpolation = static_cast<FunscriptResampler::Interpolation>(Util::Clamp(resample.interpolation, 0, static_cast<int32_t>(FunscriptResampler::Interpolation::TotalCount) - 1));
+                        auto extension = FunscriptResampler::FormatExtensions[static_cast<int32_t>(format)];
+                        auto savePath = Util::PathFromString(settings->data().last_path) / (ActiveFunscript()->Title + extension);
+                        float rate = resample.rate;
+                        Util::SaveFileDialog(TR(EXPORT_RESAMPLED), savePath.u8string(),
+                            [this, rate, interpolation, format](auto& result) {
+                                if (result.files.size() > 0) {
+                                    LoadedProject->ExportResampled(result.files[0], rate, interpolation, format);
+                                }
+                            });
+                    }
+                    OFS::Tooltip(TR(EXPORT_RESAMPLED_TOOLTIP));
+                    ImGui::EndMenu();
+                }
                 ImGui::EndMenu();
             }
             ImGui::Separator();
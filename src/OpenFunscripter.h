@@ -52,6 +52,8 @@ private:
 
 	char tmpBuf[2][32];
 	int32_t ActiveFunscriptIdx = 0;
+	// part of the active script the heatmap has to recompute
+	EventRange heatmapRange = EventRange::All();
 
 	void registerBindings();
 
@@ -59,6 +61,9 @@ private:
 	void newFrame() noexcept;
 	void render() noexcept;
 	void autoBackup() noexcept;
+	// tcode gets created the first time its window is shown
+	void setupTCode() noexcept;
+	void invalidateHeatmap(const EventRange& range) noexcept;
 
 	void exitApp(bool force = false) noexcept;
 
@@ -1,7 +1,7 @@
 #include "OFS_DownloadFfmpeg.h"
 #include "OFS_Util.h"
 #include "OFS_Localization.h"
-#include "SDL_thread.h"
+#include "OFS_TaskScheduler.h"
 
 #include <sstream>
 #include <filesystem>
@@ -103,15 +103,14 @@ void OFS_DownloadFfmpeg::DownloadFfmpegModal() noexcept
         if(!ZipExists && !DownloadInProgress) {
             ImGui::TextUnformatted(TR(FFMPEG_WAS_NOT_FOUND_MSG));
             if(ImGui::Button(TR(YES), ImVec2(-1.f, 0.f))) {
-                auto dlThread = [](void* data) -> int {
+                auto download = []() {
                     auto path = Util::PathFromString(Util::Prefpath());
                     auto downloadPath =(path / "ffmpeg.zip").wstring();
                     URLDownloadToFileW(NULL, L"https://www.gyan.dev/ffmpeg/builds/ffmpeg-release-essentials.zip",
                         downloadPath.c_str(), 0, &cb);
-                    return 0;
                 };
                 DownloadInProgress = true;
-                SDL_DetachThread(SDL_CreateThread(dlThread, "downloadFfmpeg", NULL));
+                OFS_TaskScheduler::SubmitLongRunning("downloadFfmpeg", std::move(download));
             }
         }
 
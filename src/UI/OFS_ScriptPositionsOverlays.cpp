@@ -9,7 +9,23 @@ void FrameOverlay::DrawScriptPositionContent(const OverlayDrawingCtx& ctx) noexc
     float visibleFrames = ctx.visibleTime / frameTime;
     constexpr float maxVisibleFrames = 400.f;
    
-    if (visibleFrames <= (maxVisibleFrames * 0.75f)) {
+    auto frameIndex = app->player->getFrameIndex();
+    if (visibleFrames <= (maxVisibleFrames * 0.75f) && frameIndex) {
+        // exact frame dividers, keyframes stand out
+        int alpha = 255 * (1.f - (visibleFrames / maxVisibleFrames));
+        for (int64_t frame = frameIndex->FrameAt(ctx.offsetTime); frame < frameIndex->Count(); frame++) {
+            float x = (frameIndex->Pts[frame] - ctx.offsetTime) / ctx.visibleTime;
+            if (x > 1.f) break;
+            bool keyframe = frameIndex->IsKeyframe(frame);
+            ctx.draw_list->AddLine(
+                ctx.canvas_pos + ImVec2(x * ctx.canvas_size.x, 0.f),
+                ctx.canvas_pos + ImVec2(x * ctx.canvas_size.x, ctx.canvas_size.y),
+                keyframe ? IM_COL32(140, 140, 140, alpha) : IM_COL32(80, 80, 80, alpha),
+                keyframe ? 2.f : 1.f
+            );
+        }
+    }
+    else if (visibleFrames <= (maxVisibleFrames * 0.75f)) {
         //render frame dividers
         float offset = -std::fmod(ctx.offsetTime, frameTime);
         const int lineCount = visibleFrames + 2;
@@ -5,6 +5,8 @@
 
 #include "OFS_Serialization.h"
 #include "OFS_ImGui.h"
+#include "OFS_Redraw.h"
+#include "OFS_RenderThread.h"
 
 #include "imgui.h"
 #include "imgui_stdlib.h"
@@ -35,6 +37,9 @@ void OFS_Settings::save_config()
 void OFS_Settings::load_config()
 {
 	OFS::serializer::load(&scripterSettings, &config());
+	// indexes SyncPolicyNames, a hand edited config shouldn't go out of bounds
+	scripterSettings.save_sync_policy = Util::Clamp<int32_t>(scripterSettings.save_sync_policy,
+		0, static_cast<int32_t>(OFS_AsyncIO::SyncPolicy::TotalCount) - 1);
 }
 
 void OFS_Settings::saveSettings()
@@ -106,10 +111,23 @@ bool OFS_Settings::ShowPreferenceWindow() noexcept
 					ImGui::SameLine();
 					if (ImGui::Checkbox(TR(VSYNC), (bool*)&scripterSettings.vsync)) {
 						scripterSettings.vsync = Util::Clamp(scripterSettings.vsync, 0, 1); // just in case...
-						SDL_GL_SetSwapInterval(scripterSettings.vsync);
+						OFS_RenderThread::SetSwapInterval(scripterSettings.vsync);
 						save = true;
 					}
 					OFS::Tooltip(TR(VSYNC_TOOLTIP));
+					ImGui::SameLine();
+					if (ImGui::Checkbox(TR(IDLE_MODE), &scripterSettings.idle_mode)) {
+						OFS_Redraw::SetContinuous(!scripterSettings.idle_mode);
+						save = true;
+					}
+					OFS::Tooltip(TR(IDLE_MODE_TOOLTIP));
+					if (ImGui::Combo(TR(SAVE_DURABILITY), &scripterSettings.save_sync_policy,
+						OFS_AsyncIO::SyncPolicyNames, (int32_t)OFS_AsyncIO::SyncPolicy::TotalCount)) {
+						OpenFunscripter::ptr->IO->SetSyncPolicy(OFS_AsyncIO::PriorityClass::UserSave,
+							(OFS_AsyncIO::SyncPolicy)scripterSettings.save_sync_policy);
+						save = true;
+					}
+					OFS::Tooltip(TR(SAVE_DURABILITY_TOOLTIP));
 					ImGui::Separator();
 					ImGui::InputText(TR(FONT), scripterSettings.font_override.empty() ? (char*)TR(DEFAULT_FONT) : (char*)scripterSettings.font_override.c_str(),
 						scripterSettings.font_override.size(), ImGuiInputTextFlags_ReadOnly);
@@ -127,24 +145,22 @@ bool OFS_Settings::ShowPreferenceWindow() noexcept
 					ImGui::SameLine();
 					if (ImGui::Button(TR(CLEAR))) {
 						scripterSettings.font_override = "";
-						EventSystem::SingleShot([](void* ctx) {
+						OFS_MainThreadExecutor::Post([]() {
 							// fonts can't be updated during a frame
-							// this updates the font during event processing
-							// which is not during the frame
+							// this updates the font before the next one starts
 							auto app = OpenFunscripter::ptr;
 							app->LoadOverrideFont(app->settings->data().font_override);
-							}, nullptr);
+							});
 					}
 
 					if (ImGui::InputInt(TR(FONT_SIZE), (int*)&scripterSettings.default_font_size, 1, 1)) {
 						scripterSettings.default_font_size = Util::Clamp(scripterSettings.default_font_size, 8, 64);
-						EventSystem::SingleShot([](void* ctx) {
+						OFS_MainThreadExecutor::Post([]() {
 							// fonts can't be updated during a frame
-							// this updates the font during event processing
-							// which is not during the frame
+							// this updates the font before the next one starts
 							auto app = OpenFunscripter::ptr;
 							app->LoadOverrideFont(app->settings->data().font_override);
-							}, nullptr);
+							});
 						save = true;
 					}
 					if(ImGui::BeginCombo(TR_ID("LANGUAGE", Tr::LANGUAGE), data().language_csv.empty() ? "English" : data().language_csv.c_str()))
@@ -59,6 +59,7 @@ private:
 
 		int32_t	vsync = 0;
 		int32_t framerateLimit = 150;
+		bool idle_mode = true;
 
 		int32_t action_insert_delay_ms = 0;
 
@@ -66,6 +67,8 @@ private:
 
 		int32_t buttonRepeatIntervalMs = 100;
 
+		int32_t save_sync_policy = 2; // OFS_AsyncIO::SyncPolicy::Full
+
 		struct HeatmapSettings {
 			int32_t defaultWidth = 2000;
 			int32_t defaultHeight = 50;
@@ -78,6 +81,18 @@ private:
 			}
 		} heatmapSettings;
 
+		struct ResampleSettings {
+			int32_t rate = 1000;
+			int32_t interpolation = 0; // FunscriptResampler::Interpolation
+			int32_t format = 0; // FunscriptResampler::Format
+			template <class Archive>
+			inline void reflect(Archive& ar) {
+				OFS_REFLECT(rate, ar);
+				OFS_REFLECT(interpolation, ar);
+				OFS_REFLECT(format, ar);
+			}
+		} resampleSettings;
+
 		Funscript::Metadata defaultMetadata;
 		ScriptSimulator::SimulatorSettings defaultSimulatorConfig;
 
@@ -107,12 +122,15 @@ private:
 			OFS_REFLECT(force_hw_decoding, ar);
 			OFS_REFLECT(recentFiles, ar);
 			OFS_REFLECT(heatmapSettings, ar);
+			OFS_REFLECT(resampleSettings, ar);
 			OFS_REFLECT(mirror_mode, ar);
 			OFS_REFLECT(action_insert_delay_ms, ar);
 			OFS_REFLECT(currentSpecialFunction, ar);
 			OFS_REFLECT(vsync, ar);
 			OFS_REFLECT(framerateLimit, ar);
+			OFS_REFLECT(idle_mode, ar);
 			OFS_REFLECT(buttonRepeatIntervalMs, ar);
+			OFS_REFLECT(save_sync_policy, ar);
 			OFS_REFLECT(font_override, ar);
 			OFS_REFLECT(show_tcode, ar);
 			OFS_REFLECT(defaultMetadata, ar);
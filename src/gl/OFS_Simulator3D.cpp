@@ -14,6 +14,8 @@
 #include "OFS_ImGui.h"
 #include "OpenFunscripter.h"
 #include "OFS_Shader.h"
+#include "OFS_Allocator.h"
+#include "OFS_RenderThread.h"
 
 // cube pos + normals
 constexpr float vertices[] = {
@@ -97,28 +99,35 @@ void Simulator3D::save(const std::string& path) noexcept
 
 Simulator3D::~Simulator3D()
 {
+    // never shown, don't overwrite the settings with defaults
+    if (!lightShader) return;
     auto path = Util::Prefpath("sim3d.json");
     save(path);
 }
 
 void Simulator3D::setup() noexcept
 {
+    OFS_PROFILE(__FUNCTION__);
 	lightShader = std::make_unique<LightingShader>();
 
-    glGenVertexArrays(1, &cubeVAO);
     glGenBuffers(1, &VBO);
-
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-    glBindVertexArray(cubeVAO);
-
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    // normal attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    // vaos aren't shared, the render thread needs its own
+    OFS_RenderThread::Enqueue([this, vbo = VBO]() {
+        glGenVertexArrays(1, &cubeVAO);
+        glBindVertexArray(cubeVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+        // position attribute
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        // normal attribute
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glBindVertexArray(0);
+    });
 
     reset();
     auto path = Util::Prefpath("sim3d.json");
@@ -129,6 +138,8 @@ void Simulator3D::ShowWindow(bool* open, float currentTime, bool easing, std::ve
 {
     if (open != nullptr && !*open) { return; }
     OFS_PROFILE(__FUNCTION__);
+    // set up the first time it's shown
+    if (!lightShader) setup();
     const int32_t loadedScriptsCount = scripts.size();
     auto viewport = ImGui::GetMainViewport();
     
@@ -388,38 +399,59 @@ void Simulator3D::ShowWindow(bool* open, float currentTime, bool easing, std::ve
     twistBox = glm::scale(twistBox, glm::vec3(simCubeSize, simCubeSize/4.f, simCubeSize)*1.5f);
 }
 
-void Simulator3D::renderSim() noexcept
+void Simulator3D::AddRenderCallback(ImDrawList* drawList) noexcept
+{
+    if (!lightShader) return;
+    RenderState state;
+    state.shader = lightShader.get();
+    state.vao = &cubeVAO;
+    state.viewportSize = ImGui::GetMainViewport()->Size;
+    state.projection = projection;
+    state.view = view;
+    state.boxModel = boxModel;
+    state.containerModel = containerModel;
+    state.twistBox = twistBox;
+    state.viewPos = viewPos;
+    state.lightPos = lightPos;
+    state.boxColor = boxColor;
+    state.containerColor = containerColor;
+    state.twistBoxColor = twistBoxColor;
+    drawList->AddCallback(renderSim, OFS_FrameArena::Copy(state));
+}
+
+void Simulator3D::renderSim(const ImDrawList* parentList, const ImDrawCmd* cmd) noexcept
 {
     OFS_PROFILE(__FUNCTION__);
-    auto viewport = ImGui::GetMainViewport();
-    glViewport(0, 0, viewport->Size.x, viewport->Size.y);
+    auto& state = *(const RenderState*)cmd->UserCallbackData;
+    auto& lightShader = *state.shader;
+    glViewport(0, 0, state.viewportSize.x, state.viewportSize.y);
     glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_BLEND);
 
-    lightShader->use();
-    lightShader->LightPos(glm::value_ptr(lightPos));
-    lightShader->ProjectionMtx(glm::value_ptr(projection));
-    lightShader->ViewMtx(glm::value_ptr(view));
-    lightShader->ViewPos(glm::value_ptr(viewPos));
+    lightShader.use();
+    lightShader.LightPos(glm::value_ptr(state.lightPos));
+    lightShader.ProjectionMtx(glm::value_ptr(state.projection));
+    lightShader.ViewMtx(glm::value_ptr(state.view));
+    lightShader.ViewPos(glm::value_ptr(state.viewPos));
 
-    lightShader->ObjectColor(&boxColor.Value.x);
-    lightShader->ModelMtx(glm::value_ptr(boxModel));
+    lightShader.ObjectColor(&state.boxColor.Value.x);
+    lightShader.ModelMtx(glm::value_ptr(state.boxModel));
 
     // render the cube
-    glBindVertexArray(cubeVAO);
+    glBindVertexArray(*state.vao);
     glDrawArrays(GL_TRIANGLES, 0, 36);
 
 
-    lightShader->ObjectColor(&containerColor.Value.x);
-    lightShader->ModelMtx(glm::value_ptr(containerModel));
-    glBindVertexArray(cubeVAO);
+    lightShader.ObjectColor(&state.containerColor.Value.x);
+    lightShader.ModelMtx(glm::value_ptr(state.containerModel));
+    glBindVertexArray(*state.vao);
     glDrawArrays(GL_TRIANGLES, 0, 36);
 
 
-    lightShader->ObjectColor(&twistBoxColor.Value.x);
-    lightShader->ModelMtx(glm::value_ptr(twistBox));
-    glBindVertexArray(cubeVAO);
+    lightShader.ObjectColor(&state.twistBoxColor.Value.x);
+    lightShader.ModelMtx(glm::value_ptr(state.twistBox));
+    glBindVertexArray(*state.vao);
     glDrawArrays(GL_TRIANGLES, 0, 36);
 
     glDisable(GL_DEPTH_TEST);
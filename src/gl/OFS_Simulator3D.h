@@ -26,6 +26,7 @@ private:
 	std::unique_ptr<class LightingShader> lightShader;
 
 	unsigned int VBO = 0;
+	// created and used on the render thread only
 	unsigned int cubeVAO = 0;
 	bool TranslateEnabled = false;
 
@@ -68,6 +69,25 @@ private:
 	float globalYaw = 0.f;
 	float globalPitch = 0.f;
 
+	// a copy of everything the draw callback needs, it runs on the render thread
+	struct RenderState {
+		class LightingShader* shader;
+		// the vao only exists on the render thread
+		const uint32_t* vao;
+		ImVec2 viewportSize;
+		glm::mat4 projection;
+		glm::mat4 view;
+		glm::mat4 boxModel;
+		glm::mat4 containerModel;
+		glm::mat4 twistBox;
+		glm::vec3 viewPos;
+		glm::vec3 lightPos;
+		ImColor boxColor;
+		ImColor containerColor;
+		ImColor twistBoxColor;
+	};
+	static void renderSim(const ImDrawList* parentList, const ImDrawCmd* cmd) noexcept;
+
 	void reset() noexcept;
 
 	void load(const std::string& path) noexcept;
@@ -77,10 +97,11 @@ public:
 	int32_t PitchOverride = -1;
 
 	~Simulator3D();
+	// happens on the first ShowWindow
 	void setup() noexcept;
 
 	void ShowWindow(bool* open, float currentTime, bool easing, std::vector<std::shared_ptr<class Funscript>>& scripts) noexcept;
-	void renderSim() noexcept;
+	void AddRenderCallback(ImDrawList* drawList) noexcept;
 
 
 	template <class Archive>
@@ -2,6 +2,7 @@
 #include "OFS_LuaExtensions.h"
 #include "OFS_Util.h"
 #include "OpenFunscripter.h"
+#include "OFS_Redraw.h"
 
 #include <string>
 
@@ -62,7 +63,7 @@ void OFS_LuaExtension::Update() noexcept
 	}
 }
 
-bool OFS_LuaExtension::Load() noexcept
+bool OFS_LuaExtension::Prepare() noexcept
 {
     auto directory = Util::PathFromString(this->Directory);
     auto mainFile = directory / OFS_LuaExtension::MainFile;
@@ -86,6 +87,8 @@ bool OFS_LuaExtension::Load() noexcept
 	//MaxGuiTime = 0.f;
 	//Bindables.clear();
 
+	// references have to go before the state they point into
+	mainChunk = sol::protected_function();
 	L = sol::state();
 	L.open_libraries(
 		sol::lib::base,
@@ -129,6 +132,8 @@ bool OFS_LuaExtension::Load() noexcept
 		}
 		return nullptr;
 	};
+	// update only gets called for frames which are drawn, that stops while idling
+	ofs["RequestUpdate"] = []() noexcept { OFS_Redraw::Request(); };
 
 	api = std::make_unique<OFS_ExtensionAPI>(ofs);
 	
@@ -148,10 +153,31 @@ bool OFS_LuaExtension::Load() noexcept
 	});
 #endif
 
+	auto chunk = L.load(extensionText);
+	if(!chunk.valid()) {
+		sol::error err = chunk;
+		AddError(err.what());
+		return false;
+	}
+	mainChunk = chunk.get<sol::protected_function>();
+	return true;
+}
+
+bool OFS_LuaExtension::Load() noexcept
+{
+	// startup prepares every active extension on the workers
+	if(!mainChunk.valid() && !Prepare()) return false;
+	auto chunk = std::move(mainChunk);
+	mainChunk = sol::protected_function();
+
 	try
 	{
-		auto res = L.safe_script(extensionText);
-		FUN_ASSERT(res.valid(), "what");
+		auto res = chunk();
+		if(res.status() != sol::call_status::ok) {
+			auto err = sol::stack::get_traceback_or_errors(L.lua_state());
+			AddError(err.what());
+			return false;
+		}
 
 		auto init = L.get<sol::protected_function>(OFS_LuaExtensions::InitFunction);
 		res = init();
@@ -212,6 +238,7 @@ void OFS_LuaExtension::Shutdown() noexcept
 	// MaxUpdateTime = 0.f;
 	// MaxGuiTime = 0.f;
 	// Bindables.clear();
+	mainChunk = sol::protected_function();
 	L = sol::state();
 	Active = false;
 }
\ No newline at end of file
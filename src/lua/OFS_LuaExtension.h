@@ -12,6 +12,8 @@ class OFS_LuaExtension
 {
 	private:
 		sol::state L;
+		// compiled by Prepare, runs in Load
+		sol::protected_function mainChunk;
 		std::unique_ptr<OFS_ExtensionAPI> api = nullptr;
 		bool Active = false;
     public:
@@ -40,6 +42,9 @@ class OFS_LuaExtension
 			//Hash = Util::Hash(Directory.c_str(), Directory.size());
 		}
 
+		// reads and compiles main.lua into a fresh state, nothing else is touched so it can run on any thread
+		bool Prepare() noexcept;
+		// main thread, runs main.lua and init
 		bool Load() noexcept;
 		
 		void AddError(const char* str) noexcept
@@ -3,6 +3,7 @@
 #include "OFS_Util.h"
 #include "OFS_Profiling.h"
 #include "OFS_LuaCoreExtension.h"
+#include "OFS_TaskScheduler.h"
 
 bool OFS_LuaExtensions::DevMode = false;
 bool OFS_LuaExtensions::ShowLogs = false;
@@ -17,15 +18,11 @@ inline static void ShowExtensionLogWindow(bool* open) noexcept
 
 OFS_LuaExtensions::OFS_LuaExtensions() noexcept
 {
+	// only files, this gets constructed on a worker during startup
 	load(Util::Prefpath("extension.json"));
 	UpdateExtensionList();
 	
 	OFS_CoreExtension::setup();
-
-	auto app = OpenFunscripter::ptr;
-	app->keybinds.registerDynamicHandler(OFS_LuaExtensions::DynamicBindingHandler, 
-		[this](Binding* b) { HandleBinding(b); }
-	);
 }
 
 OFS_LuaExtensions::~OFS_LuaExtensions() noexcept
@@ -36,8 +33,26 @@ OFS_LuaExtensions::~OFS_LuaExtensions() noexcept
     }
 }
 
+void OFS_LuaExtensions::Prepare() noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	// every extension has its own state
+	OFS_TaskScheduler::ParallelFor(0, Extensions.size(), 1, [this](int64_t begin, int64_t end) {
+		for (int64_t i = begin; i < end; i++) {
+			auto& ext = Extensions[i];
+			if (ext.IsActive()) ext.Prepare();
+		}
+	});
+}
+
 bool OFS_LuaExtensions::Init() noexcept
 {
+	OFS_PROFILE(__FUNCTION__);
+	auto app = OpenFunscripter::ptr;
+	app->keybinds.registerDynamicHandler(OFS_LuaExtensions::DynamicBindingHandler, 
+		[this](Binding* b) { HandleBinding(b); }
+	);
+
 	for (auto& ext : Extensions) {
 		if (ext.IsActive()) ext.Load();
 	}
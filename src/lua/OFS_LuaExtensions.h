@@ -50,6 +50,9 @@ class OFS_LuaExtensions
 
         void UpdateExtensionList() noexcept;
 
+        // compiles the active extensions in parallel, safe on any thread
+        void Prepare() noexcept;
+        // main thread, runs the active extensions
         bool Init() noexcept;
         void Update(float delta) noexcept;
         void ShowExtensions() noexcept;
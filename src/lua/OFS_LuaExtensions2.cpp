@@ -955,10 +955,9 @@ static int LuaCommitChanges(lua_State* L) noexcept
 		CommitScriptChanges(L);
 	}
 	else if(nargs >= 1) {
-		auto handle = EventSystem::ev().WaitableSingleShot([](void* ctx) noexcept {
-			CommitScriptChanges((lua_State*)ctx);
-		}, (void*)L);
-		handle->wait();
+		OFS_MainThreadExecutor::RunAndWait([L]() noexcept {
+			CommitScriptChanges(L);
+		});
 	}
 	return 0;
 }
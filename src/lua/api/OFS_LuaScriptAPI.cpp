@@ -67,10 +67,9 @@ bool OFS_ScriptAPI::Undo() noexcept
 LuaFunscript::LuaFunscript(std::weak_ptr<Funscript> script) noexcept
     : script(script)
 {
-    EventSystem::RunOnMain([&](void*) {
+    OFS_MainThreadExecutor::RunAndWait([&]() {
         this->TakeSnapshot();
-    }, nullptr)
-    ->Wait();
+    });
 }
 
 LuaFunscript::LuaFunscript(const FunscriptArray& actions) noexcept
@@ -82,7 +81,7 @@ LuaFunscript::LuaFunscript(const FunscriptArray& actions) noexcept
 
 void LuaFunscript::Commit(sol::this_state L) noexcept
 {
-    EventSystem::RunOnMain([&](void*){
+    OFS_MainThreadExecutor::RunAndWait([&]() {
         auto app = OpenFunscripter::ptr;
         auto ref = script.lock();
         if(ref) {
@@ -103,8 +102,7 @@ void LuaFunscript::Commit(sol::this_state L) noexcept
             ref->SetActions(commit);
             ref->SetSelection(selection, true);
         }
-    }, nullptr)
-    ->Wait();
+    });
 }
 
 const char* LuaFunscript::Path() const noexcept
@@ -1,8 +1,26 @@
 #include "OpenFunscripter.h"
+#include "OFS_TCodeTrace.h"
+#include "OFS_FileLogging.h"
 #include "SDL_main.h"
 
+#include <cstring>
+
 int main(int argc, char* argv[])
 {
+	if (argc > 1 && strcmp(argv[1], "--tcode-benchmark") == 0) {
+		// headless, no window or video player
+		OFS_FileLogger::Init();
+		int code = TCodeTrace::Benchmark(std::vector<std::string>(argv + 2, argv + argc));
+		OFS_FileLogger::Shutdown();
+		return code;
+	}
+	if (argc > 1 && strcmp(argv[1], "--tcode-clock-replay") == 0) {
+		OFS_FileLogger::Init();
+		int code = TCodeTrace::ClockReplay(std::vector<std::string>(argv + 2, argv + argc));
+		OFS_FileLogger::Shutdown();
+		return code;
+	}
+
 	OpenFunscripter app;
 	if(app.setup(argc, argv)) {
 		int code = app.run();